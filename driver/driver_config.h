@@ -1,6 +1,6 @@
 /*
 
-Copyright (c) 2013-2018 Draios Inc. dba Sysdig.
+Copyright (C) 2021 The Falco Authors.
 
 This file is dual licensed under either the MIT or GPL 2. See MIT.txt
 or GPL2.txt for full copies of the license.
@@ -16,4 +16,4 @@ or GPL2.txt for full copies of the license.
 
 #ifndef KBUILD_MODNAME
 #define KBUILD_MODNAME PROBE_NAME
-#endif
\ No newline at end of file
+#endif
@@ -25,6 +25,7 @@ limitations under the License.
 #include <set>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 #include <stdint.h>
 
 namespace sysdig
@@ -40,6 +41,12 @@ namespace sysdig
  * continue to dequeue and process values while the dequeue_next_key() method
  * returns true.
  *
+ * Keys are processed by a pool of up to max_workers threads, started on
+ * demand when all the running ones are busy, so run_impl() may be executed
+ * concurrently by several threads and must be thread-safe.  A given key is
+ * never handed to two workers at the same time: while a worker is looking up
+ * a key, further requests for the same key are satisfied by that lookup.
+ *
  * The constructor for this class accepts a maximum wait time; this specifies
  * how long client code is willing to wait for a synchronous response (i.e.,
  * how long the lookup() method will block waiting for the requested value).
@@ -53,8 +60,9 @@ namespace sysdig
  * <li>If the client supplied a callback handler in the call to lookup(), then
  *     that callback handler will be invoked by the async_key_value_source once
  *     the value has been collected.  Note that the callback handler will be
- *     invoked in the context of the asynchronous thread associated with the
- *     async_key_value_source.</li>
+ *     invoked in the context of one of the asynchronous threads associated
+ *     with the async_key_value_source (callbacks are never run concurrently
+ *     with each other).</li>
  * <li>If the client did not supply a handler, then the value will be stored,
  *     and the next call to the lookup() method with the same key will return
  *     the previously collected value.  If lookup() is not called with the
@@ -95,8 +103,12 @@ public:
 	 * @param[in] ttl_ms      The time, in milliseconds, that a cached
 	 *                        value will live before being considered
 	 *                        "too old" and being pruned.
+	 * @param[in] max_workers The maximum number of lookups that may run
+	 *                        concurrently.
 	 */
-	async_key_value_source(uint64_t max_wait_ms, uint64_t ttl_ms) noexcept;
+	async_key_value_source(uint64_t max_wait_ms,
+			       uint64_t ttl_ms,
+			       uint32_t max_workers = 1) noexcept;
 
 	async_key_value_source(const async_key_value_source&) = delete;
 	async_key_value_source(async_key_value_source&&) = delete;
@@ -116,6 +128,11 @@ public:
 	 */
 	uint64_t get_ttl() const;
 
+	/**
+	 * Returns the maximum number of worker threads doing lookups.
+	 */
+	uint32_t get_max_workers() const;
+
 	/**
 	 * Lookup value(s) based on the given key.  This method will block
 	 * the caller for up the max_wait_ms time specified at construction
@@ -161,8 +178,8 @@ public:
                     const callback_handler& handler = callback_handler());
 
 	/**
-	 * Determines if the async thread associated with this
-	 * async_key_value_source is running.
+	 * Determines if the async threads associated with this
+	 * async_key_value_source are running.
 	 *
 	 * <b>Note:</b> This API is for information only.  Clients should
 	 * not use this to implement any sort of complex behavior.  Such
@@ -170,7 +187,7 @@ public:
 	 * lookup() could potentially race, causing is_running() to return
 	 * false after lookup() has started the thread.
 	 *
-	 * @returns true if the async thread is running, false otherwise.
+	 * @returns true if the async threads are running, false otherwise.
 	 */
 	bool is_running() const;
 
@@ -200,9 +217,9 @@ public:
 
 protected:
 	/**
-	 * Stops the thread associated with this async_key_value_source, if
-	 * it is running; otherwise, does nothing.  The only use for this is
-	 * in a destructor to ensure that the async thread stops when the
+	 * Stops the threads associated with this async_key_value_source, if
+	 * they are running; otherwise, does nothing.  The only use for this is
+	 * in a destructor to ensure that the async threads stop when the
 	 * object is destroyed.
 	 */
 	void stop();
@@ -210,7 +227,8 @@ protected:
 	/**
 	 * Dequeues an entry from the request queue and returns it in the given
 	 * key.  Concrete subclasses will call this method to get the next key
-	 * for which to collect values.
+	 * for which to collect values.  Keys that are already being looked up
+	 * by another worker are skipped.
 	 *
 	 * @returns true if there was a key to dequeue, false otherwise.
 	 */
@@ -312,9 +330,23 @@ private:
 	 */
 	void prune_stale_requests();
 
+	/**
+	 * Forget the key the calling worker thread is looking up, if any.
+	 * This method expects that the caller is holding m_mutex.
+	 */
+	void release_in_flight_key();
+
+	/**
+	 * Returns true if the key is being looked up by a worker thread.
+	 * This method expects that the caller is holding m_mutex.
+	 */
+	bool is_in_flight(const key_type& key) const;
+
 	uint64_t m_max_wait_ms;
 	uint64_t m_ttl_ms;
-	std::thread m_thread;
+	uint32_t m_max_workers;
+	std::vector<std::thread> m_threads;
+	uint32_t m_idle_workers;
 	bool m_running;
 	bool m_terminate;
 
@@ -335,6 +367,11 @@ private:
 	std::priority_queue<queue_item_t, std::vector<queue_item_t>, std::greater<queue_item_t>> m_request_queue;
 	std::set<key_type> m_request_set;
 	value_map m_value_map;
+
+	/**
+	 * The key each worker thread is currently looking up.
+	 */
+	std::map<std::thread::id, key_type> m_in_flight;
 };
 
 
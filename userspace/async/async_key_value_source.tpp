@@ -31,10 +31,13 @@ namespace sysdig
 template<typename key_type, typename value_type>
 async_key_value_source<key_type, value_type>::async_key_value_source(
 		const uint64_t max_wait_ms,
-		const uint64_t ttl_ms) noexcept:
+		const uint64_t ttl_ms,
+		const uint32_t max_workers) noexcept:
 	m_max_wait_ms(max_wait_ms),
 	m_ttl_ms(ttl_ms),
-	m_thread(),
+	m_max_workers(std::max(max_workers, 1u)),
+	m_threads(),
+	m_idle_workers(0),
 	m_running(false),
 	m_terminate(false),
 	m_mutex(),
@@ -69,10 +72,16 @@ uint64_t async_key_value_source<key_type, value_type>::get_ttl() const
 	return m_ttl_ms;
 }
 
+template<typename key_type, typename value_type>
+uint32_t async_key_value_source<key_type, value_type>::get_max_workers() const
+{
+	return m_max_workers;
+}
+
 template<typename key_type, typename value_type>
 void async_key_value_source<key_type, value_type>::stop()
 {
-	bool join_needed = false;
+	std::vector<std::thread> threads;
 
 	{
 		std::unique_lock<std::mutex> guard(m_mutex);
@@ -80,22 +89,20 @@ void async_key_value_source<key_type, value_type>::stop()
 		if(m_running)
 		{
 			m_terminate = true;
-			join_needed = true;
+			threads.swap(m_threads);
 
-			// The async thread might be waiting for new events
-			// so wake it up
-			m_queue_not_empty_condition.notify_one();
+			// The async threads might be waiting for new events
+			// so wake them up
+			m_queue_not_empty_condition.notify_all();
 		}
 	} // Drop the mutex before join()
 
-	if (join_needed)
+	for(auto& thread : threads)
 	{
-		m_thread.join();
-
-		// Remove any pointers from the thread to this object
-		// (just to be safe)
-		m_thread = std::thread();
+		thread.join();
 	}
+
+	m_running = false;
 }
 
 template<typename key_type, typename value_type>
@@ -110,13 +117,14 @@ bool async_key_value_source<key_type, value_type>::is_running() const
 template<typename key_type, typename value_type>
 void async_key_value_source<key_type, value_type>::run()
 {
-	m_running = true;
-
 	while(!m_terminate)
 	{
 		{
 			std::unique_lock<std::mutex> guard(m_mutex);
 
+			release_in_flight_key();
+
+			++m_idle_workers;
 			while(!m_terminate)
 			{
 				// Wait for something to show up on the queue
@@ -135,6 +143,7 @@ void async_key_value_source<key_type, value_type>::run()
 					m_queue_not_empty_condition.wait_until(guard, deadline);
 				}
 			}
+			--m_idle_workers;
 
 			prune_stale_requests();
 		}
@@ -146,7 +155,8 @@ void async_key_value_source<key_type, value_type>::run()
 		}
 	}
 
-	m_running = false;
+	std::lock_guard<std::mutex> guard(m_mutex);
+	release_in_flight_key();
 }
 
 template<typename key_type, typename value_type>
@@ -158,9 +168,15 @@ bool async_key_value_source<key_type, value_type>::lookup_delayed(
 {
 	std::unique_lock<std::mutex> guard(m_mutex);
 
-	if(!m_running && !m_thread.joinable())
+	//
+	// Start a new worker if all the current ones are busy (or there
+	// are none yet), up to the configured limit
+	//
+	if(m_threads.empty() ||
+	   (!m_terminate && m_idle_workers == 0 && m_threads.size() < m_max_workers))
 	{
-		m_thread = std::thread(&async_key_value_source::run, this);
+		m_threads.emplace_back(&async_key_value_source::run, this);
+		m_running = true;
 	}
 
 	typename value_map::iterator itr = m_value_map.find(key);
@@ -252,21 +268,55 @@ bool async_key_value_source<key_type, value_type>::dequeue_next_key(key_type& ke
 	std::lock_guard<std::mutex> guard(m_mutex);
 	bool key_found = false;
 
-	if(!m_request_queue.empty())
+	// whatever this worker was looking up before is done now
+	release_in_flight_key();
+
+	while(!key_found && !m_request_queue.empty())
 	{
 		auto top_element = m_request_queue.top();
-		if(top_element.first < std::chrono::steady_clock::now())
+		if(top_element.first >= std::chrono::steady_clock::now())
+		{
+			break;
+		}
+
+		m_request_queue.pop();
+		m_request_set.erase(top_element.second);
+
+		// If another worker is already looking up this key, its
+		// store_value() will satisfy this request too
+		if(!is_in_flight(top_element.second))
 		{
 			key_found = true;
 			key = std::move(top_element.second);
-			m_request_queue.pop();
-			m_request_set.erase(key);
+			m_in_flight[std::this_thread::get_id()] = key;
 		}
 	}
 
 	return key_found;
 }
 
+// called with m_mutex held
+template<typename key_type, typename value_type>
+void async_key_value_source<key_type, value_type>::release_in_flight_key()
+{
+	m_in_flight.erase(std::this_thread::get_id());
+}
+
+// called with m_mutex held
+template<typename key_type, typename value_type>
+bool async_key_value_source<key_type, value_type>::is_in_flight(const key_type& key) const
+{
+	for(const auto& it : m_in_flight)
+	{
+		if(it.second == key)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 template<typename key_type, typename value_type>
 value_type async_key_value_source<key_type, value_type>::get_value(
 		const key_type& key)
@@ -283,6 +333,13 @@ void async_key_value_source<key_type, value_type>::store_value(
 {
 	std::lock_guard<std::mutex> guard(m_mutex);
 
+	// From now on, new requests for this key need a new lookup
+	auto in_flight = m_in_flight.find(std::this_thread::get_id());
+	if(in_flight != m_in_flight.end() && in_flight->second == key)
+	{
+		m_in_flight.erase(in_flight);
+	}
+
 	typename value_map::iterator itr = m_value_map.find(key);
 	if(itr == m_value_map.end())
 	{
@@ -140,6 +140,8 @@ const static struct luaL_Reg ll_chisel [] =
 	{"set_interval_ns", &lua_cbacks::set_interval_ns},
 	{"set_interval_s", &lua_cbacks::set_interval_s},
 	{"set_precise_interval_ns", &lua_cbacks::set_precise_interval_ns},
+	{"set_event_batch", &lua_cbacks::set_event_batch},
+	{"get_ffi_view", &lua_cbacks::get_ffi_view},
 	{"exec", &lua_cbacks::exec},
 	{NULL,NULL}
 };
@@ -255,6 +257,10 @@ sinsp_chisel::sinsp_chisel(sinsp* inspector, string filename)
 	m_lua_cinfo = NULL;
 	m_lua_last_interval_sample_time = 0;
 	m_lua_last_interval_ts = 0;
+	m_batch_size = 0;
+	m_batch_n_evts = 0;
+	m_ffi_enabled = false;
+	memset(&m_ffi_view, 0, sizeof(m_ffi_view));
 	m_udp_socket = 0;
 
 	load(filename);
@@ -280,6 +286,14 @@ void sinsp_chisel::free_lua_chisel()
 	}
 	m_allocated_fltchecks.clear();
 
+	m_batch_columns.clear();
+	m_batch_size = 0;
+	m_batch_n_evts = 0;
+
+	m_ffi_enabled = false;
+	memset(&m_ffi_view, 0, sizeof(m_ffi_view));
+	m_ffi_fields.clear();
+
 	if(m_lua_cinfo != NULL)
 	{
 		delete m_lua_cinfo;
@@ -408,6 +422,22 @@ sinsp_field_aggregation sinsp_chisel::string_to_aggregation(string ag)
 	{
 		res = A_MAX;
 	}
+	else if(ag == "DISTINCT")
+	{
+		res = A_DISTINCT;
+	}
+	else if(ag == "P50")
+	{
+		res = A_P50;
+	}
+	else if(ag == "P99")
+	{
+		res = A_P99;
+	}
+	else if(ag == "TOP")
+	{
+		res = A_TOP;
+	}
 	else
 	{
 		throw sinsp_exception("unknown view column aggregation " + ag);
@@ -1581,10 +1611,31 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 	}
 
 	//
-	// If the script has the on_event callback, call it
+	// If the script asked for batches, buffer the event, delivering the
+	// batch to on_event_batch() when it's full. Otherwise, if the script
+	// has the on_event callback, call it
 	//
-	if(m_lua_has_handle_evt)
+	if(m_batch_size != 0)
+	{
+		add_to_event_batch(evt);
+
+		if(m_batch_n_evts == m_batch_size)
+		{
+			flush_event_batch();
+		}
+
+		if(m_lua_cinfo->m_end_capture == true)
+		{
+			throw sinsp_capture_interrupt_exception();
+		}
+	}
+	else if(m_lua_has_handle_evt)
 	{
+		if(m_ffi_enabled)
+		{
+			fill_ffi_view(evt);
+		}
+
 		lua_getglobal(m_ls, "on_event");
 
 		if(lua_pcall(m_ls, 0, 1, 0) != 0)
@@ -1621,6 +1672,126 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 #endif
 }
 
+void sinsp_chisel::fill_ffi_view(sinsp_evt* evt)
+{
+	const scap_evt* pevt = evt->get_scap_evt();
+	const uint16_t* lens = (const uint16_t*)((const uint8_t*)pevt + sizeof(struct ppm_evt_hdr));
+	uint32_t offset = 0;
+	uint32_t j;
+
+	m_ffi_param_offsets.resize(pevt->nparams);
+	for(j = 0; j < pevt->nparams; j++)
+	{
+		m_ffi_param_offsets[j] = offset;
+		offset += lens[j];
+	}
+
+	//
+	// Every filter check has its own storage, so the extracted values
+	// stay valid together until the next event
+	//
+	m_ffi_fields.resize(m_allocated_fltchecks.size());
+	for(j = 0; j < m_allocated_fltchecks.size(); j++)
+	{
+		uint32_t vlen;
+		uint8_t* rawval = m_allocated_fltchecks[j]->extract(evt, &vlen);
+
+		m_ffi_fields[j].m_val = rawval;
+		m_ffi_fields[j].m_len = (rawval != NULL) ? vlen : 0;
+		m_ffi_fields[j].m_type = m_allocated_fltchecks[j]->get_field_info()->m_type;
+	}
+
+	m_ffi_view.m_evt = (const uint8_t*)pevt;
+	m_ffi_view.m_params = (const uint8_t*)(lens + pevt->nparams);
+	m_ffi_view.m_param_lens = lens;
+	m_ffi_view.m_param_offsets = m_ffi_param_offsets.data();
+	m_ffi_view.m_ts = pevt->ts;
+	m_ffi_view.m_num = evt->get_num();
+	m_ffi_view.m_evt_len = pevt->len;
+	m_ffi_view.m_nparams = pevt->nparams;
+	m_ffi_view.m_nfields = m_ffi_fields.size();
+	m_ffi_view.m_fields = m_ffi_fields.data();
+}
+
+void sinsp_chisel::add_to_event_batch(sinsp_evt* evt)
+{
+	for(auto& col : m_batch_columns)
+	{
+		uint32_t vlen;
+		uint8_t* rawval = col.m_check->extract(evt, &vlen);
+
+		if(rawval == NULL)
+		{
+			col.m_offsets.push_back(0);
+			col.m_lens.push_back(UINT32_MAX);
+			continue;
+		}
+
+		//
+		// Keep the values aligned, since numbers are read in place, and
+		// terminated like the extracted strings
+		//
+		uint32_t offset = (col.m_data.size() + 7) & ~7;
+		col.m_data.resize(offset + vlen + 1);
+		memcpy(&col.m_data[offset], rawval, vlen);
+		col.m_data[offset + vlen] = 0;
+
+		col.m_offsets.push_back(offset);
+		col.m_lens.push_back(vlen);
+	}
+
+	m_batch_n_evts++;
+}
+
+void sinsp_chisel::flush_event_batch()
+{
+#ifdef HAS_LUA_CHISELS
+	if(m_batch_n_evts == 0)
+	{
+		return;
+	}
+
+	//
+	// on_event_batch(nevts, columns), where columns[j][k] is the value of
+	// the j-th batched field for the k-th event, or nil if the event
+	// doesn't have it
+	//
+	lua_getglobal(m_ls, "on_event_batch");
+	lua_pushnumber(m_ls, (double)m_batch_n_evts);
+	lua_createtable(m_ls, m_batch_columns.size(), 0);
+
+	for(uint32_t j = 0; j < m_batch_columns.size(); j++)
+	{
+		chisel_batch_column& col = m_batch_columns[j];
+		ppm_param_type type = col.m_check->get_field_info()->m_type;
+
+		lua_createtable(m_ls, m_batch_n_evts, 0);
+
+		for(uint32_t k = 0; k < m_batch_n_evts; k++)
+		{
+			if(col.m_lens[k] != UINT32_MAX &&
+				lua_cbacks::rawval_to_lua_stack(m_ls, &col.m_data[col.m_offsets[k]], type, col.m_lens[k]) != 0)
+			{
+				lua_rawseti(m_ls, -2, k + 1);
+			}
+		}
+
+		lua_rawseti(m_ls, -2, j + 1);
+
+		col.m_data.clear();
+		col.m_offsets.clear();
+		col.m_lens.clear();
+	}
+
+	m_batch_n_evts = 0;
+
+	if(lua_pcall(m_ls, 2, 0, 0) != 0)
+	{
+		throw sinsp_exception(m_filename + " chisel error: calling on_event_batch() failed:" + lua_tostring(m_ls, -1));
+	}
+#endif // HAS_LUA_CHISELS
+}
+
 void sinsp_chisel::do_timeout(sinsp_evt* evt)
 {
 	if(m_lua_is_first_evt)
@@ -1655,6 +1826,8 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 				}
 			}
 
+			flush_event_batch();
+
 			lua_getglobal(m_ls, "on_interval");
 
 			lua_pushnumber(m_ls, (double)(ts / 1000000000));
@@ -1687,6 +1860,8 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 		{
 			uint64_t t;
 
+			flush_event_batch();
+
 			for(t = m_lua_last_interval_sample_time; t <= ts - interval; t += interval)
 			{
 				lua_getglobal(m_ls, "on_interval");
@@ -1717,6 +1892,8 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 void sinsp_chisel::do_end_of_sample()
 {
 #ifdef HAS_LUA_CHISELS
+	flush_event_batch();
+
 	lua_getglobal(m_ls, "on_end_of_sample");
 
 	if(lua_pcall(m_ls, 0, 1, 0) != 0)
@@ -1764,6 +1941,8 @@ void sinsp_chisel::on_capture_start()
 void sinsp_chisel::on_capture_end()
 {
 #ifdef HAS_LUA_CHISELS
+	flush_event_batch();
+
 	lua_getglobal(m_ls, "on_capture_end");
 
 	if(lua_isfunction(m_ls, -1))
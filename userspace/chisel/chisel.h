@@ -107,6 +107,47 @@ private:
 	sinsp* m_inspector;
 };
 
+//
+// The values of one field for the events of a batch, see
+// chisel.set_event_batch(). Values are copied back to back in m_data,
+// with a terminator; a missing value has a length of UINT32_MAX.
+//
+class chisel_batch_column
+{
+public:
+	sinsp_filter_check* m_check;
+	vector<uint8_t> m_data;
+	vector<uint32_t> m_offsets;
+	vector<uint32_t> m_lens;
+};
+
+//
+// The current event as seen through LuaJIT FFI, see
+// chisel.get_ffi_view(). The layout must match the cdef in chisel_api.cpp.
+// All pointers reference the event buffer or the filter check storage,
+// and are valid only inside on_event().
+//
+typedef struct chisel_ffi_field
+{
+	const uint8_t* m_val; // NULL if the event doesn't have the field
+	uint32_t m_len;
+	uint32_t m_type; // ppm_param_type
+}chisel_ffi_field;
+
+typedef struct chisel_ffi_view
+{
+	const uint8_t* m_evt; // the scap event, header included
+	const uint8_t* m_params; // the first parameter
+	const uint16_t* m_param_lens;
+	const uint32_t* m_param_offsets; // from m_params
+	uint64_t m_ts;
+	uint64_t m_num;
+	uint32_t m_evt_len;
+	uint32_t m_nparams;
+	uint32_t m_nfields;
+	chisel_ffi_field* m_fields; // in chisel.request_field() order
+}chisel_ffi_view;
+
 class SINSP_PUBLIC sinsp_chisel
 {
 public:
@@ -147,6 +188,9 @@ private:
 	static bool parse_view_info(lua_State *ls, OUT chisel_desc* cd);
 	static bool init_lua_chisel(chisel_desc &cd, string const &path);
 	void first_event_inits(sinsp_evt* evt);
+	void add_to_event_batch(sinsp_evt* evt);
+	void flush_event_batch();
+	void fill_ffi_view(sinsp_evt* evt);
 
 	sinsp* m_inspector;
 	string m_description;
@@ -159,6 +203,13 @@ private:
 	uint64_t m_lua_last_interval_sample_time;
 	uint64_t m_lua_last_interval_ts;
 	vector<sinsp_filter_check*> m_allocated_fltchecks;
+	uint32_t m_batch_size;
+	uint32_t m_batch_n_evts;
+	vector<chisel_batch_column> m_batch_columns;
+	bool m_ffi_enabled;
+	chisel_ffi_view m_ffi_view;
+	vector<chisel_ffi_field> m_ffi_fields;
+	vector<uint32_t> m_ffi_param_offsets;
 	char m_lua_fld_storage[PPM_MAX_ARG_SIZE];
 	chiselinfo* m_lua_cinfo;
 	string m_new_chisel_to_exec;
@@ -888,12 +888,12 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 			//
 			lua_pushstring(ls, "args");
 
-			vector<string>* args = &tinfo.m_args;
+			const vector<string>& args = tinfo.m_args;
 			lua_newtable(ls);
-			for(j = 0; j < args->size(); j++)
+			for(j = 0; j < args.size(); j++)
 			{
 				lua_pushinteger(ls, j + 1);
-				lua_pushstring(ls, args->at(j).c_str());
+				lua_pushstring(ls, args.at(j).c_str());
 				lua_settable(ls, -3);
 			}
 			lua_settable(ls,-3);
@@ -1376,6 +1376,142 @@ int lua_cbacks::set_precise_interval_ns(lua_State *ls)
 	return 0;
 }
 
+//
+// chisel.set_event_batch(size [, fields]): deliver the events that pass
+// the chisel filter to on_event_batch() in batches of up to size events,
+// instead of calling on_event() for each of them. fields is a list of
+// handles from chisel.request_field(), and defaults to all the fields
+// requested so far; their values are extracted on the C side and passed
+// as one array per field. Partial batches are delivered before
+// on_interval(), on_end_of_sample() and on_capture_end().
+//
+int lua_cbacks::set_event_batch(lua_State *ls)
+{
+	lua_getglobal(ls, "sichisel");
+
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+	lua_pop(ls, 1);
+
+	ASSERT(ch);
+	ASSERT(ch->m_lua_cinfo);
+
+	uint32_t size = (uint32_t)lua_tonumber(ls, 1);
+	if(size == 0)
+	{
+		throw sinsp_exception(ch->m_filename + " chisel error: set_event_batch() requires a positive batch size");
+	}
+
+	lua_getglobal(ls, "on_event_batch");
+	if(!lua_isfunction(ls, -1))
+	{
+		throw sinsp_exception(ch->m_filename + " chisel error: set_event_batch() requires an on_event_batch() function");
+	}
+	lua_pop(ls, 1);
+
+	vector<sinsp_filter_check*> checks;
+
+	if(lua_istable(ls, 2))
+	{
+		int n = (int)lua_objlen(ls, 2);
+
+		for(int j = 1; j <= n; j++)
+		{
+			lua_rawgeti(ls, 2, j);
+			sinsp_filter_check* chk = (sinsp_filter_check*)lua_touserdata(ls, -1);
+			lua_pop(ls, 1);
+
+			if(find(ch->m_allocated_fltchecks.begin(), ch->m_allocated_fltchecks.end(), chk) ==
+				ch->m_allocated_fltchecks.end())
+			{
+				throw sinsp_exception(ch->m_filename + " chisel error: set_event_batch() field " +
+					to_string(j) + " was not returned by request_field()");
+			}
+
+			checks.push_back(chk);
+		}
+	}
+	else
+	{
+		checks = ch->m_allocated_fltchecks;
+	}
+
+	//
+	// Deliver what was batched with the previous settings
+	//
+	ch->flush_event_batch();
+
+	ch->m_batch_columns.clear();
+	ch->m_batch_columns.resize(checks.size());
+	for(uint32_t j = 0; j < checks.size(); j++)
+	{
+		ch->m_batch_columns[j].m_check = checks[j];
+	}
+
+	ch->m_batch_size = size;
+
+	return 0;
+}
+
+//
+// chisel.get_ffi_view(): with LuaJIT, return a pointer to the current
+// event as a chisel_ffi_view cdata (see chisel.h), refreshed before every
+// on_event() call. Fields and parameters can then be read in place with
+// ffi.cast(), without allocating Lua strings or calling back into C.
+// Returns nil when FFI is not available, in which case the chisel should
+// use evt.field().
+//
+static const char* s_ffi_view_loader =
+	"local ok, ffi = pcall(require, 'ffi')\n"
+	"if not ok then return nil end\n"
+	"if not pcall(ffi.typeof, 'chisel_ffi_view') then\n"
+	"	ffi.cdef[[\n"
+	"	typedef struct chisel_ffi_field {\n"
+	"		const uint8_t* m_val;\n"
+	"		uint32_t m_len;\n"
+	"		uint32_t m_type;\n"
+	"	} chisel_ffi_field;\n"
+	"	typedef struct chisel_ffi_view {\n"
+	"		const uint8_t* m_evt;\n"
+	"		const uint8_t* m_params;\n"
+	"		const uint16_t* m_param_lens;\n"
+	"		const uint32_t* m_param_offsets;\n"
+	"		uint64_t m_ts;\n"
+	"		uint64_t m_num;\n"
+	"		uint32_t m_evt_len;\n"
+	"		uint32_t m_nparams;\n"
+	"		uint32_t m_nfields;\n"
+	"		chisel_ffi_field* m_fields;\n"
+	"	} chisel_ffi_view;\n"
+	"	]]\n"
+	"end\n"
+	"return ffi.cast('const chisel_ffi_view*', ...)\n";
+
+int lua_cbacks::get_ffi_view(lua_State *ls)
+{
+	lua_getglobal(ls, "sichisel");
+
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+	lua_pop(ls, 1);
+
+	ASSERT(ch);
+
+	if(luaL_loadstring(ls, s_ffi_view_loader) != 0)
+	{
+		throw sinsp_exception(ch->m_filename + " chisel error: " + lua_tostring(ls, -1));
+	}
+
+	lua_pushlightuserdata(ls, &ch->m_ffi_view);
+
+	if(lua_pcall(ls, 1, 1, 0) != 0)
+	{
+		throw sinsp_exception(ch->m_filename + " chisel error: get_ffi_view() failed:" + lua_tostring(ls, -1));
+	}
+
+	ch->m_ffi_enabled = !lua_isnil(ls, -1);
+
+	return 1;
+}
+
 int lua_cbacks::exec(lua_State *ls)
 {
 	lua_getglobal(ls, "sichisel");
@@ -42,7 +42,11 @@ using namespace libsinsp;
 
 sinsp_container_manager::sinsp_container_manager(sinsp* inspector, bool static_container, const std::string static_id, const std::string static_name, const std::string static_image) :
 	m_inspector(inspector),
+	m_batching(false),
 	m_last_flush_time_ns(0),
+	m_has_removed_containers(false),
+	m_binary_container_events(false),
+	m_disk_cache_loaded(false),
 	m_static_container(static_container),
 	m_static_id(static_id),
 	m_static_name(static_name),
@@ -58,6 +62,16 @@ bool sinsp_container_manager::remove_inactive_containers()
 {
 	bool res = false;
 
+	if(m_batching)
+	{
+		publish_batch(true);
+	}
+
+	if(m_has_removed_containers)
+	{
+		flush_removed_containers();
+	}
+
 	if(m_last_flush_time_ns == 0)
 	{
 		m_last_flush_time_ns = m_inspector->m_lastevent_ts - m_inspector->m_inactive_container_scan_time_ns + 30 * ONE_SECOND_IN_NS;
@@ -84,31 +98,93 @@ bool sinsp_container_manager::remove_inactive_containers()
 			return true;
 		});
 
-		auto containers = m_containers.lock();
-		for(auto it = containers->begin(); it != containers->end();)
-		{
-			if(containers_in_use.find(it->first) == containers_in_use.end())
+		// drop all the inactive containers in a single update
+		m_containers.update([&](map_t& containers) {
+			for(auto it = containers.begin(); it != containers.end();)
 			{
-				sinsp_container_info::ptr_t container = it->second;
-				for(const auto &remove_cb : m_remove_callbacks)
+				if(containers_in_use.find(it->first) == containers_in_use.end())
 				{
-					remove_cb(*container);
+					sinsp_container_info::ptr_t container = it->second;
+					for(const auto &remove_cb : m_remove_callbacks)
+					{
+						remove_cb(*container);
+					}
+					containers.erase(it++);
+				}
+				else
+				{
+					++it;
 				}
-				containers->erase(it++);
 			}
-			else
+		});
+
+		save_disk_cache();
+	}
+
+	return res;
+}
+
+void sinsp_container_manager::notify_removed_container(const std::string& container_id)
+{
+	std::lock_guard<std::mutex> lock(m_removed_lock);
+	m_removed_containers.push_back(container_id);
+	m_has_removed_containers = true;
+}
+
+void sinsp_container_manager::flush_removed_containers()
+{
+	if(m_batching)
+	{
+		publish_batch(true);
+	}
+
+	std::vector<std::string> removed;
+	{
+		std::lock_guard<std::mutex> lock(m_removed_lock);
+		removed.swap(m_removed_containers);
+		m_has_removed_containers = false;
+	}
+
+	m_containers.update([&](map_t& containers) {
+		for(const auto& container_id : removed)
+		{
+			auto it = containers.find(container_id);
+			if(it == containers.end())
+			{
+				continue;
+			}
+
+			g_logger.format(sinsp_logger::SEV_DEBUG,
+					"Removing destroyed container %s",
+					container_id.c_str());
+
+			for(const auto &remove_cb : m_remove_callbacks)
 			{
-				++it;
+				remove_cb(*it->second);
 			}
+			containers.erase(it);
 		}
-	}
+	});
 
-	return res;
+	for(const auto& container_id : removed)
+	{
+		m_lookups.erase(container_id);
+	}
 }
 
 sinsp_container_info::ptr_t sinsp_container_manager::get_container(const string& container_id) const
 {
-	auto containers = m_containers.lock();
+	if(m_batching)
+	{
+		std::lock_guard<std::mutex> lock(m_batch_lock);
+		auto it = m_batch.find(container_id);
+		if(it != m_batch.end())
+		{
+			return it->second;
+		}
+	}
+
+	auto containers = m_containers.read();
 	auto it = containers->find(container_id);
 	if(it != containers->end())
 	{
@@ -248,9 +324,31 @@ string sinsp_container_manager::container_to_json(const sinsp_container_info& co
 	return Json::FastWriter().write(obj);
 }
 
-bool sinsp_container_manager::container_to_sinsp_event(const string& json, sinsp_evt* evt, shared_ptr<sinsp_threadinfo> tinfo)
+bool sinsp_container_manager::container_to_sinsp_event(const sinsp_container_info& container_info, sinsp_evt* evt, shared_ptr<sinsp_threadinfo> tinfo)
 {
-	size_t totlen = sizeof(scap_evt) +  sizeof(uint16_t) + json.length() + 1;
+	std::string payload;
+	uint16_t type;
+
+	if(m_binary_container_events)
+	{
+		container_info.to_binary(payload);
+		type = PPME_CONTAINER_BIN_E;
+	}
+	else
+	{
+		payload = container_to_json(container_info);
+		// the JSON parameter includes the terminating NUL
+		payload.push_back('\0');
+		type = PPME_CONTAINER_JSON_E;
+	}
+
+	if(payload.size() > UINT16_MAX)
+	{
+		// the parameter length would not fit in the event
+		return false;
+	}
+
+	size_t totlen = sizeof(scap_evt) +  sizeof(uint16_t) + payload.size();
 
 	ASSERT(evt->m_pevt_storage == nullptr);
 	evt->m_pevt_storage = new char[totlen];
@@ -275,14 +373,14 @@ bool sinsp_container_manager::container_to_sinsp_event(const string& json, sinsp
 	}
 	scapevt->tid = -1;
 	scapevt->len = (uint32_t)totlen;
-	scapevt->type = PPME_CONTAINER_JSON_E;
+	scapevt->type = type;
 	scapevt->nparams = 1;
 
 	uint16_t* lens = (uint16_t*)((char *)scapevt + sizeof(struct ppm_evt_hdr));
 	char* valptr = (char*)lens + sizeof(uint16_t);
 
-	*lens = (uint16_t)json.length() + 1;
-	memcpy(valptr, json.c_str(), *lens);
+	*lens = (uint16_t)payload.size();
+	memcpy(valptr, payload.data(), *lens);
 
 	evt->init();
 	evt->m_tinfo_ref = tinfo;
@@ -293,15 +391,83 @@ bool sinsp_container_manager::container_to_sinsp_event(const string& json, sinsp
 
 sinsp_container_manager::map_ptr_t sinsp_container_manager::get_containers() const
 {
-	return m_containers.lock();
+	if(m_batching)
+	{
+		std::lock_guard<std::mutex> lock(m_batch_lock);
+		if(!m_batch.empty())
+		{
+			// a private copy, the batch gets published by end_batch()
+			auto containers = std::make_shared<map_t>(*m_containers.read());
+			for(const auto& it : m_batch)
+			{
+				(*containers)[it.first] = it.second;
+			}
+
+			return containers;
+		}
+	}
+
+	return m_containers.read();
+}
+
+void sinsp_container_manager::begin_batch()
+{
+	m_batching = true;
+}
+
+void sinsp_container_manager::end_batch()
+{
+	publish_batch(false);
+}
+
+//
+// Publish the batched containers with a single update. The removals
+// keep batching, they only need the published map to be complete
+//
+void sinsp_container_manager::publish_batch(bool keep_batching)
+{
+	std::lock_guard<std::mutex> lock(m_batch_lock);
+	if(!m_batch.empty())
+	{
+		m_containers.update([&](map_t& containers) {
+			for(const auto& it : m_batch)
+			{
+				containers[it.first] = it.second;
+			}
+		});
+		m_batch.clear();
+	}
+
+	// only now, so that lookups never miss a batched container
+	m_batching = m_batching && keep_batching;
+}
+
+bool sinsp_container_manager::add_to_batch(const sinsp_container_info::ptr_t& container_info)
+{
+	if(!m_batching)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_batch_lock);
+	if(!m_batching)
+	{
+		// end_batch() got here first
+		return false;
+	}
+
+	m_batch[container_info->m_id] = container_info;
+	return true;
 }
 
 void sinsp_container_manager::add_container(const sinsp_container_info::ptr_t& container_info, sinsp_threadinfo *thread)
 {
 	set_lookup_status(container_info->m_id, container_info->m_type, container_info->m_lookup_state);
+	if(!add_to_batch(container_info))
 	{
-		auto containers = m_containers.lock();
-		(*containers)[container_info->m_id] = container_info;
+		m_containers.update([&](map_t& containers) {
+			containers[container_info->m_id] = container_info;
+		});
 	}
 
 	for(const auto &new_cb : m_new_callbacks)
@@ -312,32 +478,44 @@ void sinsp_container_manager::add_container(const sinsp_container_info::ptr_t& c
 
 void sinsp_container_manager::replace_container(const sinsp_container_info::ptr_t& container_info)
 {
-	auto containers = m_containers.lock();
-	ASSERT(containers->find(container_info->m_id) != containers->end());
-	(*containers)[container_info->m_id] = container_info;
+	if(add_to_batch(container_info))
+	{
+		return;
+	}
+
+	m_containers.update([&](map_t& containers) {
+		ASSERT(containers.find(container_info->m_id) != containers.end());
+		containers[container_info->m_id] = container_info;
+	});
 }
 
 void sinsp_container_manager::notify_new_container(const sinsp_container_info& container_info)
 {
 	sinsp_evt *evt = new sinsp_evt();
 
-	if(container_to_sinsp_event(container_to_json(container_info), evt, container_info.get_tinfo(m_inspector)))
+	if(container_to_sinsp_event(container_info, evt, container_info.get_tinfo(m_inspector)))
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG,
-				"notify_new_container (%s): created CONTAINER_JSON event, queuing to inspector",
+				"notify_new_container (%s): created container event, queuing to inspector",
 				container_info.m_id.c_str());
 
 		std::shared_ptr<sinsp_evt> cevt(evt);
 
 		// Enqueue it onto the queue of pending container events for the inspector
 #ifndef _WIN32
-		m_inspector->m_pending_container_evts.push(cevt);
+		if(!m_inspector->m_pending_container_evts.push(std::move(cevt)))
+		{
+			g_logger.format(sinsp_logger::SEV_ERROR,
+					"notify_new_container (%s): pending container events queue full, dropping (%" PRIu64 " dropped so far)",
+					container_info.m_id.c_str(),
+					m_inspector->m_pending_container_evts.dropped());
+		}
 #endif
 	}
 	else
 	{
 		g_logger.format(sinsp_logger::SEV_ERROR,
-				"notify_new_container (%s): could not create CONTAINER_JSON event, dropping",
+				"notify_new_container (%s): could not create container event, dropping",
 				container_info.m_id.c_str());
 		delete evt;
 	}
@@ -345,10 +523,10 @@ void sinsp_container_manager::notify_new_container(const sinsp_container_info& c
 
 void sinsp_container_manager::dump_containers(scap_dumper_t* dumper)
 {
-	for(const auto& it : (*m_containers.lock()))
+	for(const auto& it : (*get_containers()))
 	{
 		sinsp_evt evt;
-		if(container_to_sinsp_event(container_to_json(*it.second), &evt, it.second->get_tinfo(m_inspector)))
+		if(container_to_sinsp_event(*it.second, &evt, it.second->get_tinfo(m_inspector)))
 		{
 			int32_t res = scap_dump(m_inspector->m_h, dumper, evt.m_pevt, evt.m_cpuid, 0);
 			if(res != SCAP_SUCCESS)
@@ -608,6 +786,80 @@ void sinsp_container_manager::cleanup()
 	{
 		eng->cleanup();
 	}
+
+	save_disk_cache();
+}
+
+void sinsp_container_manager::set_container_cache_file(const std::string& path)
+{
+	std::unique_ptr<container_disk_cache> cache;
+	if(!path.empty())
+	{
+		cache.reset(new container_disk_cache(path));
+	}
+
+	//
+	// The async lookups can be using the old cache, let it go (and
+	// unmap its file) once they're done with it
+	//
+	std::lock_guard<std::mutex> lock(m_disk_cache_lock);
+	m_disk_cache.swap(cache);
+	m_disk_cache_loaded = false;
+}
+
+bool sinsp_container_manager::load_from_disk_cache(const std::string& container_id, sinsp_container_type ctype)
+{
+	if(!m_disk_cache || !m_inspector->is_live())
+	{
+		return false;
+	}
+
+	if(!m_disk_cache_loaded)
+	{
+		m_disk_cache->load();
+		m_disk_cache_loaded = true;
+	}
+
+	auto container = m_disk_cache->take_container(container_id);
+	if(!container)
+	{
+		return false;
+	}
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"Using cached metadata for container %s (type %d, requested by engine %d)",
+			container_id.c_str(), container->m_type, ctype);
+
+	set_lookup_status(container_id, container->m_type, sinsp_container_lookup_state::SUCCESSFUL);
+	set_lookup_status(container_id, ctype, sinsp_container_lookup_state::SUCCESSFUL);
+	add_container(container, nullptr);
+	notify_new_container(*container);
+	return true;
+}
+
+void sinsp_container_manager::save_disk_cache()
+{
+	if(!m_disk_cache || !m_inspector->is_live())
+	{
+		return;
+	}
+
+	if(!m_disk_cache_loaded)
+	{
+		// don't overwrite the old cache before we had a chance to use it
+		m_disk_cache->load();
+		m_disk_cache_loaded = true;
+	}
+
+	m_disk_cache->save(*get_containers());
+}
+
+bool sinsp_container_manager::get_cached_image_info(const std::string& imageid, sinsp_container_info& container) const
+{
+	// images are never touched after the file gets loaded, we only
+	// need to keep set_container_cache_file() from swapping the cache
+	std::lock_guard<std::mutex> lock(m_disk_cache_lock);
+	return m_disk_cache && m_disk_cache_loaded && m_disk_cache->get_image(imageid, container);
 }
 
 void sinsp_container_manager::set_docker_socket_path(std::string socket_path)
@@ -624,6 +876,20 @@ void sinsp_container_manager::set_query_docker_image_info(bool query_image_info)
 #endif
 }
 
+void sinsp_container_manager::set_docker_max_concurrent_lookups(uint32_t max_lookups)
+{
+#if !defined(MINIMAL_BUILD) && !defined(_WIN32)
+	libsinsp::container_engine::docker_async_source::set_max_concurrent_lookups(max_lookups);
+#endif
+}
+
+void sinsp_container_manager::set_docker_event_stream(bool enabled)
+{
+#if !defined(MINIMAL_BUILD) && defined(HAS_CAPTURE) && !defined(_WIN32)
+	libsinsp::container_engine::docker_linux::set_event_stream(enabled);
+#endif
+}
+
 void sinsp_container_manager::set_cri_extra_queries(bool extra_queries)
 {
 #if !defined(MINIMAL_BUILD) && defined(HAS_CAPTURE)
@@ -659,8 +925,20 @@ void sinsp_container_manager::set_cri_delay(uint64_t delay_ms)
 #endif
 }
 
+void sinsp_container_manager::set_cri_max_concurrent_lookups(uint32_t max_lookups)
+{
+#if !defined(MINIMAL_BUILD) && defined(HAS_CAPTURE)
+	libsinsp::container_engine::cri::set_cri_max_concurrent_lookups(max_lookups);
+#endif
+}
+
 void sinsp_container_manager::set_container_labels_max_len(uint32_t max_label_len)
 {
 	sinsp_container_info::m_container_label_max_length = max_label_len;
 }
 
+void sinsp_container_manager::set_binary_container_events(bool binary)
+{
+	m_binary_container_events = binary;
+}
+
@@ -17,9 +17,12 @@ limitations under the License.
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "scap.h"
 
@@ -35,13 +38,15 @@ limitations under the License.
 #include "container_engine/container_cache_interface.h"
 #include "container_engine/container_engine_base.h"
 #include "container_engine/sinsp_container_type.h"
-#include "mutex.h"
+#include "container_disk_cache.h"
+#include "rcu_ptr.h"
 
 class sinsp_container_manager :
 	public libsinsp::container_engine::container_cache_interface
 {
 public:
-	using map_ptr_t = libsinsp::ConstMutexGuard<std::unordered_map<std::string, sinsp_container_info::ptr_t>>;
+	using map_t = std::unordered_map<std::string, sinsp_container_info::ptr_t>;
+	using map_ptr_t = libsinsp::rcu_ptr<map_t>::snapshot_t;
 
 	/**
 	 * Due to how the container manager is architected, it makes it difficult
@@ -61,10 +66,23 @@ public:
 	/**
 	 * @brief Get the whole container map (read-only)
 	 * @return the map of container_id -> shared_ptr<container_info>
+	 *
+	 * The returned map is an immutable snapshot: it can be used from any
+	 * thread without locking but it won't reflect later changes
 	 */
 	map_ptr_t get_containers() const;
 	bool remove_inactive_containers();
 
+	/**
+	 * @brief Collect the containers added from now on, and publish them
+	 * 	with a single copy of the container map in end_batch()
+	 *
+	 * Meant for the initial proc scan, which adds the containers one after
+	 * the other. Lookups see the batched containers in the meantime
+	 */
+	void begin_batch();
+	void end_batch();
+
 	/**
 	 * @brief Add/update a container in the manager map, executing on_new_container callbacks
 	 *
@@ -102,6 +120,16 @@ public:
 	 */
 	void notify_new_container(const sinsp_container_info& container_info) override;
 
+	/**
+	 * @brief Queue the removal of a container from the manager map
+	 * @param container_id the id of the removed container
+	 *
+	 * Can be called from any thread: the container is actually removed
+	 * (executing on_remove_container callbacks) by the next call to
+	 * remove_inactive_containers() on the event processing thread
+	 */
+	void notify_removed_container(const std::string& container_id) override;
+
 	/**
 	 * @brief Detect container engine for a thread
 	 * @param tinfo the thread to do container detection for
@@ -125,9 +153,10 @@ public:
 	// across execs e.g. "sh -c /bin/true" execing /bin/true.
 	void identify_category(sinsp_threadinfo *tinfo);
 
+	bool get_cached_image_info(const std::string& imageid, sinsp_container_info& container) const override;
+
 	bool container_exists(const std::string& container_id) const override{
-		auto containers = m_containers.lock();
-		return containers->find(container_id) != containers->end() ||
+		return get_container(container_id) != nullptr ||
 			m_lookups.find(container_id) != m_lookups.end();
 	}
 
@@ -149,12 +178,36 @@ public:
 
 	void set_docker_socket_path(std::string socket_path);
 	void set_query_docker_image_info(bool query_image_info);
+	void set_docker_max_concurrent_lookups(uint32_t max_lookups);
+	void set_docker_event_stream(bool enabled);
 	void set_cri_extra_queries(bool extra_queries);
 	void set_cri_socket_path(const std::string& path);
 	void set_cri_timeout(int64_t timeout_ms);
 	void set_cri_async(bool async);
 	void set_cri_delay(uint64_t delay_ms);
+	void set_cri_max_concurrent_lookups(uint32_t max_lookups);
 	void set_container_labels_max_len(uint32_t max_label_len);
+
+	/**
+	 * \brief choose the format of the container events we generate
+	 * @param binary if true, emit compact PPME_CONTAINER_BIN_E events,
+	 * otherwise (the default) emit PPME_CONTAINER_JSON_E events. Only
+	 * readers that know PPME_CONTAINER_BIN_E can open captures written
+	 * with binary events, so this is opt-in
+	 */
+	void set_binary_container_events(bool binary);
+
+	/**
+	 * \brief keep container and image metadata in a file across restarts
+	 * @param path the cache file, or an empty string to disable the cache
+	 *
+	 * The file is loaded when container detection starts, so that
+	 * the containers already running when we (re)start don't need new
+	 * lookups, and it's rewritten on the container table flushes and
+	 * on cleanup() whenever the containers changed. Only used in live
+	 * mode. Can be called at any time.
+	 */
+	void set_container_cache_file(const std::string& path);
 	sinsp* get_inspector() { return m_inspector; }
 
 	/**
@@ -188,25 +241,47 @@ public:
 		auto container_lookups = m_lookups.find(container_id);
 		if(container_lookups == m_lookups.end())
 		{
-			return true;
+			return !load_from_disk_cache(container_id, ctype);
 		}
 		auto engine_lookup = container_lookups->second.find(ctype);
 		return engine_lookup == container_lookups->second.end();
 	}
 private:
 	std::string container_to_json(const sinsp_container_info& container_info);
-	bool container_to_sinsp_event(const std::string& json, sinsp_evt* evt, std::shared_ptr<sinsp_threadinfo> tinfo);
+	bool container_to_sinsp_event(const sinsp_container_info& container_info, sinsp_evt* evt, std::shared_ptr<sinsp_threadinfo> tinfo);
 	std::string get_docker_env(const Json::Value &env_vars, const std::string &mti);
+	bool load_from_disk_cache(const std::string& container_id, sinsp_container_type ctype);
+	void flush_removed_containers();
+	void save_disk_cache();
+	bool add_to_batch(const sinsp_container_info::ptr_t& container_info);
+	void publish_batch(bool keep_batching);
 
 	std::list<std::shared_ptr<libsinsp::container_engine::container_engine_base>> m_container_engines;
 	std::map<sinsp_container_type, std::shared_ptr<libsinsp::container_engine::container_engine_base>> m_container_engine_by_type;
 
 	sinsp* m_inspector;
-	libsinsp::Mutex<std::unordered_map<std::string, std::shared_ptr<const sinsp_container_info>>> m_containers;
+	// read-mostly: lookups from the event thread and from consumers
+	// must not contend with the (rare) container additions
+	libsinsp::rcu_ptr<map_t> m_containers;
+	// containers added between begin_batch() and end_batch(), not yet
+	// published in m_containers
+	std::atomic<bool> m_batching;
+	mutable std::mutex m_batch_lock;
+	map_t m_batch;
 	std::unordered_map<std::string, std::unordered_map<sinsp_container_type, sinsp_container_lookup_state>> m_lookups;
 	uint64_t m_last_flush_time_ns;
 	std::list<new_container_cb> m_new_callbacks;
 	std::list<remove_container_cb> m_remove_callbacks;
+	// containers removed by notify_removed_container(), not flushed yet
+	std::mutex m_removed_lock;
+	std::vector<std::string> m_removed_containers;
+	std::atomic<bool> m_has_removed_containers;
+	bool m_binary_container_events;
+	// m_disk_cache is used by the event processing thread, except for
+	// the async lookups that read it with m_disk_cache_lock held
+	mutable std::mutex m_disk_cache_lock;
+	std::unique_ptr<libsinsp::container_disk_cache> m_disk_cache;
+	std::atomic<bool> m_disk_cache_loaded;
 
 	// indicates whether we should use only the static container engine, or the other engines.
 	// if true, we expect to have the subsequent bits of metadata as well. If this bool is false,
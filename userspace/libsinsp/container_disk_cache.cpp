@@ -0,0 +1,371 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "container_disk_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+namespace {
+
+//
+// File layout (all integers in host byte order):
+//
+// header:  "SCDC" <u32 version> <u32 num_containers> <u32 num_images>
+// entries: <u32 key_len> <key> <u32 value_len> <value>
+//
+// containers come first (keyed by container id), then images (keyed by
+// image id). Values are sinsp_container_info::to_binary() blobs; for
+// images only the image related fields are set.
+//
+const char CACHE_MAGIC[4] = {'S', 'C', 'D', 'C'};
+const uint32_t CACHE_VERSION = 1;
+const size_t CACHE_HEADER_SIZE = sizeof(CACHE_MAGIC) + 3 * sizeof(uint32_t);
+// images of no longer running containers we carry over on save()
+const uint32_t MAX_CACHED_IMAGES = 4096;
+
+bool read_u32(const char*& pos, const char* end, uint32_t& val)
+{
+	if((size_t)(end - pos) < sizeof(val))
+	{
+		return false;
+	}
+	memcpy(&val, pos, sizeof(val));
+	pos += sizeof(val);
+	return true;
+}
+
+void append_u32(std::string& out, uint32_t val)
+{
+	out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+void append_entry(std::string& out, const std::string& key, const char* value, uint32_t value_len)
+{
+	append_u32(out, key.size());
+	out.append(key);
+	append_u32(out, value_len);
+	out.append(value, value_len);
+}
+
+}
+
+using namespace libsinsp;
+
+container_disk_cache::container_disk_cache(std::string path):
+	m_path(std::move(path)),
+	m_data(nullptr),
+	m_size(0),
+	m_saved_valid(false)
+{
+}
+
+container_disk_cache::~container_disk_cache()
+{
+	unmap();
+}
+
+void container_disk_cache::unmap()
+{
+	m_containers.clear();
+	m_images.clear();
+#ifdef _WIN32
+	m_buffer.clear();
+#else
+	if(m_data != nullptr)
+	{
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+bool container_disk_cache::load()
+{
+	unmap();
+
+#ifdef _WIN32
+	std::ifstream in(m_path, std::ios::binary);
+	if(!in)
+	{
+		return false;
+	}
+	m_buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	m_data = m_buffer.data();
+	m_size = m_buffer.size();
+#else
+	int fd = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size < (off_t)CACHE_HEADER_SIZE)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+	{
+		return false;
+	}
+	m_data = static_cast<const char*>(data);
+	m_size = st.st_size;
+#endif
+
+	const char* pos = m_data;
+	const char* end = m_data + m_size;
+	uint32_t version, num_containers, num_images;
+
+	if(m_size < CACHE_HEADER_SIZE || memcmp(pos, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"container cache %s: bad header, ignoring",
+				m_path.c_str());
+		unmap();
+		return false;
+	}
+	pos += sizeof(CACHE_MAGIC);
+	read_u32(pos, end, version);
+	read_u32(pos, end, num_containers);
+	read_u32(pos, end, num_images);
+
+	if(version != CACHE_VERSION)
+	{
+		g_logger.format(sinsp_logger::SEV_INFO,
+				"container cache %s: unsupported version %u, ignoring",
+				m_path.c_str(), version);
+		unmap();
+		return false;
+	}
+
+	for(uint64_t i = 0; i < (uint64_t)num_containers + num_images; i++)
+	{
+		uint32_t key_len, value_len;
+		if(!read_u32(pos, end, key_len) || (size_t)(end - pos) < key_len)
+		{
+			break;
+		}
+		std::string key(pos, key_len);
+		pos += key_len;
+
+		if(!read_u32(pos, end, value_len) || (size_t)(end - pos) < value_len)
+		{
+			break;
+		}
+
+		auto& index = i < num_containers ? m_containers : m_images;
+		index[key] = entry{pos, value_len};
+		pos += value_len;
+	}
+
+	if(pos != end)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"container cache %s: truncated or corrupted, ignoring",
+				m_path.c_str());
+		unmap();
+		return false;
+	}
+
+	g_logger.format(sinsp_logger::SEV_INFO,
+			"container cache %s: loaded %u containers and %u images",
+			m_path.c_str(), (uint32_t)m_containers.size(), (uint32_t)m_images.size());
+	return true;
+}
+
+sinsp_container_info::ptr_t container_disk_cache::take_container(const std::string& id)
+{
+	auto it = m_containers.find(id);
+	if(it == m_containers.end())
+	{
+		return nullptr;
+	}
+
+	auto container = std::make_shared<sinsp_container_info>();
+	bool ok = container->from_binary(it->second.m_data, it->second.m_len);
+	m_containers.erase(it);
+
+	if(!ok || container->m_id != id || !container->is_successful())
+	{
+		return nullptr;
+	}
+
+	return container;
+}
+
+bool container_disk_cache::get_image(const std::string& imageid, sinsp_container_info& container) const
+{
+	auto it = m_images.find(imageid);
+	if(it == m_images.end())
+	{
+		return false;
+	}
+
+	sinsp_container_info image;
+	if(!image.from_binary(it->second.m_data, it->second.m_len))
+	{
+		return false;
+	}
+
+	// the digest we'd pick depends on the repository when an image
+	// is known under several names
+	if(!container.m_imagerepo.empty() && container.m_imagerepo != image.m_imagerepo)
+	{
+		return false;
+	}
+
+	container.m_imagerepo = image.m_imagerepo;
+	if(container.m_imagetag.empty())
+	{
+		container.m_imagetag = image.m_imagetag;
+	}
+	container.m_imagedigest = image.m_imagedigest;
+	return true;
+}
+
+bool container_disk_cache::save(const container_map_t& containers)
+{
+	//
+	// Container infos are immutable, so if we get the same ones as
+	// last time there's nothing new to write
+	//
+	container_map_t saved;
+	for(const auto& it : containers)
+	{
+		if(it.second->is_successful())
+		{
+			saved.insert(it);
+		}
+	}
+
+	if(m_saved_valid && saved == m_saved)
+	{
+		return true;
+	}
+
+	std::string buf(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	append_u32(buf, CACHE_VERSION);
+	append_u32(buf, 0); // number of containers, patched below
+	append_u32(buf, 0); // number of images, patched below
+
+	uint32_t num_containers = 0;
+	std::string value;
+	for(const auto& it : saved)
+	{
+		value.clear();
+		it.second->to_binary(value);
+		append_entry(buf, it.first, value.data(), value.size());
+		num_containers++;
+	}
+
+	uint32_t num_images = 0;
+	std::unordered_set<std::string> images;
+	for(const auto& it : saved)
+	{
+		const auto& container = *it.second;
+		if(container.m_imageid.empty() ||
+		   container.m_imagedigest.empty() ||
+		   !images.insert(container.m_imageid).second)
+		{
+			continue;
+		}
+
+		sinsp_container_info image;
+		image.m_imageid = container.m_imageid;
+		image.m_imagerepo = container.m_imagerepo;
+		image.m_imagetag = container.m_imagetag;
+		image.m_imagedigest = container.m_imagedigest;
+
+		value.clear();
+		image.to_binary(value);
+		append_entry(buf, container.m_imageid, value.data(), value.size());
+		num_images++;
+	}
+
+	// images only remain useful as long as they're pulled on the host,
+	// but we can't tell, so keep (a bounded number of) the ones we loaded
+	for(const auto& it : m_images)
+	{
+		if(num_images >= MAX_CACHED_IMAGES)
+		{
+			break;
+		}
+
+		if(images.insert(it.first).second)
+		{
+			append_entry(buf, it.first, it.second.m_data, it.second.m_len);
+			num_images++;
+		}
+	}
+
+	memcpy(&buf[sizeof(CACHE_MAGIC) + sizeof(uint32_t)], &num_containers, sizeof(num_containers));
+	memcpy(&buf[sizeof(CACHE_MAGIC) + 2 * sizeof(uint32_t)], &num_images, sizeof(num_images));
+
+	std::string tmp_path = m_path + ".tmp";
+	FILE* f = fopen(tmp_path.c_str(), "wb");
+	if(f == nullptr)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"container cache %s: cannot open for writing",
+				tmp_path.c_str());
+		return false;
+	}
+
+	bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+	ok = (fclose(f) == 0) && ok;
+#ifdef _WIN32
+	if(ok)
+	{
+		remove(m_path.c_str());
+	}
+#endif
+	if(!ok || rename(tmp_path.c_str(), m_path.c_str()) != 0)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"container cache %s: write failed",
+				m_path.c_str());
+		remove(tmp_path.c_str());
+		return false;
+	}
+
+	m_saved.swap(saved);
+	m_saved_valid = true;
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"container cache %s: saved %u containers and %u images",
+			m_path.c_str(), num_containers, num_images);
+	return true;
+}
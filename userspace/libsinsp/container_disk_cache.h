@@ -0,0 +1,125 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "container_info.h"
+
+namespace libsinsp {
+
+/**
+ * \brief On-disk cache of container and image metadata
+ *
+ * Keeps the metadata of the containers seen by a previous run (keyed
+ * by container id) and the image details resolved from the container
+ * runtime (keyed by image id), so that after a restart we don't need
+ * to query the container runtime again for every running container.
+ *
+ * The file is memory-mapped and only indexed on load(): an entry gets
+ * decoded (with sinsp_container_info::from_binary()) only when it's
+ * actually used. Entries are never trusted blindly: a cached container
+ * is only used once a container engine has matched a running process
+ * to its id.
+ *
+ * save() replaces the file atomically (write to a temporary file,
+ * then rename), so a crash never leaves a truncated cache behind.
+ *
+ * Thread safety: get_image() may be called from any thread while
+ * the other methods are only called from the event processing thread.
+ * The image index is immutable after load(), so this needs no locking.
+ */
+class container_disk_cache
+{
+public:
+	typedef std::unordered_map<std::string, sinsp_container_info::ptr_t> container_map_t;
+
+	explicit container_disk_cache(std::string path);
+	~container_disk_cache();
+
+	container_disk_cache(const container_disk_cache&) = delete;
+	container_disk_cache& operator=(const container_disk_cache&) = delete;
+
+	/**
+	 * \brief Map and index the cache file
+	 * @return false if the file is missing or invalid (the cache is then empty)
+	 */
+	bool load();
+
+	/**
+	 * \brief Get the cached metadata of a container, removing it from the cache
+	 * @return the cached metadata or nullptr if not present
+	 *
+	 * Only successful lookups get cached, so the returned container
+	 * can be used as is.
+	 */
+	sinsp_container_info::ptr_t take_container(const std::string& id);
+
+	/**
+	 * \brief Fill the image repo, tag and digest of `container` from
+	 * the cached details of image `imageid`
+	 * @return true if the image is cached and compatible with the
+	 * repository already set in `container`, if any
+	 */
+	bool get_image(const std::string& imageid, sinsp_container_info& container) const;
+
+	/**
+	 * \brief Write the successfully looked up containers in `containers`
+	 * and the images they use (plus the images loaded from the old file)
+	 * @return false if the file could not be written
+	 *
+	 * The file is left alone if those containers didn't change since
+	 * the last successful save().
+	 */
+	bool save(const container_map_t& containers);
+
+	size_t num_containers() const
+	{
+		return m_containers.size();
+	}
+
+	size_t num_images() const
+	{
+		return m_images.size();
+	}
+
+private:
+	struct entry
+	{
+		const char* m_data;
+		uint32_t m_len;
+	};
+
+	void unmap();
+
+	std::string m_path;
+	const char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	std::vector<char> m_buffer;
+#endif
+	std::unordered_map<std::string, entry> m_containers;
+	std::unordered_map<std::string, entry> m_images;
+	// the containers written by the last save(), to tell if it's dirty
+	container_map_t m_saved;
+	bool m_saved_valid;
+};
+
+}
@@ -34,6 +34,12 @@ public:
 
 	virtual void notify_new_container(const sinsp_container_info& container_info) = 0;
 
+	/**
+	 * Forget a container the container runtime reported as removed.
+	 * May be called from any thread.
+	 */
+	virtual void notify_removed_container(const std::string& container_id) = 0;
+
 	virtual bool should_lookup(const std::string& container_id, sinsp_container_type ctype) = 0;
 
 	virtual void set_lookup_status(const std::string& container_id, sinsp_container_type ctype, sinsp_container_lookup_state state) = 0;
@@ -57,6 +63,13 @@ public:
 	 * Return whether the container exists in the cache.
 	 */
 	virtual bool container_exists(const std::string& container_id) const = 0;
+
+	/**
+	 * Fill the image repo/tag/digest of `container` from previously
+	 * resolved metadata of image `imageid`, if available.
+	 * May be called from any thread.
+	 */
+	virtual bool get_cached_image_info(const std::string& imageid, sinsp_container_info& container) const = 0;
 };
 
 }
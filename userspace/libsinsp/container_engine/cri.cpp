@@ -46,6 +46,8 @@ namespace {
 bool s_async = true;
 // delay before talking to CRI/cgroups
 uint64_t s_cri_lookup_delay_ms = 500;
+// how many containers to look up in parallel
+uint32_t s_cri_max_concurrent_lookups = 4;
 
 constexpr const cgroup_layout CRI_CGROUP_LAYOUT[] = {
 	{"/", ""}, // non-systemd containerd
@@ -225,7 +227,9 @@ bool cri_async_source::lookup_sync(const libsinsp::cgroup_limits::cgroup_limits_
 	return true;
 }
 
-cri::cri(container_cache_interface &cache) : container_engine_base(cache)
+cri::cri(container_cache_interface &cache) :
+	container_engine_base(cache),
+	m_cgroup_matcher(CRI_CGROUP_LAYOUT)
 {
 	if(s_cri_unix_socket_path.empty()) {
 		return;
@@ -276,6 +280,17 @@ void cri::set_cri_delay(uint64_t delay_ms)
 {
 	s_cri_lookup_delay_ms = delay_ms;
 }
+
+void cri::set_cri_max_concurrent_lookups(uint32_t max_lookups)
+{
+	s_cri_max_concurrent_lookups = max_lookups;
+}
+#else
+cri::cri(container_cache_interface &cache) :
+	container_engine_base(cache),
+	m_cgroup_matcher(CRI_CGROUP_LAYOUT)
+{
+}
 #endif // CONTAINER_INFO
 
 bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
@@ -283,7 +298,7 @@ bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 	container_cache_interface *cache = &container_cache();
 	std::string container_id;
 
-	if(!matches_runc_cgroups(tinfo, CRI_CGROUP_LAYOUT, container_id))
+	if(!m_cgroup_matcher.match(tinfo, container_id))
 	{
 		return false;
 	}
@@ -332,7 +347,7 @@ bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 
 		if(!m_async_source)
 		{
-			auto async_source = new cri_async_source(cache, m_cri.get(), s_cri_timeout);
+			auto async_source = new cri_async_source(cache, m_cri.get(), s_cri_timeout, s_cri_max_concurrent_lookups);
 			m_async_source = std::unique_ptr<cri_async_source>(async_source);
 		}
 
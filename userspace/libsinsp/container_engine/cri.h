@@ -26,6 +26,7 @@ class sinsp_threadinfo;
 #include "container_engine/container_engine_base.h"
 #include "container_engine/sinsp_container_type.h"
 #include "container_info.h"
+#include "runc.h"
 #ifdef CONTAINER_INFO
 #include <cri.h>
 
@@ -55,8 +56,11 @@ class cri_async_source : public sysdig::async_key_value_source<
         sinsp_container_info>
 {
 public:
-	explicit cri_async_source(container_cache_interface *cache, ::libsinsp::cri::cri_interface *cri, uint64_t ttl_ms) :
-		async_key_value_source(NO_WAIT_LOOKUP, ttl_ms),
+	explicit cri_async_source(container_cache_interface *cache,
+				  ::libsinsp::cri::cri_interface *cri,
+				  uint64_t ttl_ms,
+				  uint32_t max_concurrent_lookups = 1) :
+		async_key_value_source(NO_WAIT_LOOKUP, ttl_ms, max_concurrent_lookups),
 		m_cache(cache),
 		m_cri(cri)
 	{
@@ -83,12 +87,7 @@ class cri : public container_engine_base
 {
 public:
 
-#ifdef CONTAINER_INFO
 	cri(container_cache_interface &cache);
-#else
-	cri(container_cache_interface& cache) : container_engine_base(cache)
-	{}
-#endif // CONTAINER_INFO
 	bool resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info) override;
 	void update_with_size(const std::string& container_id) override;
 #ifdef CONTAINER_INFO
@@ -98,11 +97,14 @@ public:
 	static void set_extra_queries(bool extra_queries);
 	static void set_async(bool async_limits);
 	static void set_cri_delay(uint64_t delay_ms);
+	static void set_cri_max_concurrent_lookups(uint32_t max_lookups);
 
 private:
 	std::unique_ptr<cri_async_source> m_async_source;
 	std::unique_ptr<::libsinsp::cri::cri_interface> m_cri;
 #endif // CONTAINER_INFO
+
+	libsinsp::runc::cgroup_matcher m_cgroup_matcher;
 };
 }
 }
@@ -24,12 +24,18 @@ limitations under the License.
 
 using namespace libsinsp::container_engine;
 
+namespace {
+// how long image metadata is reused before asking docker again
+constexpr const std::chrono::seconds IMAGE_CACHE_TTL(60);
+}
+
 bool docker_async_source::m_query_image_info = true;
+uint32_t docker_async_source::m_max_concurrent_lookups = 4;
 
 docker_async_source::docker_async_source(uint64_t max_wait_ms,
 					 uint64_t ttl_ms,
 					 container_cache_interface *cache)
-	: async_key_value_source(max_wait_ms, ttl_ms),
+	: async_key_value_source(max_wait_ms, ttl_ms, m_max_concurrent_lookups),
 	  m_cache(cache)
 {
 }
@@ -375,89 +381,154 @@ void docker_async_source::set_query_image_info(bool query_image_info)
 	m_query_image_info = query_image_info;
 }
 
-void docker_async_source::fetch_image_info(const docker_lookup_request& request, sinsp_container_info& container)
+void docker_async_source::set_max_concurrent_lookups(uint32_t max_lookups)
 {
-	Json::Reader reader;
-
 	g_logger.format(sinsp_logger::SEV_DEBUG,
-			"docker_async (%s) image (%s): Fetching image info",
-			request.container_id.c_str(),
-			container.m_imageid.c_str());
+			"docker_async: Setting max_concurrent_lookups=%u",
+			max_lookups);
 
-	std::string img_json;
-	std::string url = "/images/" + container.m_imageid + "/json?digests=1";
+	m_max_concurrent_lookups = max_lookups;
+}
+
+std::shared_ptr<const Json::Value> docker_async_source::get_image_json(const docker_lookup_request& request,
+									const std::string& url,
+									bool& cached)
+{
+	auto now = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(m_image_cache_mutex);
+		auto it = m_image_cache.find(url);
+		if(it != m_image_cache.end())
+		{
+			if(now - it->second.m_ts < IMAGE_CACHE_TTL)
+			{
+				g_logger.format(sinsp_logger::SEV_DEBUG,
+						"docker_async (%s): Using cached response for %s",
+						request.container_id.c_str(),
+						url.c_str());
+				cached = true;
+				return it->second.m_json;
+			}
+			m_image_cache.erase(it);
+		}
+	}
+
+	cached = false;
 
 	g_logger.format(sinsp_logger::SEV_DEBUG,
 			"docker_async url: %s",
 			url.c_str());
 
+	std::string img_json;
 	if(!(m_connection.get_docker(request, url, img_json) == docker_connection::RESP_OK))
 	{
 		g_logger.format(sinsp_logger::SEV_ERROR,
-				"docker_async (%s) image (%s): Could not fetch image info",
+				"docker_async (%s): Could not fetch %s",
 				request.container_id.c_str(),
-				container.m_imageid.c_str());
-		return;
+				url.c_str());
+		return nullptr;
 	}
 
 	g_logger.format(sinsp_logger::SEV_DEBUG,
-			"docker_async (%s) image (%s): Image info fetch returned \"%s\"",
+			"docker_async (%s): Fetch of %s returned \"%s\"",
 			request.container_id.c_str(),
-			container.m_imageid.c_str(),
+			url.c_str(),
 			img_json.c_str());
 
-	Json::Value img_root;
-	if(!reader.parse(img_json, img_root))
+	Json::Reader reader;
+	auto img_root = std::make_shared<Json::Value>();
+	if(!reader.parse(img_json, *img_root))
 	{
 		g_logger.format(sinsp_logger::SEV_ERROR,
-				"docker_async (%s) image (%s): Could not parse json image info \"%s\"",
+				"docker_async (%s): Could not parse json response for %s \"%s\"",
 				request.container_id.c_str(),
-				container.m_imageid.c_str(),
+				url.c_str(),
 				img_json.c_str());
-		return;
+		return nullptr;
 	}
 
-	parse_image_info(container, img_root);
-}
+	std::lock_guard<std::mutex> lock(m_image_cache_mutex);
 
-void docker_async_source::fetch_image_info_from_list(const docker_lookup_request& request, sinsp_container_info& container)
-{
-	Json::Reader reader;
+	// drop the expired entries so the cache doesn't grow with images
+	// that are no longer used
+	for(auto it = m_image_cache.begin(); it != m_image_cache.end();)
+	{
+		if(now - it->second.m_ts >= IMAGE_CACHE_TTL)
+		{
+			it = m_image_cache.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
 
-	g_logger.format(sinsp_logger::SEV_DEBUG,
-			"docker_async (%s): Fetching image list",
-			request.container_id.c_str());
+	image_cache_entry& entry = m_image_cache[url];
+	entry.m_ts = now;
+	entry.m_json = img_root;
 
-	std::string img_json;
-	std::string url = "/images/json?digests=1";
+	return img_root;
+}
 
+void docker_async_source::fetch_image_info(const docker_lookup_request& request, sinsp_container_info& container)
+{
 	g_logger.format(sinsp_logger::SEV_DEBUG,
-			"docker_async url: %s",
-			url.c_str());
+			"docker_async (%s) image (%s): Fetching image info",
+			request.container_id.c_str(),
+			container.m_imageid.c_str());
 
-	if(!(m_connection.get_docker(request, url, img_json) == docker_connection::RESP_OK))
+	if(m_cache->get_cached_image_info(container.m_imageid, container))
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG,
+				"docker_async (%s) image (%s): Using image info from the container cache file",
+				request.container_id.c_str(),
+				container.m_imageid.c_str());
+		return;
+	}
+
+	bool cached;
+	auto img_root = get_image_json(request, "/images/" + container.m_imageid + "/json?digests=1", cached);
+	if(!img_root)
 	{
-		g_logger.format(sinsp_logger::SEV_ERROR,
-				"docker_async (%s): Could not fetch image list",
-				request.container_id.c_str());
 		return;
 	}
 
+	parse_image_info(container, *img_root);
+}
+
+void docker_async_source::fetch_image_info_from_list(const docker_lookup_request& request, sinsp_container_info& container)
+{
 	g_logger.format(sinsp_logger::SEV_DEBUG,
-			"docker_async (%s): Image list fetch returned \"%s\"",
-			request.container_id.c_str(),
-			img_json.c_str());
+			"docker_async (%s): Fetching image list",
+			request.container_id.c_str());
 
-	Json::Value img_root;
-	if(!reader.parse(img_json, img_root))
+	const std::string url = "/images/json?digests=1";
+	bool cached;
+	auto img_root = get_image_json(request, url, cached);
+	if(!img_root)
 	{
-		g_logger.format(sinsp_logger::SEV_ERROR,
-				"docker_async (%s): Could not parse json image list \"%s\"",
-				request.container_id.c_str(),
-				img_json.c_str());
 		return;
 	}
 
+	if(!match_image_from_list(container, *img_root) && cached)
+	{
+		// the image may have been pulled after we listed the images
+		{
+			std::lock_guard<std::mutex> lock(m_image_cache_mutex);
+			m_image_cache.erase(url);
+		}
+
+		img_root = get_image_json(request, url, cached);
+		if(img_root)
+		{
+			match_image_from_list(container, *img_root);
+		}
+	}
+}
+
+bool docker_async_source::match_image_from_list(sinsp_container_info& container, const Json::Value& img_root)
+{
 	const std::string match_name = container.m_imagerepo + ':' + container.m_imagetag;
 	for(const auto& img : img_root)
 	{
@@ -467,7 +538,7 @@ void docker_async_source::fetch_image_info_from_list(const docker_lookup_request
 		const auto& names = img["Names"];
 		if(!names.isArray())
 		{
-			return;
+			return false;
 		}
 
 		for(const auto& name : names)
@@ -483,10 +554,12 @@ void docker_async_source::fetch_image_info_from_list(const docker_lookup_request
 				container.m_imageid = std::move(imgstr);
 
 				parse_image_info(container, img);
-				return;
+				return true;
 			}
 		}
 	}
+
+	return false;
 }
 
 void docker_async_source::parse_image_info(sinsp_container_info& container, const Json::Value& img)
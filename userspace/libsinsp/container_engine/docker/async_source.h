@@ -3,6 +3,11 @@
 #include "async_key_value_source.h"
 #include "container_info.h"
 
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "container_engine/docker/connection.h"
 #include "container_engine/docker/lookup_request.h"
 
@@ -20,6 +25,10 @@ public:
 	static void parse_json_mounts(const Json::Value &mnt_obj, std::vector<sinsp_container_info::container_mount_info> &mounts);
 	static void set_query_image_info(bool query_image_info);
 
+	// Maximum number of containers looked up in parallel by each
+	// docker_async_source created from now on
+	static void set_max_concurrent_lookups(uint32_t max_lookups);
+
 protected:
 	void run_impl();
 
@@ -79,9 +88,32 @@ private:
 	// find one with matching repository/tag and get the digest from there
 	void fetch_image_info_from_list(const docker_lookup_request& request, sinsp_container_info& container);
 
+	// Find the image matching the container's repository/tag in the
+	// image list and fill the image info from it. Returns true if found.
+	static bool match_image_from_list(sinsp_container_info& container, const Json::Value& img_root);
+
+	// Get the (parsed) response to an image API request, from the
+	// image cache if possible. Image metadata is shared by all the
+	// containers started from the same image, so a burst of new
+	// containers only needs one container inspect request each.
+	// Sets cached to true if the response comes from the cache.
+	std::shared_ptr<const Json::Value> get_image_json(const docker_lookup_request& request,
+							  const std::string& url,
+							  bool& cached);
+
+	struct image_cache_entry
+	{
+		std::chrono::steady_clock::time_point m_ts;
+		std::shared_ptr<const Json::Value> m_json;
+	};
+
 	container_cache_interface *m_cache;
 	docker_connection m_connection;
+	std::mutex m_image_cache_mutex;
+	// image API url -> response
+	std::unordered_map<std::string, image_cache_entry> m_image_cache;
 	static bool m_query_image_info;
+	static uint32_t m_max_concurrent_lookups;
 };
 
 
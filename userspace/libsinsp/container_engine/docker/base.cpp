@@ -14,14 +14,7 @@ docker_base::resolve_impl(sinsp_threadinfo *tinfo, const docker_lookup_request&
 {
 #ifdef CONTAINER_INFO
 	container_cache_interface *cache = &container_cache();
-	if(!m_docker_info_source)
-	{
-		g_logger.log("docker_async: Creating docker async source",
-			     sinsp_logger::SEV_DEBUG);
-		uint64_t max_wait_ms = 10000;
-		docker_async_source *src = new docker_async_source(docker_async_source::NO_WAIT_LOOKUP, max_wait_ms, cache);
-		m_docker_info_source.reset(src);
-	}
+	create_docker_info_source();
 
 	tinfo->m_container_id = request.container_id;
 
@@ -60,6 +53,18 @@ docker_base::resolve_impl(sinsp_threadinfo *tinfo, const docker_lookup_request&
 #endif // CONTAINER_INFO
 }
 
+void docker_base::create_docker_info_source()
+{
+	if(!m_docker_info_source)
+	{
+		g_logger.log("docker_async: Creating docker async source",
+			     sinsp_logger::SEV_DEBUG);
+		uint64_t max_wait_ms = 10000;
+		docker_async_source *src = new docker_async_source(docker_async_source::NO_WAIT_LOOKUP, max_wait_ms, &container_cache());
+		m_docker_info_source.reset(src);
+	}
+}
+
 void docker_base::parse_docker_async(const docker_lookup_request& request, container_cache_interface *cache)
 {
 	auto cb = [cache](const docker_lookup_request& request, const sinsp_container_info& res)
@@ -21,6 +21,9 @@ public:
 protected:
 	void parse_docker_async(const docker_lookup_request& request, container_cache_interface *cache);
 
+	// create m_docker_info_source if it doesn't exist yet
+	void create_docker_info_source();
+
 	bool resolve_impl(sinsp_threadinfo *tinfo, const docker_lookup_request& request,
 			  bool query_os_for_missing_info);
 
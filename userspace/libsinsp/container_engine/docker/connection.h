@@ -8,7 +8,11 @@
 #endif // CONTAINER_INFO
 #endif
 
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "container_engine/docker/lookup_request.h"
 
@@ -29,16 +33,60 @@ public:
 	docker_response
 	get_docker(const docker_lookup_request& request, const std::string& req_url, std::string& json);
 
+	typedef std::function<bool(const std::string& line)> line_callback;
+
+	/**
+	 * \brief Issue a request whose response is an endless stream of
+	 * newline-delimited JSON documents (e.g. /events)
+	 * @param on_line called with every complete line of the response
+	 * body; returning false closes the stream
+	 * @param stop set it (from any thread) to close the stream. It's
+	 * only checked about once per second while the stream is idle
+	 * @return RESP_OK if the stream was closed by either side,
+	 * RESP_BAD_REQUEST if the daemon rejected the request and RESP_ERROR
+	 * if we could not connect or the connection broke
+	 *
+	 * Blocks until the stream is closed, on a dedicated connection
+	 */
+	docker_response stream_docker(const docker_lookup_request& request, const std::string& req_url,
+				      const line_callback& on_line, const std::atomic<bool>& stop);
+
 	void set_api_version(const std::string& api_version)
 	{
+		std::lock_guard<std::mutex> lock(m_lock);
 		m_api_version = api_version;
 	}
 
 private:
+	std::string get_api_version() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_api_version;
+	}
+
+	// get_docker() may be called concurrently from several lookup
+	// threads, so all the state is protected by m_lock
+	mutable std::mutex m_lock;
 	std::string m_api_version;
 #ifdef CONTAINER_INFO
 #ifndef _WIN32
-	CURLM *m_curlm;
+	// A pair of curl handles used for one request at a time. They
+	// are pooled and reused, so the connection to the docker socket
+	// stays open (HTTP keep-alive) across requests
+	struct curl_handles
+	{
+		CURLM* m_curlm;
+		CURL* m_curl;
+	};
+
+	// Get handles not used by any other thread, creating them
+	// if needed, and give them back when the request is done
+	bool acquire_handles(curl_handles& handles);
+	void release_handles(const curl_handles& handles);
+
+	docker_response get_docker(const curl_handles& handles, const std::string& url, const std::string& docker_path, std::string& json);
+
+	std::vector<curl_handles> m_idle_handles;
 #endif
 #endif // CONTAINER_INFO
 };
@@ -28,50 +28,145 @@ size_t docker_curl_write_callback(const char *ptr, size_t size, size_t nmemb, st
 	return total;
 }
 
+struct docker_stream_state
+{
+	CURL* m_curl;
+	const libsinsp::container_engine::docker_connection::line_callback* m_on_line;
+	const std::atomic<bool>* m_stop;
+	std::string m_buf;
+	bool m_status_checked;
+	bool m_rejected;
+};
+
+size_t docker_stream_write_callback(const char *ptr, size_t size, size_t nmemb, docker_stream_state *state)
+{
+	const std::size_t total = size * nmemb;
+
+	if(!state->m_status_checked)
+	{
+		// first chunk of the body: don't feed error messages to the caller
+		state->m_status_checked = true;
+		long http_code = 0;
+		curl_easy_getinfo(state->m_curl, CURLINFO_RESPONSE_CODE, &http_code);
+		if(http_code != 200)
+		{
+			state->m_rejected = true;
+			return 0;
+		}
+	}
+
+	state->m_buf.append(ptr, total);
+
+	size_t start = 0;
+	size_t end;
+	while((end = state->m_buf.find('\n', start)) != std::string::npos)
+	{
+		if(end > start && !(*state->m_on_line)(state->m_buf.substr(start, end - start)))
+		{
+			// returning less than `total` makes curl abort the transfer
+			return 0;
+		}
+		start = end + 1;
+	}
+	state->m_buf.erase(0, start);
+
+	return total;
+}
+
+int docker_stream_progress_callback(docker_stream_state *state, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+{
+	return state->m_stop->load() ? 1 : 0;
+}
+
 }
 
 using namespace libsinsp::container_engine;
 
 docker_connection::docker_connection():
-	m_api_version("/v1.24"),
-	m_curlm(nullptr)
+	m_api_version("/v1.24")
 {
-	m_curlm = curl_multi_init();
+}
 
-	if(m_curlm)
+docker_connection::~docker_connection()
+{
+	for(const auto& handles : m_idle_handles)
 	{
-		curl_multi_setopt(m_curlm, CURLMOPT_PIPELINING, CURLPIPE_HTTP1|CURLPIPE_MULTIPLEX);
+		curl_easy_cleanup(handles.m_curl);
+		curl_multi_cleanup(handles.m_curlm);
 	}
+	m_idle_handles.clear();
 }
 
-docker_connection::~docker_connection()
+bool docker_connection::acquire_handles(curl_handles& handles)
 {
-	if(m_curlm)
 	{
-		curl_multi_cleanup(m_curlm);
-		m_curlm = NULL;
+		std::lock_guard<std::mutex> lock(m_lock);
+		if(!m_idle_handles.empty())
+		{
+			handles = m_idle_handles.back();
+			m_idle_handles.pop_back();
+			return true;
+		}
 	}
+
+	handles.m_curlm = curl_multi_init();
+	handles.m_curl = curl_easy_init();
+
+	if(!handles.m_curlm || !handles.m_curl)
+	{
+		if(handles.m_curl)
+		{
+			curl_easy_cleanup(handles.m_curl);
+		}
+		if(handles.m_curlm)
+		{
+			curl_multi_cleanup(handles.m_curlm);
+		}
+		return false;
+	}
+
+	curl_multi_setopt(handles.m_curlm, CURLMOPT_PIPELINING, CURLPIPE_HTTP1|CURLPIPE_MULTIPLEX);
+	return true;
+}
+
+void docker_connection::release_handles(const curl_handles& handles)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_idle_handles.push_back(handles);
 }
 
 docker_connection::docker_response docker_connection::get_docker(const docker_lookup_request& request, const std::string& req_url, std::string &json)
 {
-	CURL* curl = curl_easy_init();
-	if(!curl)
+	curl_handles handles;
+	if(!acquire_handles(handles))
 	{
 		g_logger.format(sinsp_logger::SEV_WARNING,
-				"docker_async (%s): Failed to initialize curl handle",
+				"docker_async (%s): Failed to initialize curl handles",
 				req_url.c_str());
 		return docker_response::RESP_ERROR;
 	}
 
-	auto docker_path = scap_get_host_root() + request.docker_socket;
+	std::string url = "http://localhost" + get_api_version() + req_url;
+	docker_response resp = get_docker(handles, url, scap_get_host_root() + request.docker_socket, json);
+
+	release_handles(handles);
+	return resp;
+}
+
+docker_connection::docker_response docker_connection::get_docker(const curl_handles& handles, const std::string& url, const std::string& docker_path, std::string &json)
+{
+	CURLM* curlm = handles.m_curlm;
+	CURL* curl = handles.m_curl;
+
+	// Forget the options of the previous request, but keep the
+	// connection that is still open from it
+	curl_easy_reset(curl);
+
 	curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, docker_curl_write_callback);
 	curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, docker_path.c_str());
 
-	std::string url = "http://localhost" + m_api_version + req_url;
-
 	g_logger.format(sinsp_logger::SEV_DEBUG,
 			"docker_async (%s): Fetching url",
 			url.c_str());
@@ -82,7 +177,6 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 				"docker_async (%s): curl_easy_setopt(CURLOPT_URL) failed",
 				url.c_str());
 
-		curl_easy_cleanup(curl);
 		ASSERT(false);
 		return docker_response::RESP_ERROR;
 	}
@@ -91,17 +185,15 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 		g_logger.format(sinsp_logger::SEV_DEBUG,
 				"docker_async (%s): curl_easy_setopt(CURLOPT_WRITEDATA) failed",
 				url.c_str());
-		curl_easy_cleanup(curl);
 		ASSERT(false);
 		return docker_response::RESP_ERROR;
 	}
 
-	if(curl_multi_add_handle(m_curlm, curl) != CURLM_OK)
+	if(curl_multi_add_handle(curlm, curl) != CURLM_OK)
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG,
 				"docker_async (%s): curl_multi_add_handle() failed",
 				url.c_str());
-		curl_easy_cleanup(curl);
 		ASSERT(false);
 		return docker_response::RESP_ERROR;
 	}
@@ -109,15 +201,14 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 	while(true)
 	{
 		int still_running;
-		CURLMcode res = curl_multi_perform(m_curlm, &still_running);
+		CURLMcode res = curl_multi_perform(curlm, &still_running);
 		if(res != CURLM_OK)
 		{
 			g_logger.format(sinsp_logger::SEV_DEBUG,
 					"docker_async (%s): curl_multi_perform() failed",
 					url.c_str());
 
-			curl_multi_remove_handle(m_curlm, curl);
-			curl_easy_cleanup(curl);
+			curl_multi_remove_handle(curlm, curl);
 			ASSERT(false);
 			return docker_response::RESP_ERROR;
 		}
@@ -128,27 +219,25 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 		}
 
 		int numfds;
-		res = curl_multi_wait(m_curlm, NULL, 0, 1000, &numfds);
+		res = curl_multi_wait(curlm, NULL, 0, 1000, &numfds);
 		if(res != CURLM_OK)
 		{
 			g_logger.format(sinsp_logger::SEV_DEBUG,
 					"docker_async (%s): curl_multi_wait() failed",
 					url.c_str());
 
-			curl_multi_remove_handle(m_curlm, curl);
-			curl_easy_cleanup(curl);
+			curl_multi_remove_handle(curlm, curl);
 			ASSERT(false);
 			return docker_response::RESP_ERROR;
 		}
 	}
 
-	if(curl_multi_remove_handle(m_curlm, curl) != CURLM_OK)
+	if(curl_multi_remove_handle(curlm, curl) != CURLM_OK)
 	{
 		g_logger.format(sinsp_logger::SEV_DEBUG,
 				"docker_async (%s): curl_multi_remove_handle() failed",
 				url.c_str());
 
-		curl_easy_cleanup(curl);
 		ASSERT(false);
 		return docker_response::RESP_ERROR;
 	}
@@ -160,12 +249,10 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 				"docker_async (%s): curl_easy_getinfo(CURLINFO_RESPONSE_CODE) failed",
 				url.c_str());
 
-		curl_easy_cleanup(curl);
 		ASSERT(false);
 		return docker_response::RESP_ERROR;
 	}
 
-	curl_easy_cleanup(curl);
 	g_logger.format(sinsp_logger::SEV_DEBUG,
 			"docker_async (%s): http_code=%ld",
 			url.c_str(), http_code);
@@ -196,3 +283,62 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 	return docker_response::RESP_OK;
 }
 
+
+docker_connection::docker_response docker_connection::stream_docker(const docker_lookup_request& request, const std::string& req_url,
+								    const line_callback& on_line, const std::atomic<bool>& stop)
+{
+	// the stream never completes, so it gets its own handle instead of
+	// holding one of the pooled ones forever
+	CURL* curl = curl_easy_init();
+	if(!curl)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"docker_async (%s): Failed to initialize curl handle",
+				req_url.c_str());
+		return docker_response::RESP_ERROR;
+	}
+
+	std::string url = "http://localhost" + get_api_version() + req_url;
+	std::string docker_path = scap_get_host_root() + request.docker_socket;
+	docker_stream_state state = {curl, &on_line, &stop, "", false, false};
+
+	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
+	curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, docker_path.c_str());
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, docker_stream_write_callback);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &state);
+	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+	curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, docker_stream_progress_callback);
+	curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &state);
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"docker_async (%s): Streaming url",
+			url.c_str());
+
+	CURLcode res = curl_easy_perform(curl);
+
+	long http_code = 0;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+	curl_easy_cleanup(curl);
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"docker_async (%s): stream closed, curl result=%d http_code=%ld",
+			url.c_str(), (int)res, http_code);
+
+	if(state.m_rejected || (http_code != 0 && http_code != 200))
+	{
+		return docker_response::RESP_BAD_REQUEST;
+	}
+
+	switch(res)
+	{
+	case CURLE_OK:
+	case CURLE_ABORTED_BY_CALLBACK:
+	case CURLE_WRITE_ERROR:
+		return http_code == 200 ? docker_response::RESP_OK : docker_response::RESP_ERROR;
+	default:
+		return docker_response::RESP_ERROR;
+	}
+}
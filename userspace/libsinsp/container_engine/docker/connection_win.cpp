@@ -31,7 +31,7 @@ docker_connection::~docker_connection()
 
 docker_connection::docker_response docker_connection::get_docker(const docker_lookup_request& request, const std::string& req_url, std::string &json)
 {
-	std::string req = "GET " + m_api_version + req_url + " HTTP/1.1\r\nHost: docker\r\n\r\n";
+	std::string req = "GET " + get_api_version() + req_url + " HTTP/1.1\r\nHost: docker\r\n\r\n";
 
 	const char* response = NULL;
 	bool qdres = wh_query_docker(m_inspector->get_wmi_handle(),
@@ -60,3 +60,9 @@ docker_connection::docker_response docker_connection::get_docker(const docker_lo
 	return docker_response::RESP_OK;
 }
 
+docker_connection::docker_response docker_connection::stream_docker(const docker_lookup_request& request, const std::string& req_url,
+								    const line_callback& on_line, const std::atomic<bool>& stop)
+{
+	// the WMI bridge only supports plain request/response queries
+	return docker_response::RESP_ERROR;
+}
@@ -16,6 +16,9 @@ limitations under the License.
 */
 #include "container_engine/docker/docker_linux.h"
 
+#include <algorithm>
+#include <chrono>
+
 #include "runc.h"
 #include "sinsp_int.h"
 
@@ -29,16 +32,48 @@ constexpr const cgroup_layout DOCKER_CGROUP_LAYOUT[] = {
 	{"/docker-", ".scope"}, // systemd docker
 	{nullptr, nullptr}
 };
+
+// only the events that change the set of running containers
+const char DOCKER_EVENTS_URL[] = "/events?filters=%7B%22type%22%3A%5B%22container%22%5D%2C"
+	"%22event%22%3A%5B%22start%22%2C%22destroy%22%5D%7D";
+
+constexpr const auto EVENT_STREAM_MIN_BACKOFF = std::chrono::seconds(1);
+constexpr const auto EVENT_STREAM_MAX_BACKOFF = std::chrono::seconds(30);
 }
 
 
 std::string docker_linux::m_docker_sock = "/var/run/docker.sock";
+bool docker_linux::m_event_stream = false;
+
+docker_linux::docker_linux(container_cache_interface& cache) :
+	docker_base(cache),
+	m_stop_events(false),
+	m_cgroup_matcher(DOCKER_CGROUP_LAYOUT)
+{
+}
+
+docker_linux::~docker_linux()
+{
+	stop_event_stream();
+}
+
+void docker_linux::cleanup()
+{
+	// the event thread uses m_docker_info_source, so it must go first
+	stop_event_stream();
+	docker_base::cleanup();
+}
 
 bool docker_linux::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 {
 	std::string container_id;
 
-	if(!matches_runc_cgroups(tinfo, DOCKER_CGROUP_LAYOUT, container_id))
+	if(m_event_stream && query_os_for_missing_info && !m_events_thread.joinable())
+	{
+		start_event_stream();
+	}
+
+	if(!m_cgroup_matcher.match(tinfo, container_id))
 	{
 		return false;
 	}
@@ -82,3 +117,114 @@ void docker_linux::update_with_size(const std::string &container_id)
 	(void)m_docker_info_source->lookup(instruction, result, cb);
 #endif // CONTAINER_INFO
 }
+
+void docker_linux::start_event_stream()
+{
+#ifdef CONTAINER_INFO
+	// the source is not thread safe to create, so do it here
+	// (on the event processing thread) rather than in the event thread
+	create_docker_info_source();
+
+	m_stop_events = false;
+	m_events_thread = std::thread(&docker_linux::run_event_stream, this, m_docker_sock);
+#endif // CONTAINER_INFO
+}
+
+void docker_linux::stop_event_stream()
+{
+	if(m_events_thread.joinable())
+	{
+		m_stop_events = true;
+		m_events_thread.join();
+	}
+}
+
+void docker_linux::run_event_stream(const std::string& docker_sock)
+{
+#ifdef CONTAINER_INFO
+	docker_connection connection;
+	docker_lookup_request request("", docker_sock, CT_DOCKER, 0, false);
+	auto on_line = [this, &docker_sock](const std::string& line) {
+		return on_docker_event(docker_sock, line);
+	};
+	auto backoff = EVENT_STREAM_MIN_BACKOFF;
+	bool versioned_api = true;
+
+	while(!m_stop_events)
+	{
+		auto resp = connection.stream_docker(request, DOCKER_EVENTS_URL, on_line, m_stop_events);
+
+		if(resp == docker_connection::RESP_BAD_REQUEST && versioned_api)
+		{
+			g_logger.format(sinsp_logger::SEV_DEBUG,
+					"docker_events: stream rejected, trying w/o api version");
+			connection.set_api_version("");
+			versioned_api = false;
+			continue;
+		}
+
+		if(resp == docker_connection::RESP_OK)
+		{
+			backoff = EVENT_STREAM_MIN_BACKOFF;
+		}
+		else
+		{
+			g_logger.format(sinsp_logger::SEV_DEBUG,
+					"docker_events: stream failed, retrying in %d s",
+					(int)backoff.count());
+		}
+
+		auto deadline = std::chrono::steady_clock::now() + backoff;
+		while(!m_stop_events && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+
+		if(resp != docker_connection::RESP_OK)
+		{
+			backoff = std::min(backoff * 2, EVENT_STREAM_MAX_BACKOFF);
+		}
+	}
+#endif // CONTAINER_INFO
+}
+
+bool docker_linux::on_docker_event(const std::string& docker_sock, const std::string& json)
+{
+#ifdef CONTAINER_INFO
+	Json::Value event;
+	if(!Json::Reader().parse(json, event) || event["Type"].asString() != "container")
+	{
+		return true;
+	}
+
+	std::string action = event["Action"].asString();
+	std::string container_id = event["Actor"]["ID"].asString();
+
+	// we only know containers by the short id extracted from their cgroups
+	if(container_id.size() < 12)
+	{
+		return true;
+	}
+	container_id.resize(12);
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"docker_events (%s): %s",
+			container_id.c_str(), action.c_str());
+
+	container_cache_interface* cache = &container_cache();
+	if(action == "start")
+	{
+		// concurrent lookups of the same container (e.g. if we see
+		// one of its processes right now) are merged by the source
+		if(!cache->get_container(container_id))
+		{
+			parse_docker_async(docker_lookup_request(container_id, docker_sock, CT_DOCKER, 0, false), cache);
+		}
+	}
+	else if(action == "destroy")
+	{
+		cache->notify_removed_container(container_id);
+	}
+#endif // CONTAINER_INFO
+	return true;
+}
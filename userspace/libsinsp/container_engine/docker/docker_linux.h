@@ -1,27 +1,63 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
+
 #include "container_engine/container_engine_base.h"
 #include "container_engine/docker/base.h"
+#include "runc.h"
 
 namespace libsinsp {
 namespace container_engine {
 
 class docker_linux : public docker_base {
 public:
-	docker_linux(container_cache_interface& cache) : docker_base(cache) {}
+	docker_linux(container_cache_interface& cache);
+	~docker_linux() override;
 
 	static void set_docker_sock(std::string docker_sock)
 	{
 		m_docker_sock = std::move(docker_sock);
 	}
 
+	/**
+	 * \brief subscribe to the docker event stream (off by default)
+	 *
+	 * When enabled, a background thread follows /events and looks up
+	 * every container as soon as it starts, so its metadata is usually
+	 * there before we see its first syscall, and drops it from the
+	 * container table as soon as it's destroyed. Containers started
+	 * while the stream is (re)connecting are still found the usual
+	 * way, when we see one of their processes.
+	 */
+	static void set_event_stream(bool enabled)
+	{
+		m_event_stream = enabled;
+	}
+
 	// implement container_engine_base
 	bool resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info) override;
 
 	void update_with_size(const std::string& container_id) override;
 
+	void cleanup() override;
+
 private:
+	void start_event_stream();
+	void stop_event_stream();
+	void run_event_stream(const std::string& docker_sock);
+
+	// handle one line of the event stream, always returns true
+	// (i.e. keep streaming)
+	bool on_docker_event(const std::string& docker_sock, const std::string& json);
+
 	static std::string m_docker_sock;
+	static bool m_event_stream;
+
+	std::thread m_events_thread;
+	std::atomic<bool> m_stop_events;
+
+	libsinsp::runc::cgroup_matcher m_cgroup_matcher;
 };
 
 }
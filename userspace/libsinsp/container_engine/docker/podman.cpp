@@ -70,9 +70,9 @@ int get_userns_root_uid(const sinsp_threadinfo *tinfo)
 //  0 for root containers,
 //  >0 for rootless containers,
 //  NO_MATCH if the process is not in a podman container
-int detect_podman(const sinsp_threadinfo *tinfo, std::string& container_id)
+int detect_podman(const sinsp_threadinfo *tinfo, cgroup_matcher& root_matcher, std::string& container_id)
 {
-	if(matches_runc_cgroups(tinfo, ROOT_PODMAN_CGROUP_LAYOUT, container_id))
+	if(root_matcher.match(tinfo, container_id))
 	{
 		return 0; // root
 	}
@@ -114,10 +114,16 @@ int detect_podman(const sinsp_threadinfo *tinfo, std::string& container_id)
 }
 }
 
+podman::podman(container_cache_interface& cache) :
+	docker_base(cache),
+	m_cgroup_matcher(ROOT_PODMAN_CGROUP_LAYOUT)
+{
+}
+
 bool podman::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 {
 	std::string container_id, container_name, api_sock;
-	int uid = detect_podman(tinfo, container_id);
+	int uid = detect_podman(tinfo, m_cgroup_matcher, container_id);
 	tinfo->m_container_id = container_id;
 	bool res = true;
 	if(container_id.size() == 0){
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "container_engine/docker/base.h"
+#include "runc.h"
 
 namespace libsinsp {
 namespace container_engine {
@@ -8,11 +9,13 @@ namespace container_engine {
 class podman : public docker_base
 {
 public:
-	podman(container_cache_interface& cache): docker_base(cache) {}
+	podman(container_cache_interface& cache);
 
 private:
 	static std::string m_api_sock;
 
+	libsinsp::runc::cgroup_matcher m_cgroup_matcher;
+
 	// implement container_engine_base
 	bool resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info) override;
 	void update_with_size(const std::string& container_id) override;
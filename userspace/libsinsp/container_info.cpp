@@ -15,12 +15,102 @@ limitations under the License.
 
 */
 
+#include <cstring>
 #include <utility>
 
 #include "container_info.h"
 #include "sinsp.h"
 #include "sinsp_int.h"
 
+namespace {
+
+// version of the PPME_CONTAINER_BIN_E payload produced by to_binary()
+const uint8_t CONTAINER_BINARY_VERSION = 1;
+
+class binary_writer
+{
+public:
+	explicit binary_writer(std::string &out): m_out(out)
+	{
+	}
+
+	template<typename T>
+	void put(T val)
+	{
+		m_out.append(reinterpret_cast<const char *>(&val), sizeof(val));
+	}
+
+	void put(const std::string &str)
+	{
+		put<uint32_t>(str.size());
+		m_out.append(str);
+	}
+
+private:
+	std::string &m_out;
+};
+
+class binary_reader
+{
+public:
+	binary_reader(const char *buf, size_t len): m_pos(buf), m_end(buf + len)
+	{
+	}
+
+	bool at_end() const
+	{
+		return m_pos == m_end;
+	}
+
+	template<typename T>
+	bool get(T &val)
+	{
+		if((size_t)(m_end - m_pos) < sizeof(val))
+		{
+			return false;
+		}
+		memcpy(&val, m_pos, sizeof(val));
+		m_pos += sizeof(val);
+		return true;
+	}
+
+	bool get(std::string &str)
+	{
+		uint32_t len;
+		if(!get(len) || (size_t)(m_end - m_pos) < len)
+		{
+			return false;
+		}
+		str.assign(m_pos, len);
+		m_pos += len;
+		return true;
+	}
+
+	bool get(bool &val)
+	{
+		uint8_t b;
+		if(!get(b))
+		{
+			return false;
+		}
+		val = (b != 0);
+		return true;
+	}
+
+private:
+	const char *m_pos;
+	const char *m_end;
+};
+
+bool is_exported_env_var(const std::string &var)
+{
+	return var.find("MESOS") != std::string::npos ||
+	       var.find("MARATHON") != std::string::npos ||
+	       var.find("mesos") != std::string::npos;
+}
+
+}
+
 std::vector<std::string> sinsp_container_info::container_health_probe::probe_type_names = {
 	"None",
 	"Healthcheck",
@@ -189,3 +279,232 @@ sinsp_container_info::container_health_probe::probe_type sinsp_container_info::m
 
 	return match->m_probe_type;
 }
+
+void sinsp_container_info::to_binary(std::string &out) const
+{
+	binary_writer w(out);
+
+	w.put(CONTAINER_BINARY_VERSION);
+	w.put(m_id);
+	w.put(m_full_id);
+	w.put<uint32_t>(m_type);
+	w.put(m_name);
+	w.put(m_image);
+	w.put(m_imageid);
+	w.put(m_imagerepo);
+	w.put(m_imagetag);
+	w.put(m_imagedigest);
+	w.put<uint8_t>(m_privileged);
+	w.put<uint8_t>(m_is_pod_sandbox);
+	w.put<uint8_t>(static_cast<uint8_t>(m_lookup_state));
+	w.put<int64_t>(m_created_time);
+
+	w.put<uint32_t>(m_mounts.size());
+	for(const auto &mntinfo : m_mounts)
+	{
+		w.put(mntinfo.m_source);
+		w.put(mntinfo.m_dest);
+		w.put(mntinfo.m_mode);
+		w.put<uint8_t>(mntinfo.m_rdwr);
+		w.put(mntinfo.m_propagation);
+	}
+
+	w.put(m_container_user);
+
+	w.put<uint32_t>(m_health_probes.size());
+	for(const auto &probe : m_health_probes)
+	{
+		w.put<uint8_t>(probe.m_probe_type);
+		w.put(probe.m_health_probe_exe);
+		w.put<uint32_t>(probe.m_health_probe_args.size());
+		for(const auto &arg : probe.m_health_probe_args)
+		{
+			w.put(arg);
+		}
+	}
+
+	w.put<uint32_t>(m_container_ip);
+
+	w.put<uint32_t>(m_port_mappings.size());
+	for(const auto &mapping : m_port_mappings)
+	{
+		w.put<uint32_t>(mapping.m_host_ip);
+		w.put<uint16_t>(mapping.m_host_port);
+		w.put<uint16_t>(mapping.m_container_port);
+	}
+
+	w.put<uint32_t>(m_labels.size());
+	for(const auto &pair : m_labels)
+	{
+		w.put(pair.first);
+		w.put(pair.second);
+	}
+
+	uint32_t num_env = 0;
+	for(const auto &var : m_env)
+	{
+		num_env += is_exported_env_var(var);
+	}
+	w.put(num_env);
+	for(const auto &var : m_env)
+	{
+		if(is_exported_env_var(var))
+		{
+			w.put(var);
+		}
+	}
+
+	w.put<int64_t>(m_memory_limit);
+	w.put<int64_t>(m_swap_limit);
+	w.put<int64_t>(m_cpu_shares);
+	w.put<int64_t>(m_cpu_quota);
+	w.put<int64_t>(m_cpu_period);
+	w.put<int32_t>(m_cpuset_cpu_count);
+	w.put(m_mesos_task_id);
+	w.put<uint64_t>(m_metadata_deadline);
+}
+
+bool sinsp_container_info::from_binary(const char *buf, size_t len)
+{
+	binary_reader r(buf, len);
+	uint8_t version;
+	uint32_t type;
+	uint8_t lookup_state;
+	uint32_t count;
+
+	if(!r.get(version) || version == 0)
+	{
+		return false;
+	}
+
+	// all the fields below are part of version 1
+	if(!r.get(m_id) ||
+	   !r.get(m_full_id) ||
+	   !r.get(type) ||
+	   !r.get(m_name) ||
+	   !r.get(m_image) ||
+	   !r.get(m_imageid) ||
+	   !r.get(m_imagerepo) ||
+	   !r.get(m_imagetag) ||
+	   !r.get(m_imagedigest) ||
+	   !r.get(m_privileged) ||
+	   !r.get(m_is_pod_sandbox) ||
+	   !r.get(lookup_state) ||
+	   !r.get(m_created_time))
+	{
+		return false;
+	}
+	m_type = static_cast<sinsp_container_type>(type);
+	m_lookup_state = static_cast<sinsp_container_lookup_state>(lookup_state);
+
+	if(!r.get(count))
+	{
+		return false;
+	}
+	m_mounts.clear();
+	for(uint32_t i = 0; i < count; i++)
+	{
+		container_mount_info mntinfo;
+		if(!r.get(mntinfo.m_source) ||
+		   !r.get(mntinfo.m_dest) ||
+		   !r.get(mntinfo.m_mode) ||
+		   !r.get(mntinfo.m_rdwr) ||
+		   !r.get(mntinfo.m_propagation))
+		{
+			return false;
+		}
+		m_mounts.emplace_back(std::move(mntinfo));
+	}
+
+	if(!r.get(m_container_user) || !r.get(count))
+	{
+		return false;
+	}
+	m_health_probes.clear();
+	for(uint32_t i = 0; i < count; i++)
+	{
+		container_health_probe probe;
+		uint8_t probe_type;
+		uint32_t num_args;
+		if(!r.get(probe_type) ||
+		   !r.get(probe.m_health_probe_exe) ||
+		   !r.get(num_args))
+		{
+			return false;
+		}
+		probe.m_probe_type = static_cast<container_health_probe::probe_type>(probe_type);
+		for(uint32_t j = 0; j < num_args; j++)
+		{
+			std::string arg;
+			if(!r.get(arg))
+			{
+				return false;
+			}
+			probe.m_health_probe_args.emplace_back(std::move(arg));
+		}
+		m_health_probes.emplace_back(std::move(probe));
+	}
+
+	if(!r.get(m_container_ip) || !r.get(count))
+	{
+		return false;
+	}
+	m_port_mappings.clear();
+	for(uint32_t i = 0; i < count; i++)
+	{
+		container_port_mapping mapping;
+		if(!r.get(mapping.m_host_ip) ||
+		   !r.get(mapping.m_host_port) ||
+		   !r.get(mapping.m_container_port))
+		{
+			return false;
+		}
+		m_port_mappings.push_back(mapping);
+	}
+
+	if(!r.get(count))
+	{
+		return false;
+	}
+	m_labels.clear();
+	for(uint32_t i = 0; i < count; i++)
+	{
+		std::string key;
+		std::string val;
+		if(!r.get(key) || !r.get(val))
+		{
+			return false;
+		}
+		m_labels.emplace(std::move(key), std::move(val));
+	}
+
+	if(!r.get(count))
+	{
+		return false;
+	}
+	m_env.clear();
+	for(uint32_t i = 0; i < count; i++)
+	{
+		std::string var;
+		if(!r.get(var))
+		{
+			return false;
+		}
+		m_env.emplace_back(std::move(var));
+	}
+
+	if(!r.get(m_memory_limit) ||
+	   !r.get(m_swap_limit) ||
+	   !r.get(m_cpu_shares) ||
+	   !r.get(m_cpu_quota) ||
+	   !r.get(m_cpu_period) ||
+	   !r.get(m_cpuset_cpu_count) ||
+	   !r.get(m_mesos_task_id) ||
+	   !r.get(m_metadata_deadline))
+	{
+		return false;
+	}
+
+	// a newer writer may have appended fields we don't know about
+	return version > CONTAINER_BINARY_VERSION || r.at_end();
+}
@@ -222,6 +222,27 @@ public:
 	// Match a process against the set of health probes
 	container_health_probe::probe_type match_health_probe(sinsp_threadinfo *tinfo) const;
 
+	/**
+	 * \brief Serialize the container metadata in the compact binary format
+	 * carried by PPME_CONTAINER_BIN_E events, appending it to `out`
+	 *
+	 * The format starts with a version byte. Newer versions may only append
+	 * fields, so older readers can still decode the fields they know about.
+	 * Like the JSON form, only mesos/marathon related environment variables
+	 * are included.
+	 */
+	void to_binary(std::string &out) const;
+
+	/**
+	 * \brief Fill the container metadata from the output of to_binary()
+	 * @return false if the buffer is truncated or malformed, in which case
+	 * the object may have been partially updated
+	 *
+	 * Fields missing from an older version of the format keep their
+	 * current values.
+	 */
+	bool from_binary(const char *buf, size_t len);
+
 	std::string m_id;
 	std::string m_full_id;
 	sinsp_container_type m_type;
@@ -0,0 +1,207 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace libsinsp {
+
+/**
+ * \brief A reference-counted, copy-on-write std::vector
+ *
+ * @tparam T type of the vector elements
+ *
+ * Copying a cow_vector only bumps a reference count: all the copies share
+ * the same immutable storage. The storage is duplicated lazily, the first
+ * time one of the copies is modified while still being shared.
+ *
+ * This is meant for per-thread state (e.g. command line arguments) that
+ * is inherited verbatim across clone() and only replaced on execve(), so
+ * a fork-heavy workload does not pay for a deep copy of every vector.
+ *
+ * Read access mirrors the const interface of std::vector and the object
+ * converts implicitly to `const std::vector<T>&`. Note that the sharing
+ * is not synchronized: like std::vector, a cow_vector must not be modified
+ * while other threads access it or any of its copies.
+ */
+template<typename T>
+class cow_vector {
+public:
+	typedef std::vector<T> vector_type;
+	typedef typename vector_type::value_type value_type;
+	typedef typename vector_type::size_type size_type;
+	typedef typename vector_type::const_reference const_reference;
+	typedef typename vector_type::const_iterator const_iterator;
+
+	cow_vector() = default;
+
+	cow_vector(vector_type v) : // NOLINT(google-explicit-constructor)
+		m_data(v.empty() ? nullptr : std::make_shared<vector_type>(std::move(v)))
+	{
+	}
+
+	cow_vector& operator=(vector_type v)
+	{
+		m_data = v.empty() ? nullptr : std::make_shared<vector_type>(std::move(v));
+		return *this;
+	}
+
+	const vector_type& get() const
+	{
+		return m_data ? *m_data : empty_vector();
+	}
+
+	operator const vector_type&() const // NOLINT(google-explicit-constructor)
+	{
+		return get();
+	}
+
+	size_type size() const
+	{
+		return m_data ? m_data->size() : 0;
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	const_reference operator[](size_type pos) const
+	{
+		return (*m_data)[pos];
+	}
+
+	const_reference at(size_type pos) const
+	{
+		return get().at(pos);
+	}
+
+	const_reference front() const
+	{
+		return m_data->front();
+	}
+
+	const_reference back() const
+	{
+		return m_data->back();
+	}
+
+	const_iterator begin() const
+	{
+		return get().begin();
+	}
+
+	const_iterator end() const
+	{
+		return get().end();
+	}
+
+	/**
+	 * \brief Return true if the two vectors point to the same storage
+	 *
+	 * Two empty vectors are always considered shared.
+	 */
+	bool shares_storage_with(const cow_vector& other) const
+	{
+		return m_data == other.m_data;
+	}
+
+	void clear()
+	{
+		// no need to copy the contents only to throw them away
+		m_data.reset();
+	}
+
+	void push_back(const T& value)
+	{
+		mutate().push_back(value);
+	}
+
+	void push_back(T&& value)
+	{
+		mutate().push_back(std::move(value));
+	}
+
+	template<typename... Args>
+	void emplace_back(Args&&... args)
+	{
+		mutate().emplace_back(std::forward<Args>(args)...);
+	}
+
+	/**
+	 * \brief Get write access to the underlying vector
+	 *
+	 * If the storage is shared with other copies, it gets duplicated first,
+	 * so the returned reference is only valid until the next copy of this
+	 * object is taken.
+	 */
+	vector_type& mutate()
+	{
+		if(!m_data)
+		{
+			m_data = std::make_shared<vector_type>();
+		}
+		else if(m_data.use_count() > 1)
+		{
+			m_data = std::make_shared<vector_type>(*m_data);
+		}
+		return *m_data;
+	}
+
+	friend bool operator==(const cow_vector& lhs, const cow_vector& rhs)
+	{
+		return lhs.m_data == rhs.m_data || lhs.get() == rhs.get();
+	}
+
+	friend bool operator==(const cow_vector& lhs, const vector_type& rhs)
+	{
+		return lhs.get() == rhs;
+	}
+
+	friend bool operator==(const vector_type& lhs, const cow_vector& rhs)
+	{
+		return lhs == rhs.get();
+	}
+
+	friend bool operator!=(const cow_vector& lhs, const cow_vector& rhs)
+	{
+		return !(lhs == rhs);
+	}
+
+	friend bool operator!=(const cow_vector& lhs, const vector_type& rhs)
+	{
+		return !(lhs == rhs);
+	}
+
+	friend bool operator!=(const vector_type& lhs, const cow_vector& rhs)
+	{
+		return !(lhs == rhs);
+	}
+
+private:
+	static const vector_type& empty_vector()
+	{
+		static const vector_type empty;
+		return empty;
+	}
+
+	std::shared_ptr<vector_type> m_data;
+};
+}
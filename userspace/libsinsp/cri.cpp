@@ -29,6 +29,31 @@ bool pod_uses_host_netns(const runtime::v1alpha2::PodSandboxStatusResponse& resp
 	const auto netns = resp.status().linux().namespaces().options().network();
 	return netns == runtime::v1alpha2::NODE;
 }
+
+// Find the only entry whose key starts with id, as we usually only have
+// the (12 character) short container ids. Ambiguous prefixes are misses.
+template<typename T>
+typename std::map<std::string, T>::iterator find_by_prefix(std::map<std::string, T>& entries, const std::string& id)
+{
+	if(id.empty())
+	{
+		return entries.end();
+	}
+
+	auto it = entries.lower_bound(id);
+	if(it == entries.end() || it->first.compare(0, id.size(), id) != 0)
+	{
+		return entries.end();
+	}
+
+	auto next = std::next(it);
+	if(next != entries.end() && next->first.compare(0, id.size(), id) == 0)
+	{
+		return entries.end();
+	}
+
+	return it;
+}
 }
 
 namespace libsinsp {
@@ -38,6 +63,7 @@ int64_t s_cri_timeout = 1000;
 int64_t s_cri_size_timeout = 10000;
 sinsp_container_type s_cri_runtime_type = CT_CRI;
 bool s_cri_extra_queries = true;
+int64_t s_cri_inventory_refresh_ms = 1000;
 
 cri_interface::cri_interface(const std::string& cri_path)
 {
@@ -338,8 +364,101 @@ bool cri_interface::parse_cri_user_info(const Json::Value &info, sinsp_container
 	return true;
 }
 
+bool cri_interface::refresh_inventory()
+{
+	//
+	// Claim the refresh under the lock, so that concurrent lookups don't
+	// issue the same calls, but don't hold it across the calls
+	//
+	{
+		std::lock_guard<std::mutex> lock(m_inventory_mutex);
+		auto now = std::chrono::steady_clock::now();
+		if(now - m_inventory_ts < std::chrono::milliseconds(s_cri_inventory_refresh_ms))
+		{
+			return false;
+		}
+		m_inventory_ts = now;
+	}
+
+	runtime::v1alpha2::ListPodSandboxRequest sreq;
+	runtime::v1alpha2::ListPodSandboxResponse sresp;
+	grpc::ClientContext scontext;
+	scontext.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(s_cri_timeout));
+	grpc::Status status = m_cri->ListPodSandbox(&scontext, sreq, &sresp);
+	if(!status.ok())
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG, "cri: ListPodSandbox failed: %s",
+				status.error_message().c_str());
+		return false;
+	}
+
+	runtime::v1alpha2::ListContainersRequest creq;
+	runtime::v1alpha2::ListContainersResponse cresp;
+	grpc::ClientContext ccontext;
+	ccontext.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(s_cri_timeout));
+	status = m_cri->ListContainers(&ccontext, creq, &cresp);
+	if(!status.ok())
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG, "cri: ListContainers failed: %s",
+				status.error_message().c_str());
+		return false;
+	}
+
+	std::map<std::string, std::string> containers;
+	for(const auto& container : cresp.containers())
+	{
+		containers[container.id()] = container.pod_sandbox_id();
+	}
+
+	std::map<std::string, pod_sandbox_entry> pod_sandboxes;
+	for(const auto& pod : sresp.items())
+	{
+		pod_sandboxes[pod.id()] = pod_sandbox_entry();
+	}
+
+	std::lock_guard<std::mutex> lock(m_inventory_mutex);
+
+	// Keep the addresses we already know for the pods still around
+	for(auto& pod : pod_sandboxes)
+	{
+		auto it = m_inventory_pod_sandboxes.find(pod.first);
+		if(it != m_inventory_pod_sandboxes.end())
+		{
+			pod.second = it->second;
+		}
+	}
+
+	m_inventory_pod_sandboxes.swap(pod_sandboxes);
+	m_inventory_containers.swap(containers);
+	m_image_ids.clear();
+
+	g_logger.format(sinsp_logger::SEV_DEBUG, "cri: inventory refreshed, %zu pod sandboxes, %zu containers",
+			m_inventory_pod_sandboxes.size(), m_inventory_containers.size());
+	return true;
+}
+
 bool cri_interface::is_pod_sandbox(const std::string &container_id)
 {
+	{
+		std::lock_guard<std::mutex> lock(m_inventory_mutex);
+		if(find_by_prefix(m_inventory_pod_sandboxes, container_id) != m_inventory_pod_sandboxes.end())
+		{
+			return true;
+		}
+
+		// a known container is not a pod sandbox, no need to ask
+		if(find_by_prefix(m_inventory_containers, container_id) != m_inventory_containers.end())
+		{
+			return false;
+		}
+	}
+
+	if(refresh_inventory())
+	{
+		std::lock_guard<std::mutex> lock(m_inventory_mutex);
+		return find_by_prefix(m_inventory_pod_sandboxes, container_id) != m_inventory_pod_sandboxes.end();
+	}
+
 	runtime::v1alpha2::PodSandboxStatusRequest req;
 	runtime::v1alpha2::PodSandboxStatusResponse resp;
 	req.set_pod_sandbox_id(container_id);
@@ -354,6 +473,15 @@ bool cri_interface::is_pod_sandbox(const std::string &container_id)
 
 uint32_t cri_interface::get_pod_sandbox_ip(const std::string &pod_sandbox_id)
 {
+	{
+		std::lock_guard<std::mutex> lock(m_inventory_mutex);
+		auto it = find_by_prefix(m_inventory_pod_sandboxes, pod_sandbox_id);
+		if(it != m_inventory_pod_sandboxes.end() && it->second.m_ip_valid)
+		{
+			return it->second.m_ip;
+		}
+	}
+
 	runtime::v1alpha2::PodSandboxStatusRequest req;
 	runtime::v1alpha2::PodSandboxStatusResponse resp;
 	req.set_pod_sandbox_id(pod_sandbox_id);
@@ -368,30 +496,66 @@ uint32_t cri_interface::get_pod_sandbox_ip(const std::string &pod_sandbox_id)
 		return 0;
 	}
 
-	if(pod_uses_host_netns(resp))
+	uint32_t ip = 0;
+	bool resolved = pod_uses_host_netns(resp);
+	const auto &pod_ip = resp.status().network().ip();
+	if(!resolved && !pod_ip.empty())
 	{
-		return 0;
+		int res = inet_pton(AF_INET, pod_ip.c_str(), &ip);
+		if(res == -1)
+		{
+			ASSERT(false);
+			return 0;
+		}
+
+		resolved = (res == 1);
 	}
 
-	const auto &pod_ip = resp.status().network().ip();
-	if(pod_ip.empty())
+	//
+	// The address is empty while the network of a new sandbox is still
+	// being set up: don't cache that, ask again for the next container
+	//
+	if(!resolved)
 	{
 		return 0;
 	}
 
-	uint32_t ip;
-	if(inet_pton(AF_INET, pod_ip.c_str(), &ip) == -1)
-	{
-		ASSERT(false);
-		return 0;
-	} else
+	std::lock_guard<std::mutex> lock(m_inventory_mutex);
+	auto it = m_inventory_pod_sandboxes.find(resp.status().id());
+	if(it != m_inventory_pod_sandboxes.end())
 	{
-		return ip;
+		it->second.m_ip_valid = true;
+		it->second.m_ip = ip;
 	}
+
+	return ip;
 }
 
 uint32_t cri_interface::get_container_ip(const std::string &container_id)
 {
+	std::string pod_sandbox_id;
+	auto find_pod_sandbox_id = [&]() {
+		std::lock_guard<std::mutex> lock(m_inventory_mutex);
+		auto it = find_by_prefix(m_inventory_containers, container_id);
+		if(it == m_inventory_containers.end())
+		{
+			return false;
+		}
+
+		pod_sandbox_id = it->second;
+		return true;
+	};
+
+	if(!find_pod_sandbox_id() && refresh_inventory())
+	{
+		find_pod_sandbox_id();
+	}
+
+	if(!pod_sandbox_id.empty())
+	{
+		return ntohl(get_pod_sandbox_ip(pod_sandbox_id));
+	}
+
 	runtime::v1alpha2::ListContainersRequest req;
 	runtime::v1alpha2::ListContainersResponse resp;
 	auto filter = req.mutable_filter();
@@ -421,6 +585,15 @@ uint32_t cri_interface::get_container_ip(const std::string &container_id)
 
 std::string cri_interface::get_container_image_id(const std::string &image_ref)
 {
+	{
+		std::lock_guard<std::mutex> lock(m_inventory_mutex);
+		auto it = m_image_ids.find(image_ref);
+		if(it != m_image_ids.end())
+		{
+			return it->second;
+		}
+	}
+
 	runtime::v1alpha2::ListImagesRequest req;
 	runtime::v1alpha2::ListImagesResponse resp;
 	auto filter = req.mutable_filter();
@@ -439,6 +612,8 @@ std::string cri_interface::get_container_image_id(const std::string &image_ref)
 			break;
 		case 1: {
 			const auto& image = resp.images(0);
+			std::lock_guard<std::mutex> lock(m_inventory_mutex);
+			m_image_ids[image_ref] = image.id();
 			return image.id();
 		}
 		default:
@@ -17,7 +17,10 @@ limitations under the License.
 
 #pragma once
 
+#include <chrono>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #ifndef MINIMAL_BUILD
@@ -41,6 +44,7 @@ extern std::string s_cri_unix_socket_path;
 extern int64_t s_cri_timeout;
 extern sinsp_container_type s_cri_runtime_type;
 extern bool s_cri_extra_queries;
+extern int64_t s_cri_inventory_refresh_ms;
 
 class cri_interface
 {
@@ -137,6 +141,8 @@ public:
 	 * @brief check if the passed container ID is a pod sandbox (pause container)
 	 * @param container_id the container ID to check
 	 * @return true if it's a pod sandbox
+	 *
+	 * Answered from the inventory snapshot when possible
 	 */
 	bool is_pod_sandbox(const std::string &container_id);
 
@@ -144,6 +150,9 @@ public:
 	 * @brief get pod IP address
 	 * @param pod_sandbox_id container ID of the pod sandbox
 	 * @return the IP address if possible, 0 otherwise (e.g. when the pod uses host netns)
+	 *
+	 * The address is remembered for as long as the pod sandbox exists,
+	 * so all the containers in a pod share a single PodSandboxStatus call
 	 */
 	uint32_t get_pod_sandbox_ip(const std::string &pod_sandbox_id);
 
@@ -152,8 +161,8 @@ public:
 	 * @param container_id the container ID
 	 * @return the IP address if possible, 0 otherwise (e.g. when the pod uses host netns)
 	 *
-	 * This method first finds the pod ID, then gets the IP address
-	 * of the pod sandbox container
+	 * This method first finds the pod ID (from the inventory snapshot
+	 * if possible), then gets the IP address of the pod sandbox container
 	 */
 	uint32_t get_container_ip(const std::string &container_id);
 
@@ -165,10 +174,43 @@ public:
 	std::string get_container_image_id(const std::string &image_ref);
 
 private:
+	struct pod_sandbox_entry
+	{
+		pod_sandbox_entry(): m_ip_valid(false), m_ip(0) {}
+
+		bool m_ip_valid;
+		uint32_t m_ip;
+	};
+
+	/**
+	 * @brief reload the container and pod sandbox inventory with a single
+	 * 	ListContainers and ListPodSandbox call
+	 * @return true if the snapshot was reloaded, false if it is too recent
+	 * 	to be refreshed again (see s_cri_inventory_refresh_ms) or the
+	 * 	calls failed
+	 *
+	 * Must be called without m_inventory_mutex held: the calls are made
+	 * unlocked and the new snapshot is swapped in under the lock
+	 */
+	bool refresh_inventory();
 
 	std::unique_ptr<runtime::v1alpha2::RuntimeService::Stub> m_cri;
 	std::unique_ptr<runtime::v1alpha2::ImageService::Stub> m_cri_image;
 	sinsp_container_type m_cri_runtime_type;
+
+	//
+	// Snapshot of the CRI inventory, shared by all the lookups so that
+	// we don't need extra round trips for every single container.
+	// Lookups that miss the snapshot fall back to per-container calls.
+	//
+	std::mutex m_inventory_mutex;
+	std::chrono::steady_clock::time_point m_inventory_ts;
+	// container id -> pod sandbox id
+	std::map<std::string, std::string> m_inventory_containers;
+	// pod sandbox id -> cached pod sandbox status
+	std::map<std::string, pod_sandbox_entry> m_inventory_pod_sandboxes;
+	// image ref -> image id, reset on every refresh
+	std::map<std::string, std::string> m_image_ids;
 };
 
 }
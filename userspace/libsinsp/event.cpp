@@ -159,21 +159,14 @@ uint32_t sinsp_evt::get_num_params()
 	if((m_flags & sinsp_evt::SINSP_EF_PARAMS_LOADED) == 0)
 	{
 		load_params();
-		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
 	}
 
-	return (uint32_t)m_params.size();
+	return m_nparams;
 }
 
 sinsp_evt_param *sinsp_evt::get_param(uint32_t id)
 {
-	if((m_flags & sinsp_evt::SINSP_EF_PARAMS_LOADED) == 0)
-	{
-		load_params();
-		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
-	}
-
-	return &(m_params[id]);
+	return get_param_lazy(id);
 }
 
 const char *sinsp_evt::get_param_name(uint32_t id)
@@ -181,7 +174,6 @@ const char *sinsp_evt::get_param_name(uint32_t id)
 	if((m_flags & sinsp_evt::SINSP_EF_PARAMS_LOADED) == 0)
 	{
 		load_params();
-		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
 	}
 
 	ASSERT(id < m_info->nparams);
@@ -194,7 +186,6 @@ const struct ppm_param_info* sinsp_evt::get_param_info(uint32_t id)
 	if((m_flags & sinsp_evt::SINSP_EF_PARAMS_LOADED) == 0)
 	{
 		load_params();
-		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
 	}
 
 	ASSERT(id < m_info->nparams);
@@ -745,15 +736,6 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 	uint16_t payload_len;
 	Json::Value ret;
 
-	//
-	// Make sure the params are actually loaded
-	//
-	if((m_flags & sinsp_evt::SINSP_EF_PARAMS_LOADED) == 0)
-	{
-		load_params();
-		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
-	}
-
 	ASSERT(id < get_num_params());
 
 	//
@@ -764,7 +746,7 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 	//
 	// Get the parameter
 	//
-	sinsp_evt_param *param = &(m_params[id]);
+	sinsp_evt_param *param = get_param_lazy(id);
 	payload = param->m_val;
 	payload_len = param->m_len;
 	param_info = &(m_info->params[id]);
@@ -1430,7 +1412,7 @@ std::string sinsp_evt::get_base_dir(uint32_t id, sinsp_threadinfo *tinfo)
 		return cwd;
 	}
 
-	const sinsp_evt_param* dir_param = &m_params[dirfd_id];
+	const sinsp_evt_param* dir_param = get_param_lazy(dirfd_id);
 	const int64_t dirfd = *(int64_t*)dir_param->m_val;
 
 	// If the FD is special value PPM_AT_FDCWD, just use CWD
@@ -1459,15 +1441,6 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 	uint32_t j;
 	uint16_t payload_len;
 
-	//
-	// Make sure the params are actually loaded
-	//
-	if((m_flags & sinsp_evt::SINSP_EF_PARAMS_LOADED) == 0)
-	{
-		load_params();
-		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
-	}
-
 	ASSERT(id < get_num_params());
 
 	//
@@ -1478,7 +1451,7 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 	//
 	// Get the parameter
 	//
-	sinsp_evt_param *param = &(m_params[id]);
+	sinsp_evt_param *param = get_param_lazy(id);
 	payload = param->m_val;
 	payload_len = param->m_len;
 	param_info = &(m_info->params[id]);
@@ -2467,15 +2440,6 @@ const char* sinsp_evt::get_param_value_str(const char* name, OUT const char** re
 
 const sinsp_evt_param* sinsp_evt::get_param_value_raw(const char* name)
 {
-	//
-	// Make sure the params are actually loaded
-	//
-	if((m_flags & sinsp_evt::SINSP_EF_PARAMS_LOADED) == 0)
-	{
-		load_params();
-		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
-	}
-
 	//
 	// Locate the parameter given the name
 	//
@@ -2485,7 +2449,7 @@ const sinsp_evt_param* sinsp_evt::get_param_value_raw(const char* name)
 	{
 		if(strcmp(name, get_param_name(j)) == 0)
 		{
-			return &(m_params[j]);
+			return get_param_lazy(j);
 		}
 	}
 
@@ -2747,7 +2711,9 @@ bool sinsp_evt::evtcpy(sinsp_evt& dest, const sinsp_evt& src)
 	dest.m_cpuid = src.m_cpuid;
 	// m_evtnum is used in cached filters and that is safe for reuse
 	dest.m_evtnum = src.m_evtnum;
-	dest.m_flags = src.m_flags;
+	// the parameters point into the event buffer, so they have
+	// to be decoded again from the copy
+	dest.m_flags = src.m_flags & ~(uint32_t)SINSP_EF_PARAMS_LOADED;
 	dest.m_params_loaded = src.m_params_loaded;
 
 	dest.m_iosize = src.m_iosize;
@@ -2756,7 +2722,6 @@ bool sinsp_evt::evtcpy(sinsp_evt& dest, const sinsp_evt& src)
 	dest.m_filtered_out = src.m_filtered_out;
 
 	// vectors
-	dest.m_params = src.m_params;
 	dest.m_paramstr_storage = src.m_paramstr_storage;
 	dest.m_resolved_paramstr_storage = src.m_resolved_paramstr_storage;
 
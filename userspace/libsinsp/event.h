@@ -221,6 +221,14 @@ public:
 		return m_pevt->ts;
 	}
 
+	/*!
+	  \brief Return the raw event, header and parameters included.
+	*/
+	inline const scap_evt* get_scap_evt() const
+	{
+		return m_pevt;
+	}
+
 	/*!
 	  \brief Return the event name string, e.g. 'open' or 'socket'.
 	*/
@@ -436,28 +444,62 @@ private:
 		m_tinfo = threadinfo;
 		m_fdinfo = fdinfo;
 	}
+	//
+	// Parameters are decoded lazily: load_params() only looks at the
+	// event header, and the parameter table is then filled on demand up
+	// to the highest parameter that has been requested.
+	//
 	inline void load_params()
 	{
-		uint32_t j;
-		uint32_t nparams;
-		sinsp_evt_param par;
-
 		// If we're reading a capture created with a newer version, it may contain
 		// new parameters. If instead we're reading an older version, the current
 		// event table entry may contain new parameters.
 		// Use the minimum between the two values.
-		nparams = m_info->nparams < m_pevt->nparams ? m_info->nparams : m_pevt->nparams;
-		uint16_t *lens = (uint16_t *)((char *)m_pevt + sizeof(struct ppm_evt_hdr));
+		m_nparams = m_info->nparams < m_pevt->nparams ? m_info->nparams : m_pevt->nparams;
+		m_nparams_decoded = 0;
 		// The offset in the block is instead always based on the capture value.
-		char *valptr = (char *)lens + m_pevt->nparams * sizeof(uint16_t);
-		m_params.clear();
+		m_next_param_val = (char *)m_pevt + sizeof(struct ppm_evt_hdr) + m_pevt->nparams * sizeof(uint16_t);
+		m_flags |= (uint32_t)sinsp_evt::SINSP_EF_PARAMS_LOADED;
+	}
+	inline void decode_params(uint32_t id)
+	{
+		uint16_t *lens = (uint16_t *)((char *)m_pevt + sizeof(struct ppm_evt_hdr));
+		uint32_t last = id < m_nparams ? id : m_nparams - 1;
+
+		for(uint32_t j = m_nparams_decoded; j <= last; j++)
+		{
+			m_params[j].init(m_next_param_val, lens[j]);
+			m_next_param_val += lens[j];
+		}
 
-		for(j = 0; j < nparams; j++)
+		m_nparams_decoded = last + 1;
+	}
+	inline sinsp_evt_param* get_param_lazy(uint32_t id)
+	{
+		if((m_flags & sinsp_evt::SINSP_EF_PARAMS_LOADED) == 0)
 		{
-			par.init(valptr, lens[j]);
-			m_params.push_back(par);
-			valptr += lens[j];
+			load_params();
 		}
+
+		ASSERT(id < m_nparams);
+
+		if(id >= m_nparams_decoded && m_nparams != 0)
+		{
+			decode_params(id);
+		}
+
+		return &(m_params[id]);
+	}
+	//
+	// Fast path for the exit parsers that only need the return value,
+	// which is always the first parameter: read it straight from the
+	// event buffer, without touching the parameter table
+	//
+	inline int64_t get_syscall_return_value()
+	{
+		ASSERT(m_pevt->nparams > 0);
+		ASSERT(*(uint16_t *)((char *)m_pevt + sizeof(struct ppm_evt_hdr)) == sizeof(int64_t));
+		return *(int64_t *)((char *)m_pevt + sizeof(struct ppm_evt_hdr) + m_pevt->nparams * sizeof(uint16_t));
 	}
 	std::string get_param_value_str(uint32_t id, bool resolved);
 	std::string get_param_value_str(const char* name, bool resolved = true);
@@ -484,7 +526,10 @@ VISIBILITY_PRIVATE
 	uint32_t m_flags;
 	bool m_params_loaded;
 	const struct ppm_event_info* m_info;
-	std::vector<sinsp_evt_param> m_params;
+	sinsp_evt_param m_params[PPM_MAX_EVENT_PARAMS];
+	uint32_t m_nparams;
+	uint32_t m_nparams_decoded;
+	char* m_next_param_val;
 
 	std::vector<char> m_paramstr_storage;
 	std::vector<char> m_resolved_paramstr_storage;
@@ -20,6 +20,7 @@ limitations under the License.
 #include "filter.h"
 #include "filterchecks.h"
 #include "eventformatter.h"
+#include "fast_format.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // rawstring_check implementation
@@ -74,6 +75,7 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 	const char* cfmt = lfmt.c_str();
 
 	m_tokens.clear();
+	m_tokenlens.clear();
 	uint32_t lfmtlen = (uint32_t)lfmt.length();
 
 	for(j = 0; j < lfmtlen; j++)
@@ -157,6 +159,27 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 		m_chks_to_free.push_back(chk);
 		m_tokenlens.push_back(0);
 	}
+
+	//
+	// A Json::Value object keeps its members sorted by name, and the last
+	// assignment to a name wins. Compute that order once here, so that the
+	// Json output can be streamed without building the object every time.
+	//
+	map<string, uint32_t> json_members;
+
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		if(m_tokens[j].second->get_field_info() != NULL)
+		{
+			json_members[m_tokens[j].first] = j;
+		}
+	}
+
+	m_json_tokens.clear();
+	for(const auto& it : json_members)
+	{
+		m_json_tokens.push_back(it.second);
+	}
 }
 
 bool sinsp_evt_formatter::on_capture_end(OUT string* res)
@@ -203,91 +226,91 @@ bool sinsp_evt_formatter::resolve_tokens(sinsp_evt *evt, map<string,string>& val
 
 bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT string* res)
 {
-	bool retval = true;
-	const filtercheck_field_info* fi;
+	uint32_t j;
+	sinsp_evt::param_fmt fmt = m_inspector->get_buffer_format();
 
-	uint32_t j = 0;
-	vector<sinsp_filter_check*>::iterator it;
 	res->clear();
 
 	ASSERT(m_tokenlens.size() == m_tokens.size());
 
-	for(j = 0; j < m_tokens.size(); j++)
+	if(fmt == sinsp_evt::PF_JSON
+	   || fmt == sinsp_evt::PF_JSONEOLS
+	   || fmt == sinsp_evt::PF_JSONHEX
+	   || fmt == sinsp_evt::PF_JSONHEXASCII
+	   || fmt == sinsp_evt::PF_JSONBASE64)
 	{
-		if(m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64)
-		{
-			Json::Value json_value = m_tokens[j].second->tojson(evt);
+		res->push_back('{');
 
-			if(retval == false)
-			{
-				continue;
-			}
+		for(j = 0; j < m_json_tokens.size(); j++)
+		{
+			const pair<string, sinsp_filter_check*>& token = m_tokens[m_json_tokens[j]];
 
-			if(json_value == Json::nullValue && m_require_all_values)
+			if(j != 0)
 			{
-				retval = false;
-				continue;
+				res->push_back(',');
 			}
 
-			fi = m_tokens[j].second->get_field_info();
+			libsinsp::fast_format::append_json_string(*res, token.first.c_str(), token.first.size());
+			res->push_back(':');
 
-			if(fi)
+			if(!token.second->append_json(evt, res))
 			{
-				m_root[m_tokens[j].first] = m_tokens[j].second->tojson(evt);
+				if(m_require_all_values)
+				{
+					return false;
+				}
+
+				res->append("null");
 			}
 		}
-		else
+
+		res->push_back('}');
+		return true;
+	}
+
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		sinsp_filter_check* chk = m_tokens[j].second;
+
+		if(m_tokens[j].first.empty())
 		{
-			char* str = m_tokens[j].second->tostring(evt);
+			//
+			// Literal text between two fields
+			//
+			(*res) += static_cast<rawstring_check*>(chk)->m_text;
+			continue;
+		}
 
-			if(retval == false)
-			{
-				continue;
-			}
+		size_t start = res->size();
 
-			if(str == NULL)
+		if(!chk->append_string(evt, res))
+		{
+			if(m_require_all_values)
 			{
-				if(m_require_all_values)
-				{
-					retval = false;
-					continue;
-				}
-				else
-				{
-					str = (char*)"<NA>";
-				}
+				return false;
 			}
 
-			uint32_t tks = m_tokenlens[j];
+			(*res) += "<NA>";
+		}
+
+		uint32_t tks = m_tokenlens[j];
 
-			if(tks != 0)
+		if(tks != 0)
+		{
+			size_t toklen = res->size() - start;
+
+			if(toklen < tks)
 			{
-				string sstr(str);
-				sstr.resize(tks, ' ');
-				(*res) += sstr;
+				res->append(tks - toklen, ' ');
 			}
 			else
 			{
-				(*res) += str;
+				res->resize(start + tks);
 			}
 		}
 	}
 
-	if(m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64)
-	{
-		(*res) = m_writer.write(m_root);
-		(*res) = res->substr(0, res->size() - 1);
-	}
-
-	return retval;
+	return true;
 }
 
 #else  // HAS_FILTERING
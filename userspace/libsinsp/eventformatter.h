@@ -62,6 +62,8 @@ public:
 
 	  \param evt Pointer to the event to be converted into string.
 	  \param res Pointer to the string that will be filled with the result.
+	   The output is rendered directly into it, so reusing the same string
+	   across events avoids reallocating the buffer every time.
 
 	  \return true if the string should be shown (based on the initial *),
 	   false otherwise.
@@ -88,8 +90,9 @@ private:
 	bool m_require_all_values;
 	vector<sinsp_filter_check*> m_chks_to_free;
 
-	Json::Value m_root;
-	Json::FastWriter m_writer;
+	// indexes into m_tokens of the members of the Json output, in the
+	// same (sorted, deduplicated) order a Json::Value object would have
+	vector<uint32_t> m_json_tokens;
 };
 
 /*!
@@ -0,0 +1,130 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace libsinsp {
+namespace fast_format {
+
+/**
+ * \brief Append the decimal rendering of an unsigned integer to out
+ *
+ * Equivalent to snprintf("%" PRIu64) but without the format string
+ * parsing and without an intermediate buffer owned by the caller.
+ */
+inline void append_uint(std::string& out, uint64_t val)
+{
+	char buf[20];
+	char* p = buf + sizeof(buf);
+
+	do
+	{
+		*--p = (char)('0' + (val % 10));
+		val /= 10;
+	} while(val != 0);
+
+	out.append(p, buf + sizeof(buf) - p);
+}
+
+/**
+ * \brief Append the decimal rendering of a signed integer to out
+ */
+inline void append_int(std::string& out, int64_t val)
+{
+	if(val < 0)
+	{
+		out.push_back('-');
+		// negate in unsigned space, so INT64_MIN does not overflow
+		append_uint(out, 0 - (uint64_t)val);
+	}
+	else
+	{
+		append_uint(out, (uint64_t)val);
+	}
+}
+
+/**
+ * \brief Append a dotted-quad rendering of the IPv4 address stored
+ * (in network byte order) at addr
+ */
+inline void append_ipv4(std::string& out, const uint8_t* addr)
+{
+	for(int j = 0; j < 4; j++)
+	{
+		if(j != 0)
+		{
+			out.push_back('.');
+		}
+		append_uint(out, addr[j]);
+	}
+}
+
+/**
+ * \brief Append str, quoted and escaped as a JSON string, to out
+ *
+ * The escaping matches the one done by Json::FastWriter: quotes,
+ * backslashes and control characters are escaped, everything else
+ * (including non-ASCII bytes) is copied verbatim.
+ */
+inline void append_json_string(std::string& out, const char* str, size_t len)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	const char* end = str + len;
+	const char* run = str;
+
+	out.push_back('"');
+
+	for(const char* c = str; c != end; ++c)
+	{
+		const char* esc;
+
+		switch(*c)
+		{
+		case '"': esc = "\\\""; break;
+		case '\\': esc = "\\\\"; break;
+		case '\b': esc = "\\b"; break;
+		case '\f': esc = "\\f"; break;
+		case '\n': esc = "\\n"; break;
+		case '\r': esc = "\\r"; break;
+		case '\t': esc = "\\t"; break;
+		default:
+			if(*c > 0 && *c <= 0x1F)
+			{
+				out.append(run, c - run);
+				out.append("\\u00");
+				out.push_back(hex[(*c >> 4) & 0xf]);
+				out.push_back(hex[*c & 0xf]);
+				run = c + 1;
+			}
+			continue;
+		}
+
+		out.append(run, c - run);
+		out.append(esc);
+		run = c + 1;
+	}
+
+	out.append(run, end - run);
+	out.push_back('"');
+}
+
+}
+}
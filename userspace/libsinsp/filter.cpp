@@ -40,6 +40,7 @@ limitations under the License.
 #include "filter.h"
 #include "filterchecks.h"
 #include "value_parser.h"
+#include "fast_format.h"
 #ifndef _WIN32
 #include "arpa/inet.h"
 #endif
@@ -1159,6 +1160,175 @@ Json::Value sinsp_filter_check::tojson(sinsp_evt* evt)
 	return jsonval;
 }
 
+bool sinsp_filter_check::rawval_append_string(uint8_t* rawval,
+					       ppm_param_type ptype,
+					       ppm_print_format print_format,
+					       uint32_t len,
+					       OUT string* res)
+{
+	bool dec = (print_format == PF_DEC || print_format == PF_ID);
+
+	switch(ptype)
+	{
+	case PT_INT8:
+	case PT_INT16:
+	case PT_INT32:
+	case PT_INT64:
+	case PT_PID:
+	case PT_ERRNO:
+		if(dec)
+		{
+			int64_t val = ptype == PT_INT8 ? *(int8_t*)rawval :
+				ptype == PT_INT16 ? *(int16_t*)rawval :
+				ptype == PT_INT32 ? *(int32_t*)rawval :
+				*(int64_t*)rawval;
+			libsinsp::fast_format::append_int(*res, val);
+			return true;
+		}
+		break;
+	case PT_L4PROTO:
+	case PT_UINT8:
+	case PT_PORT:
+	case PT_UINT16:
+	case PT_UINT32:
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		if(dec)
+		{
+			uint64_t val = (ptype == PT_L4PROTO || ptype == PT_UINT8) ? *(uint8_t*)rawval :
+				(ptype == PT_PORT || ptype == PT_UINT16) ? *(uint16_t*)rawval :
+				ptype == PT_UINT32 ? *(uint32_t*)rawval :
+				*(uint64_t*)rawval;
+			libsinsp::fast_format::append_uint(*res, val);
+			return true;
+		}
+		break;
+	case PT_CHARBUF:
+	case PT_FSPATH:
+	case PT_FSRELPATH:
+		res->append((char*)rawval);
+		return true;
+	case PT_BYTEBUF:
+		res->append((char*)rawval, strnlen((char*)rawval, len));
+		return true;
+	case PT_IPV4ADDR:
+		libsinsp::fast_format::append_ipv4(*res, rawval);
+		return true;
+	case PT_IPADDR:
+		if(len == sizeof(struct in_addr))
+		{
+			libsinsp::fast_format::append_ipv4(*res, rawval);
+			return true;
+		}
+		break;
+	default:
+		break;
+	}
+
+	//
+	// Less common type/format combination, use the generic renderer
+	//
+	char* str = rawval_to_string(rawval, ptype, print_format, len);
+	if(str == NULL)
+	{
+		return false;
+	}
+
+	res->append(str);
+	return true;
+}
+
+bool sinsp_filter_check::append_string(sinsp_evt* evt, OUT string* res)
+{
+	uint32_t len;
+	uint8_t* rawval = extract(evt, &len);
+
+	if(rawval == NULL)
+	{
+		return false;
+	}
+
+	return rawval_append_string(rawval, m_field->m_type, m_field->m_print_format, len, res);
+}
+
+bool sinsp_filter_check::append_json(sinsp_evt* evt, OUT string* res)
+{
+	uint32_t len;
+	Json::Value jsonval = extract_as_js(evt, &len);
+
+	if(jsonval == Json::nullValue)
+	{
+		uint8_t* rawval = extract(evt, &len);
+		if(rawval == NULL)
+		{
+			return false;
+		}
+
+		ppm_param_type ptype = m_field->m_type;
+		bool dec = (m_field->m_print_format == PF_DEC || m_field->m_print_format == PF_ID);
+
+		switch(ptype)
+		{
+		case PT_INT8:
+		case PT_INT16:
+		case PT_INT32:
+		case PT_INT64:
+		case PT_PID:
+		case PT_L4PROTO:
+		case PT_UINT8:
+		case PT_PORT:
+		case PT_UINT16:
+		case PT_UINT32:
+		case PT_UINT64:
+		case PT_RELTIME:
+		case PT_ABSTIME:
+			if(dec)
+			{
+				// numbers are rendered the same way in plain text and Json
+				return rawval_append_string(rawval, ptype, m_field->m_print_format, len, res);
+			}
+			break;
+		case PT_BOOL:
+			res->append(*(uint32_t*)rawval != 0 ? "true" : "false");
+			return true;
+		case PT_CHARBUF:
+		case PT_FSPATH:
+		case PT_BYTEBUF:
+		case PT_IPV4ADDR:
+		case PT_IPV6ADDR:
+		case PT_IPADDR:
+		case PT_FSRELPATH:
+		{
+			char* str = rawval_to_string(rawval, ptype, m_field->m_print_format, len);
+			if(str == NULL)
+			{
+				return false;
+			}
+			libsinsp::fast_format::append_json_string(*res, str, strlen(str));
+			return true;
+		}
+		default:
+			break;
+		}
+
+		jsonval = rawval_to_json(rawval, ptype, m_field->m_print_format, len);
+		if(jsonval == Json::nullValue)
+		{
+			return false;
+		}
+	}
+
+	//
+	// Structured values are rare enough that we can afford to serialize
+	// them through jsoncpp
+	//
+	Json::FastWriter writer;
+	string str = writer.write(jsonval);
+	res->append(str, 0, str.size() - 1);
+	return true;
+}
+
 int32_t sinsp_filter_check::parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
 {
 	int32_t j;
@@ -1238,7 +1238,7 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 		break;
 	case TYPE_UID:
 		{
-			if(evt->get_type() == PPME_CONTAINER_JSON_E)
+			if(evt->get_type() == PPME_CONTAINER_JSON_E || evt->get_type() == PPME_CONTAINER_BIN_E)
 			{
 				return NULL;
 			}
@@ -4613,7 +4613,8 @@ uint8_t* sinsp_filter_check_user::extract(sinsp_evt *evt, OUT uint32_t* len, boo
 	}
 
 	// For container events, use the user from the container metadata instead.
-	if(m_field_id == TYPE_NAME && evt->get_type() == PPME_CONTAINER_JSON_E)
+	if(m_field_id == TYPE_NAME &&
+	   (evt->get_type() == PPME_CONTAINER_JSON_E || evt->get_type() == PPME_CONTAINER_BIN_E))
 	{
 		const sinsp_container_info::ptr_t container_info =
 			m_inspector->m_container_manager.get_container(tinfo->m_container_id);
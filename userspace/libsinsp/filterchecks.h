@@ -153,6 +153,18 @@ public:
 	//
 	virtual Json::Value tojson(sinsp_evt* evt);
 
+	//
+	// Extract the value from the event and append its string rendering
+	// to res, without going through an intermediate buffer for the common
+	// types. Returns false, leaving res untouched, if there is no value.
+	//
+	virtual bool append_string(sinsp_evt* evt, OUT string* res);
+
+	//
+	// Same as append_string(), but appends the Json rendering of the value
+	//
+	virtual bool append_json(sinsp_evt* evt, OUT string* res);
+
 	sinsp* m_inspector;
 	bool m_needs_state_tracking = false;
 	sinsp_field_aggregation m_aggregation;
@@ -168,6 +180,11 @@ protected:
 			       ppm_print_format print_format,
 			       uint32_t len);
 	Json::Value rawval_to_json(uint8_t* rawval, ppm_param_type ptype, ppm_print_format print_format, uint32_t len);
+	bool rawval_append_string(uint8_t* rawval,
+				  ppm_param_type ptype,
+				  ppm_print_format print_format,
+				  uint32_t len,
+				  OUT string* res);
 	void string_to_rawval(const char* str, uint32_t len, ppm_param_type ptype);
 
 	char m_getpropertystr_storage[1024];
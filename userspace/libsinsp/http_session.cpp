@@ -0,0 +1,567 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "http_session.h"
+
+#include <algorithm>
+
+sinsp_http_session_manager::sinsp_http_session_manager(sinsp_http_listener* listener, uint32_t max_sessions):
+	m_listener(listener),
+	m_max_sessions(max_sessions),
+	m_next_cleanup_ts(0),
+	m_n_dropped_sessions(0),
+	m_n_dropped_requests(0),
+	m_n_parse_errors(0),
+	m_cur_session(NULL),
+	m_cur_dir(DIR_READ),
+	m_cur_evt(NULL),
+	m_cur_ts(0)
+{
+	http_parser_settings_init(&m_settings);
+	m_settings.on_message_begin = on_message_begin;
+	m_settings.on_url = on_url;
+	m_settings.on_status = on_status;
+	m_settings.on_headers_complete = on_headers_complete;
+	m_settings.on_message_complete = on_message_complete;
+}
+
+void sinsp_http_session_manager::on_read(sinsp_evt* evt, int64_t pid, int64_t fd, char* data, uint32_t original_len, uint32_t len)
+{
+	on_data(evt, pid, fd, DIR_READ, data, original_len, len);
+}
+
+void sinsp_http_session_manager::on_write(sinsp_evt* evt, int64_t pid, int64_t fd, char* data, uint32_t original_len, uint32_t len)
+{
+	on_data(evt, pid, fd, DIR_WRITE, data, original_len, len);
+}
+
+void sinsp_http_session_manager::on_erase_fd(int64_t pid, int64_t fd)
+{
+	auto it = m_sessions.find(session_key(pid, fd));
+	if(it == m_sessions.end())
+	{
+		return;
+	}
+
+	//
+	// A response without length nor chunked encoding ends with the
+	// connection
+	//
+	session* s = &it->second;
+	stream* resp = &s->m_streams[1 - s->m_req_dir];
+	if(resp->m_in_msg && !s->m_dead)
+	{
+		m_cur_evt = NULL;
+		m_cur_ts = s->m_last_ts;
+		end_message(s, (direction)(1 - s->m_req_dir));
+	}
+
+	m_n_dropped_requests += s->m_pending_count;
+	m_sessions.erase(it);
+}
+
+void sinsp_http_session_manager::on_data(sinsp_evt* evt, int64_t pid, int64_t fd, direction dir,
+	char* data, uint32_t original_len, uint32_t len)
+{
+	uint64_t ts = evt->get_ts();
+	if(ts >= m_next_cleanup_ts)
+	{
+		remove_inactive_sessions(ts);
+	}
+
+	if(len > original_len)
+	{
+		len = original_len;
+	}
+
+	uint64_t key = session_key(pid, fd);
+	auto it = m_sessions.find(key);
+	session* s;
+
+	if(it == m_sessions.end())
+	{
+		//
+		// Start tracking the connection only when a request goes through
+		// it, so that non HTTP connections cost a lookup and a glance at
+		// the payload
+		//
+		if(!is_message_start(data, len, true))
+		{
+			return;
+		}
+
+		if(m_sessions.size() >= m_max_sessions)
+		{
+			m_n_dropped_sessions++;
+			return;
+		}
+
+		s = &m_sessions[key];
+		for(uint32_t j = 0; j < 2; j++)
+		{
+			s->m_streams[j].m_body_left = 0;
+			s->m_streams[j].m_msg_bytes = 0;
+			s->m_streams[j].m_slot = -1;
+			s->m_streams[j].m_synced = false;
+			s->m_streams[j].m_in_msg = false;
+			s->m_streams[j].m_msg_done = false;
+		}
+		s->m_req_dir = dir;
+		s->m_pending_head = 0;
+		s->m_pending_count = 0;
+		s->m_pid = pid;
+		s->m_fd = fd;
+		s->m_dead = false;
+	}
+	else
+	{
+		s = &it->second;
+		if(s->m_dead)
+		{
+			return;
+		}
+	}
+
+	s->m_last_ts = ts;
+	m_cur_session = s;
+	m_cur_dir = dir;
+	m_cur_evt = evt;
+	m_cur_ts = ts;
+
+	feed(s, dir, data, original_len, len);
+}
+
+void sinsp_http_session_manager::feed(session* s, direction dir, char* data, uint32_t original_len, uint32_t len)
+{
+	stream* st = &s->m_streams[dir];
+	bool is_req = (dir == s->m_req_dir);
+	char* p = data;
+	char* end = data + len;
+
+	while(p < end)
+	{
+		if(st->m_body_left != 0)
+		{
+			uint64_t n = end - p;
+			if(n > st->m_body_left)
+			{
+				n = st->m_body_left;
+			}
+
+			p += n;
+			st->m_body_left -= n;
+			st->m_msg_bytes += n;
+			if(st->m_body_left == 0)
+			{
+				end_message(s, dir);
+			}
+			continue;
+		}
+
+		if(!st->m_in_msg)
+		{
+			if(!st->m_synced)
+			{
+				//
+				// Messages start at the beginning of a payload, anything
+				// else is what's left of a message we lost track of
+				//
+				if(p != data || !is_message_start(p, end - p, is_req))
+				{
+					break;
+				}
+				st->m_synced = true;
+			}
+
+			http_parser_init(&st->m_parser, is_req ? HTTP_REQUEST : HTTP_RESPONSE);
+			st->m_parser.data = this;
+		}
+
+		size_t parsed = http_parser_execute(&st->m_parser, &m_settings, p, end - p);
+		p += parsed;
+		st->m_msg_bytes += parsed;
+
+		enum http_errno err = HTTP_PARSER_ERRNO(&st->m_parser);
+		if(err == HPE_PAUSED)
+		{
+			http_parser_pause(&st->m_parser, 0);
+		}
+		else if(err != HPE_OK)
+		{
+			m_n_parse_errors++;
+			lose_sync(s, dir);
+			return;
+		}
+
+		if(st->m_msg_done)
+		{
+			st->m_msg_done = false;
+			if(st->m_body_left == 0)
+			{
+				end_message(s, dir);
+			}
+		}
+
+		if(st->m_parser.upgrade)
+		{
+			//
+			// What follows an upgrade request is either another protocol
+			// or, if the server refuses the upgrade, the next request.
+			// Once the server accepts it we stop tracking the connection,
+			// but keep it around so that we don't start tracking it again
+			//
+			if(is_req)
+			{
+				st->m_synced = false;
+			}
+			else
+			{
+				s->m_dead = true;
+			}
+			return;
+		}
+	}
+
+	//
+	// Account for what didn't fit in the snaplen: if it's all body of
+	// known length we're still in sync, otherwise we lost the beginning
+	// of the next message
+	//
+	uint64_t lost = original_len - len;
+	if(lost == 0)
+	{
+		return;
+	}
+
+	if(st->m_body_left != 0)
+	{
+		uint64_t n = (lost < st->m_body_left) ? lost : st->m_body_left;
+		lost -= n;
+		st->m_body_left -= n;
+		st->m_msg_bytes += n;
+		if(st->m_body_left == 0)
+		{
+			end_message(s, dir);
+		}
+	}
+
+	if(lost != 0 && (st->m_in_msg || st->m_synced))
+	{
+		st->m_msg_bytes += lost;
+		lose_sync(s, dir);
+	}
+}
+
+void sinsp_http_session_manager::begin_message(session* s, direction dir)
+{
+	stream* st = &s->m_streams[dir];
+	st->m_in_msg = true;
+	st->m_msg_bytes = 0;
+	st->m_slot = -1;
+
+	if(dir == s->m_req_dir)
+	{
+		if(s->m_pending_count == HTTP_SESSION_MAX_PENDING)
+		{
+			m_n_dropped_requests++;
+			return;
+		}
+
+		st->m_slot = (s->m_pending_head + s->m_pending_count) % HTTP_SESSION_MAX_PENDING;
+		s->m_pending_count++;
+
+		sinsp_http_request* req = &s->m_pending[st->m_slot];
+		req->m_pid = s->m_pid;
+		req->m_fd = s->m_fd;
+		req->m_is_server = (dir == DIR_READ);
+		req->m_method = 0;
+		req->m_status = 0;
+		req->m_url.clear();
+		req->m_req_ts = m_cur_ts;
+		req->m_resp_ts = 0;
+		req->m_end_ts = 0;
+		req->m_req_bytes = 0;
+		req->m_resp_bytes = 0;
+	}
+	else
+	{
+		//
+		// Responses come in the order of the requests. Without a
+		// pending request, we missed it
+		//
+		if(s->m_pending_count == 0)
+		{
+			return;
+		}
+
+		st->m_slot = s->m_pending_head;
+		sinsp_http_request* req = &s->m_pending[st->m_slot];
+		req->m_status = 0;
+		req->m_resp_ts = m_cur_ts;
+		req->m_resp_bytes = 0;
+	}
+}
+
+void sinsp_http_session_manager::end_message(session* s, direction dir)
+{
+	stream* st = &s->m_streams[dir];
+	st->m_in_msg = false;
+	if(st->m_slot == -1)
+	{
+		return;
+	}
+
+	sinsp_http_request* req = &s->m_pending[st->m_slot];
+	st->m_slot = -1;
+
+	if(dir == s->m_req_dir)
+	{
+		req->m_req_bytes = st->m_msg_bytes;
+		return;
+	}
+
+	req->m_resp_bytes = st->m_msg_bytes;
+	req->m_end_ts = m_cur_ts;
+
+	//
+	// An interim response (e.g. 100 Continue), the final one is still
+	// to come
+	//
+	if(req->m_status >= 100 && req->m_status < 200 && req->m_status != 101)
+	{
+		return;
+	}
+
+	if(m_listener != NULL)
+	{
+		m_listener->on_http_request(m_cur_evt, *req);
+	}
+
+	pop_request(s);
+}
+
+void sinsp_http_session_manager::lose_sync(session* s, direction dir)
+{
+	stream* st = &s->m_streams[dir];
+	st->m_synced = false;
+	st->m_body_left = 0;
+	st->m_msg_done = false;
+
+	if(!st->m_in_msg)
+	{
+		return;
+	}
+
+	//
+	// A request keeps waiting for its response with what we got of it.
+	// A response is still reported if we got its status, otherwise
+	// the request is given up on
+	//
+	if(dir != s->m_req_dir && st->m_slot != -1 && s->m_pending[st->m_slot].m_status == 0)
+	{
+		st->m_slot = -1;
+		st->m_in_msg = false;
+		pop_request(s);
+		m_n_dropped_requests++;
+		return;
+	}
+
+	end_message(s, dir);
+}
+
+//
+// Done with the oldest pending request. The server can answer before
+// reading the whole request, in which case we stop following it
+//
+void sinsp_http_session_manager::pop_request(session* s)
+{
+	stream* req_st = &s->m_streams[s->m_req_dir];
+	if(req_st->m_slot == (int32_t)s->m_pending_head)
+	{
+		req_st->m_slot = -1;
+	}
+
+	s->m_pending_head = (s->m_pending_head + 1) % HTTP_SESSION_MAX_PENDING;
+	s->m_pending_count--;
+}
+
+void sinsp_http_session_manager::remove_inactive_sessions(uint64_t ts)
+{
+	m_next_cleanup_ts = ts + HTTP_SESSION_TIMEOUT_NS / 2;
+
+	for(auto it = m_sessions.begin(); it != m_sessions.end();)
+	{
+		if(it->second.m_last_ts + HTTP_SESSION_TIMEOUT_NS < ts)
+		{
+			m_n_dropped_requests += it->second.m_pending_count;
+			it = m_sessions.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+//
+// A request line starts with an uppercase method followed by a space,
+// a status line with the protocol name
+//
+bool sinsp_http_session_manager::is_message_start(const char* data, uint32_t len, bool request)
+{
+	if(!request)
+	{
+		return len >= 5 && memcmp(data, "HTTP/", 5) == 0;
+	}
+
+	for(uint32_t j = 0; j < len && j <= 12; j++)
+	{
+		if(data[j] == ' ')
+		{
+			return j >= 3;
+		}
+
+		if((data[j] < 'A' || data[j] > 'Z') && data[j] != '-')
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+int sinsp_http_session_manager::on_message_begin(http_parser* parser)
+{
+	sinsp_http_session_manager* m = (sinsp_http_session_manager*)parser->data;
+	m->begin_message(m->m_cur_session, m->m_cur_dir);
+	return 0;
+}
+
+int sinsp_http_session_manager::on_url(http_parser* parser, const char* at, size_t len)
+{
+	sinsp_http_session_manager* m = (sinsp_http_session_manager*)parser->data;
+	stream* st = &m->m_cur_session->m_streams[m->m_cur_dir];
+	if(st->m_slot == -1)
+	{
+		return 0;
+	}
+
+	//
+	// The method is known by now, in case the rest of the headers get lost
+	//
+	sinsp_http_request* req = &m->m_cur_session->m_pending[st->m_slot];
+	req->m_method = parser->method;
+
+	//
+	// The URL can span several payloads
+	//
+	std::string* url = &req->m_url;
+	if(url->size() < HTTP_SESSION_MAX_URL_LEN)
+	{
+		url->append(at, std::min(len, HTTP_SESSION_MAX_URL_LEN - url->size()));
+	}
+	return 0;
+}
+
+int sinsp_http_session_manager::on_status(http_parser* parser, const char* at, size_t len)
+{
+	sinsp_http_session_manager* m = (sinsp_http_session_manager*)parser->data;
+	stream* st = &m->m_cur_session->m_streams[m->m_cur_dir];
+	if(st->m_slot == -1)
+	{
+		return 0;
+	}
+
+	//
+	// The whole status code is in by the time we get to the reason
+	// phrase, keep it in case the rest of the headers get lost
+	//
+	m->m_cur_session->m_pending[st->m_slot].m_status = parser->status_code;
+	return 0;
+}
+
+int sinsp_http_session_manager::on_headers_complete(http_parser* parser)
+{
+	sinsp_http_session_manager* m = (sinsp_http_session_manager*)parser->data;
+	session* s = m->m_cur_session;
+	stream* st = &s->m_streams[m->m_cur_dir];
+	sinsp_http_request* req = (st->m_slot != -1) ? &s->m_pending[st->m_slot] : NULL;
+	bool is_req = (m->m_cur_dir == s->m_req_dir);
+
+	if(req != NULL)
+	{
+		if(is_req)
+		{
+			req->m_method = parser->method;
+		}
+		else
+		{
+			req->m_status = parser->status_code;
+		}
+	}
+
+	if(!is_req && req != NULL)
+	{
+		//
+		// The response to a HEAD has no body whatever its headers say
+		//
+		if(req->m_method == HTTP_HEAD)
+		{
+			return 1;
+		}
+
+		//
+		// After a successful CONNECT the connection is a tunnel
+		//
+		if(req->m_method == HTTP_CONNECT && parser->status_code >= 200 && parser->status_code < 300)
+		{
+			return 2;
+		}
+	}
+
+	//
+	// Tell the parser there's no body and skip it ourselves, so that
+	// we don't parse it and we can skip the parts cut by the snaplen.
+	// The parser doesn't need to see a CONNECT body to notice the
+	// protocol change
+	//
+	if((parser->flags & F_CHUNKED) == 0 &&
+		parser->content_length != 0 &&
+		parser->content_length != (uint64_t)-1 &&
+		!parser->upgrade)
+	{
+		st->m_body_left = parser->content_length;
+		return 1;
+	}
+
+	return 0;
+}
+
+int sinsp_http_session_manager::on_message_complete(http_parser* parser)
+{
+	sinsp_http_session_manager* m = (sinsp_http_session_manager*)parser->data;
+	m->m_cur_session->m_streams[m->m_cur_dir].m_msg_done = true;
+
+	//
+	// Stop after every message, to account for its size and to start
+	// the next one with a fresh parser
+	//
+	http_parser_pause(parser, 1);
+	return 0;
+}
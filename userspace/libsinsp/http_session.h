@@ -0,0 +1,223 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include "http_parser.h"
+
+#include <string>
+#include <unordered_map>
+
+//
+// Max number of bytes of the URL kept for each request
+//
+#define HTTP_SESSION_MAX_URL_LEN 512
+
+//
+// Max number of requests of a connection waiting for their response.
+// Past it, new requests are not tracked
+//
+#define HTTP_SESSION_MAX_PENDING 8
+
+//
+// Default max number of tracked connections
+//
+#define HTTP_SESSION_DEFAULT_MAX_SESSIONS 4096
+
+//
+// Connections without any traffic for this long are forgotten
+//
+#define HTTP_SESSION_TIMEOUT_NS (30 * ONE_SECOND_IN_NS)
+
+/*!
+  \brief An HTTP request and its response, as reconstructed from the
+  payloads of the connection they went through.
+*/
+class sinsp_http_request
+{
+public:
+	int64_t m_pid; ///< The process owning the connection.
+	int64_t m_fd; ///< The fd of the connection.
+	bool m_is_server; ///< True if the process received the request, false if it sent it.
+	uint8_t m_method; ///< The request method, an enum http_method.
+	uint16_t m_status; ///< The response status code, 0 if the status line was lost.
+	std::string m_url; ///< The request URL, truncated to HTTP_SESSION_MAX_URL_LEN bytes.
+	uint64_t m_req_ts; ///< When the first byte of the request went through.
+	uint64_t m_resp_ts; ///< When the first byte of the response went through.
+	uint64_t m_end_ts; ///< When the last byte of the response went through.
+	uint64_t m_req_bytes; ///< Size of the request, headers included.
+	uint64_t m_resp_bytes; ///< Size of the response, headers included.
+
+	/*!
+	  \brief Time between the start of the request and the start of
+	  the response.
+	*/
+	uint64_t latency_ns() const
+	{
+		return m_resp_ts - m_req_ts;
+	}
+
+	const char* method_str() const
+	{
+		return http_method_str((enum http_method)m_method);
+	}
+};
+
+/*!
+  \brief Receives the requests reconstructed by sinsp_http_session_manager.
+*/
+class sinsp_http_listener
+{
+public:
+	virtual ~sinsp_http_listener()
+	{
+	}
+
+	//
+	// Called when the response to req is complete. evt is the event
+	// that completed it, or NULL if the connection was closed or
+	// forgotten. req is only valid for the duration of the call
+	//
+	virtual void on_http_request(sinsp_evt* evt, const sinsp_http_request& req) = 0;
+};
+
+//
+// Pairs the HTTP requests and responses going through the TCP
+// connections of the processes, by running http_parser incrementally
+// over the payloads of their reads and writes.
+//
+// The payloads are parsed in place, without copying them. Bodies of
+// known length are skipped without being parsed at all, which also
+// keeps the parser in sync when the payloads get truncated by the
+// snaplen. When the sync is lost anyway (truncated headers, lost
+// events, non HTTP traffic), the connection waits for the next payload
+// that starts with a request or status line.
+//
+// A connection is only tracked once a request is seen on it, and its
+// state is bounded: at most HTTP_SESSION_MAX_PENDING pipelined requests
+// with URLs of at most HTTP_SESSION_MAX_URL_LEN bytes, and at most
+// max_sessions connections overall.
+//
+class sinsp_http_session_manager
+{
+public:
+	sinsp_http_session_manager(sinsp_http_listener* listener,
+		uint32_t max_sessions = HTTP_SESSION_DEFAULT_MAX_SESSIONS);
+
+	void on_read(sinsp_evt* evt, int64_t pid, int64_t fd, char* data, uint32_t original_len, uint32_t len);
+	void on_write(sinsp_evt* evt, int64_t pid, int64_t fd, char* data, uint32_t original_len, uint32_t len);
+	void on_erase_fd(int64_t pid, int64_t fd);
+
+	uint32_t get_n_sessions() const
+	{
+		return (uint32_t)m_sessions.size();
+	}
+
+	//
+	// Connections that were not tracked because max_sessions was reached
+	//
+	uint64_t get_n_dropped_sessions() const
+	{
+		return m_n_dropped_sessions;
+	}
+
+	//
+	// Requests that were seen but never reported, because there were
+	// too many pending ones or because their response was lost
+	//
+	uint64_t get_n_dropped_requests() const
+	{
+		return m_n_dropped_requests;
+	}
+
+	uint64_t get_n_parse_errors() const
+	{
+		return m_n_parse_errors;
+	}
+
+private:
+	enum direction
+	{
+		DIR_READ = 0,
+		DIR_WRITE = 1,
+	};
+
+	//
+	// The parsing state of one direction of a connection
+	//
+	struct stream
+	{
+		http_parser m_parser;
+		uint64_t m_body_left; // body bytes still to skip
+		uint64_t m_msg_bytes; // bytes of the current message so far
+		int32_t m_slot; // pending request of the current message, -1 if untracked
+		bool m_synced; // false until a message start is found
+		bool m_in_msg;
+		bool m_msg_done; // the parser reached the end of the headers or of the message
+	};
+
+	struct session
+	{
+		stream m_streams[2];
+		direction m_req_dir;
+		sinsp_http_request m_pending[HTTP_SESSION_MAX_PENDING];
+		uint32_t m_pending_head;
+		uint32_t m_pending_count;
+		int64_t m_pid;
+		int64_t m_fd;
+		uint64_t m_last_ts;
+		bool m_dead; // the connection switched protocol
+	};
+
+	void on_data(sinsp_evt* evt, int64_t pid, int64_t fd, direction dir,
+		char* data, uint32_t original_len, uint32_t len);
+	void feed(session* s, direction dir, char* data, uint32_t original_len, uint32_t len);
+	void begin_message(session* s, direction dir);
+	void end_message(session* s, direction dir);
+	void lose_sync(session* s, direction dir);
+	void pop_request(session* s);
+	void remove_inactive_sessions(uint64_t ts);
+
+	static bool is_message_start(const char* data, uint32_t len, bool request);
+	static int on_message_begin(http_parser* parser);
+	static int on_url(http_parser* parser, const char* at, size_t len);
+	static int on_status(http_parser* parser, const char* at, size_t len);
+	static int on_headers_complete(http_parser* parser);
+	static int on_message_complete(http_parser* parser);
+
+	static inline uint64_t session_key(int64_t pid, int64_t fd)
+	{
+		return ((uint64_t)pid << 32) ^ (uint64_t)fd;
+	}
+
+	sinsp_http_listener* m_listener;
+	uint32_t m_max_sessions;
+	http_parser_settings m_settings;
+	std::unordered_map<uint64_t, session> m_sessions;
+	uint64_t m_next_cleanup_ts;
+	uint64_t m_n_dropped_sessions;
+	uint64_t m_n_dropped_requests;
+	uint64_t m_n_parse_errors;
+
+	//
+	// What the http_parser callbacks are working on
+	//
+	session* m_cur_session;
+	direction m_cur_dir;
+	sinsp_evt* m_cur_evt;
+	uint64_t m_cur_ts;
+};
@@ -24,11 +24,21 @@ limitations under the License.
 
 #include "json_query.h"
 #include "sinsp.h"
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+uint64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
 
 json_query::json_query(const std::string& json, const std::string& filter, bool dbg) :
-	m_jq(jq_init()), m_input{0}, m_result{0}, m_processed(false)
+	m_result{0}, m_processed(false)
 {
-	if(!m_jq) { cleanup(); }
 	process(json, filter, dbg);
 }
 
@@ -37,39 +47,97 @@ json_query::~json_query()
 	cleanup();
 }
 
-bool json_query::process(const std::string& json, const std::string& filter, bool dbg)
+jv json_query::parse(const std::string& json)
 {
-	cleanup(m_input);
-	cleanup(m_result);
-	clear();
+	return jv_parse/*_sized*/(json.c_str()/*, json.length()*/);
+}
 
-	if(!m_jq) { cleanup(); }
-	if(!jq_compile(m_jq, filter.c_str()))
+bool json_query::process(const std::string& json, const std::string& filter, bool dbg)
+{
+	jv input = parse(json);
+	if (!jv_is_valid(input))
 	{
-		m_error = "Filter parsing failed.";
+		cleanup(m_result);
+		clear();
+		cleanup(input, "JSON parse error.");
 		return false;
 	}
 
-	m_input = jv_parse/*_sized*/(json.c_str()/*, json.length()*/);
-	if (!jv_is_valid(m_input))
+	bool ret = process(input, filter, dbg);
+	jv_free(input);
+	if(ret)
+	{
+		m_json = json;
+	}
+	return ret;
+}
+
+bool json_query::process(jv input, const std::string& filter, bool dbg)
+{
+	cleanup(m_result);
+	clear();
+
+	program* prog = get_program(filter);
+	if(!prog->m_valid)
 	{
-		cleanup(m_input, "JSON parse error.");
+		m_error = "Filter parsing failed.";
 		return false;
 	}
 
-	jq_start(m_jq, m_input, dbg ? JQ_DEBUG_TRACE : 0);
-	m_input = jv_null(); // jq_start() freed it
-	m_result = jq_next(m_jq);
+	auto start = std::chrono::steady_clock::now();
+	jq_start(prog->m_jq, jv_copy(input), dbg ? JQ_DEBUG_TRACE : 0);
+	m_result = jq_next(prog->m_jq);
+	prog->m_stats.m_run_time += elapsed_ns(start);
+	++prog->m_stats.m_runs;
 	if (!jv_is_valid(m_result))
 	{
+		++prog->m_stats.m_failures;
 		cleanup(m_result, "json_query filtering result invalid.");
 		return false;
 	}
-	m_json = json;
 	m_filter = filter;
 	return m_processed = true;
 }
 
+json_query::program* json_query::get_program(const std::string& filter)
+{
+	program_map_t::iterator it = m_programs.find(filter);
+	if(it != m_programs.end())
+	{
+		return &it->second;
+	}
+
+	if(m_programs.size() >= MAX_PROGRAMS)
+	{
+		for(auto& p : m_programs)
+		{
+			jq_teardown(&p.second.m_jq);
+		}
+		m_programs.clear();
+	}
+
+	program prog;
+	prog.m_jq = jq_init();
+	if(!prog.m_jq)
+	{
+		throw std::runtime_error("json_query handle is null.");
+	}
+	auto start = std::chrono::steady_clock::now();
+	prog.m_valid = jq_compile(prog.m_jq, filter.c_str());
+	prog.m_stats.m_compile_time = elapsed_ns(start);
+	return &m_programs.emplace(filter, prog).first->second;
+}
+
+std::unordered_map<std::string, json_query::filter_stats> json_query::get_stats() const
+{
+	std::unordered_map<std::string, filter_stats> stats;
+	for(const auto& p : m_programs)
+	{
+		stats.emplace(p.first, p.second.m_stats);
+	}
+	return stats;
+}
+
 const std::string& json_query::result(int flags)
 {
 	if(m_processed)
@@ -95,10 +163,87 @@ const std::string& json_query::result(int flags)
 	return m_filtered_json;
 }
 
+bool json_query::result(Json::Value& root)
+{
+	if(!m_processed || !m_error.empty())
+	{
+		return false;
+	}
+	to_json(m_result, root);
+	m_result = jv_null();
+	clear();
+	return true;
+}
+
+void json_query::to_json(jv j, Json::Value& root)
+{
+	switch(jv_get_kind(j))
+	{
+		case JV_KIND_FALSE:
+			root = false;
+			break;
+		case JV_KIND_TRUE:
+			root = true;
+			break;
+		case JV_KIND_NUMBER:
+		{
+			// jq numbers are doubles; integral ones are printed, and
+			// then read back by Json::Reader, as integers
+			double d = jv_number_value(j);
+			if(std::fabs(d) >= 1e17 || std::floor(d) != d)
+			{
+				root = d;
+			}
+			else if(d <= Json::Value::maxInt)
+			{
+				root = Json::Value(static_cast<Json::Int64>(d));
+			}
+			else
+			{
+				root = Json::Value(static_cast<Json::UInt64>(d));
+			}
+			break;
+		}
+		case JV_KIND_STRING:
+		{
+			const char* str = jv_string_value(j);
+			root = Json::Value(str, str + jv_string_length_bytes(jv_copy(j)));
+			break;
+		}
+		case JV_KIND_ARRAY:
+		{
+			int len = jv_array_length(jv_copy(j));
+			root = Json::Value(Json::arrayValue);
+			root.resize(len);
+			for(int i = 0; i < len; ++i)
+			{
+				to_json(jv_array_get(jv_copy(j), i), root[i]);
+			}
+			break;
+		}
+		case JV_KIND_OBJECT:
+		{
+			root = Json::Value(Json::objectValue);
+			for(int it = jv_object_iter(j); jv_object_iter_valid(j, it); it = jv_object_iter_next(j, it))
+			{
+				jv key = jv_object_iter_key(j, it);
+				const char* str = jv_string_value(key);
+				Json::Value& member = root[std::string(str, jv_string_length_bytes(jv_copy(key)))];
+				jv_free(key);
+				to_json(jv_object_iter_value(j, it), member);
+			}
+			break;
+		}
+		default:
+			root = Json::Value();
+			break;
+	}
+	jv_free(j);
+}
+
 void json_query::clear()
 {
 	m_result = jv_null();
-	m_input = jv_null();
 	m_filtered_json.clear();
 	m_error.clear();
 	m_processed = false;
@@ -106,18 +251,13 @@ void json_query::clear()
 
 void json_query::cleanup()
 {
-	if(m_jq)
-	{
-		cleanup(m_input);
-		cleanup(m_result);
-		clear();
-		jq_teardown(&m_jq);
-		m_jq = 0;
-	}
-	else
+	cleanup(m_result);
+	clear();
+	for(auto& p : m_programs)
 	{
-		throw std::runtime_error("json_query handle is null.");
+		jq_teardown(&p.second.m_jq);
 	}
+	m_programs.clear();
 }
 
 void json_query::cleanup(jv& j, const std::string& msg)
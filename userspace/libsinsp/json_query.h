@@ -44,11 +44,23 @@ extern "C"
 	#include "jq.h"
 }
 
+#include "json/json.h"
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 
 class json_query
 {
 public:
+	// per-filter counters, times in nanoseconds
+	struct filter_stats
+	{
+		uint64_t m_runs = 0;
+		uint64_t m_failures = 0;
+		uint64_t m_compile_time = 0;
+		uint64_t m_run_time = 0;
+	};
+
 	json_query(const std::string& json = "", const std::string& filter = "", bool dbg = false);
 	~json_query();
 
@@ -59,20 +71,51 @@ public:
 	const std::string& get_filter() const;
 
 	bool process(const std::string& json, const std::string& filter, bool dbg = false);
+
+	// runs the filter on an already parsed JSON (see parse()), which is
+	// not consumed, so that a document can go through several filters
+	// while being parsed only once
+	bool process(jv input, const std::string& filter, bool dbg = false);
+
 	const std::string& result(int flags = 0);
 
+	// converts the result straight to a JSON value, without going
+	// through its text
+	bool result(Json::Value& root);
+
 	const std::string& get_error() const;
 
+	// an invalid jv on error; the caller owns the returned value
+	static jv parse(const std::string& json);
+
+	// the stats of the filters run so far
+	std::unordered_map<std::string, filter_stats> get_stats() const;
+
 private:
+	// a compiled filter; jq keeps a single program per jq_state, so
+	// each filter gets its own
+	struct program
+	{
+		jq_state*    m_jq = nullptr;
+		bool         m_valid = false;
+		filter_stats m_stats;
+	};
+	typedef std::unordered_map<std::string, program> program_map_t;
+
+	// more than a handful of filters are unexpected; past this, the
+	// cache is dropped rather than grown
+	static const size_t MAX_PROGRAMS = 32;
+
+	program* get_program(const std::string& filter);
 	void clear();
 	void cleanup();
 	void cleanup(jv& j, const std::string& msg = "");
+	static void to_json(jv j, Json::Value& root);
 
-	jq_state*           m_jq;
+	program_map_t       m_programs;
 	std::string         m_json;
 	std::string         m_filter;
 	std::string         m_filtered_json;
-	jv                  m_input;
 	jv                  m_result;
 	bool                m_processed;
 	mutable std::string m_error;
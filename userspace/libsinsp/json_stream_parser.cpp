@@ -0,0 +1,407 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "json_stream_parser.h"
+
+#include <cstring>
+
+using namespace libsinsp;
+
+namespace {
+
+bool is_scalar_char(char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+	       c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+void append_utf8(std::string& out, uint32_t cp)
+{
+	if(cp < 0x80)
+	{
+		out.push_back((char)cp);
+	}
+	else if(cp < 0x800)
+	{
+		out.push_back((char)(0xC0 | (cp >> 6)));
+		out.push_back((char)(0x80 | (cp & 0x3F)));
+	}
+	else if(cp < 0x10000)
+	{
+		out.push_back((char)(0xE0 | (cp >> 12)));
+		out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+		out.push_back((char)(0x80 | (cp & 0x3F)));
+	}
+	else
+	{
+		out.push_back((char)(0xF0 | (cp >> 18)));
+		out.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+		out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+		out.push_back((char)(0x80 | (cp & 0x3F)));
+	}
+}
+
+}
+
+json_stream_parser::json_stream_parser(const char* data, size_t len):
+	m_pos(data),
+	m_end(data + len),
+	m_error(false),
+	m_first(false)
+{
+}
+
+json_stream_parser::json_stream_parser(const char* json):
+	json_stream_parser(json, strlen(json))
+{
+}
+
+json_stream_parser::json_stream_parser(const std::string& json):
+	json_stream_parser(json.data(), json.size())
+{
+}
+
+bool json_stream_parser::fail()
+{
+	m_error = true;
+	m_pos = m_end;
+	return false;
+}
+
+bool json_stream_parser::skip_ws()
+{
+	while(m_pos < m_end &&
+	      (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+	{
+		++m_pos;
+	}
+	return m_pos < m_end;
+}
+
+bool json_stream_parser::at_end()
+{
+	return !m_error && !skip_ws();
+}
+
+bool json_stream_parser::enter_object()
+{
+	if(m_error || !skip_ws())
+	{
+		return fail();
+	}
+	if(*m_pos != '{')
+	{
+		skip();
+		return false;
+	}
+	++m_pos;
+	m_first = true;
+	return true;
+}
+
+bool json_stream_parser::next_member()
+{
+	if(m_error || !skip_ws())
+	{
+		return fail();
+	}
+	if(*m_pos == '}')
+	{
+		++m_pos;
+		m_first = false;
+		return false;
+	}
+	if(!m_first)
+	{
+		if(*m_pos != ',')
+		{
+			return fail();
+		}
+		++m_pos;
+		if(!skip_ws())
+		{
+			return fail();
+		}
+	}
+	m_first = false;
+	if(*m_pos != '"' || !parse_string(m_key) || !skip_ws() || *m_pos != ':')
+	{
+		return fail();
+	}
+	++m_pos;
+	return true;
+}
+
+bool json_stream_parser::enter_array()
+{
+	if(m_error || !skip_ws())
+	{
+		return fail();
+	}
+	if(*m_pos != '[')
+	{
+		skip();
+		return false;
+	}
+	++m_pos;
+	m_first = true;
+	return true;
+}
+
+bool json_stream_parser::next_element()
+{
+	if(m_error || !skip_ws())
+	{
+		return fail();
+	}
+	if(*m_pos == ']')
+	{
+		++m_pos;
+		m_first = false;
+		return false;
+	}
+	if(!m_first)
+	{
+		if(*m_pos != ',')
+		{
+			return fail();
+		}
+		++m_pos;
+	}
+	m_first = false;
+	return true;
+}
+
+bool json_stream_parser::read_string(std::string& out)
+{
+	if(m_error || !skip_ws())
+	{
+		return fail();
+	}
+	if(*m_pos != '"')
+	{
+		skip();
+		return false;
+	}
+	return parse_string(out);
+}
+
+bool json_stream_parser::read_int64(int64_t& out)
+{
+	if(m_error || !skip_ws())
+	{
+		return fail();
+	}
+
+	const char* start = m_pos;
+	const char* p = m_pos;
+	bool negative = false;
+	if(*p == '-')
+	{
+		negative = true;
+		++p;
+	}
+
+	uint64_t val = 0;
+	bool overflow = false;
+	const char* digits = p;
+	for(; p < m_end && *p >= '0' && *p <= '9'; ++p)
+	{
+		uint64_t digit = *p - '0';
+		if(val > (UINT64_MAX - digit) / 10)
+		{
+			overflow = true;
+		}
+		val = val * 10 + digit;
+	}
+
+	if(p == digits || (p < m_end && is_scalar_char(*p)))
+	{
+		// not a number or not an integer (fraction, exponent)
+		m_pos = start;
+		skip();
+		return false;
+	}
+	m_pos = p;
+
+	if(overflow || val > (negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX))
+	{
+		return false;
+	}
+	out = negative ? (int64_t)(0 - val) : (int64_t)val;
+	return true;
+}
+
+bool json_stream_parser::skip()
+{
+	if(m_error || !skip_ws())
+	{
+		return fail();
+	}
+
+	char c = *m_pos;
+	if(c == '"')
+	{
+		return skip_string();
+	}
+	if(c != '{' && c != '[')
+	{
+		return skip_scalar();
+	}
+
+	size_t depth = 0;
+	while(m_pos < m_end)
+	{
+		c = *m_pos;
+		if(c == '"')
+		{
+			if(!skip_string())
+			{
+				return false;
+			}
+			continue;
+		}
+		++m_pos;
+		if(c == '{' || c == '[')
+		{
+			++depth;
+		}
+		else if(c == '}' || c == ']')
+		{
+			if(--depth == 0)
+			{
+				return true;
+			}
+		}
+	}
+	return fail();
+}
+
+bool json_stream_parser::skip_scalar()
+{
+	const char* start = m_pos;
+	while(m_pos < m_end && is_scalar_char(*m_pos))
+	{
+		++m_pos;
+	}
+	return m_pos != start || fail();
+}
+
+bool json_stream_parser::skip_string()
+{
+	// m_pos is at the opening quote
+	for(++m_pos; m_pos < m_end; ++m_pos)
+	{
+		if(*m_pos == '"')
+		{
+			++m_pos;
+			return true;
+		}
+		if(*m_pos == '\\')
+		{
+			++m_pos;
+		}
+	}
+	return fail();
+}
+
+bool json_stream_parser::parse_hex4(uint32_t& cp)
+{
+	if(m_end - m_pos < 4)
+	{
+		return false;
+	}
+	cp = 0;
+	for(int i = 0; i < 4; i++)
+	{
+		char c = *m_pos++;
+		cp <<= 4;
+		if(c >= '0' && c <= '9') { cp |= c - '0'; }
+		else if(c >= 'a' && c <= 'f') { cp |= c - 'a' + 10; }
+		else if(c >= 'A' && c <= 'F') { cp |= c - 'A' + 10; }
+		else { return false; }
+	}
+	return true;
+}
+
+bool json_stream_parser::parse_string(std::string& out)
+{
+	// m_pos is at the opening quote
+	out.clear();
+	const char* run = ++m_pos;
+	while(m_pos < m_end)
+	{
+		char c = *m_pos;
+		if(c != '"' && c != '\\')
+		{
+			++m_pos;
+			continue;
+		}
+
+		out.append(run, m_pos - run);
+		if(c == '"')
+		{
+			++m_pos;
+			return true;
+		}
+
+		if(++m_pos == m_end)
+		{
+			break;
+		}
+		switch(*m_pos++)
+		{
+		case '"': out.push_back('"'); break;
+		case '\\': out.push_back('\\'); break;
+		case '/': out.push_back('/'); break;
+		case 'b': out.push_back('\b'); break;
+		case 'f': out.push_back('\f'); break;
+		case 'n': out.push_back('\n'); break;
+		case 'r': out.push_back('\r'); break;
+		case 't': out.push_back('\t'); break;
+		case 'u':
+		{
+			uint32_t cp;
+			if(!parse_hex4(cp))
+			{
+				return fail();
+			}
+			if(cp >= 0xD800 && cp <= 0xDBFF)
+			{
+				// high surrogate, must be followed by a low one
+				uint32_t low;
+				if(m_end - m_pos < 2 || m_pos[0] != '\\' || m_pos[1] != 'u')
+				{
+					return fail();
+				}
+				m_pos += 2;
+				if(!parse_hex4(low) || low < 0xDC00 || low > 0xDFFF)
+				{
+					return fail();
+				}
+				cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+			}
+			append_utf8(out, cp);
+			break;
+		}
+		default:
+			return fail();
+		}
+		run = m_pos;
+	}
+	return fail();
+}
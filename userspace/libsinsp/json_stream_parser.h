@@ -0,0 +1,149 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace libsinsp {
+
+/**
+ * \brief A pull parser walking a JSON document without building a DOM
+ *
+ * Meant for extracting a handful of fields from large documents: the
+ * caller descends into the objects and arrays it's interested in and
+ * skip()s everything else, which costs a scan of the skipped bytes
+ * and no allocation. Typical use:
+ *
+ *   json_stream_parser p(json);
+ *   if(p.enter_object())
+ *   {
+ *     while(p.next_member())
+ *     {
+ *       if(p.key() == "name") { p.read_string(name); }
+ *       else { p.skip(); }
+ *     }
+ *   }
+ *   if(!p.at_end()) { ... malformed ... }
+ *
+ * A container must be iterated until next_member() / next_element()
+ * returns false, as that consumes its closing bracket.
+ *
+ * The value readers (enter_object(), enter_array(), read_string(),
+ * read_int64()) return false and skip the value when it has a
+ * different type (including null), so optional fields need no special
+ * casing. Syntax errors stick: once one is found, every call returns
+ * false and ok() tells the two cases apart. Skipped values are only
+ * checked for balanced brackets and quotes.
+ *
+ * The input must outlive the parser.
+ */
+class json_stream_parser
+{
+public:
+	json_stream_parser(const char* data, size_t len);
+	explicit json_stream_parser(const char* json);
+	explicit json_stream_parser(const std::string& json);
+	// the parser does not copy its input
+	explicit json_stream_parser(std::string&& json) = delete;
+
+	/**
+	 * \brief false if a syntax error was found
+	 */
+	bool ok() const
+	{
+		return !m_error;
+	}
+
+	/**
+	 * \brief true if the document was parsed without errors and
+	 * only whitespace is left
+	 */
+	bool at_end();
+
+	/**
+	 * \brief Enter the object starting at the current position
+	 * @return false if the value is not an object (it's skipped)
+	 */
+	bool enter_object();
+
+	/**
+	 * \brief Move to the next member of the current object
+	 * @return true with key() set and the parser positioned at the
+	 * member value, false at the end of the object
+	 */
+	bool next_member();
+
+	/**
+	 * \brief The key of the member returned by next_member()
+	 */
+	const std::string& key() const
+	{
+		return m_key;
+	}
+
+	/**
+	 * \brief Enter the array starting at the current position
+	 * @return false if the value is not an array (it's skipped)
+	 */
+	bool enter_array();
+
+	/**
+	 * \brief Move to the next element of the current array
+	 * @return false at the end of the array
+	 */
+	bool next_element();
+
+	/**
+	 * \brief Read a string value, unescaping it into out
+	 * @return false if the value is not a string (it's skipped)
+	 */
+	bool read_string(std::string& out);
+
+	/**
+	 * \brief Read an integer value
+	 * @return false if the value is not an integer in the int64_t
+	 * range (it's skipped)
+	 */
+	bool read_int64(int64_t& out);
+
+	/**
+	 * \brief Skip the value at the current position
+	 */
+	bool skip();
+
+private:
+	bool fail();
+	bool skip_ws();
+	bool skip_string();
+	bool skip_scalar();
+	bool parse_string(std::string& out);
+	bool parse_hex4(uint32_t& cp);
+
+	const char* m_pos;
+	const char* m_end;
+	bool m_error;
+	// whether the current container has no elements yet; a single flag
+	// is enough because leaving a nested container always gets us back
+	// to a container which already has one
+	bool m_first;
+	std::string m_key;
+};
+
+}
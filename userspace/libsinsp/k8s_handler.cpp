@@ -99,6 +99,7 @@ k8s_handler::k8s_handler(const std::string& id,
 											 m_timeout_ms, m_ssl, m_bt, !m_blocking_socket, m_blocking_socket,
 											 SOCKET_HANDLER_DATA_LIMIT, true, data_max_b, data_chunk_wait_us);
 		m_handler->set_json_callback(&k8s_handler::set_event_json);
+		m_handler->set_raw_json_callback(&k8s_handler::set_event_raw_json);
 
 		// filter order is important; there are four kinds of filters:
 		// 1.a state filter (filters init state JSONs)
@@ -139,6 +140,7 @@ void k8s_handler::make_http()
 			m_handler = std::make_shared<handler_t>(*this, m_id, m_url, m_path, m_http_version,
 												 m_timeout_ms, m_ssl, m_bt, true, m_blocking_socket);
 			m_handler->set_json_callback(&k8s_handler::set_event_json);
+			m_handler->set_raw_json_callback(&k8s_handler::set_event_raw_json);
 		}
 		else if(m_collector->has(m_handler))
 		{
@@ -456,7 +458,7 @@ void k8s_handler::collect_data()
 #endif // HAS_CAPTURE
 }
 
-k8s_handler::msg_data k8s_handler::get_msg_data(const std::string& type, const std::string& kind, const Json::Value& json)
+k8s_handler::msg_data k8s_handler::get_msg_data(const std::string& type, const std::string& kind)
 {
 	msg_data data;
 	if(!type.empty())
@@ -466,14 +468,19 @@ k8s_handler::msg_data k8s_handler::get_msg_data(const std::string& type, const s
 		else if(type[0] == 'D') { data.m_reason = k8s_component::COMPONENT_DELETED; }
 		else if(type[0] == 'N') { data.m_reason = k8s_component::COMPONENT_NONEXISTENT; }
 		else if(type[0] == 'E') { data.m_reason = k8s_component::COMPONENT_ERROR; }
+		data.m_kind = kind;
 	}
-	else
+	return data;
+}
+
+k8s_handler::msg_data k8s_handler::get_msg_data(const std::string& type, const std::string& kind, const Json::Value& json)
+{
+	msg_data data = get_msg_data(type, kind);
+	if(type.empty())
 	{
 		return data;
 	}
 
-	data.m_kind = kind;
-
 	Json::Value name = json["name"];
 	if(!name.isNull())
 	{
@@ -493,6 +500,94 @@ k8s_handler::msg_data k8s_handler::get_msg_data(const std::string& type, const s
 	return data;
 }
 
+bool k8s_handler::check_msg(const msg_data& data)
+{
+	std::string reason_type = data.get_reason_desc();
+	if(data.m_reason == k8s_component::COMPONENT_ADDED)
+	{
+		if(m_state->has(data.m_uid))
+		{
+			std::ostringstream os;
+			os << "K8s " + reason_type << " message received by " << m_id <<
+#if defined(HAS_CAPTURE) && !defined(_WIN32)
+				  " [" << uri(m_url).to_string(false) << "]"
+#endif // HAS_CAPTURE
+				  "for existing " << data.m_kind << " [" << data.m_uid << "], updating only.";
+			g_logger.log(os.str(), sinsp_logger::SEV_DEBUG);
+		}
+	}
+	else if(data.m_reason == k8s_component::COMPONENT_MODIFIED)
+	{
+		if(!m_state->has(data.m_uid))
+		{
+			std::ostringstream os;
+			os << "K8s " << reason_type << " message received by " << m_id  <<
+#if defined(HAS_CAPTURE) && !defined(_WIN32)
+				  " [" << uri(m_url).to_string(false) << "]"
+#endif // HAS_CAPTURE
+				  " for non-existing " << data.m_kind << " [" << data.m_uid << "], giving up.";
+			g_logger.log(os.str(), sinsp_logger::SEV_WARNING);
+			return false;
+		}
+	}
+	else if(data.m_reason == k8s_component::COMPONENT_DELETED)
+	{
+		if(!m_state->has(data.m_uid))
+		{
+			std::ostringstream os;
+			os << "K8s " + reason_type + " message received by " << m_id <<
+#if defined(HAS_CAPTURE) && !defined(_WIN32)
+				  " [" << uri(m_url).to_string(false) << "]"
+#endif // HAS_CAPTURE
+				  " for non-existing " << data.m_kind << " [" << data.m_uid << "], giving up.";
+			g_logger.log(os.str(), sinsp_logger::SEV_WARNING);
+			return false;
+		}
+	}
+	else
+	{
+		if(data.m_reason == k8s_component::COMPONENT_NONEXISTENT)
+		{
+			g_logger.log(std::string("Non-existent K8S component (" + name() + "), reason: ") +
+						 std::to_string(data.m_reason), sinsp_logger::SEV_DEBUG);
+		}
+		else
+		{
+			g_logger.log(std::string("Unsupported K8S " + name() + " event reason: ") +
+						 std::to_string(data.m_reason), sinsp_logger::SEV_ERROR);
+		}
+		return false;
+	}
+	return true;
+}
+
+void k8s_handler::msg_handled(const msg_data& data, bool success)
+{
+	std::string reason_type = data.get_reason_desc();
+	if(success)
+	{
+		std::ostringstream os;
+		os << "K8s [" + reason_type + ", " << data.m_kind <<
+			", " << data.m_name << ", " << data.m_uid << "]";
+		g_logger.log(os.str(), sinsp_logger::SEV_INFO);
+		if(data.m_reason == k8s_component::COMPONENT_ADDED ||
+		   data.m_reason == k8s_component::COMPONENT_MODIFIED)
+		{
+			m_state->update_cache(k8s_component::get_type(name()), data.m_uid);
+		}
+		else
+		{
+			m_state->update_cache(k8s_component::get_type(name()));
+		}
+	}
+	else
+	{
+		g_logger.log("K8s: error occurred while handling " + reason_type +
+					 " event for " + data.m_kind + ' ' + data.m_name + " [" +
+					 data.m_uid + ']', sinsp_logger::SEV_ERROR);
+	}
+}
+
 void k8s_handler::handle_json(Json::Value&& root)
 {
 	/*if(g_logger.get_severity() >= sinsp_logger::SEV_TRACE)
@@ -544,85 +639,20 @@ void k8s_handler::handle_json(Json::Value&& root)
 							continue;
 						}
 						*/
-						std::string reason_type = data.get_reason_desc();
-						if(data.m_reason == k8s_component::COMPONENT_ADDED)
-						{
-							if(m_state->has(data.m_uid))
-							{
-								std::ostringstream os;
-								os << "K8s " + reason_type << " message received by " << m_id <<
-#if defined(HAS_CAPTURE) && !defined(_WIN32)
-									  " [" << uri(m_url).to_string(false) << "]"
-#endif // HAS_CAPTURE
-									  "for existing " << data.m_kind << " [" << data.m_uid << "], updating only.";
-								g_logger.log(os.str(), sinsp_logger::SEV_DEBUG);
-							}
-						}
-						else if(data.m_reason == k8s_component::COMPONENT_MODIFIED)
-						{
-							if(!m_state->has(data.m_uid))
-							{
-								std::ostringstream os;
-								os << "K8s " << reason_type << " message received by " << m_id  <<
-#if defined(HAS_CAPTURE) && !defined(_WIN32)
-									  " [" << uri(m_url).to_string(false) << "]"
-#endif // HAS_CAPTURE
-									  " for non-existing " << data.m_kind << " [" << data.m_uid << "], giving up.";
-								g_logger.log(os.str(), sinsp_logger::SEV_WARNING);
-								continue;
-							}
-						}
-						else if(data.m_reason == k8s_component::COMPONENT_DELETED)
-						{
-							if(!m_state->has(data.m_uid))
-							{
-								std::ostringstream os;
-								os << "K8s " + reason_type + " message received by " << m_id <<
-#if defined(HAS_CAPTURE) && !defined(_WIN32)
-									  " [" << uri(m_url).to_string(false) << "]"
-#endif // HAS_CAPTURE
-									  " for non-existing " << data.m_kind << " [" << data.m_uid << "], giving up.";
-								g_logger.log(os.str(), sinsp_logger::SEV_WARNING);
-								continue;
-							}
-						}
-						else if(data.m_reason == k8s_component::COMPONENT_ERROR)
+						if(data.m_reason == k8s_component::COMPONENT_ERROR)
 						{
 							handle_error(data, item);
 							continue;
 						}
-						else
+						if(!check_msg(data))
 						{
-							if(data.m_reason == k8s_component::COMPONENT_NONEXISTENT)
-							{
-								g_logger.log(std::string("Non-existent K8S component (" + name() + "), reason: ") +
-											 std::to_string(data.m_reason), sinsp_logger::SEV_DEBUG);
-							}
-							else
-							{
-								g_logger.log(std::string("Unsupported K8S " + name() + " event reason: ") +
-											 std::to_string(data.m_reason), sinsp_logger::SEV_ERROR);
-							}
 							continue;
 						}
 						/*if(g_logger.get_severity() >= sinsp_logger::SEV_TRACE)
 						{
 							g_logger.log("K8s handling item:\n" + json_as_string(item), sinsp_logger::SEV_TRACE);
 						}*/
-						if(handle_component(item, &data))
-						{
-							std::ostringstream os;
-							os << "K8s [" + reason_type + ", " << data.m_kind <<
-								", " << data.m_name << ", " << data.m_uid << "]";
-							g_logger.log(os.str(), sinsp_logger::SEV_INFO);
-							m_state->update_cache(k8s_component::get_type(name()));
-						}
-						else
-						{
-							g_logger.log("K8s: error occurred while handling " + reason_type +
-										 " event for " + data.m_kind + ' ' + data.m_name + " [" +
-										 data.m_uid + ']', sinsp_logger::SEV_ERROR);
-						}
+						msg_handled(data, handle_component(item, &data));
 					} // end for items
 				}
 			}
@@ -695,20 +725,25 @@ void k8s_handler::process_events()
 		{
 			m_state_processing_started = true;
 			if(++counter >= get_max_messages()) { break; }
-			if(*evt && !(*evt)->isNull())
+			const json_ptr_t& json = evt->m_json;
+			if(evt->m_decoded)
+			{
+				handle_decoded(*evt->m_decoded);
+			}
+			else if(json && !json->isNull())
 			{
 				if(g_logger.get_severity() >= sinsp_logger::SEV_TRACE)
 				{
-					g_logger.log("k8s_handler (" + m_id + ") processing event data:\n" + json_as_string(*(*evt)),
+					g_logger.log("k8s_handler (" + m_id + ") processing event data:\n" + json_as_string(*json),
 								 sinsp_logger::SEV_TRACE);
 				}
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
 				if(m_is_captured)
 				{
-					m_state->enqueue_capture_event(**evt);
+					m_state->enqueue_capture_event(*json);
 				}
 #endif // HAS_CAPTURE
-				handle_json(std::move(**evt));
+				handle_json(std::move(*json));
 			}
 			else
 			{
@@ -716,7 +751,7 @@ void k8s_handler::process_events()
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
 							 "(" + uri(m_url).to_string(false) + ") " +
 #endif // HAS_CAPTURE
-							(!(*evt) ? "data is null." : ((*evt)->isNull() ? "JSON is null." : "Unknown")),
+							(!json ? "data is null." : (json->isNull() ? "JSON is null." : "Unknown")),
 							sinsp_logger::SEV_ERROR);
 			}
 			evt = m_events.erase(evt);
@@ -734,7 +769,7 @@ void k8s_handler::set_event_json(json_ptr_t json, const std::string&)
 				, sinsp_logger::SEV_TRACE);
 	// empty JSON is fine here; if there are no entities, state and first watch will pass nothing in here
 	// null is checked when processing
-	m_events.emplace_back(json);
+	m_events.push_back(event_t{json, nullptr});
 	g_logger.log("k8s_handler added event, (" + m_id + ") has " + std::to_string(m_events.size())
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
 				+ " events from " + uri(m_url).to_string(false)
@@ -745,6 +780,42 @@ void k8s_handler::set_event_json(json_ptr_t json, const std::string&)
 #endif // HAS_CAPTURE
 }
 
+bool k8s_handler::set_event_raw_json(const std::string& json, const std::string&)
+{
+	if(!m_state)
+	{
+		return false;
+	}
+#if defined(HAS_CAPTURE) && !defined(_WIN32)
+	// captures store the filtered JSON, so they need the jq path
+	if(m_is_captured && m_state->is_captured())
+	{
+		return false;
+	}
+#endif // HAS_CAPTURE
+
+	decoded_msg_ptr_t msg = decode_json(json);
+	if(!msg)
+	{
+		return false;
+	}
+
+	m_events.push_back(event_t{nullptr, msg});
+#if defined(HAS_CAPTURE) && !defined(_WIN32)
+	if(!m_resp_recvd) { m_resp_recvd = true; }
+#endif // HAS_CAPTURE
+	return true;
+}
+
+k8s_handler::decoded_msg_ptr_t k8s_handler::decode_json(const std::string& json)
+{
+	return nullptr;
+}
+
+void k8s_handler::handle_decoded(decoded_msg& msg)
+{
+}
+
 k8s_pair_list k8s_handler::extract_object(const Json::Value& object)
 {
 	k8s_pair_list entry_list;
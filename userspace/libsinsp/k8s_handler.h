@@ -39,6 +39,15 @@ public:
 	typedef std::vector<std::string>       uri_list_t;
 	typedef std::shared_ptr<Json::Value>   json_ptr_t;
 	typedef std::shared_ptr<k8s_api_error> api_error_ptr;
+
+	// a message decoded by the handler straight from the API server
+	// JSON (see decode_json()), bypassing the jq filters and the DOM
+	class decoded_msg
+	{
+	public:
+		virtual ~decoded_msg() = default;
+	};
+	typedef std::shared_ptr<decoded_msg>   decoded_msg_ptr_t;
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
 	typedef sinsp_ssl::ptr_t                             ssl_ptr_t;
 	typedef sinsp_bearer_token::ptr_t                    bt_ptr_t;
@@ -79,6 +88,7 @@ public:
 	bool is_alive() const;
 	bool ready() const;
 	void set_event_json(json_ptr_t json, const std::string&);
+	bool set_event_raw_json(const std::string& json, const std::string&);
 	const std::string& get_id() const;
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
 	handler_ptr_t handler();
@@ -101,7 +111,17 @@ protected:
 	typedef std::unordered_set<std::string> ip_addr_list_t;
 
 	virtual bool handle_component(const Json::Value& json, const msg_data* data = 0) = 0;
+
+	// handlers which can extract what they need from the raw JSON
+	// override these two; decode_json() returns null for messages it
+	// does not (want to) handle, which then go through the jq filters
+	virtual decoded_msg_ptr_t decode_json(const std::string& json);
+	virtual void handle_decoded(decoded_msg& msg);
+
+	msg_data get_msg_data(const std::string& evt, const std::string& type);
 	msg_data get_msg_data(const std::string& evt, const std::string& type, const Json::Value& root);
+	bool check_msg(const msg_data& data);
+	void msg_handled(const msg_data& data, bool success);
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
 	static bool is_ip_address(const std::string& addr);
 #endif // HAS_CAPTURE
@@ -134,7 +154,13 @@ protected:
 private:
 	typedef void (k8s_handler::*callback_func_t)(json_ptr_t, const std::string&);
 
-	typedef std::vector<json_ptr_t> event_list_t;
+	// exactly one of the two is set
+	struct event_t
+	{
+		json_ptr_t        m_json;
+		decoded_msg_ptr_t m_decoded;
+	};
+	typedef std::vector<event_t> event_list_t;
 
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
 	static ip_addr_list_t hostname_to_ip(const std::string& hostname);
@@ -20,8 +20,10 @@ limitations under the License.
 #ifndef CYGWING_AGENT
 
 #include "k8s_pod_handler.h"
+#include "json_stream_parser.h"
 #include "sinsp.h"
 #include "sinsp_int.h"
+#include <algorithm>
 
 // filters normalize state and event JSONs, so they can be processed generically:
 // event is turned into a single-entry array, state is turned into an array of ADDED events
@@ -193,33 +195,39 @@ k8s_container::list k8s_pod_handler::extract_pod_containers(const Json::Value& i
 }
 
 void k8s_pod_handler::extract_pod_data(const Json::Value& item, k8s_pod_t& pod)
+{
+	pod_item data;
+	extract_pod_data(item, data);
+	if(!data.m_node_name.empty())
+	{
+		pod.set_node_name(data.m_node_name);
+	}
+	if(!data.m_host_ip.empty())
+	{
+		pod.set_host_ip(data.m_host_ip);
+	}
+	if(!data.m_pod_ip.empty())
+	{
+		pod.set_internal_ip(data.m_pod_ip);
+	}
+}
+
+void k8s_pod_handler::extract_pod_data(const Json::Value& item, pod_item& pod)
 {
 	const Json::Value& node_name = item["nodeName"];
 	if(!node_name.isNull())
 	{
-		std::string nn = node_name.asString();
-		if(!nn.empty())
-		{
-			pod.set_node_name(nn);
-		}
+		pod.m_node_name = node_name.asString();
 	}
 	const Json::Value& host_ip = item["hostIP"];
 	if(!host_ip.isNull())
 	{
-		std::string hip = host_ip.asString();
-		if(!hip.empty())
-		{
-			pod.set_host_ip(hip);
-		}
+		pod.m_host_ip = host_ip.asString();
 	}
 	const Json::Value& pod_ip = item["podIP"];
 	if(!pod_ip.isNull())
 	{
-		std::string pip = pod_ip.asString();
-		if(!pip.empty())
-		{
-			pod.set_internal_ip(pip);
-		}
+		pod.m_pod_ip = pod_ip.asString();
 	}
 }
 
@@ -243,48 +251,394 @@ size_t k8s_pod_handler::extract_pod_restart_count(const Json::Value& item)
 
 bool k8s_pod_handler::handle_component(const Json::Value& json, const msg_data* data)
 {
-	if(data)
+	if(!data)
+	{
+		throw sinsp_exception("K8s node handler: data is null.");
+	}
+
+	pod_item item;
+	if(m_state && ((data->m_reason == k8s_component::COMPONENT_ADDED) ||
+				   (data->m_reason == k8s_component::COMPONENT_MODIFIED)))
+	{
+		item.m_labels = k8s_component::extract_object(json, "labels");
+		item.m_container_ids = extract_pod_container_ids(json);
+		item.m_containers = extract_pod_containers(json);
+		extract_pod_data(json, item);
+		item.m_restart_count = extract_pod_restart_count(json);
+	}
+	return handle_pod(*data, item);
+}
+
+bool k8s_pod_handler::handle_pod(const msg_data& data, pod_item& item)
+{
+	if(m_state)
+	{
+		if((data.m_reason == k8s_component::COMPONENT_ADDED) ||
+		   (data.m_reason == k8s_component::COMPONENT_MODIFIED))
+		{
+			k8s_pod_t& pod =
+				m_state->get_component<k8s_pods, k8s_pod_t>(m_state->get_pods(),
+															  data.m_name, data.m_uid, data.m_namespace);
+			if(item.m_labels.size() > 0)
+			{
+				pod.set_labels(std::move(item.m_labels));
+			}
+			if(!item.m_node_name.empty())
+			{
+				pod.set_node_name(item.m_node_name);
+			}
+			if(!item.m_host_ip.empty())
+			{
+				pod.set_host_ip(item.m_host_ip);
+			}
+			if(!item.m_pod_ip.empty())
+			{
+				pod.set_internal_ip(item.m_pod_ip);
+			}
+			pod.set_restart_count(item.m_restart_count);
+			pod.set_container_ids(std::move(item.m_container_ids));
+			pod.set_containers(std::move(item.m_containers));
+		}
+		else if(data.m_reason == k8s_component::COMPONENT_DELETED)
+		{
+			if(!m_state->delete_component(m_state->get_pods(), data.m_uid))
+			{
+				log_not_found(data);
+				return false;
+			}
+		}
+	}
+	else if(data.m_reason != k8s_component::COMPONENT_ERROR)
+	{
+		g_logger.log(std::string("Unsupported K8S " + name() + " event reason: ") +
+					 std::to_string(data.m_reason), sinsp_logger::SEV_ERROR);
+		return false;
+	}
+	return true;
+}
+
+k8s_handler::decoded_msg_ptr_t k8s_pod_handler::decode_json(const std::string& json)
+{
+	std::shared_ptr<pod_msg> msg = std::make_shared<pod_msg>();
+	if(!decode_pod_json(json, *msg))
+	{
+		return nullptr;
+	}
+	return msg;
+}
+
+void k8s_pod_handler::handle_decoded(decoded_msg& msg)
+{
+	pod_msg& pods = static_cast<pod_msg&>(msg);
+	for(pod_item& item : pods.m_items)
+	{
+		msg_data data = get_msg_data(pods.m_type, "Pod");
+		data.m_name = item.m_name;
+		data.m_uid = item.m_uid;
+		data.m_namespace = item.m_namespace;
+		if(check_msg(data))
+		{
+			msg_handled(data, handle_pod(data, item));
+		}
+	}
+}
+
+//
+// Streaming decoding of the raw pod JSON; this extracts the same data
+// as the jq filters plus the extract_* functions above (which work on
+// the filter output) without building any JSON DOM, which matters
+// with the volume of pod updates of large clusters
+//
+
+namespace {
+
+using libsinsp::json_stream_parser;
+
+void decode_labels(json_stream_parser& p, k8s_pair_list& labels)
+{
+	if(!p.enter_object())
+	{
+		return;
+	}
+	std::string value;
+	while(p.next_member())
+	{
+		if(p.read_string(value))
+		{
+			labels.emplace_back(p.key(), value);
+		}
+	}
+	// the DOM path gets them sorted by name
+	std::stable_sort(labels.begin(), labels.end(),
+		[](const k8s_pair_t& a, const k8s_pair_t& b) { return a.first < b.first; });
+}
+
+void decode_metadata(json_stream_parser& p, k8s_pod_handler::pod_item& item)
+{
+	if(!p.enter_object())
+	{
+		return;
+	}
+	while(p.next_member())
+	{
+		const std::string& key = p.key();
+		if(key == "name") { p.read_string(item.m_name); }
+		else if(key == "uid") { p.read_string(item.m_uid); }
+		else if(key == "namespace") { p.read_string(item.m_namespace); }
+		else if(key == "labels") { decode_labels(p, item.m_labels); }
+		else { p.skip(); }
+	}
+}
+
+void decode_ports(json_stream_parser& p, k8s_container::port_list& ports)
+{
+	if(!p.enter_array())
+	{
+		return;
+	}
+	while(p.next_element())
+	{
+		std::string name, protocol;
+		int64_t number = 0;
+		bool has_name = false, has_number = false, has_protocol = false;
+		if(p.enter_object())
+		{
+			while(p.next_member())
+			{
+				const std::string& key = p.key();
+				if(key == "name") { has_name = p.read_string(name); }
+				else if(key == "containerPort") { has_number = p.read_int64(number); }
+				else if(key == "protocol") { has_protocol = p.read_string(protocol); }
+				else { p.skip(); }
+			}
+		}
+
+		k8s_container::port port;
+		if(has_name)
+		{
+			port.set_name(name);
+		}
+		if(!has_number)
+		{
+			g_logger.log("Port not found, setting value to 0", sinsp_logger::SEV_WARNING);
+		}
+		port.set_port(has_number ? (uint32_t)number : 0);
+		if(has_protocol)
+		{
+			port.set_protocol(protocol);
+		}
+		else
+		{
+			g_logger.log("Protocol not found for port: " + (has_name ? name : "[NO NAME]"),
+						 sinsp_logger::SEV_WARNING);
+		}
+		ports.push_back(port);
+	}
+}
+
+void decode_containers(json_stream_parser& p, k8s_container::list& containers)
+{
+	if(!p.enter_array())
+	{
+		return;
+	}
+	// like extract_pod_containers(), stop at the first unnamed container
+	bool done = false;
+	while(p.next_element())
+	{
+		if(done)
+		{
+			p.skip();
+			continue;
+		}
+		if(!p.enter_object())
+		{
+			continue;
+		}
+
+		std::string name;
+		bool has_name = false;
+		k8s_container::port_list ports;
+		while(p.next_member())
+		{
+			const std::string& key = p.key();
+			if(key == "name") { has_name = p.read_string(name); }
+			else if(key == "ports") { decode_ports(p, ports); }
+			else { p.skip(); }
+		}
+
+		if(has_name)
+		{
+			containers.emplace_back(k8s_container(name, ports));
+		}
+		else
+		{
+			done = true;
+		}
+	}
+}
+
+void decode_container_statuses(json_stream_parser& p,
+							   k8s_pod_t::container_id_list& container_ids,
+							   size_t* restart_count)
+{
+	if(!p.enter_array())
 	{
-		if(m_state)
+		return;
+	}
+	std::string container_id;
+	while(p.next_element())
+	{
+		if(!p.enter_object())
+		{
+			continue;
+		}
+		while(p.next_member())
 		{
-			if((data->m_reason == k8s_component::COMPONENT_ADDED) ||
-			   (data->m_reason == k8s_component::COMPONENT_MODIFIED))
+			const std::string& key = p.key();
+			int64_t rc;
+			if(key == "containerID")
+			{
+				if(p.read_string(container_id))
+				{
+					container_ids.push_back(container_id);
+				}
+			}
+			else if(restart_count && key == "restartCount")
 			{
-				k8s_pod_t& pod =
-					m_state->get_component<k8s_pods, k8s_pod_t>(m_state->get_pods(),
-																  data->m_name, data->m_uid, data->m_namespace);
-				k8s_pair_list entries = k8s_component::extract_object(json, "labels");
-				if(entries.size() > 0)
+				if(p.read_int64(rc) && rc >= INT32_MIN && rc <= INT32_MAX)
 				{
-					pod.set_labels(std::move(entries));
+					*restart_count += (int)rc;
 				}
-				k8s_pod_t::container_id_list container_ids = extract_pod_container_ids(json);
-				k8s_container::list containers = extract_pod_containers(json);
-				extract_pod_data(json, pod);
-				pod.set_restart_count(extract_pod_restart_count(json));
-				pod.set_container_ids(std::move(container_ids));
-				pod.set_containers(std::move(containers));
 			}
-			else if(data->m_reason == k8s_component::COMPONENT_DELETED)
+			else
+			{
+				p.skip();
+			}
+		}
+	}
+}
+
+bool decode_pod(json_stream_parser& p, k8s_pod_handler::pod_item& item)
+{
+	if(!p.enter_object())
+	{
+		return false;
+	}
+
+	std::string kind;
+	k8s_pod_t::container_id_list init_container_ids;
+	while(p.next_member())
+	{
+		const std::string& key = p.key();
+		if(key == "kind")
+		{
+			p.read_string(kind);
+		}
+		else if(key == "metadata")
+		{
+			decode_metadata(p, item);
+		}
+		else if(key == "spec" || key == "status")
+		{
+			if(!p.enter_object())
+			{
+				continue;
+			}
+			while(p.next_member())
 			{
-				if(!m_state->delete_component(m_state->get_pods(), data->m_uid))
+				const std::string& field = p.key();
+				if(field == "nodeName") { p.read_string(item.m_node_name); }
+				else if(field == "containers") { decode_containers(p, item.m_containers); }
+				else if(field == "hostIP") { p.read_string(item.m_host_ip); }
+				else if(field == "podIP") { p.read_string(item.m_pod_ip); }
+				else if(field == "containerStatuses")
+				{
+					decode_container_statuses(p, item.m_container_ids, &item.m_restart_count);
+				}
+				else if(field == "initContainerStatuses")
 				{
-					log_not_found(*data);
-					return false;
+					decode_container_statuses(p, init_container_ids, nullptr);
 				}
+				else { p.skip(); }
 			}
 		}
-		else if(data->m_reason != k8s_component::COMPONENT_ERROR)
+		else
 		{
-			g_logger.log(std::string("Unsupported K8S " + name() + " event reason: ") +
-						 std::to_string(data->m_reason), sinsp_logger::SEV_ERROR);
-			return false;
+			p.skip();
 		}
 	}
-	else
+
+	item.m_container_ids.insert(item.m_container_ids.end(),
+								init_container_ids.begin(), init_container_ids.end());
+	return p.ok() && (kind.empty() || kind == "Pod");
+}
+
+}
+
+bool k8s_pod_handler::decode_pod_json(const std::string& json, pod_msg& msg)
+{
+	json_stream_parser p(json);
+	std::string kind;
+	bool is_event = false;
+	bool is_list = false;
+	bool pods_ok = true;
+
+	msg.m_type.clear();
+	msg.m_items.clear();
+	if(!p.enter_object())
 	{
-		throw sinsp_exception("K8s node handler: data is null.");
+		return false;
 	}
-	return true;
+	while(p.next_member())
+	{
+		const std::string& key = p.key();
+		if(key == "type")
+		{
+			p.read_string(msg.m_type);
+		}
+		else if(key == "kind")
+		{
+			p.read_string(kind);
+		}
+		else if(key == "object")
+		{
+			// watch event
+			is_event = true;
+			msg.m_items.emplace_back();
+			pods_ok = decode_pod(p, msg.m_items.back()) && pods_ok;
+		}
+		else if(key == "items")
+		{
+			// initial state
+			if(!p.enter_array())
+			{
+				continue;
+			}
+			is_list = true;
+			while(p.next_element())
+			{
+				msg.m_items.emplace_back();
+				pods_ok = decode_pod(p, msg.m_items.back()) && pods_ok;
+			}
+		}
+		else
+		{
+			p.skip();
+		}
+	}
+
+	if(!p.at_end() || !pods_ok || is_event == is_list)
+	{
+		return false;
+	}
+	if(is_list)
+	{
+		msg.m_type = "ADDED";
+		return kind == "PodList";
+	}
+	// errors (and anything unexpected) are left to the jq filters
+	return kind.empty() &&
+		   (msg.m_type == "ADDED" || msg.m_type == "MODIFIED" || msg.m_type == "DELETED");
 }
 #endif // CYGWING_AGENT
@@ -46,9 +46,37 @@ public:
 
 	~k8s_pod_handler();
 
+	// the pod fields kept in k8s_state_t
+	struct pod_item
+	{
+		std::string                    m_name;
+		std::string                    m_uid;
+		std::string                    m_namespace;
+		k8s_pair_list                  m_labels;
+		k8s_pod_t::container_id_list   m_container_ids;
+		k8s_container::list            m_containers;
+		std::string                    m_node_name;
+		std::string                    m_host_ip;
+		std::string                    m_pod_ip;
+		size_t                         m_restart_count = 0;
+	};
+
+	// a pod watch event or the pod list of the initial state
+	struct pod_msg : public decoded_msg
+	{
+		std::string           m_type;
+		std::vector<pod_item> m_items;
+	};
+
+	// extract the pods from a raw API server message, without going
+	// through a JSON DOM; returns false for errors and for messages not
+	// understood, which must go through the jq filters instead
+	static bool decode_pod_json(const std::string& json, pod_msg& msg);
+
 	static std::vector<std::string> extract_pod_container_ids(const Json::Value& item);
 	static k8s_container::list extract_pod_containers(const Json::Value& item);
 	static void extract_pod_data(const Json::Value& item, k8s_pod_t& pod);
+	static void extract_pod_data(const Json::Value& item, pod_item& pod);
 	static size_t extract_pod_restart_count(const Json::Value& item);
 
 private:
@@ -56,6 +84,9 @@ private:
 	static std::string STATE_FILTER;
 
 	virtual bool handle_component(const Json::Value& json, const msg_data* data = 0);
+	virtual decoded_msg_ptr_t decode_json(const std::string& json);
+	virtual void handle_decoded(decoded_msg& msg);
+	bool handle_pod(const msg_data& data, pod_item& item);
 };
 
 #endif // MINIMAL_BUILD
\ No newline at end of file
@@ -23,6 +23,7 @@ limitations under the License.
 #include "k8s_pod_handler.h"
 #include "sinsp.h"
 #include "sinsp_int.h"
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 
@@ -54,33 +55,37 @@ void k8s_state_t::update_pod(k8s_pod_t& pod, const Json::Value& item)
 	pod.set_containers(std::move(containers));
 }
 
-void k8s_state_t::cache_pod(container_pod_map& map, const std::string& id, const k8s_pod_t* pod)
+std::string k8s_state_t::cache_pod(container_pod_map& map, const std::string& id, const k8s_pod_t* pod) const
 {
 	ASSERT(pod);
 	ASSERT(!pod->get_name().empty());
 	std::string::size_type pos = id.find(m_docker_prefix);
 	if(pos == 0)
 	{
-		map[id.substr(m_docker_prefix.size(), m_id_length)] = pod;
-		return;
+		std::string key = id.substr(m_docker_prefix.size(), m_id_length);
+		map[key] = pod;
+		return key;
 	}
 	pos = id.find(m_rkt_prefix);
 	if(pos == 0)
 	{
-		map[id.substr(m_rkt_prefix.size())] = pod;
-		return;
+		std::string key = id.substr(m_rkt_prefix.size());
+		map[key] = pod;
+		return key;
 	}
 	pos = id.find(m_containerd_prefix);
 	if(pos == 0)
 	{
-		map[id.substr(m_containerd_prefix.size(), m_id_length)] = pod;
-		return;
+		std::string key = id.substr(m_containerd_prefix.size(), m_id_length);
+		map[key] = pod;
+		return key;
 	}
 	pos = id.find(m_crio_prefix);
 	if(pos == 0)
 	{
-		map[id.substr(m_crio_prefix.size(), m_id_length)] = pod;
-		return;
+		std::string key = id.substr(m_crio_prefix.size(), m_id_length);
+		map[key] = pod;
+		return key;
 	}
 	throw sinsp_exception("Invalid container ID (expected one of: '" + m_docker_prefix +
 						 "{ID}', '" + m_rkt_prefix + "{ID}', '" + m_containerd_prefix +
@@ -262,19 +267,16 @@ k8s_component& k8s_state_t::add_common_single_value(k8s_component::type componen
 
 k8s_node_t* k8s_state_t::get_node(const std::string& uid)
 {
-	for (auto& node : m_nodes)
-	{
-		if(node.get_uid() == uid)
-		{
-			return &node;
-		}
-	}
-
-	return nullptr;
+	return find_component(m_nodes, uid);
 }
 
 void k8s_state_t::clear(k8s_component::type type)
 {
+#ifndef HAS_ANALYZER
+	// the caches point into the vectors we're about to clear
+	m_stale_caches = ~0u;
+#endif // HAS_ANALYZER
+
 	if(type == k8s_component::K8S_COMPONENT_COUNT)
 	{
 		m_namespaces.clear();
@@ -326,12 +328,256 @@ void k8s_state_t::clear(k8s_component::type type)
 void k8s_state_t::update_cache(const k8s_component::type_map::key_type& component)
 {
 #ifndef HAS_ANALYZER
+	if(component < k8s_component::K8S_COMPONENT_COUNT)
+	{
+		m_stale_caches |= 1u << component;
+	}
+#endif // HAS_ANALYZER
+}
+
+void k8s_state_t::update_cache(const k8s_component::type_map::key_type& component, const std::string& uid)
+{
+#ifndef HAS_ANALYZER
+	bool updated = false;
+	switch(component)
+	{
+		case k8s_component::K8S_PODS:
+			updated = update_pod_cache(uid);
+			break;
+		case k8s_component::K8S_REPLICATIONCONTROLLERS:
+			updated = update_selected_pods(m_controllers, m_pod_rcs, m_rc_keys, uid);
+			break;
+		case k8s_component::K8S_REPLICASETS:
+			updated = update_selected_pods(m_replicasets, m_pod_rss, m_rs_keys, uid);
+			break;
+		case k8s_component::K8S_SERVICES:
+			updated = update_selected_pods(m_services, m_pod_services, m_service_keys, uid);
+			break;
+		case k8s_component::K8S_DEPLOYMENTS:
+			updated = update_selected_pods(m_deployments, m_pod_deployments, m_deployment_keys, uid);
+			break;
+		default:
+			break;
+	}
+	if(!updated)
+	{
+		update_cache(component);
+	}
+#else
+	update_cache(component);
+#endif // HAS_ANALYZER
+}
+
+#ifndef HAS_ANALYZER
+
+std::string k8s_state_t::pod_label_key(const std::string& ns, const k8s_pair_t& label)
+{
+	std::string key;
+	key.reserve(ns.size() + label.first.size() + label.second.size() + 2);
+	key.append(ns).append(1, '\0').append(label.first).append(1, '\0').append(label.second);
+	return key;
+}
+
+void k8s_state_t::cache_pod_entries(const k8s_pod_t& pod, cache_keys& keys) const
+{
+	keys.m_uid = pod.get_uid();
+	keys.m_keys.clear();
+	keys.m_labels.clear();
+
+	for(const auto& c_id : pod.get_container_ids())
+	{
+		if(!is_component_cached(m_container_pods, c_id, &pod))
+		{
+			keys.m_keys.push_back(cache_pod(m_container_pods, c_id, &pod));
+		}
+		else
+		{
+			g_logger.log("Attempt to cache already cached POD: " + c_id, sinsp_logger::SEV_ERROR);
+		}
+	}
+
+	for(const auto& label : pod.get_labels())
+	{
+		std::string key = pod_label_key(pod.get_namespace(), label);
+		std::vector<const k8s_pod_t*>& pods = m_pod_labels[key];
+		auto it = std::lower_bound(pods.begin(), pods.end(), &pod);
+		// a label repeated in the same pod
+		if(it == pods.end() || *it != &pod)
+		{
+			pods.insert(it, &pod);
+			keys.m_labels.push_back(std::move(key));
+		}
+	}
+}
+
+void k8s_state_t::uncache_pod_entries(const k8s_pod_t& pod, const cache_keys& keys) const
+{
+	for(const auto& key : keys.m_keys)
+	{
+		auto it = m_container_pods.find(key);
+		if(it != m_container_pods.end() && it->second == &pod)
+		{
+			m_container_pods.erase(it);
+		}
+	}
+
+	for(const auto& key : keys.m_labels)
+	{
+		auto it = m_pod_labels.find(key);
+		if(it == m_pod_labels.end())
+		{
+			continue;
+		}
+		std::vector<const k8s_pod_t*>& pods = it->second;
+		auto pod_it = std::lower_bound(pods.begin(), pods.end(), &pod);
+		if(pod_it != pods.end() && *pod_it == &pod)
+		{
+			pods.erase(pod_it);
+		}
+		if(pods.empty())
+		{
+			m_pod_labels.erase(it);
+		}
+	}
+}
+
+bool k8s_state_t::update_pod_cache(const std::string& uid) const
+{
+	if((m_stale_caches & (1u << k8s_component::K8S_PODS)) || m_pod_keys.m_data != m_pods.data())
+	{
+		return false;
+	}
+	const k8s_pod_t* pod = find_component(m_pods, uid);
+	if(!pod)
+	{
+		return false;
+	}
+
+	std::vector<cache_keys>& keys = m_pod_keys.m_components;
+	size_t pos = pod - m_pods.data();
+	if(m_pods.size() == keys.size() && keys[pos].m_uid == uid)
+	{
+		uncache_pod_entries(*pod, keys[pos]);
+	}
+	else if(m_pods.size() == keys.size() + 1 && pos == keys.size())
+	{
+		keys.emplace_back();
+	}
+	else
+	{
+		return false;
+	}
+	cache_pod_entries(*pod, keys[pos]);
+	return true;
+}
+
+template <typename C, typename M>
+void k8s_state_t::cache_selected_pods(const C& components, M& map, cache_keys_list& keys, const char* name) const
+{
+	map.clear();
+	keys.m_data = components.data();
+	keys.m_components.clear();
+	keys.m_components.reserve(components.size());
+	for(const auto& component : components)
+	{
+		keys.m_components.emplace_back();
+		cache_keys& component_keys = keys.m_components.back();
+		component_keys.m_uid = component.get_uid();
+		std::vector<const k8s_pod_t*> pod_subset = get_selected_pods(component);
+		for(auto& pod : pod_subset)
+		{
+			const std::string& pod_uid = pod->get_uid();
+			if(!is_component_cached(map, pod_uid, &component))
+			{
+				cache_component(map, pod_uid, &component);
+				component_keys.m_keys.push_back(pod_uid);
+			}
+			else
+			{
+				g_logger.log(std::string("Attempt to cache already cached ") + name + ": " + pod_uid, sinsp_logger::SEV_ERROR);
+			}
+		}
+	}
+}
+
+//
+// For the controllers, mapping a pod to a single one, the first one in
+// the vector selecting it wins on a full rebuild but the one already
+// holding it does here; they only differ for overlapping selectors,
+// which kubernetes does not support anyway.
+//
+template <typename C, typename M>
+bool k8s_state_t::update_selected_pods(const C& components, M& map, cache_keys_list& keys, const std::string& uid) const
+{
+	typedef typename C::value_type component_t;
+	if((m_stale_caches & (1u << component_t::COMPONENT_TYPE)) || keys.m_data != components.data())
+	{
+		return false;
+	}
+	const component_t* component = find_component(components, uid);
+	if(!component)
+	{
+		return false;
+	}
+
+	size_t pos = component - components.data();
+	if(components.size() == keys.m_components.size() && keys.m_components[pos].m_uid == uid)
+	{
+		for(const auto& pod_uid : keys.m_components[pos].m_keys)
+		{
+			auto range = map.equal_range(pod_uid);
+			for(auto it = range.first; it != range.second; ++it)
+			{
+				if(it->second == component)
+				{
+					map.erase(it);
+					break;
+				}
+			}
+		}
+	}
+	else if(components.size() == keys.m_components.size() + 1 && pos == keys.m_components.size())
+	{
+		keys.m_components.emplace_back();
+	}
+	else
+	{
+		return false;
+	}
+
+	cache_keys& component_keys = keys.m_components[pos];
+	component_keys.m_uid = uid;
+	component_keys.m_keys.clear();
+	for(const k8s_pod_t* pod : get_selected_pods(*component))
+	{
+		const std::string& pod_uid = pod->get_uid();
+		if(!is_component_cached(map, pod_uid, component))
+		{
+			cache_component(map, pod_uid, component);
+			component_keys.m_keys.push_back(pod_uid);
+		}
+	}
+	return true;
+}
+
+#endif // HAS_ANALYZER
+
+void k8s_state_t::refresh_cache(k8s_component::type component) const
+{
+#ifndef HAS_ANALYZER
+	uint32_t bit = 1u << component;
+	if(!(m_stale_caches & bit))
+	{
+		return;
+	}
+	m_stale_caches &= ~bit;
+
 	switch (component)
 	{
 		case k8s_component::K8S_NAMESPACES:
 		{
-			const k8s_namespaces& nspaces = get_namespaces();
-			k8s_state_t::namespace_map& ns_map = get_namespace_map();
+			const k8s_namespaces& nspaces = m_namespaces;
+			k8s_state_t::namespace_map& ns_map = m_namespace_map;
 			ns_map.clear();
 			for(const auto& ns : nspaces)
 			{
@@ -350,101 +596,28 @@ void k8s_state_t::update_cache(const k8s_component::type_map::key_type& componen
 
 		case k8s_component::K8S_PODS:
 		{
-			const k8s_pods& pods = get_pods();
-			k8s_state_t::container_pod_map& container_pod_map = get_container_pod_map();
-			container_pod_map.clear();
-			for(const auto& pod : pods)
+			m_container_pods.clear();
+			m_pod_labels.clear();
+			m_pod_keys.m_data = m_pods.data();
+			m_pod_keys.m_components.resize(m_pods.size());
+			for(size_t i = 0; i < m_pods.size(); ++i)
 			{
-				const k8s_pod_t::container_id_list& c_ids = pod.get_container_ids();
-				for(const auto& c_id : c_ids)
-				{
-					if(!is_component_cached(container_pod_map, c_id, &pod))
-					{
-						cache_pod(container_pod_map, c_id, &pod);
-					}
-					else
-					{
-						g_logger.log("Attempt to cache already cached POD: " + c_id, sinsp_logger::SEV_ERROR);
-					}
-				}
+				cache_pod_entries(m_pods[i], m_pod_keys.m_components[i]);
 			}
 		}
 		break;
 
 		case k8s_component::K8S_REPLICATIONCONTROLLERS:
-		{
-			const k8s_controllers& rcs = get_rcs();
-			const k8s_pods& pods = get_pods();
-			k8s_state_t::pod_rc_map& pod_ctrl_map = get_pod_rc_map();
-			pod_ctrl_map.clear();
-			for(const auto& rc : rcs)
-			{
-				std::vector<const k8s_pod_t*> pod_subset = rc.get_selected_pods(pods);
-				for(auto& pod : pod_subset)
-				{
-					const std::string& pod_uid = pod->get_uid();
-					if(!is_component_cached(pod_ctrl_map, pod_uid, &rc))
-					{
-						cache_component(pod_ctrl_map, pod_uid, &rc);
-					}
-					else
-					{
-						g_logger.log("Attempt to cache already cached REPLICATION CONTROLLER: " + pod_uid, sinsp_logger::SEV_ERROR);
-					}
-				}
-			}
-		}
-		break;
+			cache_selected_pods(m_controllers, m_pod_rcs, m_rc_keys, "REPLICATION CONTROLLER");
+			break;
 
 		case k8s_component::K8S_REPLICASETS:
-		{
-			const k8s_replicasets& rss = get_rss();
-			const k8s_pods& pods = get_pods();
-			k8s_state_t::pod_rs_map& pod_rset_map = get_pod_rs_map();
-			pod_rset_map.clear();
-			for(const auto& rs : rss)
-			{
-				std::vector<const k8s_pod_t*> pod_subset = rs.get_selected_pods(pods);
-				for(auto& pod : pod_subset)
-				{
-					const std::string& pod_uid = pod->get_uid();
-					if(!is_component_cached(pod_rset_map, pod_uid, &rs))
-					{
-						cache_component(pod_rset_map, pod_uid, &rs);
-					}
-					else
-					{
-						g_logger.log("Attempt to cache already cached REPLICA SET: " + pod_uid, sinsp_logger::SEV_ERROR);
-					}
-				}
-			}
-		}
-		break;
+			cache_selected_pods(m_replicasets, m_pod_rss, m_rs_keys, "REPLICA SET");
+			break;
 
 		case k8s_component::K8S_SERVICES:
-		{
-			const k8s_services& services = get_services();
-			const k8s_pods& pods = get_pods();
-			k8s_state_t::pod_service_map& pod_svc_map = get_pod_service_map();
-			pod_svc_map.clear();
-			for(const auto& service : services)
-			{
-				std::vector<const k8s_pod_t*> pod_subset = service.get_selected_pods(pods);
-				for(auto& pod : pod_subset)
-				{
-					const std::string& pod_uid = pod->get_uid();
-					if(!is_component_cached(pod_svc_map, pod_uid, &service))
-					{
-						cache_component(pod_svc_map, pod_uid, &service);
-					}
-					else
-					{
-						g_logger.log("Attempt to cache already cached SERVICE: " + pod_uid, sinsp_logger::SEV_ERROR);
-					}
-				}
-			}
-		}
-		break;
+			cache_selected_pods(m_services, m_pod_services, m_service_keys, "SERVICE");
+			break;
 
 		case k8s_component::K8S_DAEMONSETS:
 		{
@@ -473,29 +646,8 @@ void k8s_state_t::update_cache(const k8s_component::type_map::key_type& componen
 		break;
 
 		case k8s_component::K8S_DEPLOYMENTS:
-		{
-			const k8s_deployments& deployments = get_deployments();
-			const k8s_pods& pods = get_pods();
-			k8s_state_t::pod_deployment_map& pod_deployment_map = get_pod_deployment_map();
-			pod_deployment_map.clear();
-			for(const auto& deployment : deployments)
-			{
-				std::vector<const k8s_pod_t*> pod_subset = deployment.get_selected_pods(pods);
-				for(auto& pod : pod_subset)
-				{
-					const std::string& pod_uid = pod->get_uid();
-					if(!is_component_cached(pod_deployment_map, pod_uid, &deployment))
-					{
-						cache_component(pod_deployment_map, pod_uid, &deployment);
-					}
-					else
-					{
-						g_logger.log("Attempt to cache already cached Deployment: " + pod_uid, sinsp_logger::SEV_ERROR);
-					}
-				}
-			}
-		}
-		break;
+			cache_selected_pods(m_deployments, m_pod_deployments, m_deployment_keys, "Deployment");
+			break;
 
 		default: return;
 	}
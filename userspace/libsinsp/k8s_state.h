@@ -30,6 +30,113 @@ limitations under the License.
 #include <map>
 #include <unordered_map>
 
+//
+// uid index
+//
+
+// Positions of the components of one of the state vectors, by uid.
+// Found entries are verified and the index is rebuilt whenever it's out
+// of sync with the vector (an erase moved the components, or the vector
+// was changed without going through the index), so lookups are never
+// wrong, only as slow as a linear scan once after such a change.
+// Like the linear scan it replaces, it finds the first component with
+// a given uid.
+template <typename C>
+class k8s_uid_index
+{
+public:
+	typedef typename C::value_type component_t;
+
+	component_t* find(C& components, const std::string& uid) const
+	{
+		size_t pos = position(components, uid);
+		return pos == NPOS ? nullptr : &components[pos];
+	}
+
+	const component_t* find(const C& components, const std::string& uid) const
+	{
+		size_t pos = position(components, uid);
+		return pos == NPOS ? nullptr : &components[pos];
+	}
+
+	// the last component of the vector was just added
+	void added(const C& components)
+	{
+		if(!m_stale && m_size + 1 == components.size())
+		{
+			m_index.emplace(components.back().get_uid(), m_size++);
+		}
+		else
+		{
+			m_stale = true;
+		}
+	}
+
+	bool erase(C& components, const std::string& uid)
+	{
+		size_t pos = position(components, uid);
+		if(pos == NPOS)
+		{
+			return false;
+		}
+		components.erase(components.begin() + pos);
+		if(pos == components.size())
+		{
+			m_index.erase(uid);
+			--m_size;
+		}
+		else
+		{
+			// the components after pos moved; rebuild on next use
+			m_stale = true;
+		}
+		return true;
+	}
+
+private:
+	static const size_t NPOS = ~(size_t)0;
+
+	size_t position(const C& components, const std::string& uid) const
+	{
+		if(m_stale || m_size != components.size())
+		{
+			rebuild(components);
+		}
+		auto it = m_index.find(uid);
+		if(it == m_index.end())
+		{
+			return NPOS;
+		}
+		if(it->second < components.size() && components[it->second].get_uid() == uid)
+		{
+			return it->second;
+		}
+		rebuild(components);
+		it = m_index.find(uid);
+		if(it == m_index.end())
+		{
+			return NPOS;
+		}
+		return it->second;
+	}
+
+	void rebuild(const C& components) const
+	{
+		m_index.clear();
+		m_index.reserve(components.size());
+		for(size_t i = 0; i < components.size(); ++i)
+		{
+			m_index.emplace(components[i].get_uid(), i);
+		}
+		m_size = components.size();
+		m_stale = false;
+	}
+
+	mutable std::unordered_map<std::string, size_t> m_index;
+	mutable size_t m_size = 0;
+	mutable bool m_stale = false;
+};
+
 //
 // state
 //
@@ -153,14 +260,7 @@ public:
 	template <typename C>
 	bool has(const C& components, const std::string& uid) const
 	{
-		for (auto& comp : components)
-		{
-			if(uid == comp.get_uid())
-			{
-				return true;
-			}
-		}
-		return false;
+		return find_component(components, uid) != nullptr;
 	}
 
 	bool has(const std::string& uid) const
@@ -173,27 +273,13 @@ public:
 	template <typename C, typename T>
 	T* get_component(C& components, const std::string& uid)
 	{
-		for (auto& comp : components)
-		{
-			if(comp.get_uid() == uid)
-			{
-				return &comp;
-			}
-		}
-		return 0;
+		return find_component(components, uid);
 	}
 
 	template <typename C, typename T>
 	const T* get_component(const C& components, const std::string& uid) const
 	{
-		for (const auto& comp : components)
-		{
-			if(comp.get_uid() == uid)
-			{
-				return &comp;
-			}
-		}
-		return 0;
+		return find_component(components, uid);
 	}
 
 	template <typename C, typename T>
@@ -201,6 +287,10 @@ public:
 	{
 		m_component_map[uid] = T::COMPONENT_TYPE;
 		container.emplace_back(std::move(T(name, uid, ns)));
+		if(k8s_uid_index<C>* index = uid_index(container))
+		{
+			index->added(container);
+		}
 		return container.back();
 	}
 
@@ -210,12 +300,10 @@ public:
 	template <typename C, typename T>
 	T& get_component(C& container, const std::string& name, const std::string& uid, const std::string& ns = "")
 	{
-		for (auto& comp : container)
+		T* comp = find_component(container, uid);
+		if(comp)
 		{
-			if(comp.get_uid() == uid)
-			{
-				return comp;
-			}
+			return *comp;
 		}
 		return add_component<C, T>(container, name, uid, ns);
 	}
@@ -223,6 +311,16 @@ public:
 	template <typename C>
 	bool delete_component(C& components, const std::string& uid)
 	{
+		if(k8s_uid_index<C>* index = uid_index(components))
+		{
+			if(!index->erase(components, uid))
+			{
+				return false;
+			}
+			m_component_map.erase(uid);
+			return true;
+		}
+
 		for (typename C::iterator component = components.begin(),
 			end = components.end();
 			component != end;
@@ -253,6 +351,7 @@ public:
 	// pod by container;
 	const k8s_pod_t* get_pod(const std::string& container) const
 	{
+		refresh_cache(k8s_component::K8S_PODS);
 		container_pod_map::const_iterator it = m_container_pods.find(container);
 		if(it != m_container_pods.end())
 		{
@@ -261,20 +360,66 @@ public:
 		return 0;
 	}
 
-	const namespace_map& get_namespace_map() const { return m_namespace_map; }
-	const container_pod_map& get_container_pod_map() const { return m_container_pods; }
-	const pod_service_map& get_pod_service_map() const { return m_pod_services; }
-	const pod_rc_map& get_pod_rc_map() const { return m_pod_rcs; }
-	const pod_rs_map& get_pod_rs_map() const { return m_pod_rss; }
-	const pod_deployment_map& get_pod_deployment_map() const { return m_pod_deployments; }
+	const namespace_map& get_namespace_map() const
+	{
+		refresh_cache(k8s_component::K8S_NAMESPACES);
+		return m_namespace_map;
+	}
+
+	const container_pod_map& get_container_pod_map() const
+	{
+		refresh_cache(k8s_component::K8S_PODS);
+		return m_container_pods;
+	}
+
+	const pod_service_map& get_pod_service_map() const
+	{
+		refresh_cache(k8s_component::K8S_SERVICES);
+		return m_pod_services;
+	}
+
+	const pod_rc_map& get_pod_rc_map() const
+	{
+		refresh_cache(k8s_component::K8S_REPLICATIONCONTROLLERS);
+		return m_pod_rcs;
+	}
+
+	const pod_rs_map& get_pod_rs_map() const
+	{
+		refresh_cache(k8s_component::K8S_REPLICASETS);
+		return m_pod_rss;
+	}
+
+	const pod_deployment_map& get_pod_deployment_map() const
+	{
+		refresh_cache(k8s_component::K8S_DEPLOYMENTS);
+		return m_pod_deployments;
+	}
+
+	// the pods selected by a replication controller, replica set, service
+	// or deployment; same as its get_selected_pods(get_pods()), but only
+	// looks at the pods having the least common of the selector labels
+	template <typename T>
+	std::vector<const k8s_pod_t*> get_selected_pods(const T& component) const;
 
 #endif // HAS_ANALYZER
 
+	// marks the lookup caches built from the given component type as
+	// stale; they get rebuilt on their next use, so a burst of updates
+	// costs a single rebuild
+	void update_cache(const k8s_component::type_map::key_type& component);
+
+	// the component with the given uid was added or modified in place;
+	// updates its entries only when the caches are otherwise current,
+	// else same as above. Removals must go through the above.
+	void update_cache(const k8s_component::type_map::key_type& component, const std::string& uid);
+
 	void set_capture_version(int version);
 	int get_capture_version() const;
 
 #ifdef HAS_CAPTURE
 	typedef std::deque<std::string> event_list_t;
+	bool is_captured() const { return m_is_captured; }
 	const event_list_t& get_capture_events() const { return m_capture_events; }
 	void enqueue_capture_event(const Json::Value& item);
 	std::string dequeue_capture_event();
@@ -282,7 +427,7 @@ public:
 
 private:
 
-	void update_cache(const k8s_component::type_map::key_type& component);
+	void refresh_cache(k8s_component::type component) const;
 	static k8s_component::type component_from_json(const Json::Value& item);
 	static Json::Value extract_capture_data(const Json::Value& item);
 
@@ -297,6 +442,52 @@ private:
 		return 0;
 	}
 
+	// the uid index of one of our component vectors, null for any
+	// other vector
+	k8s_uid_index<k8s_namespaces>* uid_index(const k8s_namespaces& c) const { return &c == &m_namespaces ? &m_namespace_index : nullptr; }
+	k8s_uid_index<k8s_nodes>* uid_index(const k8s_nodes& c) const { return &c == &m_nodes ? &m_node_index : nullptr; }
+	k8s_uid_index<k8s_pods>* uid_index(const k8s_pods& c) const { return &c == &m_pods ? &m_pod_index : nullptr; }
+	k8s_uid_index<k8s_controllers>* uid_index(const k8s_controllers& c) const { return &c == &m_controllers ? &m_controller_index : nullptr; }
+	k8s_uid_index<k8s_replicasets>* uid_index(const k8s_replicasets& c) const { return &c == &m_replicasets ? &m_replicaset_index : nullptr; }
+	k8s_uid_index<k8s_services>* uid_index(const k8s_services& c) const { return &c == &m_services ? &m_service_index : nullptr; }
+	k8s_uid_index<k8s_daemonsets>* uid_index(const k8s_daemonsets& c) const { return &c == &m_daemonsets ? &m_daemonset_index : nullptr; }
+	k8s_uid_index<k8s_deployments>* uid_index(const k8s_deployments& c) const { return &c == &m_deployments ? &m_deployment_index : nullptr; }
+	k8s_uid_index<k8s_events>* uid_index(const k8s_events& c) const { return &c == &m_events ? &m_event_index : nullptr; }
+
+	template <typename C>
+	typename C::value_type* find_component(C& components, const std::string& uid)
+	{
+		if(k8s_uid_index<C>* index = uid_index(components))
+		{
+			return index->find(components, uid);
+		}
+		for (auto& comp : components)
+		{
+			if(comp.get_uid() == uid)
+			{
+				return &comp;
+			}
+		}
+		return nullptr;
+	}
+
+	template <typename C>
+	const typename C::value_type* find_component(const C& components, const std::string& uid) const
+	{
+		if(const k8s_uid_index<C>* index = uid_index(components))
+		{
+			return index->find(components, uid);
+		}
+		for (const auto& comp : components)
+		{
+			if(comp.get_uid() == uid)
+			{
+				return &comp;
+			}
+		}
+		return nullptr;
+	}
+
 	template<typename C>
 	bool is_component_cached(const C& map, const std::string& key) const
 	{
@@ -317,10 +508,11 @@ private:
 		return false;
 	}
 
-	void cache_pod(container_pod_map& map, const std::string& id, const k8s_pod_t* pod);
+	// returns the key the pod was cached under
+	std::string cache_pod(container_pod_map& map, const std::string& id, const k8s_pod_t* pod) const;
 
 	template<typename C>
-	void cache_component(C& map, const std::string& key, typename C::mapped_type component)
+	void cache_component(C& map, const std::string& key, typename C::mapped_type component) const
 	{
 		ASSERT(component);
 		ASSERT(!component->get_name().empty());
@@ -329,7 +521,7 @@ private:
 	}
 
 	template<typename C>
-	void uncache_component(C& map, const std::string& key)
+	void uncache_component(C& map, const std::string& key) const
 	{
 		typename C::iterator it = map.find(key);
 		if(it != map.end())
@@ -338,16 +530,6 @@ private:
 		}
 	}
 
-#ifndef HAS_ANALYZER
-
-	namespace_map& get_namespace_map() { return m_namespace_map; }
-	container_pod_map& get_container_pod_map() { return m_container_pods; }
-	pod_service_map& get_pod_service_map() { return m_pod_services; }
-	pod_rc_map& get_pod_rc_map() { return m_pod_rcs; }
-	pod_rs_map& get_pod_rs_map() { return m_pod_rss; }
-	pod_deployment_map& get_pod_deployment_map() { return m_pod_deployments; }
-
-#endif // HAS_ANALYZER
 
 	static const std::string m_docker_prefix; // "docker://"
 	static const std::string m_rkt_prefix; // "rkt://"
@@ -357,12 +539,57 @@ private:
 
 #ifndef HAS_ANALYZER
 
-	namespace_map            m_namespace_map;
-	container_pod_map        m_container_pods;
-	pod_service_map          m_pod_services;
-	pod_rc_map               m_pod_rcs;
-	pod_rs_map               m_pod_rss;
-	pod_deployment_map       m_pod_deployments;
+	typedef std::unordered_map<std::string, std::vector<const k8s_pod_t*>> pod_label_index_t;
+
+	// what a cached component was cached under, so that its entries can
+	// be dropped once it has changed
+	struct cache_keys
+	{
+		std::string              m_uid;
+		// pods: the container_pod_map keys;
+		// controllers, services...: the uids of the selected pods
+		std::vector<std::string> m_keys;
+		// pods: the pod_label_key()s
+		std::vector<std::string> m_labels;
+	};
+
+	// the cache_keys of a component vector, in the vector order
+	struct cache_keys_list
+	{
+		// the vector data when the keys were recorded; the caches
+		// point into it
+		const void*             m_data = nullptr;
+		std::vector<cache_keys> m_components;
+	};
+
+	void cache_pod_entries(const k8s_pod_t& pod, cache_keys& keys) const;
+	void uncache_pod_entries(const k8s_pod_t& pod, const cache_keys& keys) const;
+	bool update_pod_cache(const std::string& uid) const;
+	static std::string pod_label_key(const std::string& ns, const k8s_pair_t& label);
+
+	template <typename C, typename M>
+	void cache_selected_pods(const C& components, M& map, cache_keys_list& keys, const char* name) const;
+	template <typename C, typename M>
+	bool update_selected_pods(const C& components, M& map, cache_keys_list& keys, const std::string& uid) const;
+
+	// the lookup caches are rebuilt lazily, see update_cache()
+	mutable namespace_map            m_namespace_map;
+	mutable container_pod_map        m_container_pods;
+	mutable pod_service_map          m_pod_services;
+	mutable pod_rc_map               m_pod_rcs;
+	mutable pod_rs_map               m_pod_rss;
+	mutable pod_deployment_map       m_pod_deployments;
+	// pods by namespace and label (see pod_label_key()), each list
+	// sorted by address, i.e. in the m_pods order; used to match
+	// selectors
+	mutable pod_label_index_t        m_pod_labels;
+	mutable cache_keys_list          m_pod_keys;
+	mutable cache_keys_list          m_rc_keys;
+	mutable cache_keys_list          m_rs_keys;
+	mutable cache_keys_list          m_service_keys;
+	mutable cache_keys_list          m_deployment_keys;
+	// bit mask of the component types whose caches need a rebuild
+	mutable uint32_t                 m_stale_caches = ~0u;
 
 #endif // HAS_ANALYZER
 
@@ -381,6 +608,17 @@ private:
 	k8s_daemonsets  m_daemonsets;
 	k8s_deployments m_deployments;
 	k8s_events      m_events;
+
+	mutable k8s_uid_index<k8s_namespaces>  m_namespace_index;
+	mutable k8s_uid_index<k8s_nodes>       m_node_index;
+	mutable k8s_uid_index<k8s_pods>        m_pod_index;
+	mutable k8s_uid_index<k8s_controllers> m_controller_index;
+	mutable k8s_uid_index<k8s_replicasets> m_replicaset_index;
+	mutable k8s_uid_index<k8s_services>    m_service_index;
+	mutable k8s_uid_index<k8s_daemonsets>  m_daemonset_index;
+	mutable k8s_uid_index<k8s_deployments> m_deployment_index;
+	mutable k8s_uid_index<k8s_events>      m_event_index;
+
 	// map for uid/type cache for all components
 	// used by to quickly lookup any component by uid
 	component_map_t m_component_map;
@@ -643,6 +881,45 @@ inline void k8s_state_t::add_last_pod_container_id(std::string&& container_id)
 	}
 }
 
+#ifndef HAS_ANALYZER
+
+template <typename T>
+std::vector<const k8s_pod_t*> k8s_state_t::get_selected_pods(const T& component) const
+{
+	std::vector<const k8s_pod_t*> pod_vec;
+	const k8s_pair_list& selectors = component.get_selectors();
+	if(selectors.empty())
+	{
+		return pod_vec;
+	}
+
+	refresh_cache(k8s_component::K8S_PODS);
+	const std::vector<const k8s_pod_t*>* candidates = nullptr;
+	for(const auto& selector : selectors)
+	{
+		auto it = m_pod_labels.find(pod_label_key(component.get_namespace(), selector));
+		if(it == m_pod_labels.end())
+		{
+			return pod_vec;
+		}
+		if(!candidates || it->second.size() < candidates->size())
+		{
+			candidates = &it->second;
+		}
+	}
+
+	for(const k8s_pod_t* pod : *candidates)
+	{
+		if(component.selectors_in_labels(pod->get_labels()))
+		{
+			pod_vec.push_back(pod);
+		}
+	}
+	return pod_vec;
+}
+
+#endif // HAS_ANALYZER
+
 inline void k8s_state_t::set_capture_version(int version)
 {
 	if(version != CAPTURE_VERSION_NONE &&
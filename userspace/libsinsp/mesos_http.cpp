@@ -34,6 +34,7 @@ limitations under the License.
 #include <sstream>
 #include <stdexcept>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <cstring>
 
@@ -483,29 +484,14 @@ bool mesos_http::get_all_data(callback_func_t parse)
 
 int mesos_http::wait(int for_recv)
 {
-	struct timeval tv;
-	fd_set infd, outfd, errfd;
-	int res;
-
-	tv.tv_sec = m_timeout_ms / 1000;
-	tv.tv_usec = (m_timeout_ms % 1000) * 1000;
-
-	FD_ZERO(&infd);
-	FD_ZERO(&outfd);
-	FD_ZERO(&errfd);
-	FD_SET(m_watch_socket, &errfd);
-
-	if(for_recv)
-	{
-		FD_SET(m_watch_socket, &infd);
-	}
-	else
-	{
-		FD_SET(m_watch_socket, &outfd);
-	}
-
-	res = select(m_watch_socket + 1, &infd, &outfd, &errfd, &tv);
-	return res;
+	// poll() has no FD_SETSIZE limit on the descriptor value, which the
+	// watch socket can easily exceed when many connections are open
+	struct pollfd pfd;
+	pfd.fd = m_watch_socket;
+	pfd.events = for_recv ? POLLIN : POLLOUT;
+	pfd.revents = 0;
+
+	return poll(&pfd, 1, (int)m_timeout_ms);
 }
 
 int mesos_http::get_socket(long timeout_ms)
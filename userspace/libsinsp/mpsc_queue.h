@@ -0,0 +1,310 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace libsinsp {
+
+/**
+ * \brief A bounded lock-free queue for many producers and one consumer
+ *
+ * @tparam T type of the queued elements (must be move constructible
+ * and move assignable)
+ *
+ * The elements live in a ring of preallocated slots, each with its own
+ * sequence number telling whether the slot is free or holds a value
+ * for the current lap, so neither push() nor pop() ever take a lock or
+ * allocate memory. Producers claim a slot with a compare-and-swap on
+ * the tail and publish it with a release store of its sequence number.
+ * A producer that gets preempted between the two leaves its slot
+ * unpublished: the consumer can't get past that slot, so it sees the
+ * queue as empty and every element pushed after it waits until the
+ * producer resumes. The other producers keep claiming slots until the
+ * ring is full, then DROP_NEWEST rejects their elements and DROP_OLDEST
+ * makes them wait on the same slot.
+ *
+ * When the queue is full, push() follows the overflow policy given
+ * at construction:
+ *  - DROP_NEWEST rejects the new element
+ *  - DROP_OLDEST evicts the oldest queued element to make room, which
+ *    keeps the most recent ones when the consumer falls behind
+ * Either way the lost element is counted in dropped().
+ *
+ * pop() and pop_batch() must only be called by one thread at a time.
+ */
+template<typename T>
+class mpsc_queue
+{
+public:
+	enum overflow_policy
+	{
+		DROP_NEWEST,
+		DROP_OLDEST,
+	};
+
+	/**
+	 * \brief Build a queue with room for at least `capacity` elements
+	 *
+	 * The capacity is rounded up to the next power of two
+	 */
+	explicit mpsc_queue(size_t capacity, overflow_policy policy = DROP_NEWEST):
+		m_mask(round_capacity(capacity) - 1),
+		m_slots(new slot[m_mask + 1]),
+		m_policy(policy),
+		m_head(0),
+		m_tail(0),
+		m_dropped(0)
+	{
+		for(size_t j = 0; j <= m_mask; j++)
+		{
+			m_slots[j].m_seq.store(j, std::memory_order_relaxed);
+		}
+	}
+
+	mpsc_queue(const mpsc_queue&) = delete;
+	mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+	~mpsc_queue()
+	{
+		T val;
+		while(pop(val))
+		{
+		}
+	}
+
+	/**
+	 * \brief Add an element, applying the overflow policy if the queue is full
+	 *
+	 * @return false if the element was not queued (only with DROP_NEWEST)
+	 */
+	bool push(T&& val)
+	{
+		while(!try_push(val))
+		{
+			if(m_policy == DROP_NEWEST)
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			// make room by consuming the oldest element ourselves.
+			// If that fails, the queue was drained in the meantime or
+			// the oldest slot is being written right now: just retry
+			T oldest;
+			if(try_pop(oldest))
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		return true;
+	}
+
+	bool push(const T& val)
+	{
+		T copy(val);
+		return push(std::move(copy));
+	}
+
+	/**
+	 * \brief Take the oldest element, if any
+	 *
+	 * @return false if the queue is empty
+	 */
+	bool pop(T& val)
+	{
+		return try_pop(val);
+	}
+
+	/**
+	 * \brief Take up to `max` elements, appending them to `out`
+	 *
+	 * @tparam C a container with push_back(T&&), e.g. std::vector<T>
+	 * @return the number of elements taken
+	 */
+	template<typename C>
+	size_t pop_batch(C& out, size_t max)
+	{
+		size_t n = 0;
+		T val;
+		while(n < max && try_pop(val))
+		{
+			out.push_back(std::move(val));
+			n++;
+		}
+		return n;
+	}
+
+	/**
+	 * \brief Number of queued elements
+	 *
+	 * Only a snapshot when producers are running
+	 */
+	size_t size() const
+	{
+		size_t head = m_head.load(std::memory_order_acquire);
+		size_t tail = m_tail.load(std::memory_order_acquire);
+		return (tail > head) ? tail - head : 0;
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	size_t capacity() const
+	{
+		return m_mask + 1;
+	}
+
+	overflow_policy policy() const
+	{
+		return m_policy;
+	}
+
+	/**
+	 * \brief Number of elements lost because the queue was full
+	 */
+	uint64_t dropped() const
+	{
+		return m_dropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	//
+	// A slot with sequence number s is free for the producer of
+	// position s, and holds the value of position s - 1 for the
+	// consumer
+	//
+	struct slot
+	{
+		std::atomic<size_t> m_seq;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+
+		T* val()
+		{
+			return reinterpret_cast<T*>(&m_storage);
+		}
+	};
+
+	static size_t round_capacity(size_t capacity)
+	{
+		size_t res = 2;
+		while(res < capacity)
+		{
+			res <<= 1;
+		}
+		return res;
+	}
+
+	bool try_push(T& val)
+	{
+		size_t pos = m_tail.load(std::memory_order_relaxed);
+		while(true)
+		{
+			slot& s = m_slots[pos & m_mask];
+			size_t seq = s.m_seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if(diff == 0)
+			{
+				if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					new (s.val()) T(std::move(val));
+					s.m_seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+				// pos was reloaded by the failed CAS
+			}
+			else if(diff < 0)
+			{
+				// the slot still holds the value of the previous lap
+				return false;
+			}
+			else
+			{
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//
+	// The head is advanced with a CAS rather than a plain store because
+	// DROP_OLDEST producers consume too when the queue is full
+	//
+	bool try_pop(T& val)
+	{
+		size_t pos = m_head.load(std::memory_order_relaxed);
+		while(true)
+		{
+			slot& s = m_slots[pos & m_mask];
+			size_t seq = s.m_seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if(diff == 0)
+			{
+				if(m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					val = std::move(*s.val());
+					s.val()->~T();
+					s.m_seq.store(pos + m_mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if(diff < 0)
+			{
+				// empty, or the producer of this slot didn't publish it yet
+				return false;
+			}
+			else
+			{
+				pos = m_head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//
+	// The consumer and the producers update different cache lines.
+	// Padding by hand rather than with alignas() keeps the queue (and
+	// the classes embedding it) allocatable with the plain operator new
+	//
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	const size_t m_mask;
+	std::unique_ptr<slot[]> m_slots;
+	const overflow_policy m_policy;
+
+	char m_pad0[CACHE_LINE_SIZE];
+	std::atomic<size_t> m_head;
+	char m_pad1[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> m_tail;
+	char m_pad2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+	std::atomic<uint64_t> m_dropped;
+};
+
+}
@@ -38,6 +38,7 @@ limitations under the License.
 #include "filter.h"
 #include "filterchecks.h"
 #include "protodecoder.h"
+#include "http_session.h"
 #ifdef SIMULATE_DROP_MODE
 bool should_drop(sinsp_evt *evt);
 #endif
@@ -53,7 +54,8 @@ extern sinsp_evttables g_infotables;
 sinsp_parser::sinsp_parser(sinsp *inspector) :
 	m_inspector(inspector),
 	m_tmp_evt(m_inspector),
-	m_fd_listener(NULL)
+	m_fd_listener(NULL),
+	m_http_sessions(NULL)
 {
 	m_fake_userevt = (scap_evt*)m_fake_userevt_storage;
 
@@ -66,6 +68,7 @@ sinsp_parser::sinsp_parser(sinsp *inspector) :
 	init_metaevt(m_k8s_metaevents_state, PPME_K8S_E, SP_EVT_BUF_SIZE);
 	init_metaevt(m_mesos_metaevents_state, PPME_MESOS_E, SP_EVT_BUF_SIZE);
 	m_drop_event_flags = EF_NONE;
+	m_event_buffers_memory = 0;
 }
 
 sinsp_parser::~sinsp_parser()
@@ -75,11 +78,13 @@ sinsp_parser::~sinsp_parser()
 		delete m_protodecoders[j];
 	}
 
-	while(!m_tmp_events_buffer.empty())
+	for(auto& buffers : m_tmp_events_buffer)
 	{
-		auto ptr = m_tmp_events_buffer.top();
-		free(ptr);
-		m_tmp_events_buffer.pop();
+		while(!buffers.empty())
+		{
+			destroy_event_buffer(buffers.top());
+			buffers.pop();
+		}
 	}
 	m_protodecoders.clear();
 
@@ -90,6 +95,8 @@ sinsp_parser::~sinsp_parser()
 	{
 		delete m_inspector->m_partial_tracers_pool;
 	}
+
+	delete m_http_sessions;
 }
 
 void sinsp_parser::init_scapevt(metaevents_state& evt_state, uint16_t evt_type, uint16_t buf_size)
@@ -245,14 +252,14 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 		}
 
 		// FALLTHRU
+	//
+	// Only store the enter events whose parameters are read
+	// back when parsing the corresponding exit event
+	//
 	case PPME_SYSCALL_OPEN_E:
 	case PPME_SOCKET_SOCKET_E:
-	case PPME_SYSCALL_EVENTFD_E:
-	case PPME_SYSCALL_CHDIR_E:
-	case PPME_SYSCALL_FCHDIR_E:
 	case PPME_SYSCALL_CREAT_E:
 	case PPME_SYSCALL_OPENAT_E:
-	case PPME_SOCKET_SHUTDOWN_E:
 	case PPME_SYSCALL_GETRLIMIT_E:
 	case PPME_SYSCALL_SETRLIMIT_E:
 	case PPME_SYSCALL_PRLIMIT_E:
@@ -264,7 +271,6 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	case PPME_SYSCALL_SETGID_E:
 	case PPME_SYSCALL_EXECVE_18_E:
 	case PPME_SYSCALL_EXECVE_19_E:
-	case PPME_SYSCALL_SETPGID_E:
 		store_event(evt);
 		break;
 	case PPME_SYSCALL_WRITE_E:
@@ -437,6 +443,9 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	case PPME_CONTAINER_JSON_E:
 		parse_container_json_evt(evt);
 		break;
+	case PPME_CONTAINER_BIN_E:
+		parse_container_bin_evt(evt);
+		break;
 	case PPME_CPU_HOTPLUG_E:
 		parse_cpu_hotplug_enter(evt);
 		break;
@@ -544,7 +553,7 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 	// cleared in init(). So only keep the threadinfo for "live"
 	// containers.
 	//
-	if (m_inspector->is_live() && etype == PPME_CONTAINER_JSON_E && evt->m_tinfo_ref != nullptr)
+	if (m_inspector->is_live() && (etype == PPME_CONTAINER_JSON_E || etype == PPME_CONTAINER_BIN_E) && evt->m_tinfo_ref != nullptr)
 	{
 		// this is a synthetic event generated by the container manager
 		// the threadinfo should already be set properly
@@ -606,7 +615,7 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 		query_os = true;
 	}
 
-	if(etype == PPME_CONTAINER_JSON_E)
+	if(etype == PPME_CONTAINER_JSON_E || etype == PPME_CONTAINER_BIN_E)
 	{
 		evt->m_tinfo = nullptr;
 		return true;
@@ -714,11 +723,7 @@ bool sinsp_parser::reset(sinsp_evt *evt)
 			  evt->m_info->params[0].name[1] == 'd' &&
 			  evt->m_info->params[0].name[2] == '\0')))
 		{
-			sinsp_evt_param *parinfo;
-
-			parinfo = evt->get_param(0);
-			ASSERT(parinfo->m_len == sizeof(int64_t));
-			int64_t res = *(int64_t *)parinfo->m_val;
+			int64_t res = evt->get_syscall_return_value();
 
 			if(res < 0)
 			{
@@ -800,12 +805,20 @@ void sinsp_parser::store_event(sinsp_evt *evt)
 	}
 
 	//
-	// Copy the data
+	// Copy the data. The buffer is normally released when the exit event
+	// is parsed, but it can still be around if the exit was dropped: only
+	// reuse it if it's big enough.
 	//
 	auto tinfo = evt->m_tinfo;
+	if(tinfo->m_lastevent_data != NULL && event_buffer_size(tinfo->m_lastevent_data) < elen)
+	{
+		free_event_buffer(tinfo->m_lastevent_data);
+		tinfo->m_lastevent_data = NULL;
+	}
+
 	if(tinfo->m_lastevent_data == NULL)
 	{
-		tinfo->m_lastevent_data = reserve_event_buffer();
+		tinfo->m_lastevent_data = reserve_event_buffer(elen);
 	}
 	memcpy(tinfo->m_lastevent_data, evt->m_pevt, elen);
 	tinfo->m_lastevent_cpuid = evt->get_cpuid();
@@ -886,6 +899,17 @@ sinsp_protodecoder* sinsp_parser::add_protodecoder(string decoder_name)
 	return nd;
 }
 
+void sinsp_parser::set_http_listener(sinsp_http_listener* listener, uint32_t max_sessions)
+{
+	delete m_http_sessions;
+	m_http_sessions = NULL;
+
+	if(listener != NULL)
+	{
+		m_http_sessions = new sinsp_http_session_manager(listener, max_sessions);
+	}
+}
+
 void sinsp_parser::register_event_callback(sinsp_pd_callback_type etype, sinsp_protodecoder* dec)
 {
 	switch(etype)
@@ -923,9 +947,7 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 	//
 	// Validate the return value and get the child tid
 	//
-	parinfo = evt->get_param(0);
-	ASSERT(parinfo->m_len == sizeof(int64_t));
-	childtid = *(int64_t *)parinfo->m_val;
+	childtid = evt->get_syscall_return_value();
 
 	switch(evt->get_type())
 	{
@@ -1163,7 +1185,7 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		// Copy the full executable path from the parent
 		tinfo->m_exepath = ptinfo->m_exepath;
 
-		// Copy the command arguments from the parent
+		// Share the command arguments with the parent
 		tinfo->m_args = ptinfo->m_args;
 
 		// Copy the root from the parent
@@ -1505,6 +1527,10 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		case PPME_SYSCALL_VFORK_20_X:
 		case PPME_SYSCALL_CLONE_20_X:
 			parinfo = evt->get_param(14);
+			// Start from the parent's cgroups: if they didn't change
+			// set_cgroups() will keep sharing them instead of
+			// building a copy
+			tinfo->m_cgroups = ptinfo->m_cgroups;
 			tinfo->set_cgroups(parinfo->m_val, parinfo->m_len);
 			m_inspector->m_container_manager.resolve_container(tinfo, m_inspector->is_live());
 			break;
@@ -1559,9 +1585,7 @@ void sinsp_parser::parse_execve_exit(sinsp_evt *evt)
 	sinsp_evt *enter_evt = &m_tmp_evt;
 
 	// Validate the return value
-	parinfo = evt->get_param(0);
-	ASSERT(parinfo->m_len == sizeof(int64_t));
-	retval = *(int64_t *)parinfo->m_val;
+	retval = evt->get_syscall_return_value();
 
 	if(retval < 0)
 	{
@@ -2046,9 +2070,7 @@ void sinsp_parser::parse_open_openat_creat_exit(sinsp_evt *evt)
 	//
 	// Check the return value
 	//
-	parinfo = evt->get_param(0);
-	ASSERT(parinfo->m_len == sizeof(int64_t));
-	fd = *(int64_t *)parinfo->m_val;
+	fd = evt->get_syscall_return_value();
 
 	//
 	// Parse the parameters, based on the event type
@@ -2384,9 +2406,7 @@ void sinsp_parser::parse_socket_exit(sinsp_evt *evt)
 	// parameters in one scan. We don't care too much because we assume that we get here
 	// seldom enough that saving few tens of CPU cycles is not important.
 	//
-	parinfo = evt->get_param(0);
-	ASSERT(parinfo->m_len == sizeof(int64_t));
-	fd = *(int64_t *)parinfo->m_val;
+	fd = evt->get_syscall_return_value();
 
 	if(fd < 0)
 	{
@@ -2762,9 +2782,7 @@ void sinsp_parser::parse_accept_exit(sinsp_evt *evt)
 	//
 	// Extract the fd
 	//
-	parinfo = evt->get_param(0);
-	ASSERT(parinfo->m_len == sizeof(int64_t));
-	fd = *(int64_t *)parinfo->m_val;
+	fd = evt->get_syscall_return_value();
 
 	if(fd < 0)
 	{
@@ -2915,19 +2933,21 @@ void sinsp_parser::erase_fd(erase_fd_params* params)
 	{
 		m_fd_listener->on_erase_fd(params);
 	}
+
+	if(m_http_sessions && params->m_tinfo != NULL)
+	{
+		m_http_sessions->on_erase_fd(params->m_tinfo->m_pid, params->m_fd);
+	}
 }
 
 void sinsp_parser::parse_close_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t retval;
 
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	//
 	// If the close() was successful, do the cleanup
@@ -3022,9 +3042,7 @@ void sinsp_parser::parse_socketpair_exit(sinsp_evt *evt)
 	uint64_t source_address;
 	uint64_t peer_address;
 
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(retval < 0)
 	{
@@ -3071,9 +3089,7 @@ void sinsp_parser::parse_pipe_exit(sinsp_evt *evt)
 	int64_t retval;
 	uint64_t ino;
 
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(retval < 0)
 	{
@@ -3487,10 +3503,16 @@ bool sinsp_parser::detect_and_process_tracer_write(sinsp_evt *evt,
 {
 	//
 	// Tracers get into the engine as normal writes, but the FD has a flag to
-	// quickly recognize them.
+	// quickly recognize them. Most writes are on FDs that are neither, and
+	// leave with a single test.
 	//
 	uint32_t flags = evt->m_fdinfo->m_flags;
 
+	if((flags & (sinsp_fdinfo_t::FLAGS_IS_TRACER_FD | sinsp_fdinfo_t::FLAGS_IS_TRACER_FILE)) == 0)
+	{
+		return false;
+	}
+
 	if(!(flags & sinsp_fdinfo_t::FLAGS_IS_NOT_TRACER_FD))
 	{
 		sinsp_fdinfo_t* orifdinfo = evt->m_fdinfo;
@@ -3550,9 +3572,7 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	ASSERT(parinfo->m_len == sizeof(int64_t));
-	retval = *(int64_t *)parinfo->m_val;
+	retval = evt->get_syscall_return_value();
 
 	if(evt->m_fdinfo == NULL)
 	{
@@ -3683,6 +3703,15 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 					(*it)->on_read(evt, data, datalen);
 				}
 			}
+
+			//
+			// Pair the HTTP requests and responses going through the connection
+			//
+			if(m_http_sessions && evt->m_fdinfo->is_tcp_socket())
+			{
+				m_http_sessions->on_read(evt, evt->m_tinfo->m_pid, evt->m_tinfo->m_lastevent_fd,
+					data, (uint32_t)retval, datalen);
+			}
 		}
 		else
 		{
@@ -3771,6 +3800,15 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 					(*it)->on_write(evt, data, datalen);
 				}
 			}
+
+			//
+			// Pair the HTTP requests and responses going through the connection
+			//
+			if(m_http_sessions && evt->m_fdinfo->is_tcp_socket())
+			{
+				m_http_sessions->on_write(evt, evt->m_tinfo->m_pid, evt->m_tinfo->m_lastevent_fd,
+					data, (uint32_t)retval, datalen);
+			}
 		}
 	} else if (m_track_connection_status) {
 		if (evt->m_fdinfo->m_type == SCAP_FD_IPV4_SOCK ||
@@ -3797,9 +3835,7 @@ void sinsp_parser::parse_sendfile_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	ASSERT(parinfo->m_len == sizeof(int64_t));
-	retval = *(int64_t *)parinfo->m_val;
+	retval = evt->get_syscall_return_value();
 
 	//
 	// If the operation was successful, validate that the fd exists
@@ -3833,7 +3869,6 @@ void sinsp_parser::parse_sendfile_exit(sinsp_evt *evt)
 
 void sinsp_parser::parse_eventfd_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t fd;
 	sinsp_fdinfo_t fdi;
 
@@ -3846,9 +3881,7 @@ void sinsp_parser::parse_eventfd_exit(sinsp_evt *evt)
 		return;
 	}
 
-	parinfo = evt->get_param(0);
-	ASSERT(parinfo->m_len == sizeof(int64_t));
-	fd = *(int64_t *)parinfo->m_val;
+	fd = evt->get_syscall_return_value();
 
 	if(fd < 0)
 	{
@@ -3902,15 +3935,12 @@ void sinsp_parser::parse_chdir_exit(sinsp_evt *evt)
 
 void sinsp_parser::parse_fchdir_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t retval;
 
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	//
 	// In case of success, update the thread working dir
@@ -3939,9 +3969,7 @@ void sinsp_parser::parse_getcwd_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	//
 	// Check if the syscall was successful
@@ -4002,15 +4030,12 @@ void sinsp_parser::parse_getcwd_exit(sinsp_evt *evt)
 
 void sinsp_parser::parse_shutdown_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t retval;
 
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	ASSERT(parinfo->m_len == sizeof(int64_t));
-	retval = *(int64_t *)parinfo->m_val;
+	retval = evt->get_syscall_return_value();
 
 	//
 	// If the operation was successful, do the cleanup
@@ -4031,7 +4056,6 @@ void sinsp_parser::parse_shutdown_exit(sinsp_evt *evt)
 
 void sinsp_parser::parse_dup_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t retval;
 
 	if(evt->m_tinfo == nullptr)
@@ -4042,9 +4066,7 @@ void sinsp_parser::parse_dup_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	//
 	// Check if the syscall was successful
@@ -4095,15 +4117,12 @@ void sinsp_parser::parse_dup_exit(sinsp_evt *evt)
 
 void sinsp_parser::parse_signalfd_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t retval;
 
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(evt->m_tinfo == nullptr)
 	{
@@ -4132,15 +4151,12 @@ void sinsp_parser::parse_signalfd_exit(sinsp_evt *evt)
 
 void sinsp_parser::parse_timerfd_create_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t retval;
 
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(evt->m_tinfo == nullptr)
 	{
@@ -4169,15 +4185,12 @@ void sinsp_parser::parse_timerfd_create_exit(sinsp_evt *evt)
 
 void sinsp_parser::parse_inotify_init_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t retval;
 
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(evt->m_tinfo == nullptr)
 	{
@@ -4220,9 +4233,7 @@ void sinsp_parser::parse_getrlimit_setrlimit_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	//
 	// Check if the syscall was successful
@@ -4287,9 +4298,7 @@ void sinsp_parser::parse_prlimit_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	//
 	// Check if the syscall was successful
@@ -4360,7 +4369,7 @@ void sinsp_parser::parse_select_poll_epollwait_enter(sinsp_evt *evt)
 
 	if(evt->m_tinfo->m_lastevent_data == NULL)
 	{
-		evt->m_tinfo->m_lastevent_data = reserve_event_buffer();
+		evt->m_tinfo->m_lastevent_data = reserve_event_buffer(sizeof(uint64_t));
 	}
 	*(uint64_t*)evt->m_tinfo->m_lastevent_data = evt->get_ts();
 }
@@ -4383,16 +4392,13 @@ void sinsp_parser::parse_fcntl_enter(sinsp_evt *evt)
 
 void sinsp_parser::parse_fcntl_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t retval;
 	sinsp_evt *enter_evt = &m_tmp_evt;
 
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	//
 	// If this is not a F_DUPFD or F_DUPFD_CLOEXEC command, ignore it
@@ -4482,9 +4488,7 @@ void sinsp_parser::parse_setresuid_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(retval >= 0 && retrieve_enter_event(enter_evt, evt))
 	{
@@ -4510,9 +4514,7 @@ void sinsp_parser::parse_setresgid_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(retval >= 0 && retrieve_enter_event(enter_evt, evt))
 	{
@@ -4538,9 +4540,7 @@ void sinsp_parser::parse_setuid_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(retval >= 0 && retrieve_enter_event(enter_evt, evt))
 	{
@@ -4562,9 +4562,7 @@ void sinsp_parser::parse_setgid_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(retval >= 0 && retrieve_enter_event(enter_evt, evt))
 	{
@@ -4624,10 +4622,12 @@ namespace
 	}
 }
 
-void sinsp_parser::parse_container_json_evt(sinsp_evt *evt)
+//
+// Return true (and filter the event out) if the container event is about
+// a container we already have complete metadata for
+//
+bool sinsp_parser::skip_container_evt(sinsp_evt *evt)
 {
-	ASSERT(m_inspector);
-
 	if(evt->m_tinfo_ref != nullptr)
 	{
 		const auto& container_id = evt->m_tinfo_ref->m_container_id;
@@ -4636,10 +4636,78 @@ void sinsp_parser::parse_container_json_evt(sinsp_evt *evt)
 		{
 			SINSP_DEBUG("Ignoring container event for already successful lookup of %s", container_id.c_str());
 			evt->m_filtered_out = true;
-			return;
+			return true;
 		}
 	}
 
+	return false;
+}
+
+//
+// Common tail of the container event parsers: sanitize the decoded
+// metadata and store it in the container manager
+//
+void sinsp_parser::add_container_from_evt(sinsp_evt *evt, const std::shared_ptr<sinsp_container_info>& container_info)
+{
+	switch(container_info->m_lookup_state)
+	{
+	case sinsp_container_lookup_state::STARTED:
+	case sinsp_container_lookup_state::SUCCESSFUL:
+	case sinsp_container_lookup_state::FAILED:
+		break;
+	default:
+		container_info->m_lookup_state = sinsp_container_lookup_state::SUCCESSFUL;
+	}
+
+	// state == STARTED doesn't make sense in a scap file
+	// as there's no actual lookup that would ever finish
+	if(!evt->m_tinfo_ref && container_info->m_lookup_state == sinsp_container_lookup_state::STARTED)
+	{
+		SINSP_DEBUG("Rewriting lookup_state = STARTED from scap file to FAILED for container %s",
+			container_info->m_id.c_str());
+		container_info->m_lookup_state = sinsp_container_lookup_state::FAILED;
+	}
+
+	if(!container_info->is_successful())
+	{
+		SINSP_DEBUG("Filtering container event for failed lookup of %s (but calling callbacks anyway)", container_info->m_id.c_str());
+		evt->m_filtered_out = true;
+	}
+	evt->m_tinfo_ref = container_info->get_tinfo(m_inspector);
+	evt->m_tinfo = evt->m_tinfo_ref.get();
+	m_inspector->m_container_manager.add_container(container_info, evt->get_thread_info(true));
+}
+
+void sinsp_parser::parse_container_bin_evt(sinsp_evt *evt)
+{
+	ASSERT(m_inspector);
+
+	if(skip_container_evt(evt))
+	{
+		return;
+	}
+
+	sinsp_evt_param *parinfo = evt->get_param(0);
+	ASSERT(parinfo);
+
+	auto container_info = std::make_shared<sinsp_container_info>();
+	if(!container_info->from_binary(parinfo->m_val, parinfo->m_len))
+	{
+		throw sinsp_exception("Invalid binary container info encountered while parsing container event");
+	}
+
+	add_container_from_evt(evt, container_info);
+}
+
+void sinsp_parser::parse_container_json_evt(sinsp_evt *evt)
+{
+	ASSERT(m_inspector);
+
+	if(skip_container_evt(evt))
+	{
+		return;
+	}
+
 	sinsp_evt_param *parinfo = evt->get_param(0);
 	ASSERT(parinfo);
 	ASSERT(parinfo->m_len > 0);
@@ -4711,24 +4779,6 @@ void sinsp_parser::parse_container_json_evt(sinsp_evt *evt)
 		if(check_json_val_is_convertible(lookup_state, Json::uintValue, "lookup_state"))
 		{
 			container_info->m_lookup_state = static_cast<sinsp_container_lookup_state>(lookup_state.asUInt());
-			switch(container_info->m_lookup_state)
-			{
-			case sinsp_container_lookup_state::STARTED:
-			case sinsp_container_lookup_state::SUCCESSFUL:
-			case sinsp_container_lookup_state::FAILED:
-				break;
-			default:
-				container_info->m_lookup_state = sinsp_container_lookup_state::SUCCESSFUL;
-			}
-
-			// state == STARTED doesn't make sense in a scap file
-			// as there's no actual lookup that would ever finish
-			if(!evt->m_tinfo_ref && container_info->m_lookup_state == sinsp_container_lookup_state::STARTED)
-			{
-				SINSP_DEBUG("Rewriting lookup_state = STARTED from scap file to FAILED for container %s",
-					container_info->m_id.c_str());
-				container_info->m_lookup_state = sinsp_container_lookup_state::FAILED;
-			}
 		}
 
 		const Json::Value& created_time = container["created_time"];
@@ -4858,14 +4908,7 @@ void sinsp_parser::parse_container_json_evt(sinsp_evt *evt)
 			}
 		}
 
-		if(!container_info->is_successful())
-		{
-			SINSP_DEBUG("Filtering container event for failed lookup of %s (but calling callbacks anyway)", container_info->m_id.c_str());
-			evt->m_filtered_out = true;
-		}
-		evt->m_tinfo_ref = container_info->get_tinfo(m_inspector);
-		evt->m_tinfo = evt->m_tinfo_ref.get();
-		m_inspector->m_container_manager.add_container(container_info, evt->get_thread_info(true));
+		add_container_from_evt(evt, container_info);
 		/*
 		SINSP_STR_DEBUG("Container\n-------\nID:" + container_info.m_id +
 		                "\nType: " + std::to_string(container_info.m_type) +
@@ -4914,20 +4957,76 @@ void sinsp_parser::parse_cpu_hotplug_enter(sinsp_evt *evt)
 	}
 }
 
-uint8_t* sinsp_parser::reserve_event_buffer()
+//
+// Every enter event buffer is preceded by a small header holding its
+// size class, so that it can be returned to the right LIFO
+//
+static const uint32_t s_event_buffer_sizes[SP_EVT_BUF_NUM_CLASSES] =
+{
+	SP_EVT_BUF_SMALL_SIZE,
+	SP_EVT_BUF_MEDIUM_SIZE,
+	SP_EVT_BUF_SIZE
+};
+
+static const size_t EVENT_BUFFER_HEADER_SIZE = sizeof(uint64_t);
+
+static inline uint32_t event_buffer_class(uint32_t size)
+{
+	uint32_t j;
+
+	for(j = 0; j < SP_EVT_BUF_NUM_CLASSES - 1; j++)
+	{
+		if(size <= s_event_buffer_sizes[j])
+		{
+			break;
+		}
+	}
+
+	return j;
+}
+
+static inline uint64_t& event_buffer_header(uint8_t* ptr)
+{
+	return *(uint64_t*)(ptr - EVENT_BUFFER_HEADER_SIZE);
+}
+
+uint32_t sinsp_parser::event_buffer_size(uint8_t* ptr)
+{
+	return s_event_buffer_sizes[event_buffer_header(ptr)];
+}
+
+uint8_t* sinsp_parser::reserve_event_buffer(uint32_t size)
 {
-	if(m_tmp_events_buffer.empty())
+	ASSERT(size <= SP_EVT_BUF_SIZE);
+	uint32_t cls = event_buffer_class(size);
+	auto& buffers = m_tmp_events_buffer[cls];
+
+	if(buffers.empty())
 	{
-		return (uint8_t*)malloc(sizeof(uint8_t)*SP_EVT_BUF_SIZE);
+		uint8_t* base = (uint8_t*)malloc(EVENT_BUFFER_HEADER_SIZE + s_event_buffer_sizes[cls]);
+		if(base == NULL)
+		{
+			throw sinsp_exception("cannot allocate enter event buffer");
+		}
+
+		m_event_buffers_memory += EVENT_BUFFER_HEADER_SIZE + s_event_buffer_sizes[cls];
+		uint8_t* ptr = base + EVENT_BUFFER_HEADER_SIZE;
+		event_buffer_header(ptr) = cls;
+		return ptr;
 	}
 	else
 	{
-		auto ptr = m_tmp_events_buffer.top();
-		m_tmp_events_buffer.pop();
+		auto ptr = buffers.top();
+		buffers.pop();
 		return ptr;
 	}
 }
 
+void sinsp_parser::destroy_event_buffer(uint8_t* ptr)
+{
+	free(ptr - EVENT_BUFFER_HEADER_SIZE);
+}
+
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 int sinsp_parser::get_k8s_version(const std::string& json)
 {
@@ -5032,15 +5131,12 @@ void sinsp_parser::parse_chroot_exit(sinsp_evt *evt)
 
 void sinsp_parser::parse_setsid_exit(sinsp_evt *evt)
 {
-	sinsp_evt_param *parinfo;
 	int64_t retval;
 
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(retval >= 0)
 	{
@@ -5083,9 +5179,7 @@ void sinsp_parser::parse_getsockopt_exit(sinsp_evt *evt)
 	//
 	// Extract the return value
 	//
-	parinfo = evt->get_param(0);
-	retval = *(int64_t *)parinfo->m_val;
-	ASSERT(parinfo->m_len == sizeof(int64_t));
+	retval = evt->get_syscall_return_value();
 
 	if(retval < 0)
 	{
@@ -5130,12 +5224,20 @@ void sinsp_parser::parse_getsockopt_exit(sinsp_evt *evt)
 
 void sinsp_parser::free_event_buffer(uint8_t *ptr)
 {
-	if(m_tmp_events_buffer.size() < m_inspector->m_thread_manager->m_threadtable.size())
+	auto& buffers = m_tmp_events_buffer[event_buffer_header(ptr)];
+
+	if(buffers.size() < m_inspector->m_thread_manager->m_threadtable.size())
 	{
-		m_tmp_events_buffer.push(ptr);
+		buffers.push(ptr);
 	}
 	else
 	{
-		free(ptr);
+		release_event_buffer(ptr);
 	}
 }
+
+void sinsp_parser::release_event_buffer(uint8_t *ptr)
+{
+	m_event_buffers_memory -= EVENT_BUFFER_HEADER_SIZE + event_buffer_size(ptr);
+	destroy_event_buffer(ptr);
+}
@@ -22,6 +22,8 @@ limitations under the License.
 #include "sinsp.h"
 
 class sinsp_fd_listener;
+class sinsp_http_listener;
+class sinsp_http_session_manager;
 
 class metaevents_state
 {
@@ -52,6 +54,27 @@ public:
 	//
 	bool retrieve_enter_event(sinsp_evt* enter_evt, sinsp_evt* exit_evt);
 
+	//
+	// Total memory currently allocated to store enter events,
+	// including the recycled buffers
+	//
+	uint64_t get_event_buffers_memory() const
+	{
+		return m_event_buffers_memory;
+	}
+
+	//
+	// Release a buffer returned by reserve_event_buffer() without
+	// recycling it
+	//
+	static void destroy_event_buffer(uint8_t* ptr);
+
+	//
+	// Same as destroy_event_buffer(), also taking the buffer out of
+	// get_event_buffers_memory()
+	//
+	void release_event_buffer(uint8_t* ptr);
+
 	//
 	// Combine the openat arguments into a full file name
 	//
@@ -63,6 +86,15 @@ public:
 	sinsp_protodecoder* add_protodecoder(string decoder_name);
 	void register_event_callback(sinsp_pd_callback_type etype, sinsp_protodecoder* dec);
 
+	//
+	// HTTP request reconstruction, see sinsp::set_http_listener()
+	//
+	void set_http_listener(sinsp_http_listener* listener, uint32_t max_sessions);
+	const sinsp_http_session_manager* get_http_sessions() const
+	{
+		return m_http_sessions;
+	}
+
 	void schedule_k8s_events();
 	void schedule_mesos_events();
 
@@ -133,6 +165,9 @@ private:
 	void parse_setgid_exit(sinsp_evt* evt);
 	void parse_container_evt(sinsp_evt* evt); // deprecated, only for backward-compatibility
 	void parse_container_json_evt(sinsp_evt *evt);
+	void parse_container_bin_evt(sinsp_evt *evt);
+	bool skip_container_evt(sinsp_evt *evt);
+	void add_container_from_evt(sinsp_evt *evt, const std::shared_ptr<sinsp_container_info>& container_info);
 	inline uint32_t parse_tracer(sinsp_evt *evt, int64_t retval);
 	void parse_cpu_hotplug_enter(sinsp_evt* evt);
 	int get_k8s_version(const std::string& json);
@@ -158,8 +193,9 @@ private:
 	bool set_unix_info(sinsp_fdinfo_t* fdinfo, uint8_t* packed_data);
 
 	void swap_addresses(sinsp_fdinfo_t* fdinfo);
-	uint8_t* reserve_event_buffer();
+	uint8_t* reserve_event_buffer(uint32_t size);
 	void free_event_buffer(uint8_t*);
+	static uint32_t event_buffer_size(uint8_t* ptr);
 
 	//
 	// Pointers to inspector context
@@ -179,6 +215,9 @@ private:
 	// FD listener callback
 	sinsp_fd_listener* m_fd_listener;
 
+	// HTTP request reconstruction, NULL when off
+	sinsp_http_session_manager* m_http_sessions;
+
 	//
 	// The protocol decoders allocated by this parser
 	//
@@ -188,10 +227,15 @@ private:
 	int              m_k8s_capture_version = -1;
 	metaevents_state m_mesos_metaevents_state;
 
-	stack<uint8_t*> m_tmp_events_buffer;
+	//
+	// Recycled enter event buffers, one LIFO per size class
+	//
+	stack<uint8_t*> m_tmp_events_buffer[SP_EVT_BUF_NUM_CLASSES];
+	uint64_t m_event_buffers_memory;
 	friend class sinsp_analyzer;
 	friend class sinsp_analyzer_fd_listener;
 	friend class sinsp_protodecoder;
 	friend class sinsp_baseliner;
 	friend class sinsp_container_manager;
+	friend class sinsp_thread_manager;
 };
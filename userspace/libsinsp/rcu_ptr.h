@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace libsinsp {
+
+/**
+ * \brief A read-copy-update wrapper around an immutable value of type T
+ *
+ * @tparam T type of the published value (must be copyable)
+ *
+ * Readers get a `std::shared_ptr<const T>` snapshot of the current value
+ * and never block writers (or each other): the snapshot stays valid and
+ * unchanged for as long as the reader holds on to it, even if a newer
+ * version gets published in the meantime. Old versions are freed when
+ * their last reader drops them.
+ *
+ * Writers copy the current value, modify the copy and publish it, so
+ * a writer that needs to change several entries should do it within
+ * a single update() call to pay for a single copy.
+ *
+ * Every publication gets a process-wide unique epoch number. A reading
+ * thread remembers the last snapshot it loaded together with its epoch
+ * and, as long as the epoch did not change, read() only costs an atomic
+ * load and a reference count increment, without taking any lock.
+ * The cache has a single slot per thread (and per T), so a thread
+ * alternating between two rcu_ptr<T> instances falls back to the
+ * (still correct, but slower) std::atomic_load of the snapshot.
+ */
+template<typename T>
+class rcu_ptr {
+public:
+	typedef std::shared_ptr<const T> snapshot_t;
+
+	rcu_ptr() : rcu_ptr(T())
+	{
+	}
+
+	explicit rcu_ptr(T inner) :
+		m_current(std::make_shared<const T>(std::move(inner))),
+		m_epoch(next_epoch())
+	{
+	}
+
+	rcu_ptr(const rcu_ptr&) = delete;
+	rcu_ptr& operator=(const rcu_ptr&) = delete;
+
+	/**
+	 * \brief Get a snapshot of the current value
+	 *
+	 * The returned pointer is never null
+	 */
+	snapshot_t read() const
+	{
+		reader_cache& cache = thread_cache();
+		uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+
+		if(cache.m_epoch != epoch)
+		{
+			// the value is published before the epoch, so the snapshot
+			// we load now is at least as new as `epoch`. If it's even newer,
+			// the next read() will just load it again
+			cache.m_snapshot = std::atomic_load(&m_current);
+			cache.m_epoch = epoch;
+		}
+
+		return cache.m_snapshot;
+	}
+
+	/**
+	 * \brief Publish a modified copy of the current value
+	 *
+	 * @param fn a callable taking a `T&`, applied to a private copy
+	 * of the current value before it's published
+	 *
+	 * Concurrent writers are serialized, so no update is ever lost
+	 */
+	template<typename F>
+	void update(F fn)
+	{
+		std::lock_guard<std::mutex> lock(m_write_lock);
+
+		std::shared_ptr<T> next = std::make_shared<T>(*std::atomic_load(&m_current));
+		fn(*next);
+
+		std::atomic_store(&m_current, snapshot_t(std::move(next)));
+		m_epoch.store(next_epoch(), std::memory_order_release);
+	}
+
+private:
+	struct reader_cache {
+		uint64_t m_epoch = 0;
+		snapshot_t m_snapshot;
+	};
+
+	static reader_cache& thread_cache()
+	{
+		// one slot per thread and per T: epochs are unique across all
+		// the rcu_ptr<T> instances, so a stale slot never matches
+		static thread_local reader_cache cache;
+		return cache;
+	}
+
+	static uint64_t next_epoch()
+	{
+		static std::atomic<uint64_t> s_epoch(0);
+		return ++s_epoch;
+	}
+
+	std::mutex m_write_lock;
+	snapshot_t m_current;
+	std::atomic<uint64_t> m_epoch;
+};
+}
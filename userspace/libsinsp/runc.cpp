@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "runc.h"
 
+#include <cctype>
 #include <cstring>
 
 #include "sinsp.h"
@@ -93,5 +94,111 @@ bool matches_runc_cgroups(const sinsp_threadinfo *tinfo, const cgroup_layout *la
 
 	return false;
 }
+
+cgroup_matcher::cgroup_matcher(const cgroup_layout *layout, size_t max_cache_entries):
+	m_max_cache_entries(max_cache_entries)
+{
+	for(size_t i = 0; layout[i].prefix && layout[i].suffix; ++i)
+	{
+		size_t suffix_idx = 0;
+		while(suffix_idx < m_suffixes.size() && m_suffixes[suffix_idx] != layout[i].suffix)
+		{
+			++suffix_idx;
+		}
+
+		if(suffix_idx == m_suffixes.size())
+		{
+			m_suffixes.emplace_back(layout[i].suffix);
+		}
+
+		m_patterns.push_back({layout[i].prefix, suffix_idx});
+	}
+}
+
+bool cgroup_matcher::match_uncached(const std::string &cgroup, std::string &container_id) const
+{
+	// where the container id starts for each suffix, npos if there
+	// are no 64 hex digits right before the suffix
+	std::vector<size_t> id_start(m_suffixes.size(), std::string::npos);
+
+	for(size_t i = 0; i < m_suffixes.size(); ++i)
+	{
+		size_t end_pos = cgroup.rfind(m_suffixes[i]);
+		if(end_pos == std::string::npos || end_pos < CONTAINER_ID_LENGTH)
+		{
+			continue;
+		}
+
+		size_t start_pos = end_pos - CONTAINER_ID_LENGTH;
+		bool valid = true;
+		for(size_t j = start_pos; j < end_pos; ++j)
+		{
+			if(!isxdigit((unsigned char)cgroup[j]))
+			{
+				valid = false;
+				break;
+			}
+		}
+
+		if(valid)
+		{
+			id_start[i] = start_pos;
+		}
+	}
+
+	for(const auto &pattern : m_patterns)
+	{
+		size_t start_pos = id_start[pattern.suffix_idx];
+		if(start_pos == std::string::npos || start_pos < pattern.prefix.size())
+		{
+			continue;
+		}
+
+		if(cgroup.compare(start_pos - pattern.prefix.size(), pattern.prefix.size(), pattern.prefix) == 0)
+		{
+			container_id = cgroup.substr(start_pos, REPORTED_CONTAINER_ID_LENGTH);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool cgroup_matcher::match(const std::string &cgroup, std::string &container_id)
+{
+	auto it = m_cache.find(cgroup);
+	if(it == m_cache.end())
+	{
+		if(m_cache.size() >= m_max_cache_entries)
+		{
+			m_cache.clear();
+		}
+
+		std::string id;
+		match_uncached(cgroup, id);
+		it = m_cache.emplace(cgroup, std::move(id)).first;
+	}
+
+	if(it->second.empty())
+	{
+		return false;
+	}
+
+	container_id = it->second;
+	return true;
+}
+
+bool cgroup_matcher::match(const sinsp_threadinfo *tinfo, std::string &container_id)
+{
+	for(const auto &it : tinfo->m_cgroups)
+	{
+		if(match(it.second, container_id))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
 }
 }
\ No newline at end of file
@@ -18,6 +18,8 @@ limitations under the License.
 #pragma once
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 class sinsp_threadinfo;
 
@@ -79,5 +81,64 @@ bool match_container_id(const std::string &cgroup, const libsinsp::runc::cgroup_
  * unchanged.
  */
 bool matches_runc_cgroups(const sinsp_threadinfo *tinfo, const cgroup_layout *layout, std::string &container_id);
+
+/**
+ * @brief A precompiled list of cgroup layouts, with a per-cgroup result cache
+ *
+ * Matches the same patterns as `match_container_id()`, but in a single
+ * pass over the cgroup path: every distinct suffix is located once,
+ * the 64 hex digits preceding it are validated once and only then the
+ * prefixes are compared, in layout order.
+ *
+ * Since all the threads of a container share the same cgroups, results
+ * (including misses) are cached per cgroup path. The cache is dropped
+ * as a whole once it grows past `max_cache_entries`.
+ *
+ * The matcher is not thread-safe: each container engine owns one
+ * and only uses it from the event processing thread.
+ */
+class cgroup_matcher {
+public:
+	static const size_t DEFAULT_MAX_CACHE_ENTRIES = 1024;
+
+	/**
+	 * @param layout an array of (prefix, suffix) pairs, terminated
+	 *   by a pair of null pointers
+	 */
+	explicit cgroup_matcher(const cgroup_layout *layout, size_t max_cache_entries = DEFAULT_MAX_CACHE_ENTRIES);
+
+	/**
+	 * @brief Match `cgroup` against the compiled layouts
+	 * @return true if `cgroup` matches any of the layouts
+	 *
+	 * On a match, `container_id` is set to the truncated container id,
+	 * otherwise it remains unchanged.
+	 */
+	bool match(const std::string &cgroup, std::string &container_id);
+
+	/**
+	 * @brief Match all the cgroups of `tinfo`, like `matches_runc_cgroups()`
+	 */
+	bool match(const sinsp_threadinfo *tinfo, std::string &container_id);
+
+	size_t cache_size() const
+	{
+		return m_cache.size();
+	}
+
+private:
+	struct pattern {
+		std::string prefix;
+		size_t suffix_idx;
+	};
+
+	bool match_uncached(const std::string &cgroup, std::string &container_id) const;
+
+	std::vector<std::string> m_suffixes;
+	std::vector<pattern> m_patterns;
+	size_t m_max_cache_entries;
+	// cgroup path -> container id, empty if the path does not match
+	std::unordered_map<std::string, std::string> m_cache;
+};
 }
 }
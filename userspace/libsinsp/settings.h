@@ -28,6 +28,14 @@ limitations under the License.
 //
 #define SP_EVT_BUF_SIZE 4096
 
+//
+// Stored enter events are kept in size-classed buffers, so that the
+// (very common) small events don't take a full SP_EVT_BUF_SIZE buffer.
+//
+#define SP_EVT_BUF_SMALL_SIZE 128
+#define SP_EVT_BUF_MEDIUM_SIZE 512
+#define SP_EVT_BUF_NUM_CLASSES 3
+
 //
 // If defined, the filtering system is compiled
 //
@@ -60,6 +68,12 @@ limitations under the License.
 //
 #define DEFAULT_INACTIVE_CONTAINER_SCAN_TIME_S 30
 
+//
+// Max number of container events waiting to be returned by sinsp::next().
+// Past it, new events are dropped
+//
+#define MAX_PENDING_CONTAINER_EVTS 4096
+
 //
 // Default snaplen
 //
@@ -68,6 +68,9 @@ sinsp::sinsp(bool static_container, const std::string static_id, const std::stri
 	m_evt(this),
 	m_lastevent_ts(0),
 	m_container_manager(this, static_container, static_id, static_name, static_image),
+#ifndef _WIN32
+	m_pending_container_evts(MAX_PENDING_CONTAINER_EVTS),
+#endif
 	m_suppressed_comms()
 {
 #if !defined(MINIMAL_BUILD) && !defined(CYGWING_AGENT) && defined(HAS_CAPTURE)
@@ -346,7 +349,9 @@ void sinsp::init()
 
 			if(res == SCAP_SUCCESS)
 			{
-				if((pevent->type != PPME_CONTAINER_E) && (pevent->type != PPME_CONTAINER_JSON_E))
+				if((pevent->type != PPME_CONTAINER_E) &&
+				   (pevent->type != PPME_CONTAINER_JSON_E) &&
+				   (pevent->type != PPME_CONTAINER_BIN_E))
 				{
 					break;
 				}
@@ -494,8 +499,14 @@ void sinsp::open_live_common(uint32_t timeout_ms, scap_mode_t mode)
 
 	add_suppressed_comms(oargs);
 
+	//
+	// The proc scan resolves the containers of the threads it finds,
+	// publish them all at once
+	//
 	int32_t scap_rc;
+	m_container_manager.begin_batch();
 	m_h = scap_open(oargs, error, &scap_rc);
+	m_container_manager.end_batch();
 
 	if(m_h == NULL)
 	{
@@ -548,8 +559,14 @@ void sinsp::open_nodriver()
 	oargs.proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs.proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
 
+	//
+	// The proc scan resolves the containers of the threads it finds,
+	// publish them all at once
+	//
 	int32_t scap_rc;
+	m_container_manager.begin_batch();
 	m_h = scap_open(oargs, error, &scap_rc);
+	m_container_manager.end_batch();
 
 	if(m_h == NULL)
 	{
@@ -925,12 +942,14 @@ void sinsp::import_thread_table()
 	//
 	// Scan the scap table and add the threads to our list
 	//
+	m_container_manager.begin_batch();
 	HASH_ITER(hh, table, pi, tpi)
 	{
 		sinsp_threadinfo* newti = build_threadinfo();
 		newti->init(pi);
 		m_thread_manager->add_thread(newti, true);
 	}
+	m_container_manager.end_batch();
 }
 
 void sinsp::import_ifaddr_list()
@@ -1144,7 +1163,7 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		}
 	}
 #ifndef _WIN32
-	else if (m_pending_container_evts.try_pop(m_container_evt))
+	else if (m_pending_container_evts.pop(m_container_evt))
 	{
 		res = SCAP_SUCCESS;
 		evt = m_container_evt.get();
@@ -1209,7 +1228,9 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 
 	uint64_t ts = evt->get_ts();
 
-	if(m_firstevent_ts == 0 && evt->m_pevt->type != PPME_CONTAINER_JSON_E)
+	if(m_firstevent_ts == 0 &&
+	   evt->m_pevt->type != PPME_CONTAINER_JSON_E &&
+	   evt->m_pevt->type != PPME_CONTAINER_BIN_E)
 	{
 		m_firstevent_ts = ts;
 	}
@@ -1530,6 +1551,16 @@ void sinsp::set_query_docker_image_info(bool query_image_info)
 	m_container_manager.set_query_docker_image_info(query_image_info);
 }
 
+void sinsp::set_docker_max_concurrent_lookups(uint32_t max_lookups)
+{
+	m_container_manager.set_docker_max_concurrent_lookups(max_lookups);
+}
+
+void sinsp::set_docker_event_stream(bool enabled)
+{
+	m_container_manager.set_docker_event_stream(enabled);
+}
+
 void sinsp::set_cri_extra_queries(bool extra_queries)
 {
 	m_container_manager.set_cri_extra_queries(extra_queries);
@@ -1555,11 +1586,26 @@ void sinsp::set_cri_delay(uint64_t delay_ms)
 	m_container_manager.set_cri_delay(delay_ms);
 }
 
+void sinsp::set_cri_max_concurrent_lookups(uint32_t max_lookups)
+{
+	m_container_manager.set_cri_max_concurrent_lookups(max_lookups);
+}
+
 void sinsp::set_container_labels_max_len(uint32_t max_label_len)
 {
 	m_container_manager.set_container_labels_max_len(max_label_len);
 }
 
+void sinsp::set_binary_container_events(bool binary)
+{
+	m_container_manager.set_binary_container_events(binary);
+}
+
+void sinsp::set_container_cache_file(const std::string& path)
+{
+	m_container_manager.set_container_cache_file(path);
+}
+
 void sinsp::set_snaplen(uint32_t snaplen)
 {
 	//
@@ -1827,6 +1873,11 @@ sinsp_stats sinsp::get_stats()
 		m_thread_manager->update_statistics();
 	}
 
+	if(m_parser)
+	{
+		m_stats.m_stored_evts_memory = m_parser->get_event_buffers_memory();
+	}
+
 	//
 	// Return the result
 	//
@@ -1922,6 +1973,16 @@ sinsp_protodecoder* sinsp::require_protodecoder(string decoder_name)
 	return m_parser->add_protodecoder(decoder_name);
 }
 
+void sinsp::set_http_listener(sinsp_http_listener* listener, uint32_t max_sessions)
+{
+	m_parser->set_http_listener(listener, max_sessions);
+}
+
+const sinsp_http_session_manager* sinsp::get_http_sessions() const
+{
+	return m_parser->get_http_sessions();
+}
+
 void sinsp::clear_eventmask()
 {
 	if (scap_clear_eventmask(m_h) != SCAP_SUCCESS)
@@ -2431,9 +2492,125 @@ void sinsp::set_proc_scan_log_interval_ms(uint64_t val)
 ///////////////////////////////////////////////////////////////////////////////
 // Note: this is defined here so we can inline it in sinso::next
 ///////////////////////////////////////////////////////////////////////////////
+//
+// Erase the fds of an expired main thread, at most *budget of them.
+// Returns true when the fd table is empty and the thread can go.
+//
+bool sinsp_thread_manager::expire_fds(sinsp_threadinfo* tinfo, uint32_t* budget)
+{
+	sinsp_fdtable* fdtable = tinfo->get_fd_table();
+	if(fdtable == NULL)
+	{
+		return true;
+	}
+
+	erase_fd_params eparams;
+	eparams.m_remove_from_table = false;
+	eparams.m_tinfo = tinfo;
+	eparams.m_ts = m_inspector->m_lastevent_ts;
+
+	while(!fdtable->m_table.empty())
+	{
+		if(*budget == 0)
+		{
+			return false;
+		}
+
+		auto fdit = fdtable->m_table.begin();
+		eparams.m_fd = fdit->first;
+		eparams.m_fdinfo = &(fdit->second);
+		m_inspector->m_parser->erase_fd(&eparams);
+		fdtable->erase(eparams.m_fd);
+		(*budget)--;
+	}
+
+	return true;
+}
+
 bool sinsp_thread_manager::remove_inactive_threads()
 {
 	bool res = false;
+	uint64_t now = m_inspector->m_lastevent_ts;
+	uint64_t timeout = m_inspector->m_thread_timeout_ns;
+	uint32_t fd_budget = m_max_expired_fds_per_event;
+
+	//
+	// Instead of periodically walking the whole table, look at the
+	// threads that have been queued for longer than the timeout, at
+	// most a few of them per event. The expiry list is ordered, so we
+	// can stop at the first thread that hasn't expired yet.
+	//
+	for(uint32_t j = 0; j < m_max_expiry_checks_per_event; j++)
+	{
+		sinsp_threadinfo* tinfo = m_threadtable.expiry_head();
+		if(tinfo == nullptr || now <= tinfo->m_expiry_ts + timeout)
+		{
+			break;
+		}
+
+		bool closed = (tinfo->m_flags & PPM_CL_CLOSED) != 0;
+
+		//
+		// A thread whose fds we already started to erase has been
+		// found dead by a previous event, don't check it again
+		//
+		if(tinfo->m_tid != m_expiring_tid)
+		{
+			m_expiring_tid = -1;
+
+			if(!closed && now <= tinfo->m_lastaccess_ts + timeout)
+			{
+				//
+				// The thread has been looked up since it was queued,
+				// check it again a timeout from now
+				//
+				m_threadtable.expiry_requeue(tinfo, now);
+				continue;
+			}
+
+			if(!closed && scap_is_thread_alive(m_inspector->m_h, tinfo->m_pid, tinfo->m_tid, tinfo->m_comm.c_str()))
+			{
+				m_threadtable.expiry_requeue(tinfo, now);
+				continue;
+			}
+		}
+
+		int64_t tid = tinfo->m_tid;
+
+		//
+		// Erasing the fds of a big process in one go is what made the
+		// periodic flush expensive, so spread it over the next events.
+		// This is only worth it if the thread is actually going away.
+		//
+		if(((tinfo->m_pid == tinfo->m_tid) || tinfo->m_flags & PPM_CL_IS_MAIN_THREAD) &&
+		   (closed || tinfo->m_nchilds == 0) &&
+		   !expire_fds(tinfo, &fd_budget))
+		{
+			m_expiring_tid = tid;
+			break;
+		}
+
+		m_expiring_tid = -1;
+
+		//
+		// Reset the cache
+		//
+		m_last_tid = 0;
+		m_last_tinfo.reset();
+
+		remove_thread(tid, closed);
+
+		//
+		// The thread is still referenced by its children, keep it
+		// queued and remember to rebalance the dependency tree
+		//
+		tinfo = m_threadtable.get(tid);
+		if(tinfo != nullptr)
+		{
+			m_threadtable.expiry_requeue(tinfo, now);
+			m_child_dependencies_dirty = true;
+		}
+	}
 
 	if(m_last_flush_time_ns == 0)
 	{
@@ -2456,49 +2633,36 @@ bool sinsp_thread_manager::remove_inactive_threads()
 	if(m_inspector->m_lastevent_ts >
 		m_last_flush_time_ns + m_inspector->m_inactive_thread_scan_time_ns)
 	{
-		std::unordered_map<uint64_t, bool> to_delete;
-
 		res = true;
 
 		m_last_flush_time_ns = m_inspector->m_lastevent_ts;
 
-		g_logger.format(sinsp_logger::SEV_INFO, "Flushing thread table");
-
 		//
-		// Go through the table and remove dead entries.
+		// Closed threads are removed as soon as they don't have
+		// children anymore, so they don't wait for the timeout
 		//
-		m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
-			bool closed = (tinfo.m_flags & PPM_CL_CLOSED) != 0;
-
-			if(closed ||
-				((m_inspector->m_lastevent_ts > tinfo.m_lastaccess_ts + m_inspector->m_thread_timeout_ns) &&
-					!scap_is_thread_alive(m_inspector->m_h, tinfo.m_pid, tinfo.m_tid, tinfo.m_comm.c_str()))
-					)
+		std::vector<int64_t> closed_tids;
+		closed_tids.swap(m_closed_tids);
+		for(int64_t tid : closed_tids)
+		{
+			sinsp_threadinfo* tinfo = m_threadtable.get(tid);
+			if(tinfo != nullptr && (tinfo->m_flags & PPM_CL_CLOSED))
 			{
-				//
-				// Reset the cache
-				//
-				m_last_tid = 0;
-				m_last_tinfo.reset();
-
-#ifdef GATHER_INTERNAL_STATS
-				m_removed_threads->increment();
-#endif
-				to_delete[tinfo.m_tid] = closed;
+				remove_thread(tid, true);
 			}
-			return true;
-		});
-
-		for (auto& it : to_delete)
-		{
-			remove_thread(it.first, it.second);
 		}
 
 		//
 		// Rebalance the thread table dependency tree, so we free up threads that
 		// exited but that are stuck because of reference counting.
+		// This requires a full table walk, so only do it when needed.
 		//
-		recreate_child_dependencies();
+		if(m_child_dependencies_dirty)
+		{
+			g_logger.format(sinsp_logger::SEV_INFO, "Rebuilding thread table dependencies");
+			m_child_dependencies_dirty = false;
+			recreate_child_dependencies();
+		}
 	}
 
 	return res;
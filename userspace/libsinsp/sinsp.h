@@ -46,8 +46,6 @@ limitations under the License.
 
 #ifdef _WIN32
 #pragma warning(disable: 4251 4200 4221 4190)
-#else
-#include "tbb/concurrent_queue.h"
 #endif
 
 #include "sinsp_inet.h"
@@ -78,6 +76,7 @@ using namespace std;
 #include "container.h"
 #include "viewinfo.h"
 #include "utils.h"
+#include "mpsc_queue.h"
 
 #ifndef VISIBILITY_PRIVATE
 // Some code defines VISIBILITY_PRIVATE to nothing to get private access to sinsp
@@ -103,6 +102,8 @@ class sinsp_analyzer;
 class sinsp_filter;
 class cycle_writer;
 class sinsp_protodecoder;
+class sinsp_http_listener;
+class sinsp_http_session_manager;
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 class k8s;
 #endif // !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
@@ -755,6 +756,26 @@ public:
 	*/
 	void protodecoder_register_reset(sinsp_protodecoder* dec);
 
+	/*!
+	  \brief Reconstruct the HTTP requests going through the TCP connections
+	  of the processes, and pair them with their responses.
+
+	  \param listener receives every request when its response completes.
+	   NULL turns the reconstruction off.
+	  \param max_sessions max number of connections tracked at the same
+	   time, e.g. HTTP_SESSION_DEFAULT_MAX_SESSIONS.
+
+	  \note Only the payload bytes within the snaplen are parsed, so the
+	   URLs can get truncated. Bodies don't need to be captured.
+	*/
+	void set_http_listener(sinsp_http_listener* listener, uint32_t max_sessions);
+
+	/*!
+	  \brief Return the state of the HTTP request reconstruction, or NULL
+	  if it's off.
+	*/
+	const sinsp_http_session_manager* get_http_sessions() const;
+
 	/*!
 	  \brief If this is an offline capture, return the name of the file that is
 	   being read, otherwise return an empty string.
@@ -942,6 +963,8 @@ public:
 
 	void set_docker_socket_path(std::string socket_path);
 	void set_query_docker_image_info(bool query_image_info);
+	void set_docker_max_concurrent_lookups(uint32_t max_lookups);
+	void set_docker_event_stream(bool enabled);
 
 	void set_cri_extra_queries(bool extra_queries);
 
@@ -953,7 +976,10 @@ public:
 	void set_cri_timeout(int64_t timeout_ms);
 	void set_cri_async(bool async);
 	void set_cri_delay(uint64_t delay_ms);
+	void set_cri_max_concurrent_lookups(uint32_t max_lookups);
 	void set_container_labels_max_len(uint32_t max_label_len);
+	void set_binary_container_events(bool binary);
+	void set_container_cache_file(const std::string& path);
 
 	uint64_t get_lastevent_ts() const { return m_lastevent_ts; }
 
@@ -1218,7 +1244,7 @@ public:
 	// callbacks that occur after looking up container
 	// information, read from sinsp::next().
 #ifndef _WIN32
-	tbb::concurrent_queue<shared_ptr<sinsp_evt>> m_pending_container_evts;
+	libsinsp::mpsc_queue<shared_ptr<sinsp_evt>> m_pending_container_evts;
 #endif
 
 	// Holds an event dequeued from the above queue
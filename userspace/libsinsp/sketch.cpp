@@ -0,0 +1,480 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace libsinsp;
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// the t-digest compression factor, which bounds the centroid count to
+// COMPRESSION + 1
+const double COMPRESSION = tdigest::CENTROIDS - 4;
+
+double k_scale(double q)
+{
+	return COMPRESSION / (2 * PI) * asin(2 * q - 1);
+}
+
+void saturating_add(uint32_t& dst, uint32_t val)
+{
+	dst = (dst > UINT32_MAX - val) ? UINT32_MAX : dst + val;
+}
+
+}
+
+//
+// MurmurHash64A
+//
+uint64_t libsinsp::sketch_hash(const uint8_t* data, uint32_t len)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ (len * m);
+	uint64_t w;
+
+	for(; len >= sizeof(w); len -= sizeof(w), data += sizeof(w))
+	{
+		memcpy(&w, data, sizeof(w));
+		w *= m;
+		w ^= w >> 47;
+		w *= m;
+		h ^= w;
+		h *= m;
+	}
+
+	if(len != 0)
+	{
+		w = 0;
+		memcpy(&w, data, len);
+		h ^= w;
+		h *= m;
+	}
+
+	h ^= h >> 47;
+	h *= m;
+	h ^= h >> 47;
+	return h;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// hyperloglog implementation
+///////////////////////////////////////////////////////////////////////////////
+void hyperloglog::init()
+{
+	memset(m_registers, 0, sizeof(m_registers));
+}
+
+void hyperloglog::add(const uint8_t* val, uint32_t len)
+{
+	uint64_t h = sketch_hash(val, len);
+	uint32_t idx = (uint32_t)(h >> (64 - PRECISION));
+
+	//
+	// The rank is the position of the first set bit in the remaining
+	// bits, capped so that it fits their count
+	//
+	uint64_t w = h << PRECISION;
+	uint8_t rank = 1;
+	while(rank <= 64 - PRECISION && (w & (1ULL << 63)) == 0)
+	{
+		w <<= 1;
+		rank++;
+	}
+
+	if(rank > m_registers[idx])
+	{
+		m_registers[idx] = rank;
+	}
+}
+
+void hyperloglog::merge(const hyperloglog& other)
+{
+	for(uint32_t j = 0; j < REGISTERS; j++)
+	{
+		if(other.m_registers[j] > m_registers[j])
+		{
+			m_registers[j] = other.m_registers[j];
+		}
+	}
+}
+
+uint64_t hyperloglog::estimate() const
+{
+	double m = REGISTERS;
+	double sum = 0;
+	uint32_t zeros = 0;
+
+	for(uint32_t j = 0; j < REGISTERS; j++)
+	{
+		sum += ldexp(1.0, -m_registers[j]);
+		if(m_registers[j] == 0)
+		{
+			zeros++;
+		}
+	}
+
+	double res = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+
+	//
+	// Small cardinalities are better estimated by linear counting
+	//
+	if(res <= 2.5 * m && zeros != 0)
+	{
+		res = m * log(m / zeros);
+	}
+
+	return (uint64_t)(res + 0.5);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// tdigest implementation
+///////////////////////////////////////////////////////////////////////////////
+void tdigest::init()
+{
+	m_n_centroids = 0;
+	m_n_buffered = 0;
+	m_total_weight = 0;
+	m_min = 0;
+	m_max = 0;
+}
+
+void tdigest::add(double val)
+{
+	if(m_n_buffered == BUFFER)
+	{
+		compress(NULL, 0);
+	}
+
+	if(m_total_weight == 0)
+	{
+		m_min = val;
+		m_max = val;
+	}
+	else
+	{
+		m_min = std::min(m_min, val);
+		m_max = std::max(m_max, val);
+	}
+
+	m_buffer[m_n_buffered++] = val;
+	m_total_weight++;
+}
+
+void tdigest::merge(const tdigest& other)
+{
+	if(other.m_total_weight == 0)
+	{
+		return;
+	}
+
+	centroid extra[CENTROIDS + BUFFER];
+	uint32_t n_extra = 0;
+	uint32_t j;
+
+	for(j = 0; j < other.m_n_centroids; j++)
+	{
+		extra[n_extra++] = other.m_centroids[j];
+	}
+
+	for(j = 0; j < other.m_n_buffered; j++)
+	{
+		extra[n_extra].m_mean = other.m_buffer[j];
+		extra[n_extra].m_weight = 1;
+		n_extra++;
+	}
+
+	if(m_total_weight == 0)
+	{
+		m_min = other.m_min;
+		m_max = other.m_max;
+	}
+	else
+	{
+		m_min = std::min(m_min, other.m_min);
+		m_max = std::max(m_max, other.m_max);
+	}
+
+	m_total_weight += other.m_total_weight;
+	compress(extra, n_extra);
+}
+
+void tdigest::compress(const centroid* extra, uint32_t n_extra)
+{
+	centroid all[2 * (CENTROIDS + BUFFER)];
+	uint32_t n = 0;
+	uint32_t j;
+
+	for(j = 0; j < m_n_centroids; j++)
+	{
+		all[n++] = m_centroids[j];
+	}
+
+	for(j = 0; j < m_n_buffered; j++)
+	{
+		all[n].m_mean = m_buffer[j];
+		all[n].m_weight = 1;
+		n++;
+	}
+
+	for(j = 0; j < n_extra; j++)
+	{
+		all[n++] = extra[j];
+	}
+
+	m_n_buffered = 0;
+	m_n_centroids = 0;
+
+	if(n == 0)
+	{
+		return;
+	}
+
+	std::sort(all, all + n, [](const centroid& a, const centroid& b) {
+		return a.m_mean < b.m_mean;
+	});
+
+	//
+	// Merge neighbours as long as the centroid spans at most one unit of
+	// the k1 scale, which keeps the centroids near the tails small
+	//
+	centroid cur = all[0];
+	double weight_before = 0;
+	double k_left = k_scale(0);
+
+	for(j = 1; j < n; j++)
+	{
+		double proposed = cur.m_weight + all[j].m_weight;
+		double q_right = std::min(1.0, (weight_before + proposed) / m_total_weight);
+
+		if(k_scale(q_right) - k_left <= 1 || m_n_centroids == CENTROIDS - 1)
+		{
+			cur.m_mean += (all[j].m_mean - cur.m_mean) * all[j].m_weight / proposed;
+			cur.m_weight = proposed;
+		}
+		else
+		{
+			m_centroids[m_n_centroids++] = cur;
+			weight_before += cur.m_weight;
+			k_left = k_scale(std::min(1.0, weight_before / m_total_weight));
+			cur = all[j];
+		}
+	}
+
+	m_centroids[m_n_centroids++] = cur;
+}
+
+double tdigest::quantile(double q)
+{
+	if(m_n_buffered != 0)
+	{
+		compress(NULL, 0);
+	}
+
+	if(m_n_centroids == 0)
+	{
+		return 0;
+	}
+
+	double target = q * m_total_weight;
+	if(target <= 0)
+	{
+		return m_min;
+	}
+	if(target >= m_total_weight)
+	{
+		return m_max;
+	}
+
+	//
+	// Interpolate between the centers of the centroids around the
+	// target, using the min and max at the ends
+	//
+	double prev_center = 0;
+	double prev_mean = m_min;
+	double cum = 0;
+
+	for(uint32_t j = 0; j < m_n_centroids; j++)
+	{
+		double center = cum + m_centroids[j].m_weight / 2;
+		if(target < center)
+		{
+			return prev_mean + (m_centroids[j].m_mean - prev_mean) *
+				(target - prev_center) / (center - prev_center);
+		}
+
+		prev_center = center;
+		prev_mean = m_centroids[j].m_mean;
+		cum += m_centroids[j].m_weight;
+	}
+
+	return prev_mean + (m_max - prev_mean) *
+		(target - prev_center) / (m_total_weight - prev_center);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// count_min_top implementation
+///////////////////////////////////////////////////////////////////////////////
+void count_min_top::init()
+{
+	memset(m_counts, 0, sizeof(m_counts));
+	m_n_slots = 0;
+}
+
+//
+// Every row indexes its counters with its own 16 bits of the hash. Deriving
+// them as h1 + j * h2 instead leaves so few index sets for a width this small
+// that a rare value often shares all its counters with the most frequent one.
+//
+uint32_t count_min_top::increment(uint64_t hash, uint32_t count)
+{
+	uint32_t res = UINT32_MAX;
+
+	for(uint32_t j = 0; j < DEPTH; j++)
+	{
+		uint32_t& counter = m_counts[j][(hash >> (j * 16)) % WIDTH];
+		saturating_add(counter, count);
+		res = std::min(res, counter);
+	}
+
+	return res;
+}
+
+uint32_t count_min_top::count(uint64_t hash) const
+{
+	uint32_t res = UINT32_MAX;
+
+	for(uint32_t j = 0; j < DEPTH; j++)
+	{
+		res = std::min(res, m_counts[j][(hash >> (j * 16)) % WIDTH]);
+	}
+
+	return res;
+}
+
+void count_min_top::offer(uint64_t hash, uint32_t count, const uint8_t* val, uint32_t len)
+{
+	uint32_t j;
+	slot* dst = NULL;
+
+	for(j = 0; j < m_n_slots; j++)
+	{
+		if(m_slots[j].m_hash == hash)
+		{
+			m_slots[j].m_count = count;
+			return;
+		}
+	}
+
+	if(m_n_slots < SLOTS)
+	{
+		dst = &m_slots[m_n_slots++];
+	}
+	else
+	{
+		dst = &m_slots[0];
+		for(j = 1; j < SLOTS; j++)
+		{
+			if(m_slots[j].m_count < dst->m_count)
+			{
+				dst = &m_slots[j];
+			}
+		}
+
+		if(count <= dst->m_count)
+		{
+			return;
+		}
+	}
+
+	dst->m_hash = hash;
+	dst->m_count = count;
+	if(len > VALUE_SIZE)
+	{
+		// keep truncated strings terminated
+		memcpy(dst->m_val, val, VALUE_SIZE - 1);
+		dst->m_val[VALUE_SIZE - 1] = 0;
+		dst->m_len = VALUE_SIZE;
+	}
+	else
+	{
+		memcpy(dst->m_val, val, len);
+		dst->m_len = len;
+	}
+}
+
+void count_min_top::add(const uint8_t* val, uint32_t len)
+{
+	uint64_t hash = sketch_hash(val, len);
+	offer(hash, increment(hash, 1), val, len);
+}
+
+void count_min_top::merge(const count_min_top& other)
+{
+	uint32_t j;
+	uint32_t k;
+
+	for(j = 0; j < DEPTH; j++)
+	{
+		for(k = 0; k < WIDTH; k++)
+		{
+			saturating_add(m_counts[j][k], other.m_counts[j][k]);
+		}
+	}
+
+	for(j = 0; j < m_n_slots; j++)
+	{
+		m_slots[j].m_count = count(m_slots[j].m_hash);
+	}
+
+	for(j = 0; j < other.m_n_slots; j++)
+	{
+		const slot& s = other.m_slots[j];
+		offer(s.m_hash, count(s.m_hash), s.m_val, s.m_len);
+	}
+}
+
+const uint8_t* count_min_top::top(uint32_t* len, uint32_t* count) const
+{
+	const slot* res = NULL;
+
+	for(uint32_t j = 0; j < m_n_slots; j++)
+	{
+		if(res == NULL || m_slots[j].m_count > res->m_count)
+		{
+			res = &m_slots[j];
+		}
+	}
+
+	if(res == NULL)
+	{
+		*len = 0;
+		return NULL;
+	}
+
+	*len = res->m_len;
+	if(count != NULL)
+	{
+		*count = res->m_count;
+	}
+	return res->m_val;
+}
@@ -0,0 +1,137 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//
+// Fixed-size sketches for approximate aggregations. They hold no pointers
+// and need no destruction, so that they can be placed in the memory of a
+// sinsp_table_buffer like the exact aggregates: call init() on the raw
+// memory, then add() and merge() as needed.
+//
+namespace libsinsp {
+
+/**
+ * \brief 64 bit hash of a byte string
+ */
+uint64_t sketch_hash(const uint8_t* data, uint32_t len);
+
+/**
+ * \brief HyperLogLog distinct count, with a standard error of about 3%
+ */
+class hyperloglog
+{
+public:
+	static const uint32_t PRECISION = 10;
+	static const uint32_t REGISTERS = 1 << PRECISION;
+
+	void init();
+	void add(const uint8_t* val, uint32_t len);
+	void merge(const hyperloglog& other);
+	uint64_t estimate() const;
+
+private:
+	uint8_t m_registers[REGISTERS];
+};
+
+/**
+ * \brief Merging t-digest, for quantiles accurate at the tails
+ *
+ * Values are appended to a buffer and compressed into at most
+ * CENTROIDS centroids when it's full.
+ */
+class tdigest
+{
+public:
+	static const uint32_t CENTROIDS = 100;
+	static const uint32_t BUFFER = 100;
+
+	void init();
+	void add(double val);
+	void merge(const tdigest& other);
+
+	/**
+	 * \brief The value at quantile q (0 to 1), or 0 if the digest is empty
+	 */
+	double quantile(double q);
+
+private:
+	struct centroid
+	{
+		double m_mean;
+		double m_weight;
+	};
+
+	void compress(const centroid* extra, uint32_t n_extra);
+
+	centroid m_centroids[CENTROIDS];
+	uint32_t m_n_centroids;
+	uint32_t m_n_buffered;
+	double m_buffer[BUFFER];
+	double m_total_weight;
+	double m_min;
+	double m_max;
+};
+
+/**
+ * \brief The most frequent value of a stream, from a Count-Min sketch
+ *
+ * The sketch estimates the frequency of every value; the SLOTS values
+ * with the highest estimate are kept as candidates. Values longer than
+ * VALUE_SIZE are kept truncated.
+ */
+class count_min_top
+{
+public:
+	static const uint32_t DEPTH = 4;
+	static const uint32_t WIDTH = 64;
+	static const uint32_t SLOTS = 4;
+	static const uint32_t VALUE_SIZE = 64;
+
+	void init();
+	void add(const uint8_t* val, uint32_t len);
+	void merge(const count_min_top& other);
+
+	/**
+	 * \brief The most frequent value, or nullptr if the sketch is empty
+	 * @param len set to the length of the value
+	 * @param count if not nullptr, set to its estimated frequency
+	 */
+	const uint8_t* top(uint32_t* len, uint32_t* count = nullptr) const;
+
+private:
+	struct slot
+	{
+		uint64_t m_hash;
+		uint32_t m_count;
+		uint32_t m_len;
+		uint8_t m_val[VALUE_SIZE];
+	};
+
+	uint32_t increment(uint64_t hash, uint32_t count);
+	uint32_t count(uint64_t hash) const;
+	void offer(uint64_t hash, uint32_t count, const uint8_t* val, uint32_t len);
+
+	uint32_t m_counts[DEPTH][WIDTH];
+	slot m_slots[SLOTS];
+	uint32_t m_n_slots;
+};
+
+}
@@ -24,23 +24,64 @@ limitations under the License.
 
 #include "socket_handler.h"
 
+#include <sys/epoll.h>
+#include <ctime>
+#include <set>
+#include <vector>
+
+//
+// Multiplexes the data handlers (see socket_handler.h) of many
+// connections on a single thread.
+//
+// By default sockets are watched with edge-triggered epoll, which
+// costs O(active sockets) per call and has no limit on the number
+// or value of file descriptors; if epoll is not available (or
+// use_epoll is false) we fall back to select(), which scans all
+// the sockets on every call and only works with descriptors below
+// FD_SETSIZE.
+//
+// Handlers receive the data straight into a read buffer owned by
+// the collector, shared by all of them.
+//
 template <typename T>
 class socket_collector
 {
 public:
 	typedef std::map<int, std::shared_ptr<T>> socket_map_t;
 
-	socket_collector(bool do_loop = false, long timeout_ms = 1000L):
+	socket_collector(bool do_loop = false, long timeout_ms = 1000L, bool use_epoll = true):
 		m_nfds(0),
 		m_loop(do_loop),
 		m_timeout_ms(timeout_ms),
-		m_stopped(false)
+		m_stopped(false),
+		m_read_buf(READ_BUFFER_SIZE)
 	{
 		clear_fds();
+		if(use_epoll)
+		{
+			m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+			if(m_epoll_fd < 0)
+			{
+				g_logger.log(std::string("Socket collector: epoll not available (") + strerror(errno) +
+							 "), falling back to select()", sinsp_logger::SEV_WARNING);
+			}
+		}
 	}
 
 	~socket_collector()
 	{
+		if(m_epoll_fd >= 0)
+		{
+			close(m_epoll_fd);
+		}
+	}
+
+	socket_collector(const socket_collector&) = delete;
+	socket_collector& operator=(const socket_collector&) = delete;
+
+	bool uses_epoll() const
+	{
+		return m_epoll_fd >= 0;
 	}
 
 	void add(std::shared_ptr<T> handler)
@@ -49,6 +90,10 @@ public:
 		{
 			int sockfd = handler->get_socket(m_timeout_ms);
 			m_sockets[sockfd] = handler;
+			if(m_epoll_fd >= 0)
+			{
+				epoll_watch(sockfd);
+			}
 			g_logger.log("Socket collector: handler [" + handler->get_id() +
 						 "] added socket (" + std::to_string(sockfd) + ')',
 						 sinsp_logger::SEV_TRACE);
@@ -120,6 +165,14 @@ public:
 	void remove_all()
 	{
 		clear_fds();
+		if(m_epoll_fd >= 0)
+		{
+			for(const auto& sock : m_sockets)
+			{
+				epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, sock.first, nullptr);
+			}
+		}
+		m_ready_fds.clear();
 		m_sockets.clear();
 		m_nfds = 0;
 	}
@@ -179,15 +232,7 @@ public:
 
 	bool is_fd_valid(int sockfd)
 	{
-		struct timeval tv = {0};
-		fd_set infd, outfd, errfd;
-		FD_ZERO(&infd);
-		FD_ZERO(&outfd);
-		FD_ZERO(&errfd);
-		FD_SET(sockfd, &infd);
-		FD_SET(sockfd, &outfd);
-		FD_SET(sockfd, &errfd);
-		return 0 <= select(sockfd + 1, &infd, &outfd, &errfd, &tv);
+		return sockfd >= 0 && fcntl(sockfd, F_GETFD) != -1;
 	}
 
 	void enable_sockets()
@@ -205,6 +250,14 @@ public:
 						remove(it);
 						continue;
 					}
+					else if(it->first >= FD_SETSIZE)
+					{
+						g_logger.log("Socket collector: socket " + std::to_string(it->first) +
+									 " is out of select() range, removing handler [" + it->second->get_id() + ']',
+									 sinsp_logger::SEV_ERROR);
+						remove(it);
+						continue;
+					}
 					else
 					{
 						sockfd = it->first;
@@ -225,89 +278,26 @@ public:
 	{
 		try
 		{
-			struct timeval tv;
-			int res;
 			m_stopped = false;
 			while(!m_stopped)
 			{
-				tv.tv_sec  = m_loop ? m_timeout_ms / 1000 : 0;
-				tv.tv_usec = m_loop ? (m_timeout_ms % 1000) * 1000 : 0;
+				if(m_sockets.size())
 				{
-					if(m_sockets.size())
+					if(m_epoll_fd >= 0)
 					{
-						enable_sockets(); // flag all enabled handler sockets
-						g_logger.log("Socket collector: total sockets=" + std::to_string(m_sockets.size()) +
-										 ", select-enabled sockets= " + std::to_string(signaled_sockets_count()),
-										 sinsp_logger::SEV_TRACE);
-						res = select(m_nfds + 1, &m_infd, NULL, &m_errfd, &tv);
-						g_logger.log("Socket collector: total sockets=" + std::to_string(m_sockets.size()) +
-										 ", signaled sockets= " + std::to_string(signaled_sockets_count()),
-										 sinsp_logger::SEV_TRACE);
-						if(res == 0) // all quiet
-						{
-							g_logger.log("Socket collector: " + std::to_string(m_sockets.size()) + " sockets total, no activity.",
-										 sinsp_logger::SEV_DEBUG);
-						}
-						else if(res < 0) // select error
-						{
-							// socket sets are undefined after error, nothing to do here ...
-							throw sinsp_exception(std::string("Socket collector: select error (").append(strerror(errno)).append(1, ')'));
-						}
-						else // data available or socket error
-						{
-							trace_sockets();
-							for(typename socket_map_t::iterator it = m_sockets.begin(); it != m_sockets.end();)
-							{
-								std::string id = it->second->get_id();
-								int err = 0;
-								if(FD_ISSET(it->first, &m_infd))
-								{
-									if(it->second && it->second->is_enabled() && (err = it->second->on_data()))
-									{
-										if((err != EAGAIN) && (err != EINPROGRESS))
-										{
-											if(err != it->second->CONNECTION_CLOSED)
-											{
-												g_logger.log("Socket collector: data handling error " + std::to_string(errno) + ", (" +
-															 strerror(errno) + "), removing handler [" + id + ']', sinsp_logger::SEV_ERROR);
-											}
-											else
-											{
-												g_logger.log("Socket collector: connection close detected while handling data"
-															 ", removing handler [" + id + ']', sinsp_logger::SEV_DEBUG);
-											}
-											remove(it);
-											continue;
-										}
-									}
-								}
-
-								if(FD_ISSET(it->first, &m_errfd))
-								{
-									if(it->second && (err = it->second->get_socket_error()))
-									{
-										g_logger.log("Socket collector: socket error " + std::to_string(err) + ", (" +
-													  strerror(err) + "), removing handler [" + id + ']', sinsp_logger::SEV_ERROR);
-									}
-									else
-									{
-										g_logger.log("Socket collector: handler [" + id + "] unknown socket error, closing connection.",
-													 sinsp_logger::SEV_ERROR);
-									}
-									remove(it);
-									continue;
-								}
-								++it;
-							}
-						}
+						get_data_epoll();
 					}
 					else
 					{
-						g_logger.log("Socket collector is empty.", sinsp_logger::SEV_DEBUG);
-						m_stopped = true;
-						return;
+						get_data_select();
 					}
 				}
+				else
+				{
+					g_logger.log("Socket collector is empty.", sinsp_logger::SEV_DEBUG);
+					m_stopped = true;
+					return;
+				}
 				if(!m_loop) { break; }
 			}
 		}
@@ -352,16 +342,239 @@ public:
 	}
 
 private:
+	static const size_t READ_BUFFER_SIZE = 64 * 1024;
+	static const int EPOLL_MAX_EVENTS = 256;
+
 	void clear_fds()
 	{
 		FD_ZERO(&m_errfd);
 		FD_ZERO(&m_infd);
 	}
 
+	void epoll_watch(int sockfd)
+	{
+		struct epoll_event ev = {};
+		ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+		ev.data.fd = sockfd;
+		if(epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, sockfd, &ev) != 0 &&
+		   (errno != EEXIST || epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, sockfd, &ev) != 0))
+		{
+			// an invalid socket will be dropped by the next validity check
+			g_logger.log("Socket collector: cannot watch socket " + std::to_string(sockfd) +
+						 " (" + strerror(errno) + ')', sinsp_logger::SEV_ERROR);
+		}
+	}
+
+	// returns true if the handler must be removed
+	bool handle_data(T& handler, const std::string& id)
+	{
+		int err = handler.on_data(&m_read_buf[0], m_read_buf.size());
+		if(err && (err != EAGAIN) && (err != EINPROGRESS))
+		{
+			if(err != handler.CONNECTION_CLOSED)
+			{
+				g_logger.log("Socket collector: data handling error " + std::to_string(errno) + ", (" +
+							 strerror(errno) + "), removing handler [" + id + ']', sinsp_logger::SEV_ERROR);
+			}
+			else
+			{
+				g_logger.log("Socket collector: connection close detected while handling data"
+							 ", removing handler [" + id + ']', sinsp_logger::SEV_DEBUG);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void handle_error(T* handler, const std::string& id)
+	{
+		int err = 0;
+		if(handler && (err = handler->get_socket_error()))
+		{
+			g_logger.log("Socket collector: socket error " + std::to_string(err) + ", (" +
+						  strerror(err) + "), removing handler [" + id + ']', sinsp_logger::SEV_ERROR);
+		}
+		else
+		{
+			g_logger.log("Socket collector: handler [" + id + "] unknown socket error, closing connection.",
+						 sinsp_logger::SEV_ERROR);
+		}
+	}
+
+	void get_data_select()
+	{
+		struct timeval tv;
+		int res;
+
+		tv.tv_sec  = m_loop ? m_timeout_ms / 1000 : 0;
+		tv.tv_usec = m_loop ? (m_timeout_ms % 1000) * 1000 : 0;
+
+		enable_sockets(); // flag all enabled handler sockets
+		g_logger.log("Socket collector: total sockets=" + std::to_string(m_sockets.size()) +
+						 ", select-enabled sockets= " + std::to_string(signaled_sockets_count()),
+						 sinsp_logger::SEV_TRACE);
+		res = select(m_nfds + 1, &m_infd, NULL, &m_errfd, &tv);
+		g_logger.log("Socket collector: total sockets=" + std::to_string(m_sockets.size()) +
+						 ", signaled sockets= " + std::to_string(signaled_sockets_count()),
+						 sinsp_logger::SEV_TRACE);
+		if(res == 0) // all quiet
+		{
+			g_logger.log("Socket collector: " + std::to_string(m_sockets.size()) + " sockets total, no activity.",
+						 sinsp_logger::SEV_DEBUG);
+		}
+		else if(res < 0) // select error
+		{
+			// socket sets are undefined after error, nothing to do here ...
+			throw sinsp_exception(std::string("Socket collector: select error (").append(strerror(errno)).append(1, ')'));
+		}
+		else // data available or socket error
+		{
+			trace_sockets();
+			for(typename socket_map_t::iterator it = m_sockets.begin(); it != m_sockets.end();)
+			{
+				std::string id = it->second->get_id();
+				if(FD_ISSET(it->first, &m_infd))
+				{
+					if(it->second && it->second->is_enabled() && handle_data(*it->second, id))
+					{
+						remove(it);
+						continue;
+					}
+				}
+
+				if(FD_ISSET(it->first, &m_errfd))
+				{
+					handle_error(it->second.get(), id);
+					remove(it);
+					continue;
+				}
+				++it;
+			}
+		}
+	}
+
+	//
+	// Edge-triggered: we only hear about a socket when new data arrives,
+	// so a socket stays in m_ready_fds until its handler has drained it.
+	// This also covers data that arrives while the handler is disabled,
+	// which select() would simply report again once it's enabled.
+	//
+	void get_data_epoll()
+	{
+		remove_invalid_sockets();
+
+		int timeout_ms = m_loop ? (int)m_timeout_ms : 0;
+		for(int fd : m_ready_fds)
+		{
+			typename socket_map_t::const_iterator it = m_sockets.find(fd);
+			if(it != m_sockets.end() && it->second && it->second->is_enabled())
+			{
+				timeout_ms = 0; // don't wait, we already have work to do
+				break;
+			}
+		}
+
+		struct epoll_event events[EPOLL_MAX_EVENTS];
+		int res = epoll_wait(m_epoll_fd, events, EPOLL_MAX_EVENTS, timeout_ms);
+		if(res < 0)
+		{
+			if(errno == EINTR)
+			{
+				return;
+			}
+			throw sinsp_exception(std::string("Socket collector: epoll_wait error (").append(strerror(errno)).append(1, ')'));
+		}
+
+		g_logger.log("Socket collector: total sockets=" + std::to_string(m_sockets.size()) +
+					 ", signaled sockets=" + std::to_string(res) +
+					 ", pending sockets=" + std::to_string(m_ready_fds.size()),
+					 sinsp_logger::SEV_TRACE);
+
+		for(int i = 0; i < res; i++)
+		{
+			typename socket_map_t::iterator it = m_sockets.find(events[i].data.fd);
+			if(it == m_sockets.end())
+			{
+				continue;
+			}
+
+			if(events[i].events & EPOLLERR)
+			{
+				handle_error(it->second.get(), it->second ? it->second->get_id() : "");
+				remove(it);
+				continue;
+			}
+
+			// EPOLLHUP and EPOLLRDHUP too: the handler reads what's left
+			// and then notices the connection is closed
+			m_ready_fds.insert(it->first);
+		}
+
+		if(m_ready_fds.empty())
+		{
+			g_logger.log("Socket collector: " + std::to_string(m_sockets.size()) + " sockets total, no activity.",
+						 sinsp_logger::SEV_DEBUG);
+			return;
+		}
+
+		for(auto ready = m_ready_fds.begin(); ready != m_ready_fds.end();)
+		{
+			// remove() may erase fd from m_ready_fds, so move on first
+			int fd = *ready++;
+			typename socket_map_t::iterator it = m_sockets.find(fd);
+			if(it == m_sockets.end())
+			{
+				m_ready_fds.erase(fd);
+				continue;
+			}
+			if(!it->second || !it->second->is_enabled())
+			{
+				continue;
+			}
+
+			if(handle_data(*it->second, it->second->get_id()))
+			{
+				remove(it);
+			}
+			else if(it->second->is_drained())
+			{
+				m_ready_fds.erase(fd);
+			}
+		}
+	}
+
+	// select() fails on invalid descriptors, so enable_sockets() finds
+	// them on every call; epoll silently forgets closed ones, so check
+	// every now and then
+	void remove_invalid_sockets()
+	{
+		time_t now = time(nullptr);
+		if(now == m_last_validity_check)
+		{
+			return;
+		}
+		m_last_validity_check = now;
+
+		for(typename socket_map_t::iterator it = m_sockets.begin(); it != m_sockets.end();)
+		{
+			if(!is_fd_valid(it->first))
+			{
+				remove(it);
+				continue;
+			}
+			++it;
+		}
+	}
+
 	typename socket_map_t::iterator& remove(typename socket_map_t::iterator& it)
 	{
 		if(it != m_sockets.end())
 		{
+			if(m_epoll_fd >= 0)
+			{
+				epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, it->first, nullptr);
+				m_ready_fds.erase(it->first);
+			}
 			m_sockets.erase(it++);
 		}
 		m_nfds = 0;
@@ -383,6 +596,10 @@ private:
 	long         m_timeout_ms;
 	bool         m_stopped = false;
 	bool         m_steady_state = false;
+	int          m_epoll_fd = -1;
+	std::set<int> m_ready_fds;
+	time_t       m_last_validity_check = 0;
+	std::vector<char> m_read_buf;
 };
 
 #endif // HAS_CAPTURE
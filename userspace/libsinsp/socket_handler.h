@@ -37,6 +37,7 @@ limitations under the License.
 #include "json_query.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
@@ -68,6 +69,7 @@ public:
 	typedef sinsp_ssl::ptr_t                     ssl_ptr_t;
 	typedef sinsp_bearer_token::ptr_t            bt_ptr_t;
 	typedef void (T::*json_callback_func_t)(json_ptr_t, const std::string&);
+	typedef bool (T::*raw_json_callback_func_t)(const std::string&, const std::string&);
 
 	static const std::string HTTP_VERSION_10;
 	static const std::string HTTP_VERSION_11;
@@ -221,6 +223,13 @@ public:
 		m_json_callback = f;
 	}
 
+	// optional; gets every JSON before the filters are applied and,
+	// when it returns true, the JSON is considered handled
+	void set_raw_json_callback(raw_json_callback_func_t f)
+	{
+		m_raw_json_callback = f;
+	}
+
 	SSL* ssl_connection()
 	{
 		return m_ssl_connection;
@@ -432,16 +441,22 @@ public:
 		bool handled = false;
 		for(auto js = m_json.begin(); js != m_json.end();)
 		{
-			handled = false;
-			for(auto it = m_json_filters.cbegin(); it != m_json_filters.cend(); ++it)
+			handled = m_raw_json_callback && (m_obj.*m_raw_json_callback)(*js, m_id);
+			if(!handled)
 			{
-				json_ptr_t pjson = try_parse(m_jq, *js, *it, m_id, m_url.to_string(false));
-				if(pjson)
+				// parsed once, for all the filters
+				jv input = json_query::parse(*js);
+				for(auto it = m_json_filters.cbegin(); it != m_json_filters.cend(); ++it)
 				{
-					(m_obj.*m_json_callback)(pjson, m_id);
-					handled = true;
-					break;
+					json_ptr_t pjson = try_parse(m_jq, input, *js, *it, m_id, m_url.to_string(false));
+					if(pjson)
+					{
+						(m_obj.*m_json_callback)(pjson, m_id);
+						handled = true;
+						break;
+					}
 				}
+				jv_free(input);
 			}
 			if(!handled)
 			{
@@ -511,6 +526,14 @@ public:
 	}
 
 	int on_data()
+	{
+		return on_data(&m_buf[0], m_buf.size());
+	}
+
+	// Receive into (and parse straight out of) a caller-provided buffer,
+	// so a collector serving many handlers can share one large buffer
+	// instead of each handler reading in small chunks
+	int on_data(char* buf, size_t buf_len)
 	{
 		bool is_error = false;
 
@@ -520,24 +543,25 @@ public:
 		}
 
 		ssize_t iolen = 0;
-		size_t len_read = 0, len_to_read = m_buf.size();
+		size_t len_read = 0, len_to_read = buf_len;
+		m_drained = false;
 		try
 		{
 			do
 			{
 				if(len_read >= m_data_limit) { break; }
-				else if((len_read + m_buf.size()) > m_data_limit)
+				else if((len_read + buf_len) > m_data_limit)
 				{
 					len_to_read = m_data_limit - len_read;
 				}
 				errno = 0;
 				if(m_url.is_secure())
 				{
-					iolen = static_cast<ssize_t>(SSL_read(m_ssl_connection, &m_buf[0], len_to_read));
+					iolen = static_cast<ssize_t>(SSL_read(m_ssl_connection, buf, len_to_read));
 				}
 				else
 				{
-					iolen = recv(m_socket, &m_buf[0], len_to_read, 0);
+					iolen = recv(m_socket, buf, len_to_read, 0);
 				}
 				if(iolen > 0) { len_read += iolen; }
 				m_sock_err = errno;
@@ -550,14 +574,14 @@ public:
 				/* uncomment to see raw HTTP stream data in trace logs
 					if((iolen > 0) && g_logger.get_severity() >= sinsp_logger::SEV_TRACE)
 					{
-						g_logger.log("Socket handler (" + m_id + "), data --->" + std::string(&m_buf[0], iolen) + "<--- data",
+						g_logger.log("Socket handler (" + m_id + "), data --->" + std::string(buf, iolen) + "<--- data",
 									 sinsp_logger::SEV_TRACE);
 					}
 				*/
 				if(iolen > 0)
 				{
-					size_t len = (iolen <= static_cast<ssize_t>(m_buf.size())) ? static_cast<size_t>(iolen) : m_buf.size();
-					if(CONNECTION_CLOSED == process(&m_buf[0], len))
+					size_t len = (iolen <= static_cast<ssize_t>(buf_len)) ? static_cast<size_t>(iolen) : buf_len;
+					if(CONNECTION_CLOSED == process(buf, len))
 					{
 						return CONNECTION_CLOSED;
 					}
@@ -625,6 +649,7 @@ public:
 					}
 				}
 			} while(iolen && (m_sock_err != EAGAIN) && (len_read < m_data_limit));
+			m_drained = (m_sock_err == EAGAIN || m_sock_err == EWOULDBLOCK);
 			g_logger.log("Socket handler (" + m_id + ") " +
 						 std::to_string(len_read) + " bytes of data received",
 						 sinsp_logger::SEV_TRACE);
@@ -653,6 +678,15 @@ public:
 		return is_error ? m_sock_err : CONNECTION_CLOSED;
 	}
 
+	// true if the last on_data() call read everything available on the
+	// socket, false if it stopped early (on the data limit or on error);
+	// with edge-triggered polling the latter needs another on_data() call
+	// before waiting for new data
+	bool is_drained() const
+	{
+		return m_drained;
+	}
+
 	void on_error(const std::string& /*err*/, bool /*disconnect*/)
 	{
 	}
@@ -731,47 +765,57 @@ public:
 	{
 		std::ostringstream filters;
 		filters << std::endl << "Filters:" << std::endl;
+		std::unordered_map<std::string, json_query::filter_stats> stats = m_jq.get_stats();
 		for(auto filter : m_json_filters)
 		{
-			filters << filter << std::endl;
+			filters << filter;
+			auto it = stats.find(filter);
+			if(it != stats.end() && it->second.m_runs)
+			{
+				const json_query::filter_stats& st = it->second;
+				filters << " [runs=" << st.m_runs << ", failures=" << st.m_failures <<
+					", avg=" << st.m_run_time / st.m_runs << "ns, compile=" << st.m_compile_time << "ns]";
+			}
+			filters << std::endl;
 		}
 		g_logger.log("Socket handler (" + m_id + "), [" + m_url.to_string(false) + "]" + filters.str(), sev);
 	}
 
-	static json_ptr_t try_parse(json_query& jq, const std::string& json, const std::string& filter,
+	std::unordered_map<std::string, json_query::filter_stats> get_filter_stats() const
+	{
+		return m_jq.get_stats();
+	}
+
+	static json_ptr_t try_parse(json_query& jq, jv input, const std::string& json, const std::string& filter,
 				    const std::string& id, const std::string& url)
 	{
-		std::string filtered_json(json);
+		json_ptr_t root(new Json::Value());
 		if(!filter.empty())
 		{
 			// failure to parse is ok, it will fail over to the next filter
 			// and log error if all filters fail
-			if(jq.process(json, filter))
-			{
-				filtered_json = jq.result();
-				if (filtered_json.empty() && !jq.get_error().empty())
-				{
-					g_logger.log("Socket handler (" + id + "), [" +
-						     url + "] filter result is empty \"" +
-						     jq.get_error() + "\"; JSON: <" +
-						     json + ">, jq filter: <" + filter + '>',
-						     sinsp_logger::SEV_DEBUG);
-				}
-			}
-			else
+			if(!jv_is_valid(input))
 			{
 				g_logger.log("Socket handler (" + id + "), [" +
-					     url + "] filter processing error \"" +
-					     jq.get_error() + "\"; JSON: <" +
+					     url + "] JSON parse error; JSON: <" +
 					     json + ">, jq filter: <" + filter + '>',
 					     sinsp_logger::SEV_DEBUG);
 				return nullptr;
 			}
+			if(jq.process(input, filter) && jq.result(*root))
+			{
+				return root;
+			}
+			g_logger.log("Socket handler (" + id + "), [" +
+				     url + "] filter processing error \"" +
+				     jq.get_error() + "\"; JSON: <" +
+				     json + ">, jq filter: <" + filter + '>',
+				     sinsp_logger::SEV_DEBUG);
+			return nullptr;
 		}
-		json_ptr_t root(new Json::Value());
 		try
 		{
-			if(Json::Reader().parse(filtered_json, *root))
+			if(Json::Reader().parse(json, *root))
 			{
 				/*
 				if(g_logger.get_severity() >= sinsp_logger::SEV_TRACE)
@@ -828,35 +872,17 @@ private:
 
 	int wait(bool for_recv, long tout = 1000L)
 	{
-		struct timeval tv;
-		tv.tv_sec = m_timeout_ms / 1000;
-		tv.tv_usec = (m_timeout_ms % 1000) * 1000;
-
-		fd_set infd, outfd, errfd;
-		FD_ZERO(&infd);
-		FD_ZERO(&outfd);
-		FD_ZERO(&errfd);
-		FD_SET(m_socket, &errfd);
-		if(for_recv)
-		{
-			FD_SET(m_socket, &infd);
-		}
-		else
-		{
-			FD_SET(m_socket, &outfd);
-		}
-
-		return select(m_socket + 1, &infd, &outfd, &errfd, &tv);
+		struct pollfd pfd = {m_socket, (short)(for_recv ? POLLIN : POLLOUT), 0};
+		return poll(&pfd, 1, (int)m_timeout_ms);
 	}
 
+	// poll() rather than select(): there may be more than FD_SETSIZE
+	// sockets open, see socket_collector
 	bool send_ready()
 	{
-		struct timeval tv = {0};
-		fd_set outfd;
-		FD_ZERO(&outfd);
-		FD_SET(m_socket, &outfd);
-		int sel_ret = select(m_socket + 1, 0, &outfd, 0, &tv);
-		if(sel_ret != 1) { return false; }
+		struct pollfd pfd = {m_socket, POLLOUT, 0};
+		int poll_ret = poll(&pfd, 1, 0);
+		if(poll_ret != 1) { return false; }
 		int sock_ret = get_socket_error();
 		if(!sock_ret) { return true; }
 		return false;
@@ -864,20 +890,14 @@ private:
 
 	bool recv_ready()
 	{
-		struct timeval tv = {0};
-		fd_set infd;
-		FD_ZERO(&infd);
-		FD_SET(m_socket, &infd);
-		return select(m_socket + 1, &infd, 0, 0, &tv) == 1;
+		struct pollfd pfd = {m_socket, POLLIN, 0};
+		return poll(&pfd, 1, 0) == 1;
 	}
 
 	bool socket_error()
 	{
-		struct timeval tv = {0};
-		fd_set errfd;
-		FD_ZERO(&errfd);
-		FD_SET(m_socket, &errfd);
-		return select(m_socket + 1, 0, 0, &errfd, &tv) == 1;
+		struct pollfd pfd = {m_socket, POLLPRI, 0};
+		return poll(&pfd, 1, 0) == 1;
 	}
 
 	static int ssl_verify_callback(int preverify_ok, X509_STORE_CTX* ctx)
@@ -1594,10 +1614,12 @@ private:
 	bool                     m_blocking = false;
 	std::vector<char>        m_buf;
 	int                      m_sock_err = 0;
+	bool                     m_drained = false;
 	ssl_ptr_t                m_ssl;
 	bt_ptr_t                 m_bt;
 	long                     m_timeout_ms;
 	json_callback_func_t     m_json_callback = nullptr;
+	raw_json_callback_func_t m_raw_json_callback = nullptr;
 	std::string              m_data_buf;
 	std::string              m_request;
 	std::string              m_http_version;
@@ -51,6 +51,7 @@ public:
 	uint64_t m_n_store_drops;
 	uint64_t m_n_retrieved_evts;
 	uint64_t m_n_retrieve_drops;
+	uint64_t m_stored_evts_memory;
 
 private:
 	internal_metrics::registry m_metrics_registry;
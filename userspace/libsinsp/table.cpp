@@ -16,6 +16,10 @@ limitations under the License.
 */
 
 #include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 #include "sinsp.h"
 #include "sinsp_int.h"
@@ -23,6 +27,7 @@ limitations under the License.
 #include "filter.h"
 #include "filterchecks.h"
 #include "table.h"
+#include "sketch.h"
 
 extern sinsp_filter_check_list g_filterlist;
 extern sinsp_evttables g_infotables;
@@ -33,6 +38,11 @@ extern sinsp_evttables g_infotables;
 typedef struct table_row_cmp
 {
 	bool operator()(const sinsp_sample_row& src, const sinsp_sample_row& dst)
+	{
+		return compare(src.m_values[m_colid], dst.m_values[m_colid]);
+	}
+
+	bool compare(const sinsp_table_field& src, const sinsp_table_field& dst)
 	{
 		cmpop op;
 
@@ -45,24 +55,23 @@ typedef struct table_row_cmp
 			op = CO_GT;
 		}
 
-		if(src.m_values[m_colid].m_cnt > 1 ||
-			dst.m_values[m_colid].m_cnt > 1)
+		if(src.m_cnt > 1 || dst.m_cnt > 1)
 		{
 			return flt_compare_avg(op, m_type, 
-				src.m_values[m_colid].m_val, 
-				dst.m_values[m_colid].m_val, 
-				src.m_values[m_colid].m_len, 
-				dst.m_values[m_colid].m_len,
-				src.m_values[m_colid].m_cnt, 
-				dst.m_values[m_colid].m_cnt);
+				src.m_val, 
+				dst.m_val, 
+				src.m_len, 
+				dst.m_len,
+				src.m_cnt, 
+				dst.m_cnt);
 		}
 		else
 		{
 			return flt_compare(op, m_type, 
-				src.m_values[m_colid].m_val, 
-				dst.m_values[m_colid].m_val, 
-				src.m_values[m_colid].m_len, 
-				dst.m_values[m_colid].m_len);
+				src.m_val, 
+				dst.m_val, 
+				src.m_len, 
+				dst.m_len);
 		}
 	}
 
@@ -71,6 +80,336 @@ typedef struct table_row_cmp
 	bool m_ascending;
 }table_row_cmp;
 
+//
+// A worker thread aggregating the table rows whose key hashes to it.
+// The event thread appends the extracted rows to m_batch and hands the
+// full batches over through m_pending. All the rows of a key go to the
+// same shard, in event order, so every key is aggregated exactly like
+// in the serial path; the rows created during the current sample are
+// also listed in m_new_rows, with the number of the event that created
+// them, so that the table can be rebuilt in the serial insertion order.
+//
+class sinsp_table_shard
+{
+public:
+	typedef struct new_row
+	{
+		uint64_t m_seq;
+		sinsp_table_field m_key;
+		sinsp_table_field* m_vals;
+	}new_row;
+
+	sinsp_table_shard(sinsp_table* table)
+	{
+		m_table = table;
+		m_buffer = &m_buffer1;
+		m_busy = false;
+		m_stop = false;
+		m_thread = std::thread(&sinsp_table_shard::run, this);
+	}
+
+	~sinsp_table_shard()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_cond.notify_one();
+		m_thread.join();
+	}
+
+	//
+	// Hand the current batch over to the worker. Event thread only.
+	//
+	void submit()
+	{
+		if(m_batch.empty())
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending.push_back(std::move(m_batch));
+			if(m_spare.empty())
+			{
+				m_batch = vector<uint8_t>();
+			}
+			else
+			{
+				m_batch = std::move(m_spare.back());
+				m_spare.pop_back();
+			}
+		}
+		m_cond.notify_one();
+
+		m_batch.reserve(SINSP_TABLE_SHARD_BATCH_SIZE);
+	}
+
+	//
+	// Wait until everything submitted so far has been aggregated, and
+	// report the errors the worker ran into.
+	//
+	void drain()
+	{
+		submit();
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done_cond.wait(lock, [this] { return m_pending.empty() && !m_busy; });
+
+		if(m_error)
+		{
+			std::exception_ptr error = m_error;
+			m_error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	//
+	// Start a new sample, keeping the rows of the previous one alive
+	// for the consumers of the table. Only while drained.
+	//
+	void switch_buffers()
+	{
+		m_buffer = (m_buffer == &m_buffer1)? &m_buffer2 : &m_buffer1;
+		m_buffer->clear();
+		m_rows.clear();
+		m_new_rows.clear();
+	}
+
+	vector<uint8_t> m_batch;
+	unordered_map<sinsp_table_field, sinsp_table_field*, sinsp_table_field_hasher> m_rows;
+	vector<new_row> m_new_rows;
+	sinsp_table_buffer* m_buffer;
+
+private:
+	void run()
+	{
+		vector<vector<uint8_t>> batches;
+		vector<sinsp_table_field> flds;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while(true)
+		{
+			m_cond.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+			if(m_pending.empty())
+			{
+				return;
+			}
+
+			batches.swap(m_pending);
+			m_busy = true;
+			lock.unlock();
+
+			try
+			{
+				for(auto& batch : batches)
+				{
+					process_batch(batch, flds);
+				}
+			}
+			catch(...)
+			{
+				lock.lock();
+				if(!m_error)
+				{
+					m_error = std::current_exception();
+				}
+				lock.unlock();
+			}
+
+			lock.lock();
+			for(auto& batch : batches)
+			{
+				batch.clear();
+				m_spare.push_back(std::move(batch));
+			}
+			batches.clear();
+			m_busy = false;
+			m_done_cond.notify_all();
+		}
+	}
+
+	//
+	// Decode the rows encoded by sinsp_table::add_shard_row() and
+	// aggregate them
+	//
+	void process_batch(vector<uint8_t>& batch, vector<sinsp_table_field>& flds)
+	{
+		uint32_t j;
+		uint32_t nflds = m_table->m_n_premerge_fields;
+		uint8_t* p = batch.data();
+		uint8_t* end = p + batch.size();
+		uint64_t seq;
+
+		flds.resize(nflds);
+
+		while(p < end)
+		{
+			memcpy(&seq, p, sizeof(uint64_t));
+			p += sizeof(uint64_t);
+
+			for(j = 0; j < nflds; j++)
+			{
+				memcpy(&flds[j].m_len, p, sizeof(uint32_t));
+				memcpy(&flds[j].m_cnt, p + sizeof(uint32_t), sizeof(uint32_t));
+				p += 2 * sizeof(uint32_t);
+				flds[j].m_val = p;
+				p += flds[j].m_len;
+			}
+
+			m_table->aggregate_shard_row(this, flds.data(), seq);
+		}
+	}
+
+	sinsp_table* m_table;
+	sinsp_table_buffer m_buffer1;
+	sinsp_table_buffer m_buffer2;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::condition_variable m_done_cond;
+	vector<vector<uint8_t>> m_pending;
+	vector<vector<uint8_t>> m_spare;
+	bool m_busy;
+	bool m_stop;
+	std::exception_ptr m_error;
+};
+
+//
+// Sketch helpers. The states live in the table buffers, aligned for the
+// doubles in the t-digest.
+//
+static inline bool is_sketch(uint32_t aggr)
+{
+	return aggr == A_DISTINCT || aggr == A_P50 || aggr == A_P99 || aggr == A_TOP;
+}
+
+static uint32_t sketch_size(uint32_t aggr)
+{
+	switch(aggr)
+	{
+	case A_DISTINCT:
+		return sizeof(libsinsp::hyperloglog);
+	case A_P50:
+	case A_P99:
+		return sizeof(libsinsp::tdigest);
+	case A_TOP:
+		return sizeof(libsinsp::count_min_top);
+	default:
+		ASSERT(false);
+		return 0;
+	}
+}
+
+static bool is_numeric_type(ppm_param_type type)
+{
+	switch(type)
+	{
+	case PT_INT8:
+	case PT_INT16:
+	case PT_INT32:
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+	case PT_UINT8:
+	case PT_UINT16:
+	case PT_UINT32:
+	case PT_UINT64:
+	case PT_PORT:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+	case PT_DOUBLE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static double to_double(ppm_param_type type, uint8_t* val)
+{
+	switch(type)
+	{
+	case PT_INT8:
+		return *(int8_t*)val;
+	case PT_INT16:
+		return *(int16_t*)val;
+	case PT_INT32:
+		return *(int32_t*)val;
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+		return (double)*(int64_t*)val;
+	case PT_UINT8:
+		return *(uint8_t*)val;
+	case PT_UINT16:
+	case PT_PORT:
+		return *(uint16_t*)val;
+	case PT_UINT32:
+		return *(uint32_t*)val;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		return (double)*(uint64_t*)val;
+	case PT_DOUBLE:
+		return *(double*)val;
+	default:
+		ASSERT(false);
+		return 0;
+	}
+}
+
+//
+// Write val in dst with the given type, returning its length
+//
+static uint32_t from_double(ppm_param_type type, double val, uint8_t* dst)
+{
+	int64_t ival = (int64_t)(val < 0? val - 0.5 : val + 0.5);
+	uint64_t uval = (val <= 0)? 0 : (uint64_t)(val + 0.5);
+
+	switch(type)
+	{
+	case PT_INT8:
+		*(int8_t*)dst = (int8_t)ival;
+		return 1;
+	case PT_INT16:
+		*(int16_t*)dst = (int16_t)ival;
+		return 2;
+	case PT_INT32:
+		*(int32_t*)dst = (int32_t)ival;
+		return 4;
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_FD:
+	case PT_PID:
+		*(int64_t*)dst = ival;
+		return 8;
+	case PT_UINT8:
+		*(uint8_t*)dst = (uint8_t)uval;
+		return 1;
+	case PT_UINT16:
+	case PT_PORT:
+		*(uint16_t*)dst = (uint16_t)uval;
+		return 2;
+	case PT_UINT32:
+		*(uint32_t*)dst = (uint32_t)uval;
+		return 4;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		*(uint64_t*)dst = uval;
+		return 8;
+	case PT_DOUBLE:
+		*(double*)dst = val;
+		return sizeof(double);
+	default:
+		ASSERT(false);
+		return 0;
+	}
+}
+
 sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_interval_ns, 
 	sinsp_table::output_type output_type, uint32_t json_first_row, uint32_t json_last_row)
 {
@@ -92,6 +431,7 @@ sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_inte
 	m_buffer = &m_buffer1;
 	m_is_sorting_ascending = false;
 	m_sorting_col = -1;
+	m_max_rows = 0;
 	m_just_sorted = true;
 	m_do_merging = true;
 	m_types = &m_premerge_types;
@@ -105,12 +445,15 @@ sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_inte
 	m_sample_data = NULL;
 	m_json_first_row = json_first_row;
 	m_json_last_row = json_last_row;
+	m_shard_seq = 0;
 }
 
 sinsp_table::~sinsp_table()
 {
 	uint32_t j;
 
+	stop_shards();
+
 	for(j = 0; j < m_chks_to_free.size(); j++)
 	{
 		delete m_chks_to_free[j];
@@ -245,6 +588,8 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 		m_premerge_legend.push_back(*(*it)->get_field_info());
 	}
 
+	m_premerge_src_types = m_premerge_types;
+
 	m_premerge_vals_array_sz = (m_n_fields - 1) * sizeof(sinsp_table_field);
 	m_vals_array_sz = m_premerge_vals_array_sz;
 
@@ -267,6 +612,7 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 		// No merge string. We can stop here
 		//
 		m_do_merging = false;
+		configure_sketches();
 		return;
 	}
 	else if(n_gby_keys > 1)
@@ -339,6 +685,8 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 	}
 
 	m_postmerge_vals_array_sz = (m_n_postmerge_fields - 1) * sizeof(sinsp_table_field);
+
+	configure_sketches();
 }
 
 void sinsp_table::add_row(bool merging)
@@ -351,6 +699,8 @@ void sinsp_table::add_row(bool merging)
 
 	if(m_type == sinsp_table::TT_TABLE)
 	{
+		vector<sinsp_table_sketch_col>* sketches = merging? &m_postmerge_sketches : &m_premerge_sketches;
+
 		//
 		// This is a table. Do a proper key lookup and update the entry
 		//
@@ -365,14 +715,23 @@ void sinsp_table::add_row(bool merging)
 			key.m_cnt = 1;
 			m_vals = (sinsp_table_field*)m_buffer->reserve(m_vals_array_sz);
 
+			//
+			// Note: the values already have their length, and when merging
+			// they can be sketch states, whose length get_field_len() can't
+			// tell
+			//
 			for(j = 1; j < m_n_fields; j++)
 			{
-				uint32_t vlen = get_field_len(j);
 				m_vals[j - 1].m_val = m_fld_pointers[j].m_val;
-				m_vals[j - 1].m_len = vlen;
+				m_vals[j - 1].m_len = m_fld_pointers[j].m_len;
 				m_vals[j - 1].m_cnt = m_fld_pointers[j].m_cnt;
 			}
 
+			if(!sketches->empty())
+			{
+				init_sketches(m_vals, m_fld_pointers, sketches, m_buffer);
+			}
+
 			(*m_table)[key] = m_vals;
 		}
 		else
@@ -393,6 +752,11 @@ void sinsp_table::add_row(bool merging)
 					add_fields(j, &m_fld_pointers[j], m_premerge_extractors[j]->m_aggregation);
 				}
 			}
+
+			if(!sketches->empty())
+			{
+				update_sketches(m_vals, m_fld_pointers, sketches);
+			}
 		}
 	}
 	else
@@ -469,8 +833,11 @@ void sinsp_table::process_event(sinsp_evt* evt)
 					return;
 				}
 
-				pfld->m_len = get_field_len(j);
-				pfld->m_val = m_buffer->copy(pfld->m_val, pfld->m_len);
+				pfld->m_len = get_field_len(m_premerge_src_types[j], pfld);
+				if(m_shards.empty())
+				{
+					pfld->m_val = m_buffer->copy(pfld->m_val, pfld->m_len);
+				}
 				pfld->m_cnt = 0;
 			}
 			else
@@ -481,15 +848,25 @@ void sinsp_table::process_event(sinsp_evt* evt)
 		else
 		{
 			pfld->m_val = val;
-			pfld->m_len = get_field_len(j);
-			pfld->m_val = m_buffer->copy(val, pfld->m_len);
+			pfld->m_len = get_field_len(m_premerge_src_types[j], pfld);
+			if(m_shards.empty())
+			{
+				pfld->m_val = m_buffer->copy(val, pfld->m_len);
+			}
 			pfld->m_cnt = 1;
 		}
 	}
 
 	//
-	// Add the row
+	// Add the row. With aggregation shards, the values are still owned by
+	// the extractors and get copied in the batch of the shard instead.
 	//
+	if(!m_shards.empty())
+	{
+		add_shard_row();
+		return;
+	}
+
 	add_row(false);
 
 	return;
@@ -552,6 +929,14 @@ void sinsp_table::flush(sinsp_evt* evt)
 			//
 			process_proctable(evt);
 
+			//
+			// Collect the rows aggregated by the shards
+			//
+			if(!m_shards.empty())
+			{
+				merge_shards();
+			}
+
 			//
 			// If there is a merging step, switch the types to point to the merging ones.
 			//
@@ -582,6 +967,11 @@ void sinsp_table::flush(sinsp_evt* evt)
 				// Clear the current data storage
 				//
 				m_buffer->clear();
+
+				for(auto shard : m_shards)
+				{
+					shard->switch_buffers();
+				}
 			}
 
 			//
@@ -827,8 +1217,7 @@ void sinsp_table::sort_sample()
 		table_row_cmp cc;
 		cc.m_colid = m_sorting_col;
 		cc.m_ascending = m_is_sorting_ascending;
-		uint32_t tyid = m_do_merging? m_sorting_col + 2 : m_sorting_col + 1;
-		cc.m_type = m_premerge_types[tyid];
+		cc.m_type = get_sorting_type();
 
 		sort(m_sample_data->begin(),
 			m_sample_data->end(),
@@ -975,7 +1364,6 @@ void sinsp_table::create_sample()
 	{
 		uint32_t j;
 		m_full_sample_data.clear();
-		sinsp_sample_row row;
 
 		//
 		// If merging is on, perform the merge and switch to the merged table 
@@ -985,6 +1373,12 @@ void sinsp_table::create_sample()
 			m_table = &m_merge_table;
 			m_merge_table.clear();
 
+			//
+			// Sketches not merged as such take part in the merge with their
+			// results
+			//
+			finalize_sketches(&m_premerge_table, &m_premerge_sketches, true);
+
 			for(auto it = m_premerge_table.begin(); it != m_premerge_table.end(); ++it)
 			{
 				for(j = 0; j < m_n_postmerge_fields; j++)
@@ -1014,22 +1408,28 @@ void sinsp_table::create_sample()
 			m_table = &m_premerge_table;
 		}
 
+		finalize_sketches(m_table, m_do_merging? &m_postmerge_sketches : &m_premerge_sketches, false);
+
 		//
 		// Emit the table
 		//
+		if(m_max_rows != 0 && m_table->size() > m_max_rows &&
+			m_sorting_col != -1 && (uint32_t)m_sorting_col < m_n_fields - 1)
+		{
+			create_top_sample();
+			return;
+		}
+
+		m_full_sample_data.reserve(m_table->size());
+
 		for(auto it = m_table->begin(); it != m_table->end(); ++it)
 		{
+			m_full_sample_data.emplace_back();
+			sinsp_sample_row& row = m_full_sample_data.back();
 			row.m_key = it->first;
 
-			row.m_values.clear();
-
 			sinsp_table_field* fields = it->second;
-			for(j = 0; j < m_n_fields - 1; j++)
-			{
-				row.m_values.push_back(fields[j]);
-			}
-
-			m_full_sample_data.push_back(row);
+			row.m_values.assign(fields, fields + m_n_fields - 1);
 		}
 	}
 	else
@@ -1042,6 +1442,48 @@ void sinsp_table::create_sample()
 	}
 }
 
+//
+// Materialize only the top m_max_rows rows by the sorting column: they
+// are picked with a partial sort of the table entries, so the cost is
+// O(n log m_max_rows) with no per row allocation for the other rows.
+//
+void sinsp_table::create_top_sample()
+{
+	table_row_cmp cc;
+	cc.m_colid = m_sorting_col;
+	cc.m_ascending = m_is_sorting_ascending;
+	cc.m_type = get_sorting_type();
+
+	typedef pair<const sinsp_table_field*, sinsp_table_field*> entry;
+	vector<entry> entries;
+	entries.reserve(m_table->size());
+	for(auto it = m_table->begin(); it != m_table->end(); ++it)
+	{
+		entries.emplace_back(&it->first, it->second);
+	}
+
+	uint32_t colid = m_sorting_col;
+	partial_sort(entries.begin(), entries.begin() + m_max_rows, entries.end(),
+		[&cc, colid](const entry& src, const entry& dst)
+		{
+			return cc.compare(src.second[colid], dst.second[colid]);
+		});
+
+	m_full_sample_data.resize(m_max_rows);
+	for(uint32_t j = 0; j < m_max_rows; j++)
+	{
+		sinsp_sample_row& row = m_full_sample_data[j];
+		row.m_key = *entries[j].first;
+		row.m_values.assign(entries[j].second, entries[j].second + m_n_fields - 1);
+	}
+}
+
+ppm_param_type sinsp_table::get_sorting_type()
+{
+	uint32_t tyid = m_do_merging? m_sorting_col + 2 : m_sorting_col + 1;
+	return m_premerge_types[tyid];
+}
+
 void sinsp_table::add_fields_sum(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src)
 {
 	uint8_t* operand1 = dst->m_val;
@@ -1176,7 +1618,7 @@ void sinsp_table::add_fields_sum_of_avg(ppm_param_type type, sinsp_table_field *
 	dst->m_cnt = 1;
 }
 
-void sinsp_table::add_fields_max(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src)
+void sinsp_table::add_fields_max(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src, sinsp_table_buffer* buffer)
 {
 	uint8_t* operand1 = dst->m_val;
 	uint8_t* operand2 = src->m_val;
@@ -1248,7 +1690,7 @@ void sinsp_table::add_fields_max(ppm_param_type type, sinsp_table_field *dst, si
 		}
 		else
 		{
-			dst->m_val = m_buffer->copy(src->m_val, src->m_len);
+			dst->m_val = buffer->copy(src->m_val, src->m_len);
 		}
 
 		dst->m_len = src->m_len;
@@ -1257,7 +1699,7 @@ void sinsp_table::add_fields_max(ppm_param_type type, sinsp_table_field *dst, si
 	}
 }
 
-void sinsp_table::add_fields_min(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src)
+void sinsp_table::add_fields_min(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src, sinsp_table_buffer* buffer)
 {
 	uint8_t* operand1 = dst->m_val;
 	uint8_t* operand2 = src->m_val;
@@ -1330,7 +1772,7 @@ void sinsp_table::add_fields_min(ppm_param_type type, sinsp_table_field *dst, si
 		}
 		else
 		{
-			dst->m_val = m_buffer->copy(src->m_val, src->m_len);
+			dst->m_val = buffer->copy(src->m_val, src->m_len);
 		}
 
 		dst->m_len = src->m_len;
@@ -1341,9 +1783,11 @@ void sinsp_table::add_fields_min(ppm_param_type type, sinsp_table_field *dst, si
 
 void sinsp_table::add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t aggr)
 {
-	ppm_param_type type = (*m_types)[dst_id];
-	sinsp_table_field* dst = &(m_vals[dst_id - 1]);
+	add_fields((*m_types)[dst_id], &(m_vals[dst_id - 1]), src, aggr, m_buffer);
+}
 
+void sinsp_table::add_fields(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src, uint32_t aggr, sinsp_table_buffer* buffer)
+{
 	switch(aggr)
 	{
 	case A_NONE:
@@ -1365,7 +1809,7 @@ void sinsp_table::add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t a
 		add_fields_sum(type, dst, src);		
 		return;
 	case A_MAX:
-		add_fields_max(type, dst, src);		
+		add_fields_max(type, dst, src, buffer);		
 		return;
 	case A_MIN:
 		if(src->m_cnt != 0)
@@ -1377,10 +1821,18 @@ void sinsp_table::add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t a
 			}
 			else
 			{
-				add_fields_min(type, dst, src);
+				add_fields_min(type, dst, src, buffer);
 			}
 		}
 		return;
+	case A_DISTINCT:
+	case A_P50:
+	case A_P99:
+	case A_TOP:
+		//
+		// Sketches are updated by update_sketches()
+		//
+		return;
 	default:
 		ASSERT(false);
 		return;
@@ -1389,12 +1841,11 @@ void sinsp_table::add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t a
 
 uint32_t sinsp_table::get_field_len(uint32_t id)
 {
-	ppm_param_type type;
-	sinsp_table_field *fld;
-
-	type = (*m_types)[id];
-	fld = &(m_fld_pointers[id]);
+	return get_field_len((*m_types)[id], &(m_fld_pointers[id]));
+}
 
+uint32_t sinsp_table::get_field_len(ppm_param_type type, sinsp_table_field* fld)
+{
 	switch(type)
 	{
 	case PT_INT8:
@@ -1506,6 +1957,471 @@ void sinsp_table::switch_buffers()
 	}
 }
 
+void sinsp_table::set_aggregation_shards(uint32_t nshards)
+{
+	if(nshards > 1 && m_type != sinsp_table::TT_TABLE)
+	{
+		throw sinsp_exception("aggregation shards are only supported by tables");
+	}
+
+	if(m_shard_seq != 0 || !m_premerge_table.empty())
+	{
+		throw sinsp_exception("aggregation shards must be set before the first event");
+	}
+
+	stop_shards();
+
+	if(nshards > 1)
+	{
+		for(uint32_t j = 0; j < nshards; j++)
+		{
+			m_shards.push_back(new sinsp_table_shard(this));
+		}
+	}
+}
+
+void sinsp_table::stop_shards()
+{
+	for(auto shard : m_shards)
+	{
+		delete shard;
+	}
+
+	m_shards.clear();
+}
+
+//
+// Append the row in m_premerge_fld_pointers to the batch of the shard
+// owning its key, as [seq][len, cnt, value] for every field
+//
+void sinsp_table::add_shard_row()
+{
+	uint32_t j;
+	sinsp_table_field* flds = m_premerge_fld_pointers;
+
+	//
+	// Scramble the key hash again before picking the shard, so that the
+	// shard tables don't all end up with the same low hash bits
+	//
+	uint64_t h = (uint64_t)sinsp_table_field_hasher()(flds[0]) * 0x9e3779b97f4a7c15ULL;
+	sinsp_table_shard* shard = m_shards[(uint32_t)(h >> 32) % m_shards.size()];
+
+	size_t size = sizeof(uint64_t);
+	for(j = 0; j < m_n_premerge_fields; j++)
+	{
+		size += 2 * sizeof(uint32_t) + flds[j].m_len;
+	}
+
+	vector<uint8_t>& batch = shard->m_batch;
+	size_t pos = batch.size();
+	batch.resize(pos + size);
+	uint8_t* p = &batch[pos];
+
+	memcpy(p, &m_shard_seq, sizeof(uint64_t));
+	p += sizeof(uint64_t);
+
+	for(j = 0; j < m_n_premerge_fields; j++)
+	{
+		memcpy(p, &flds[j].m_len, sizeof(uint32_t));
+		memcpy(p + sizeof(uint32_t), &flds[j].m_cnt, sizeof(uint32_t));
+		p += 2 * sizeof(uint32_t);
+		memcpy(p, flds[j].m_val, flds[j].m_len);
+		p += flds[j].m_len;
+	}
+
+	m_shard_seq++;
+
+	if(batch.size() >= SINSP_TABLE_SHARD_BATCH_SIZE)
+	{
+		shard->submit();
+	}
+}
+
+//
+// The shard counterpart of add_row(false). Runs on the shard thread, so it
+// only touches the shard and the premerge configuration of the table.
+//
+void sinsp_table::aggregate_shard_row(sinsp_table_shard* shard, sinsp_table_field* flds, uint64_t seq)
+{
+	uint32_t j;
+
+	auto it = shard->m_rows.find(flds[0]);
+
+	if(it == shard->m_rows.end())
+	{
+		sinsp_table_buffer* buffer = shard->m_buffer;
+		sinsp_table_field key(buffer->copy(flds[0].m_val, flds[0].m_len), flds[0].m_len, 1);
+		sinsp_table_field* vals = (sinsp_table_field*)buffer->reserve(m_premerge_vals_array_sz);
+
+		for(j = 1; j < m_n_premerge_fields; j++)
+		{
+			vals[j - 1].m_val = buffer->copy(flds[j].m_val, flds[j].m_len);
+			vals[j - 1].m_len = flds[j].m_len;
+			vals[j - 1].m_cnt = flds[j].m_cnt;
+		}
+
+		if(!m_premerge_sketches.empty())
+		{
+			init_sketches(vals, flds, &m_premerge_sketches, buffer);
+		}
+
+		shard->m_rows[key] = vals;
+		shard->m_new_rows.push_back({seq, key, vals});
+	}
+	else
+	{
+		for(j = 1; j < m_n_premerge_fields; j++)
+		{
+			add_fields(m_premerge_types[j], &it->second[j - 1], &flds[j],
+				m_premerge_extractors[j]->m_aggregation, shard->m_buffer);
+		}
+
+		if(!m_premerge_sketches.empty())
+		{
+			update_sketches(it->second, flds, &m_premerge_sketches);
+		}
+	}
+}
+
+void sinsp_table::merge_shards()
+{
+	uint32_t j;
+
+	//
+	// Wait for all the shards before reporting an error, so that none of
+	// them is still running when the buffers get switched
+	//
+	std::exception_ptr error;
+	for(auto shard : m_shards)
+	{
+		try
+		{
+			shard->drain();
+		}
+		catch(...)
+		{
+			if(!error)
+			{
+				error = std::current_exception();
+			}
+		}
+	}
+
+	if(error)
+	{
+		std::rethrow_exception(error);
+	}
+
+	//
+	// Every key lives in a single shard, so there's nothing to aggregate
+	// here. Insert the rows in the order their keys were first seen, which
+	// gives the premerge table the same content and iteration order it
+	// gets in the serial path.
+	//
+	vector<size_t> pos(m_shards.size(), 0);
+
+	while(true)
+	{
+		sinsp_table_shard::new_row* next = NULL;
+		uint32_t next_shard = 0;
+
+		for(j = 0; j < m_shards.size(); j++)
+		{
+			if(pos[j] < m_shards[j]->m_new_rows.size())
+			{
+				sinsp_table_shard::new_row* row = &m_shards[j]->m_new_rows[pos[j]];
+				if(next == NULL || row->m_seq < next->m_seq)
+				{
+					next = row;
+					next_shard = j;
+				}
+			}
+		}
+
+		if(next == NULL)
+		{
+			break;
+		}
+
+		m_premerge_table[next->m_key] = next->m_vals;
+		pos[next_shard]++;
+	}
+}
+
+void sinsp_table::configure_sketches()
+{
+	uint32_t j;
+
+	//
+	// Lists don't aggregate
+	//
+	if(m_type != sinsp_table::TT_TABLE)
+	{
+		return;
+	}
+
+	for(j = 1; j < m_n_premerge_fields; j++)
+	{
+		sinsp_filter_check* chk = m_premerge_extractors[j];
+		sinsp_table_sketch_col col;
+
+		if(!is_sketch(chk->m_aggregation))
+		{
+			continue;
+		}
+
+		col.m_id = j;
+		col.m_aggregation = chk->m_aggregation;
+		col.m_src_type = m_premerge_types[j];
+		col.m_merge_states = false;
+		col.m_keep_states = m_do_merging && chk->m_merge_aggregation == chk->m_aggregation &&
+			m_groupby_columns[0] != j;
+		m_premerge_sketches.push_back(col);
+	}
+
+	for(j = 1; m_do_merging && j < m_n_postmerge_fields; j++)
+	{
+		sinsp_filter_check* chk = m_postmerge_extractors[j];
+		sinsp_table_sketch_col col;
+
+		if(!is_sketch(chk->m_merge_aggregation))
+		{
+			continue;
+		}
+
+		col.m_id = j;
+		col.m_aggregation = chk->m_merge_aggregation;
+		col.m_merge_states = (chk->m_aggregation == chk->m_merge_aggregation);
+		col.m_keep_states = false;
+		col.m_src_type = m_premerge_types[m_groupby_columns[j]];
+		m_postmerge_sketches.push_back(col);
+	}
+
+	//
+	// Update the column types to the ones of the sketch results. The
+	// postmerge columns get their values from the premerge ones.
+	//
+	for(auto& col : m_premerge_sketches)
+	{
+		if((col.m_aggregation == A_P50 || col.m_aggregation == A_P99) && !is_numeric_type(col.m_src_type))
+		{
+			throw sinsp_exception("percentile aggregation of non numeric field " + 
+				string(m_premerge_legend[col.m_id].m_name));
+		}
+
+		if(col.m_aggregation == A_DISTINCT)
+		{
+			m_premerge_types[col.m_id] = PT_UINT64;
+			m_premerge_legend[col.m_id].m_type = PT_UINT64;
+			m_premerge_legend[col.m_id].m_print_format = PF_DEC;
+		}
+	}
+
+	for(j = 0; m_do_merging && j < m_n_postmerge_fields; j++)
+	{
+		m_postmerge_types[j] = m_premerge_types[m_groupby_columns[j]];
+		m_postmerge_legend[j] = m_premerge_legend[m_groupby_columns[j]];
+	}
+
+	for(auto& col : m_postmerge_sketches)
+	{
+		if(col.m_merge_states)
+		{
+			col.m_src_type = m_premerge_src_types[m_groupby_columns[col.m_id]];
+		}
+		else if((col.m_aggregation == A_P50 || col.m_aggregation == A_P99) && !is_numeric_type(col.m_src_type))
+		{
+			throw sinsp_exception("percentile aggregation of non numeric field " + 
+				string(m_postmerge_legend[col.m_id].m_name));
+		}
+
+		if(col.m_aggregation == A_DISTINCT)
+		{
+			m_postmerge_types[col.m_id] = PT_UINT64;
+			m_postmerge_legend[col.m_id].m_type = PT_UINT64;
+			m_postmerge_legend[col.m_id].m_print_format = PF_DEC;
+		}
+	}
+}
+
+//
+// Create the sketch states of a new row, from the values in flds
+//
+void sinsp_table::init_sketches(sinsp_table_field* vals, sinsp_table_field* flds, 
+	vector<sinsp_table_sketch_col>* sketches, sinsp_table_buffer* buffer)
+{
+	for(auto& col : *sketches)
+	{
+		sinsp_table_field* dst = &vals[col.m_id - 1];
+
+		if(col.m_merge_states)
+		{
+			//
+			// Like the other values, adopt the state of the first premerge row
+			//
+			continue;
+		}
+
+		uint32_t size = sketch_size(col.m_aggregation);
+		uint8_t* state = buffer->reserve(size + 7);
+		state = (uint8_t*)(((uintptr_t)state + 7) & ~(uintptr_t)7);
+
+		switch(col.m_aggregation)
+		{
+		case A_DISTINCT:
+			((libsinsp::hyperloglog*)state)->init();
+			break;
+		case A_P50:
+		case A_P99:
+			((libsinsp::tdigest*)state)->init();
+			break;
+		case A_TOP:
+			((libsinsp::count_min_top*)state)->init();
+			break;
+		default:
+			ASSERT(false);
+			break;
+		}
+
+		dst->m_val = state;
+		dst->m_len = size;
+		dst->m_cnt = 1;
+	}
+
+	update_sketches(vals, flds, sketches);
+}
+
+void sinsp_table::update_sketches(sinsp_table_field* vals, sinsp_table_field* flds, 
+	vector<sinsp_table_sketch_col>* sketches)
+{
+	for(auto& col : *sketches)
+	{
+		sinsp_table_field* src = &flds[col.m_id];
+		uint8_t* state = vals[col.m_id - 1].m_val;
+
+		if(col.m_merge_states)
+		{
+			if(state != src->m_val)
+			{
+				switch(col.m_aggregation)
+				{
+				case A_DISTINCT:
+					((libsinsp::hyperloglog*)state)->merge(*(libsinsp::hyperloglog*)src->m_val);
+					break;
+				case A_P50:
+				case A_P99:
+					((libsinsp::tdigest*)state)->merge(*(libsinsp::tdigest*)src->m_val);
+					break;
+				case A_TOP:
+					((libsinsp::count_min_top*)state)->merge(*(libsinsp::count_min_top*)src->m_val);
+					break;
+				default:
+					ASSERT(false);
+					break;
+				}
+			}
+
+			continue;
+		}
+
+		//
+		// Defaults don't count
+		//
+		if(src->m_cnt == 0)
+		{
+			continue;
+		}
+
+		switch(col.m_aggregation)
+		{
+		case A_DISTINCT:
+			((libsinsp::hyperloglog*)state)->add(src->m_val, src->m_len);
+			break;
+		case A_P50:
+		case A_P99:
+			((libsinsp::tdigest*)state)->add(to_double(col.m_src_type, src->m_val) / src->m_cnt);
+			break;
+		case A_TOP:
+			((libsinsp::count_min_top*)state)->add(src->m_val, src->m_len);
+			break;
+		default:
+			ASSERT(false);
+			break;
+		}
+	}
+}
+
+//
+// Replace the sketch states of the table rows with their results, which
+// are written over the states. When merging, skip the states that the
+// merge will combine.
+//
+void sinsp_table::finalize_sketches(unordered_map<sinsp_table_field, sinsp_table_field*, sinsp_table_field_hasher>* table, 
+	vector<sinsp_table_sketch_col>* sketches, bool merging)
+{
+	if(sketches->empty())
+	{
+		return;
+	}
+
+	for(auto it = table->begin(); it != table->end(); ++it)
+	{
+		for(auto& col : *sketches)
+		{
+			sinsp_table_field* fld = &it->second[col.m_id - 1];
+			uint8_t* state = fld->m_val;
+
+			if(merging && col.m_keep_states)
+			{
+				continue;
+			}
+
+			switch(col.m_aggregation)
+			{
+			case A_DISTINCT:
+			{
+				uint64_t res = ((libsinsp::hyperloglog*)state)->estimate();
+				memcpy(state, &res, sizeof(res));
+				fld->m_len = sizeof(res);
+				break;
+			}
+			case A_P50:
+			case A_P99:
+			{
+				double res = ((libsinsp::tdigest*)state)->quantile(col.m_aggregation == A_P50? 0.5 : 0.99);
+				fld->m_len = from_double(col.m_src_type, res, state);
+				break;
+			}
+			case A_TOP:
+			{
+				uint32_t len;
+				const uint8_t* res = ((libsinsp::count_min_top*)state)->top(&len);
+				if(res != NULL)
+				{
+					fld->m_val = (uint8_t*)res;
+					fld->m_len = len;
+				}
+				else
+				{
+					//
+					// Only defaults were seen, use a zero value
+					//
+					memset(state, 0, 16);
+					fld->m_len = 0;
+					fld->m_len = get_field_len(col.m_src_type, fld);
+				}
+				break;
+			}
+			default:
+				ASSERT(false);
+				break;
+			}
+
+			fld->m_cnt = 1;
+		}
+	}
+}
+
 pair<filtercheck_field_info*, string> sinsp_table::get_row_key_name_and_val(uint32_t rownum, bool force)
 {
 	pair<filtercheck_field_info*, string> res;
@@ -17,8 +17,10 @@ limitations under the License.
 
 #define SINSP_TABLE_DEFAULT_REFRESH_INTERVAL_NS 1000000000
 #define SINSP_TABLE_BUFFER_ENTRY_SIZE 16384
+#define SINSP_TABLE_SHARD_BATCH_SIZE (256 * 1024)
 
 class sinsp_filter_check_reference;
+class sinsp_table_shard;
 
 typedef enum sysdig_table_action
 {
@@ -122,21 +124,45 @@ private:
 	uint32_t m_storage_len;
 };
 
+//
+// MurmurHash64A-style hash of the field bytes, a word at a time
+//
 struct sinsp_table_field_hasher
 {
-  size_t operator()(const sinsp_table_field& k) const
-  {
-	  size_t h = 0;
-	  uint8_t* s = k.m_val;
-	  uint32_t len = k.m_len;
-
-	  while(--len)
-	  {
-		  h = h * 101 + (unsigned) *s++;
-	  }
-
-	  return h;  
-  }
+	size_t operator()(const sinsp_table_field& k) const
+	{
+		const uint64_t m = 0xc6a4a7935bd1e995ULL;
+		const uint8_t* s = k.m_val;
+		uint32_t len = k.m_len;
+		uint64_t h = 0x9e3779b97f4a7c15ULL ^ (len * m);
+		uint64_t w;
+
+		for(; len >= sizeof(w); len -= sizeof(w), s += sizeof(w))
+		{
+			memcpy(&w, s, sizeof(w));
+			h = (h ^ mix(w)) * m;
+		}
+
+		if(len != 0)
+		{
+			w = 0;
+			memcpy(&w, s, len);
+			h = (h ^ mix(w)) * m;
+		}
+
+		h ^= h >> 47;
+		h *= m;
+		h ^= h >> 47;
+		return (size_t)h;
+	}
+
+private:
+	static inline uint64_t mix(uint64_t w)
+	{
+		w *= 0xc6a4a7935bd1e995ULL;
+		w ^= w >> 47;
+		return w * 0xc6a4a7935bd1e995ULL;
+	}
 };
 
 class sinsp_table_buffer
@@ -210,6 +236,24 @@ public:
 	uint32_t m_pos;
 };
 
+//
+// A table column aggregated by a sketch. Its rows hold the sketch state
+// until the sample is created, when the state is replaced by the result.
+//
+typedef struct sinsp_table_sketch_col
+{
+	uint32_t m_id;
+	sinsp_field_aggregation m_aggregation;
+	// the type of the values added to the sketch
+	ppm_param_type m_src_type;
+	// for a postmerge column, whether its values are premerge states to
+	// merge, because both columns have the same aggregation
+	bool m_merge_states;
+	// for a premerge column, whether its states are left to the postmerge
+	// column that merges them instead of being finalized
+	bool m_keep_states;
+}sinsp_table_sketch_col;
+
 class sinsp_sample_row
 {
 public:
@@ -290,6 +334,33 @@ public:
 	{
 		m_is_sorting_ascending = is_sorting_ascending;
 	}
+	//
+	// Limit the samples of tables to their top rows by the sorting
+	// column, so that large tables don't need to materialize and sort
+	// every row. 0, the default, means no limit. Note that the
+	// freetext filter and search_in_sample() only see these rows, and
+	// that the rows are picked with the sorting column of the flush.
+	//
+	void set_max_rows(uint32_t max_rows)
+	{
+		m_max_rows = max_rows;
+	}
+	uint32_t get_max_rows()
+	{
+		return m_max_rows;
+	}
+	//
+	// Aggregate tables on nshards worker threads: the event thread only
+	// extracts the row values, and each thread owns the rows whose key
+	// hashes to it. The rows are merged back at flush time, with the
+	// same results as the serial aggregation. Must be set before the
+	// first event; 0 or 1 means no worker threads.
+	//
+	void set_aggregation_shards(uint32_t nshards);
+	uint32_t get_aggregation_shards()
+	{
+		return (uint32_t)m_shards.size();
+	}
 
 	uint64_t m_next_flush_time_ns;
 	uint64_t m_prev_flush_time_ns;
@@ -301,13 +372,25 @@ private:
 	inline void add_row(bool merging);
 	inline void add_fields_sum(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
 	inline void add_fields_sum_of_avg(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
-	inline void add_fields_max(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
-	inline void add_fields_min(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
+	inline void add_fields_max(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src, sinsp_table_buffer* buffer);
+	inline void add_fields_min(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src, sinsp_table_buffer* buffer);
 	inline void add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t aggr);
+	inline void add_fields(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src, uint32_t aggr, sinsp_table_buffer* buffer);
 	void process_proctable(sinsp_evt* evt);
 	inline uint32_t get_field_len(uint32_t id);
+	inline uint32_t get_field_len(ppm_param_type type, sinsp_table_field* fld);
 	inline uint8_t* get_default_val(filtercheck_field_info* fld);
+	void add_shard_row();
+	void aggregate_shard_row(sinsp_table_shard* shard, sinsp_table_field* flds, uint64_t seq);
+	void merge_shards();
+	void stop_shards();
+	void configure_sketches();
+	void init_sketches(sinsp_table_field* vals, sinsp_table_field* flds, vector<sinsp_table_sketch_col>* sketches, sinsp_table_buffer* buffer);
+	void update_sketches(sinsp_table_field* vals, sinsp_table_field* flds, vector<sinsp_table_sketch_col>* sketches);
+	void finalize_sketches(unordered_map<sinsp_table_field, sinsp_table_field*, sinsp_table_field_hasher>* table, vector<sinsp_table_sketch_col>* sketches, bool merging);
 	void create_sample();
+	void create_top_sample();
+	ppm_param_type get_sorting_type();
 	void switch_buffers();
 	void print_raw(vector<sinsp_sample_row>* sample_data, uint64_t time_delta);
 	void print_json(vector<sinsp_sample_row>* sample_data, uint64_t time_delta);
@@ -323,6 +406,11 @@ private:
 	vector<sinsp_filter_check*> m_chks_to_free;
 	vector<ppm_param_type> m_premerge_types;
 	vector<ppm_param_type> m_postmerge_types;
+	// the types of the extracted values, which for sketch columns differ
+	// from the types in m_premerge_types
+	vector<ppm_param_type> m_premerge_src_types;
+	vector<sinsp_table_sketch_col> m_premerge_sketches;
+	vector<sinsp_table_sketch_col> m_postmerge_sketches;
 	bool m_is_key_present;
 	bool m_is_groupby_key_present;
 	vector<uint32_t> m_groupby_columns;
@@ -345,6 +433,7 @@ private:
 	vector<sinsp_sample_row>* m_sample_data;
 	sinsp_table_field* m_vals;
 	int32_t m_sorting_col;
+	uint32_t m_max_rows;
 	bool m_just_sorted;
 	bool m_is_sorting_ascending;
 	bool m_do_merging;
@@ -359,7 +448,10 @@ private:
 	uint32_t m_view_depth;
 	uint32_t m_json_first_row;
 	uint32_t m_json_last_row;
+	vector<sinsp_table_shard*> m_shards;
+	uint64_t m_shard_seq;
 
 	friend class curses_table;	
 	friend class sinsp_cursesui;
+	friend class sinsp_table_shard;
 };
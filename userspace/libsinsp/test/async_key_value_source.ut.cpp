@@ -0,0 +1,228 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <async_key_value_source.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+
+/**
+ * A source whose lookups block until release() is called, so that
+ * the tests can observe how many of them run at the same time
+ */
+class blocking_source : public sysdig::async_key_value_source<std::string, std::string>
+{
+public:
+	explicit blocking_source(uint32_t max_workers, uint64_t ttl_ms = 60000):
+		async_key_value_source(NO_WAIT_LOOKUP, ttl_ms, max_workers),
+		m_active(0),
+		m_max_active(0),
+		m_idle_runs(0),
+		m_released(false)
+	{
+	}
+
+	~blocking_source()
+	{
+		release();
+		stop();
+	}
+
+	void release()
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_released = true;
+		m_release_cond.notify_all();
+	}
+
+	uint32_t lookups(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_lookups[key];
+	}
+
+	std::atomic<uint32_t> m_active;
+	std::atomic<uint32_t> m_max_active;
+	// run_impl() calls that ran out of keys to look up
+	std::atomic<uint32_t> m_idle_runs;
+
+protected:
+	void run_impl() override
+	{
+		std::string key;
+
+		while(dequeue_next_key(key))
+		{
+			uint32_t active = ++m_active;
+			uint32_t max_active = m_max_active;
+			while(active > max_active && !m_max_active.compare_exchange_weak(max_active, active))
+			{
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(m_lock);
+				m_lookups[key]++;
+				m_release_cond.wait(lock, [this] { return m_released; });
+			}
+
+			--m_active;
+			store_value(key, "value-" + key);
+		}
+
+		++m_idle_runs;
+	}
+
+private:
+	std::mutex m_lock;
+	std::condition_variable m_release_cond;
+	bool m_released;
+	std::map<std::string, uint32_t> m_lookups;
+};
+
+template<typename Pred>
+bool wait_for(Pred pred)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+	while(!pred())
+	{
+		if(std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return true;
+}
+
+}
+
+TEST(async_key_value_source_test, concurrency_limit)
+{
+	blocking_source source(3);
+	std::string value;
+
+	for(int i = 0; i < 10; i++)
+	{
+		ASSERT_FALSE(source.lookup(std::to_string(i), value));
+	}
+
+	ASSERT_TRUE(wait_for([&] { return source.m_active == 3; }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ASSERT_EQ(3, source.m_max_active);
+
+	source.release();
+
+	std::unordered_map<std::string, std::string> results;
+	ASSERT_TRUE(wait_for([&] {
+		for(const auto& it : source.get_complete_results())
+		{
+			results.insert(it);
+		}
+		return results.size() == 10;
+	}));
+
+	for(int i = 0; i < 10; i++)
+	{
+		ASSERT_EQ("value-" + std::to_string(i), results[std::to_string(i)]);
+	}
+	ASSERT_EQ(3, source.m_max_active);
+}
+
+TEST(async_key_value_source_test, duplicate_requests)
+{
+	blocking_source source(4);
+	std::string value;
+	std::mutex lock;
+	std::map<std::string, std::string> callbacks;
+
+	auto cb = [&](const std::string& key, const std::string& value)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		callbacks[key] = value;
+	};
+
+	ASSERT_FALSE(source.lookup("a", value, cb));
+	ASSERT_TRUE(wait_for([&] { return source.m_active == 1; }));
+
+	// a second request while the first one is in progress must not
+	// start another lookup
+	ASSERT_FALSE(source.lookup("a", value, cb));
+	ASSERT_FALSE(source.lookup("b", value, cb));
+	ASSERT_TRUE(wait_for([&] { return source.m_active == 2; }));
+
+	source.release();
+
+	ASSERT_TRUE(wait_for([&] {
+		std::lock_guard<std::mutex> guard(lock);
+		return callbacks.size() == 2;
+	}));
+
+	ASSERT_EQ("value-a", callbacks["a"]);
+	ASSERT_EQ("value-b", callbacks["b"]);
+	ASSERT_EQ(1, source.lookups("a"));
+	ASSERT_EQ(1, source.lookups("b"));
+}
+
+TEST(async_key_value_source_test, duplicate_in_flight_request)
+{
+	blocking_source source(3, 100);
+	std::string value;
+	std::mutex lock;
+	std::map<std::string, std::string> callbacks;
+
+	auto cb = [&](const std::string& key, const std::string& value)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		callbacks[key] = value;
+	};
+
+	ASSERT_FALSE(source.lookup("a", value, cb));
+	ASSERT_TRUE(wait_for([&] { return source.m_active == 1; }));
+
+	// let the pending request for "a" expire, the next worker
+	// prunes it while the lookup is still blocked
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	ASSERT_FALSE(source.lookup("b", value, cb));
+	ASSERT_TRUE(wait_for([&] { return source.m_active == 2; }));
+
+	// "a" is queued again while the first worker is still looking it
+	// up: the third worker must skip it instead of starting a new lookup
+	ASSERT_FALSE(source.lookup("a", value, cb));
+	ASSERT_TRUE(wait_for([&] { return source.m_idle_runs == 1; }));
+	ASSERT_EQ(2, source.m_active);
+
+	source.release();
+
+	ASSERT_TRUE(wait_for([&] {
+		std::lock_guard<std::mutex> guard(lock);
+		return callbacks.size() == 2;
+	}));
+
+	ASSERT_EQ("value-a", callbacks["a"]);
+	ASSERT_EQ("value-b", callbacks["b"]);
+	ASSERT_EQ(1, source.lookups("a"));
+	ASSERT_EQ(1, source.lookups("b"));
+}
@@ -0,0 +1,234 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// to build the events by hand
+#define VISIBILITY_PRIVATE
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "chisel.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <unistd.h>
+
+extern sinsp_evttables g_infotables;
+
+namespace {
+
+//
+// The same computation over three fields, done with one Lua call and
+// three evt.field() calls per event, with the FFI view, and with
+// batches. The total is written to the file given as argument. The FFI
+// chisel writes -1 instead with stock Lua, which has no FFI, and -2 if
+// LuaJIT didn't give it the view.
+//
+const char* chisel_common =
+	"description = 'test'\n"
+	"short_description = 'test'\n"
+	"category = 'test'\n"
+	"args = {{name = 'out', description = 'result file', argtype = 'string'}}\n"
+	"local out\n"
+	"local total = 0\n"
+	"local fpid, fname, fvmsize\n"
+	"function on_set_arg(name, val) out = val return true end\n"
+	"function request_fields()\n"
+	"	fpid = chisel.request_field('proc.pid')\n"
+	"	fname = chisel.request_field('proc.name')\n"
+	"	fvmsize = chisel.request_field('thread.vmsize')\n"
+	"end\n"
+	"function on_capture_end()\n"
+	"	local f = io.open(out, 'w')\n"
+	"	f:write(string.format('%.0f', total))\n"
+	"	f:close()\n"
+	"end\n";
+
+const char* chisel_field =
+	"function on_init() request_fields() return true end\n"
+	"function on_event()\n"
+	"	total = total + evt.field(fpid) + evt.field(fvmsize) + #evt.field(fname)\n"
+	"	return true\n"
+	"end\n";
+
+const char* chisel_ffi =
+	"local ffi, view\n"
+	"function on_init()\n"
+	"	request_fields()\n"
+	"	view = chisel.get_ffi_view()\n"
+	"	if view ~= nil then ffi = require('ffi')\n"
+	"	elseif jit then total = -2\n"
+	"	else total = -1 end\n"
+	"	return true\n"
+	"end\n"
+	"function on_event()\n"
+	"	if view == nil then return true end\n"
+	"	local f = view.m_fields\n"
+	"	total = total + tonumber(ffi.cast('const int64_t*', f[0].m_val)[0]) +\n"
+	"		tonumber(ffi.cast('const uint64_t*', f[2].m_val)[0]) + f[1].m_len\n"
+	"	return true\n"
+	"end\n";
+
+const char* chisel_batch =
+	"function on_init()\n"
+	"	request_fields()\n"
+	"	chisel.set_event_batch(256)\n"
+	"	return true\n"
+	"end\n"
+	"function on_event_batch(n, cols)\n"
+	"	local pids, names, vmsizes = cols[1], cols[2], cols[3]\n"
+	"	for i = 1, n do\n"
+	"		total = total + pids[i] + vmsizes[i] + #names[i]\n"
+	"	end\n"
+	"end\n";
+
+//
+// Counts the batched events, flagging empty or oversized batches
+//
+const char* chisel_batch_count =
+	"function on_init()\n"
+	"	request_fields()\n"
+	"	chisel.set_event_batch(256)\n"
+	"	return true\n"
+	"end\n"
+	"function on_event_batch(n, cols)\n"
+	"	if n == 0 or n > 256 or #cols[1] ~= n then total = -1e9 end\n"
+	"	total = total + n\n"
+	"end\n";
+
+const char* comms[] = {"bash", "sshd", "nginx", "postgres", "java", "python3", "node"};
+
+//
+// Run n_evts events of random fake threads through a chisel, returning
+// its total and the time it took
+//
+double run_chisel(const char* body, uint32_t n_evts, uint64_t* elapsed_ns)
+{
+	char dir[] = "/tmp/chisel_ut_XXXXXX";
+	EXPECT_NE(nullptr, mkdtemp(dir));
+	std::string path = std::string(dir) + "/test_chisel.lua";
+	std::string out = std::string(dir) + "/out";
+	{
+		std::ofstream f(path);
+		f << chisel_common << body;
+	}
+
+	sinsp inspector;
+	std::mt19937 rng(42);
+	vector<sinsp_threadinfo> threads(100);
+	for(uint32_t j = 0; j < threads.size(); j++)
+	{
+		threads[j].m_tid = 1000 + j;
+		threads[j].m_pid = 1000 + j - (j % 4);
+		threads[j].m_comm = comms[rng() % (sizeof(comms) / sizeof(comms[0]))];
+		threads[j].m_vmsize_kb = rng() % 100000;
+	}
+
+	scap_evt scapevt;
+	scapevt.ts = 10 * ONE_SECOND_IN_NS;
+	scapevt.type = PPME_SYSDIGEVENT_X;
+	scapevt.len = sizeof(scapevt);
+	scapevt.nparams = 0;
+
+	sinsp_evt evt;
+	evt.m_inspector = &inspector;
+	evt.m_info = &(g_infotables.m_event_info[PPME_SYSDIGEVENT_X]);
+	evt.m_pevt = &scapevt;
+	evt.m_cpuid = 0;
+	evt.m_fdinfo = NULL;
+
+	sinsp_chisel ch(&inspector, path);
+	ch.set_args(out);
+	ch.on_init();
+
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t j = 0; j < n_evts; j++)
+	{
+		evt.m_tinfo = &threads[rng() % threads.size()];
+		evt.m_evtnum = j;
+		scapevt.tid = evt.m_tinfo->m_tid;
+		scapevt.ts++;
+		ch.run(&evt);
+	}
+	ch.on_capture_end();
+	*elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+
+	double total = 0;
+	std::ifstream f(out);
+	f >> total;
+
+	unlink(out.c_str());
+	unlink(path.c_str());
+	rmdir(dir);
+	return total;
+}
+
+}
+
+TEST(chisel, event_batches)
+{
+	uint64_t elapsed;
+
+	// three full batches, then on_capture_end() delivers the last 232 events
+	ASSERT_EQ(1000, run_chisel(chisel_batch_count, 1000, &elapsed));
+
+	// and no empty batch when the events fill the last one
+	ASSERT_EQ(768, run_chisel(chisel_batch_count, 768, &elapsed));
+}
+
+TEST(chisel, field_access_paths)
+{
+	uint64_t elapsed;
+	double expected = run_chisel(chisel_field, 10000, &elapsed);
+	ASSERT_GT(expected, 0);
+
+	// the last batch is only partially filled
+	ASSERT_EQ(expected, run_chisel(chisel_batch, 10000, &elapsed));
+
+	double ffi = run_chisel(chisel_ffi, 10000, &elapsed);
+	ASSERT_NE(-2, ffi);
+	if(ffi != -1)
+	{
+		ASSERT_EQ(expected, ffi);
+	}
+}
+
+//
+// Per event cost of evt.field(), of the batches and of the FFI view,
+// including the Lua work of the chisels. It only prints the timings
+//
+TEST(chisel, DISABLED_field_access_benchmark)
+{
+	const uint32_t n_evts = 2000000;
+	const char* names[] = {"evt.field", "batch", "ffi"};
+	const char* bodies[] = {chisel_field, chisel_batch, chisel_ffi};
+
+	for(uint32_t j = 0; j < 3; j++)
+	{
+		uint64_t elapsed;
+		if(run_chisel(bodies[j], n_evts, &elapsed) == -1)
+		{
+			std::cout << names[j] << ": not available" << std::endl;
+			continue;
+		}
+
+		std::cout << names[j] << ": " << elapsed / n_evts << " ns" << std::endl;
+	}
+}
@@ -0,0 +1,89 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "container.h"
+
+#include <thread>
+
+namespace {
+
+sinsp_container_info::ptr_t make_container(const std::string& id, const std::string& name)
+{
+	auto container = std::make_shared<sinsp_container_info>();
+	container->m_id = id;
+	container->m_type = CT_DOCKER;
+	container->m_name = name;
+	return container;
+}
+
+}
+
+TEST(container_manager, batched_containers_are_visible)
+{
+	sinsp inspector;
+	sinsp_container_manager& manager = inspector.m_container_manager;
+
+	manager.add_container(make_container("aaaaaaaaaaaa", "before"), nullptr);
+	auto published = manager.get_containers();
+
+	manager.begin_batch();
+	manager.add_container(make_container("bbbbbbbbbbbb", "batched"), nullptr);
+	manager.replace_container(make_container("aaaaaaaaaaaa", "replaced"));
+
+	// lookups from any thread see the batch
+	ASSERT_EQ("replaced", manager.get_container("aaaaaaaaaaaa")->m_name);
+	std::thread([&manager] {
+		ASSERT_TRUE(manager.container_exists("bbbbbbbbbbbb"));
+	}).join();
+	ASSERT_EQ(2u, manager.get_containers()->size());
+
+	// but it isn't published yet
+	ASSERT_EQ(1u, published->size());
+	ASSERT_EQ("before", published->at("aaaaaaaaaaaa")->m_name);
+
+	manager.end_batch();
+	auto containers = manager.get_containers();
+	ASSERT_EQ(2u, containers->size());
+	ASSERT_EQ("replaced", containers->at("aaaaaaaaaaaa")->m_name);
+	ASSERT_EQ("batched", containers->at("bbbbbbbbbbbb")->m_name);
+
+	// out of a batch, containers are published right away
+	manager.add_container(make_container("cccccccccccc", "after"), nullptr);
+	ASSERT_EQ(3u, manager.get_containers()->size());
+}
+
+TEST(container_manager, removal_publishes_the_batch)
+{
+	sinsp inspector;
+	sinsp_container_manager& manager = inspector.m_container_manager;
+
+	manager.begin_batch();
+	manager.add_container(make_container("aaaaaaaaaaaa", "removed"), nullptr);
+	manager.add_container(make_container("bbbbbbbbbbbb", "kept"), nullptr);
+	manager.notify_removed_container("aaaaaaaaaaaa");
+	manager.remove_inactive_containers();
+
+	ASSERT_EQ(nullptr, manager.get_container("aaaaaaaaaaaa"));
+	ASSERT_NE(nullptr, manager.get_container("bbbbbbbbbbbb"));
+
+	// still batching
+	manager.add_container(make_container("cccccccccccc", "batched"), nullptr);
+	manager.end_batch();
+	ASSERT_EQ(2u, manager.get_containers()->size());
+}
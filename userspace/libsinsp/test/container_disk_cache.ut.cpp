@@ -0,0 +1,145 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <container_disk_cache.h>
+
+#include <cstdio>
+#include <unistd.h>
+
+using namespace libsinsp;
+
+namespace {
+
+sinsp_container_info::ptr_t make_container(const std::string& id, const std::string& imageid)
+{
+	auto container = std::make_shared<sinsp_container_info>();
+	container->m_id = id;
+	container->m_type = CT_DOCKER;
+	container->m_name = "name-" + id;
+	container->m_imageid = imageid;
+	container->m_imagerepo = "docker.io/library/redis";
+	container->m_imagetag = "6";
+	container->m_imagedigest = "sha256:" + imageid;
+	return container;
+}
+
+}
+
+TEST(container_disk_cache_test, save_and_load)
+{
+	std::string path = "/tmp/container_disk_cache_test." + std::to_string(getpid());
+
+	container_disk_cache::container_map_t containers;
+	containers["aaaaaaaaaaaa"] = make_container("aaaaaaaaaaaa", "img1");
+	containers["bbbbbbbbbbbb"] = make_container("bbbbbbbbbbbb", "img1");
+
+	auto failed = make_container("cccccccccccc", "img2");
+	std::const_pointer_cast<sinsp_container_info>(failed)->m_lookup_state = sinsp_container_lookup_state::FAILED;
+	containers["cccccccccccc"] = failed;
+
+	{
+		container_disk_cache cache(path);
+		ASSERT_FALSE(cache.load());
+		ASSERT_TRUE(cache.save(containers));
+	}
+
+	container_disk_cache cache(path);
+	ASSERT_TRUE(cache.load());
+	// failed lookups (and their images) are not persisted
+	EXPECT_EQ(cache.num_containers(), 2u);
+	EXPECT_EQ(cache.num_images(), 1u);
+
+	auto container = cache.take_container("aaaaaaaaaaaa");
+	ASSERT_NE(container, nullptr);
+	EXPECT_EQ(container->m_name, "name-aaaaaaaaaaaa");
+	EXPECT_EQ(container->m_type, CT_DOCKER);
+
+	// entries are handed out only once
+	EXPECT_EQ(cache.take_container("aaaaaaaaaaaa"), nullptr);
+	EXPECT_EQ(cache.take_container("cccccccccccc"), nullptr);
+
+	sinsp_container_info info;
+	ASSERT_TRUE(cache.get_image("img1", info));
+	EXPECT_EQ(info.m_imagerepo, "docker.io/library/redis");
+	EXPECT_EQ(info.m_imagetag, "6");
+	EXPECT_EQ(info.m_imagedigest, "sha256:img1");
+
+	sinsp_container_info other_repo;
+	other_repo.m_imagerepo = "example.com/redis";
+	EXPECT_FALSE(cache.get_image("img1", other_repo));
+	EXPECT_FALSE(cache.get_image("img2", info));
+
+	remove(path.c_str());
+}
+
+TEST(container_disk_cache_test, corrupted_file)
+{
+	std::string path = "/tmp/container_disk_cache_test_bad." + std::to_string(getpid());
+
+	{
+		container_disk_cache cache(path);
+		container_disk_cache::container_map_t containers;
+		containers["aaaaaaaaaaaa"] = make_container("aaaaaaaaaaaa", "img1");
+		ASSERT_TRUE(cache.save(containers));
+	}
+
+	// chop off the last byte
+	FILE* f = fopen(path.c_str(), "r+");
+	ASSERT_NE(f, nullptr);
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fclose(f);
+	ASSERT_EQ(truncate(path.c_str(), size - 1), 0);
+
+	container_disk_cache cache(path);
+	EXPECT_FALSE(cache.load());
+	EXPECT_EQ(cache.num_containers(), 0u);
+
+	remove(path.c_str());
+}
+
+TEST(container_disk_cache_test, save_only_when_dirty)
+{
+	std::string path = "/tmp/container_disk_cache_test." + std::to_string(getpid());
+
+	container_disk_cache::container_map_t containers;
+	containers["aaaaaaaaaaaa"] = make_container("aaaaaaaaaaaa", "img1");
+
+	container_disk_cache cache(path);
+	ASSERT_TRUE(cache.save(containers));
+	ASSERT_EQ(remove(path.c_str()), 0);
+
+	// same containers, the file doesn't get written again
+	auto failed = make_container("cccccccccccc", "img2");
+	std::const_pointer_cast<sinsp_container_info>(failed)->m_lookup_state = sinsp_container_lookup_state::FAILED;
+	containers["cccccccccccc"] = failed;
+	ASSERT_TRUE(cache.save(containers));
+	EXPECT_NE(access(path.c_str(), F_OK), 0);
+
+	// a replaced container makes it dirty
+	containers["aaaaaaaaaaaa"] = make_container("aaaaaaaaaaaa", "img3");
+	ASSERT_TRUE(cache.save(containers));
+	ASSERT_EQ(access(path.c_str(), F_OK), 0);
+
+	container_disk_cache loaded(path);
+	ASSERT_TRUE(loaded.load());
+	sinsp_container_info info;
+	EXPECT_TRUE(loaded.get_image("img3", info));
+
+	remove(path.c_str());
+}
@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <container_info.h>
+
+TEST(container_info_test, binary_roundtrip)
+{
+	sinsp_container_info info;
+	info.m_id = "0123456789ab";
+	info.m_full_id = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+	info.m_type = CT_CRIO;
+	info.m_name = "nginx";
+	info.m_image = "docker.io/library/nginx:latest";
+	info.m_imagedigest = "sha256:deadbeef";
+	info.m_container_ip = 0x0a000001;
+	info.m_privileged = true;
+	info.m_is_pod_sandbox = true;
+	info.m_lookup_state = sinsp_container_lookup_state::FAILED;
+	info.m_created_time = 1614000000;
+	info.m_mounts.emplace_back("/src", "/dst", "ro", false, "rprivate");
+	info.m_port_mappings.resize(1);
+	info.m_port_mappings[0].m_host_port = 8080;
+	info.m_port_mappings[0].m_container_port = 80;
+	info.m_labels["io.kubernetes.pod.name"] = "nginx-1";
+	info.m_labels["empty"] = "";
+	info.m_env = {"MESOS_TASK_ID=1", "PATH=/bin"};
+	info.m_health_probes.emplace_back(sinsp_container_info::container_health_probe::PT_LIVENESS_PROBE,
+					  "curl", std::vector<std::string>{"-f", "http://localhost/"});
+	info.m_memory_limit = 1 << 30;
+	info.m_cpu_quota = -1;
+	info.m_cpuset_cpu_count = 2;
+	info.m_metadata_deadline = UINT64_MAX;
+
+	std::string buf;
+	info.to_binary(buf);
+
+	sinsp_container_info out;
+	ASSERT_TRUE(out.from_binary(buf.data(), buf.size()));
+
+	EXPECT_EQ(out.m_id, info.m_id);
+	EXPECT_EQ(out.m_full_id, info.m_full_id);
+	EXPECT_EQ(out.m_type, info.m_type);
+	EXPECT_EQ(out.m_name, info.m_name);
+	EXPECT_EQ(out.m_image, info.m_image);
+	EXPECT_EQ(out.m_imagedigest, info.m_imagedigest);
+	EXPECT_EQ(out.m_container_ip, info.m_container_ip);
+	EXPECT_TRUE(out.m_privileged);
+	EXPECT_TRUE(out.m_is_pod_sandbox);
+	EXPECT_EQ(out.m_lookup_state, info.m_lookup_state);
+	EXPECT_EQ(out.m_created_time, info.m_created_time);
+	ASSERT_EQ(out.m_mounts.size(), 1u);
+	EXPECT_EQ(out.m_mounts[0].to_string(), info.m_mounts[0].to_string());
+	ASSERT_EQ(out.m_port_mappings.size(), 1u);
+	EXPECT_EQ(out.m_port_mappings[0].m_host_port, 8080);
+	EXPECT_EQ(out.m_port_mappings[0].m_container_port, 80);
+	EXPECT_EQ(out.m_labels, info.m_labels);
+	// like the JSON form, only mesos-related variables are kept
+	EXPECT_EQ(out.m_env, std::vector<std::string>{"MESOS_TASK_ID=1"});
+	ASSERT_EQ(out.m_health_probes.size(), 1u);
+	EXPECT_EQ(out.m_health_probes.front().m_health_probe_exe, "curl");
+	EXPECT_EQ(out.m_health_probes.front().m_health_probe_args.size(), 2u);
+	EXPECT_EQ(out.m_memory_limit, info.m_memory_limit);
+	EXPECT_EQ(out.m_cpu_quota, info.m_cpu_quota);
+	EXPECT_EQ(out.m_cpuset_cpu_count, info.m_cpuset_cpu_count);
+	EXPECT_EQ(out.m_metadata_deadline, info.m_metadata_deadline);
+}
+
+TEST(container_info_test, binary_truncated)
+{
+	sinsp_container_info info;
+	info.m_id = "0123456789ab";
+	info.m_labels["a"] = "b";
+
+	std::string buf;
+	info.to_binary(buf);
+
+	for(size_t len = 0; len < buf.size(); len++)
+	{
+		sinsp_container_info out;
+		ASSERT_FALSE(out.from_binary(buf.data(), len)) << len;
+	}
+}
@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <cow_vector.h>
+#include <string>
+
+using libsinsp::cow_vector;
+
+TEST(cow_vector_test, empty)
+{
+	cow_vector<std::string> v;
+	ASSERT_TRUE(v.empty());
+	ASSERT_EQ(0, v.size());
+	ASSERT_TRUE(v.begin() == v.end());
+	ASSERT_TRUE(v == std::vector<std::string>());
+}
+
+TEST(cow_vector_test, copy_shares_storage)
+{
+	cow_vector<std::string> parent(std::vector<std::string>{"-d1", "-n"});
+	cow_vector<std::string> child = parent;
+
+	ASSERT_TRUE(child.shares_storage_with(parent));
+	ASSERT_EQ(&parent[0], &child[0]);
+	ASSERT_EQ(parent, child);
+}
+
+TEST(cow_vector_test, write_detaches_copy)
+{
+	cow_vector<std::string> parent(std::vector<std::string>{"a", "b"});
+	cow_vector<std::string> child = parent;
+
+	child.push_back("c");
+
+	ASSERT_FALSE(child.shares_storage_with(parent));
+	ASSERT_EQ(2, parent.size());
+	ASSERT_EQ(3, child.size());
+	ASSERT_EQ("c", child.back());
+	ASSERT_EQ("a", child.front());
+}
+
+TEST(cow_vector_test, unshared_write_in_place)
+{
+	cow_vector<std::string> v(std::vector<std::string>{"a"});
+	const std::vector<std::string>* storage = &v.get();
+
+	v.emplace_back("b");
+	v.mutate()[1] = "c";
+
+	ASSERT_EQ(storage, &v.get());
+	ASSERT_EQ((std::vector<std::string>{"a", "c"}), v);
+}
+
+TEST(cow_vector_test, assign_and_clear)
+{
+	cow_vector<std::string> parent(std::vector<std::string>{"a"});
+	cow_vector<std::string> child = parent;
+
+	child = std::vector<std::string>{"x", "y"};
+	ASSERT_EQ(1, parent.size());
+	ASSERT_EQ("y", child.at(1));
+
+	child.clear();
+	ASSERT_TRUE(child.empty());
+	ASSERT_EQ("a", parent[0]);
+}
+
+TEST(cow_vector_test, const_vector_conversion)
+{
+	cow_vector<std::pair<std::string, std::string>> v;
+	v.push_back(std::make_pair("cpu", "/docker/abc"));
+
+	const std::vector<std::pair<std::string, std::string>>& ref = v;
+	ASSERT_EQ(1, ref.size());
+	ASSERT_EQ("/docker/abc", ref[0].second);
+
+	size_t n = 0;
+	for(const auto& it : v)
+	{
+		ASSERT_EQ("cpu", it.first);
+		n++;
+	}
+	ASSERT_EQ(1, n);
+}
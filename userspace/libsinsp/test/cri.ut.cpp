@@ -0,0 +1,355 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#if !defined(MINIMAL_BUILD) && !defined(_WIN32)
+
+#include <gtest.h>
+#include "cri.h"
+
+#include <grpcpp/generic/async_generic_service.h>
+#include <grpcpp/grpcpp.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace libsinsp::cri;
+
+namespace {
+
+const char pod_id[] = "5fa1c9d0e2b7a4f3c8d6e1b9a7f2c4d8e0b3a6f9c1d4e7b2a5f8c0d3e6b9a1f4";
+const char container_id[] = "9e2b7d4f1a8c3e6b0d5f2a9c7e4b1d8f3a6c0e9b2d5f8a1c4e7b0d3f6a9c2e5b";
+
+/**
+ * A CRI runtime on a unix socket, with one pod sandbox running one
+ * container. It counts the calls it gets by method name, and can hold
+ * the ListPodSandbox calls until it's told to answer them. The pod
+ * address it reports can be changed, or set empty like while the CNI
+ * plugin is still setting up the network of the sandbox.
+ */
+class stub_cri_runtime
+{
+public:
+	stub_cri_runtime():
+		m_pod_ip("10.1.2.3"),
+		m_hold(false)
+	{
+		char dir[] = "/tmp/cri_testXXXXXX";
+		m_dir = mkdtemp(dir);
+		m_path = m_dir + "/cri.sock";
+
+		grpc::ServerBuilder builder;
+		builder.AddListeningPort("unix://" + m_path, grpc::InsecureServerCredentials());
+		builder.RegisterAsyncGenericService(&m_service);
+		m_cq = builder.AddCompletionQueue();
+		m_server = builder.BuildAndStart();
+
+		m_thread = std::thread(&stub_cri_runtime::run, this);
+	}
+
+	~stub_cri_runtime()
+	{
+		release();
+		m_server->Shutdown();
+		m_cq->Shutdown();
+		m_thread.join();
+
+		void* tag;
+		bool ok;
+		while(m_cq->Next(&tag, &ok))
+		{
+		}
+
+		unlink(m_path.c_str());
+		rmdir(m_dir.c_str());
+	}
+
+	const std::string& path() const
+	{
+		return m_path;
+	}
+
+	uint32_t calls(const std::string& method)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_calls[method];
+	}
+
+	void set_pod_ip(const std::string& ip)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pod_ip = ip;
+	}
+
+	void hold()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_hold = true;
+	}
+
+	void release()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_hold = false;
+		m_cond.notify_all();
+	}
+
+	void wait_for_calls(const std::string& method, uint32_t n)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [&] { return m_calls[method] >= n; });
+	}
+
+private:
+	//
+	// Serve one call at a time: the clients in the tests are synchronous
+	//
+	void run()
+	{
+		while(true)
+		{
+			grpc::GenericServerContext ctx;
+			grpc::GenericServerAsyncReaderWriter stream(&ctx);
+			m_service.RequestCall(&ctx, &stream, m_cq.get(), m_cq.get(), this);
+			if(!next())
+			{
+				return;
+			}
+
+			grpc::ByteBuffer req;
+			stream.Read(&req, this);
+			if(!next())
+			{
+				return;
+			}
+
+			std::string resp;
+			grpc::Status status = handle(ctx.method(), to_string(req), &resp);
+			if(status.ok())
+			{
+				grpc::Slice slice(resp);
+				stream.WriteAndFinish(grpc::ByteBuffer(&slice, 1), grpc::WriteOptions(), status, this);
+			}
+			else
+			{
+				stream.Finish(status, this);
+			}
+
+			if(!next())
+			{
+				return;
+			}
+		}
+	}
+
+	bool next()
+	{
+		void* tag;
+		bool ok;
+		return m_cq->Next(&tag, &ok) && ok;
+	}
+
+	static std::string to_string(const grpc::ByteBuffer& buf)
+	{
+		std::vector<grpc::Slice> slices;
+		std::string res;
+
+		buf.Dump(&slices);
+		for(const auto& slice : slices)
+		{
+			res.append((const char*)slice.begin(), slice.size());
+		}
+
+		return res;
+	}
+
+	grpc::Status handle(const std::string& method, const std::string& req, std::string* resp)
+	{
+		std::string name = method.substr(method.rfind('/') + 1);
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_calls[name]++;
+			m_cond.notify_all();
+
+			if(name == "ListPodSandbox")
+			{
+				m_cond.wait(lock, [this] { return !m_hold; });
+			}
+		}
+
+		if(name == "Version")
+		{
+			runtime::v1alpha2::VersionResponse r;
+			r.set_runtime_name("containerd");
+			r.set_runtime_version("1.4.0");
+			r.SerializeToString(resp);
+		}
+		else if(name == "ListPodSandbox")
+		{
+			runtime::v1alpha2::ListPodSandboxResponse r;
+			r.add_items()->set_id(pod_id);
+			r.SerializeToString(resp);
+		}
+		else if(name == "ListContainers")
+		{
+			runtime::v1alpha2::ListContainersResponse r;
+			auto container = r.add_containers();
+			container->set_id(container_id);
+			container->set_pod_sandbox_id(pod_id);
+			r.SerializeToString(resp);
+		}
+		else if(name == "PodSandboxStatus")
+		{
+			runtime::v1alpha2::PodSandboxStatusRequest q;
+			q.ParseFromString(req);
+			if(q.pod_sandbox_id() != pod_id)
+			{
+				return grpc::Status(grpc::StatusCode::NOT_FOUND, "no such pod sandbox");
+			}
+
+			runtime::v1alpha2::PodSandboxStatusResponse r;
+			r.mutable_status()->set_id(pod_id);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			r.mutable_status()->mutable_network()->set_ip(m_pod_ip);
+			r.SerializeToString(resp);
+		}
+		else
+		{
+			return grpc::Status(grpc::StatusCode::UNIMPLEMENTED, name);
+		}
+
+		return grpc::Status::OK;
+	}
+
+	std::string m_dir;
+	std::string m_path;
+	grpc::AsyncGenericService m_service;
+	std::unique_ptr<grpc::ServerCompletionQueue> m_cq;
+	std::unique_ptr<grpc::Server> m_server;
+	std::thread m_thread;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::map<std::string, uint32_t> m_calls;
+	std::string m_pod_ip;
+	bool m_hold;
+};
+
+class cri_inventory_test : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		m_refresh_ms = s_cri_inventory_refresh_ms;
+		s_cri_inventory_refresh_ms = 60000;
+	}
+
+	void TearDown() override
+	{
+		s_cri_inventory_refresh_ms = m_refresh_ms;
+	}
+
+	stub_cri_runtime m_runtime;
+	int64_t m_refresh_ms;
+};
+
+}
+
+TEST_F(cri_inventory_test, lookups_use_the_inventory)
+{
+	cri_interface cri(m_runtime.path());
+	ASSERT_TRUE(cri.is_ok());
+	ASSERT_EQ(1u, m_runtime.calls("Version"));
+
+	// the first miss loads the inventory
+	ASSERT_FALSE(cri.is_pod_sandbox(std::string(container_id, 12)));
+	ASSERT_EQ(1u, m_runtime.calls("ListPodSandbox"));
+	ASSERT_EQ(1u, m_runtime.calls("ListContainers"));
+
+	// known containers and pods are answered without any call
+	ASSERT_TRUE(cri.is_pod_sandbox(std::string(pod_id, 12)));
+	ASSERT_FALSE(cri.is_pod_sandbox(std::string(container_id, 12)));
+	ASSERT_EQ(0u, m_runtime.calls("PodSandboxStatus"));
+
+	// the pod address is asked once, then cached
+	uint32_t ip = ntohl(inet_addr("10.1.2.3"));
+	ASSERT_EQ(ip, cri.get_container_ip(std::string(container_id, 12)));
+	ASSERT_EQ(ip, cri.get_container_ip(std::string(container_id, 12)));
+	ASSERT_EQ(1u, m_runtime.calls("PodSandboxStatus"));
+
+	// an unknown id can't refresh the inventory this soon, so it's
+	// looked up on its own
+	ASSERT_FALSE(cri.is_pod_sandbox("0123456789ab"));
+	ASSERT_EQ(2u, m_runtime.calls("PodSandboxStatus"));
+	ASSERT_EQ(1u, m_runtime.calls("ListPodSandbox"));
+	ASSERT_EQ(1u, m_runtime.calls("ListContainers"));
+}
+
+TEST_F(cri_inventory_test, empty_pod_ip_is_not_cached)
+{
+	cri_interface cri(m_runtime.path());
+	ASSERT_TRUE(cri.is_ok());
+
+	// the sandbox has no address yet
+	m_runtime.set_pod_ip("");
+	ASSERT_EQ(0u, cri.get_container_ip(std::string(container_id, 12)));
+	ASSERT_EQ(1u, m_runtime.calls("PodSandboxStatus"));
+
+	// so it's asked again, and the real one gets cached
+	m_runtime.set_pod_ip("10.1.2.3");
+	uint32_t ip = ntohl(inet_addr("10.1.2.3"));
+	ASSERT_EQ(ip, cri.get_container_ip(std::string(container_id, 12)));
+	ASSERT_EQ(ip, cri.get_container_ip(std::string(container_id, 12)));
+	ASSERT_EQ(2u, m_runtime.calls("PodSandboxStatus"));
+}
+
+TEST_F(cri_inventory_test, refresh_does_not_block_lookups)
+{
+	cri_interface cri(m_runtime.path());
+	ASSERT_TRUE(cri.is_ok());
+	ASSERT_TRUE(cri.is_pod_sandbox(std::string(pod_id, 12)));
+
+	// a miss refreshes the inventory, whose calls the runtime holds
+	s_cri_inventory_refresh_ms = 0;
+	m_runtime.hold();
+	std::thread miss([&cri] {
+		cri.is_pod_sandbox("0123456789ab");
+	});
+	m_runtime.wait_for_calls("ListPodSandbox", 2);
+
+	// meanwhile the snapshot is still there for everybody else
+	ASSERT_TRUE(cri.is_pod_sandbox(std::string(pod_id, 12)));
+	ASSERT_FALSE(cri.is_pod_sandbox(std::string(container_id, 12)));
+
+	m_runtime.release();
+	miss.join();
+	ASSERT_EQ(2u, m_runtime.calls("ListPodSandbox"));
+	ASSERT_EQ(2u, m_runtime.calls("ListContainers"));
+	ASSERT_EQ(0u, m_runtime.calls("PodSandboxStatus"));
+}
+
+#endif // !MINIMAL_BUILD && !_WIN32
@@ -0,0 +1,272 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#if defined(CONTAINER_INFO) && !defined(_WIN32)
+
+#include <gtest.h>
+#include "container_engine/docker/connection.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace libsinsp::container_engine;
+
+namespace {
+
+/**
+ * A minimal HTTP/1.1 server on a unix socket, standing in for the docker
+ * daemon. It answers every request with the requested url, as json,
+ * and keeps the connections open. Requests for /events get an endless
+ * response with a few newline-delimited json documents instead.
+ */
+class stub_docker_server
+{
+public:
+	stub_docker_server():
+		m_connections(0),
+		m_requests(0),
+		m_stop(false)
+	{
+		char dir[] = "/tmp/docker_connection_testXXXXXX";
+		m_dir = mkdtemp(dir);
+		m_path = m_dir + "/docker.sock";
+
+		m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		struct sockaddr_un addr = {};
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, m_path.c_str(), sizeof(addr.sun_path) - 1);
+		bind(m_fd, (struct sockaddr*)&addr, sizeof(addr));
+		listen(m_fd, 16);
+
+		m_thread = std::thread(&stub_docker_server::run, this);
+	}
+
+	~stub_docker_server()
+	{
+		m_stop = true;
+		m_thread.join();
+		close(m_fd);
+		unlink(m_path.c_str());
+		rmdir(m_dir.c_str());
+	}
+
+	const std::string& path() const
+	{
+		return m_path;
+	}
+
+	std::atomic<int> m_connections;
+	std::atomic<int> m_requests;
+
+private:
+	void run()
+	{
+		std::vector<struct pollfd> fds = {{m_fd, POLLIN, 0}};
+		std::vector<std::string> buffers = {""};
+
+		while(!m_stop)
+		{
+			if(poll(fds.data(), fds.size(), 10) <= 0)
+			{
+				continue;
+			}
+
+			if(fds[0].revents & POLLIN)
+			{
+				fds.push_back({accept(m_fd, NULL, NULL), POLLIN, 0});
+				buffers.emplace_back();
+				m_connections++;
+			}
+
+			for(size_t j = 1; j < fds.size(); j++)
+			{
+				if(fds[j].fd < 0 || !(fds[j].revents & (POLLIN | POLLHUP)))
+				{
+					continue;
+				}
+
+				char buf[4096];
+				ssize_t n = read(fds[j].fd, buf, sizeof(buf));
+				if(n <= 0)
+				{
+					close(fds[j].fd);
+					fds[j].fd = -1;
+					continue;
+				}
+
+				buffers[j].append(buf, n);
+				size_t end;
+				while((end = buffers[j].find("\r\n\r\n")) != std::string::npos)
+				{
+					respond(fds[j].fd, buffers[j].substr(0, end));
+					buffers[j].erase(0, end + 4);
+				}
+			}
+		}
+
+		for(size_t j = 1; j < fds.size(); j++)
+		{
+			if(fds[j].fd >= 0)
+			{
+				close(fds[j].fd);
+			}
+		}
+	}
+
+	void respond(int fd, const std::string& request)
+	{
+		m_requests++;
+
+		// "GET <url> HTTP/1.1"
+		size_t start = request.find(' ') + 1;
+		std::string url = request.substr(start, request.find(' ', start) - start);
+		bool missing = url.find("missing") != std::string::npos;
+
+		if(!missing && url.find("/events") != std::string::npos)
+		{
+			// no Content-Length: the body lasts until the connection
+			// is closed, and lines may be split across writes
+			const char* chunks[] = {
+				"HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n",
+				"{\"id\":1}\n{\"id\"",
+				":2}\n\n{\"id\":3}\n",
+			};
+			for(const char* chunk : chunks)
+			{
+				ASSERT_EQ((ssize_t)strlen(chunk), write(fd, chunk, strlen(chunk)));
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			return;
+		}
+
+		std::string body = "{\"url\":\"" + url + "\"}";
+		std::string resp = std::string(missing ? "HTTP/1.1 404 Not Found" : "HTTP/1.1 200 OK") +
+			"\r\nContent-Type: application/json\r\nContent-Length: " +
+			std::to_string(body.size()) + "\r\n\r\n" + body;
+
+		ASSERT_EQ((ssize_t)resp.size(), write(fd, resp.c_str(), resp.size()));
+	}
+
+	std::string m_dir;
+	std::string m_path;
+	int m_fd;
+	std::thread m_thread;
+	std::atomic<bool> m_stop;
+};
+
+}
+
+TEST(docker_connection_test, keep_alive)
+{
+	stub_docker_server server;
+	docker_connection connection;
+	docker_lookup_request request("abc", server.path(), CT_DOCKER, 0, false);
+
+	for(int i = 0; i < 3; i++)
+	{
+		std::string json;
+		ASSERT_EQ(docker_connection::RESP_OK, connection.get_docker(request, "/containers/abc/json", json));
+		ASSERT_EQ("{\"url\":\"/v1.24/containers/abc/json\"}", json);
+	}
+
+	ASSERT_EQ(3, server.m_requests);
+	ASSERT_EQ(1, server.m_connections);
+}
+
+TEST(docker_connection_test, bad_request)
+{
+	stub_docker_server server;
+	docker_connection connection;
+	docker_lookup_request request("missing", server.path(), CT_DOCKER, 0, false);
+	std::string json;
+
+	ASSERT_EQ(docker_connection::RESP_BAD_REQUEST, connection.get_docker(request, "/containers/missing/json", json));
+
+	connection.set_api_version("");
+	json.clear();
+	request.container_id = "abc";
+	ASSERT_EQ(docker_connection::RESP_OK, connection.get_docker(request, "/containers/abc/json", json));
+	ASSERT_EQ("{\"url\":\"/containers/abc/json\"}", json);
+}
+
+TEST(docker_connection_test, stream)
+{
+	stub_docker_server server;
+	docker_connection connection;
+	docker_lookup_request request("", server.path(), CT_DOCKER, 0, false);
+	std::atomic<bool> stop(false);
+	std::vector<std::string> lines;
+
+	auto resp = connection.stream_docker(request, "/events", [&](const std::string& line) {
+		lines.push_back(line);
+		return lines.size() < 3;
+	}, stop);
+
+	ASSERT_EQ(docker_connection::RESP_OK, resp);
+	ASSERT_EQ(std::vector<std::string>({"{\"id\":1}", "{\"id\":2}", "{\"id\":3}"}), lines);
+}
+
+TEST(docker_connection_test, stream_stop)
+{
+	stub_docker_server server;
+	docker_connection connection;
+	docker_lookup_request request("", server.path(), CT_DOCKER, 0, false);
+	std::atomic<bool> stop(false);
+	int num_lines = 0;
+
+	std::thread stopper([&stop]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		stop = true;
+	});
+
+	auto resp = connection.stream_docker(request, "/events", [&](const std::string& line) {
+		num_lines++;
+		return true;
+	}, stop);
+	stopper.join();
+
+	ASSERT_EQ(docker_connection::RESP_OK, resp);
+	ASSERT_EQ(3, num_lines);
+}
+
+TEST(docker_connection_test, stream_rejected)
+{
+	stub_docker_server server;
+	docker_connection connection;
+	docker_lookup_request request("", server.path(), CT_DOCKER, 0, false);
+	std::atomic<bool> stop(false);
+	int num_lines = 0;
+
+	auto resp = connection.stream_docker(request, "/missing/events", [&](const std::string& line) {
+		num_lines++;
+		return true;
+	}, stop);
+
+	ASSERT_EQ(docker_connection::RESP_BAD_REQUEST, resp);
+	ASSERT_EQ(0, num_lines);
+}
+
+#endif // CONTAINER_INFO && !_WIN32
@@ -0,0 +1,67 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <fast_format.h>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+
+using namespace libsinsp::fast_format;
+
+TEST(fast_format_test, integers)
+{
+	const int64_t values[] = {0, 1, -1, 9, 10, -10, 12345, INT64_MAX, INT64_MIN};
+
+	for(int64_t v : values)
+	{
+		char expected[32];
+		std::string out = "x";
+
+		snprintf(expected, sizeof(expected), "x%" PRId64, v);
+		append_int(out, v);
+		ASSERT_EQ(expected, out);
+	}
+
+	std::string out;
+	append_uint(out, UINT64_MAX);
+	ASSERT_EQ("18446744073709551615", out);
+}
+
+TEST(fast_format_test, ipv4)
+{
+	const uint8_t addr[] = {192, 168, 0, 10};
+	std::string out;
+
+	append_ipv4(out, addr);
+	out.push_back(':');
+	append_uint(out, 8080);
+	ASSERT_EQ("192.168.0.10:8080", out);
+}
+
+TEST(fast_format_test, json_string)
+{
+	std::string out;
+	std::string in("a\"b\\c\nd\x01/\xc3\xa9", 11);
+
+	append_json_string(out, in.c_str(), in.size());
+	ASSERT_EQ("\"a\\\"b\\\\c\\nd\\u0001/\xc3\xa9\"", out);
+
+	out.clear();
+	append_json_string(out, "", 0);
+	ASSERT_EQ("\"\"", out);
+}
@@ -0,0 +1,402 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// to build the events by hand
+#define VISIBILITY_PRIVATE
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "http_session.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+namespace {
+
+class request_recorder : public sinsp_http_listener
+{
+public:
+	void on_http_request(sinsp_evt* evt, const sinsp_http_request& req)
+	{
+		m_reqs.push_back(req);
+		m_evts.push_back(evt);
+	}
+
+	vector<sinsp_http_request> m_reqs;
+	vector<sinsp_evt*> m_evts;
+};
+
+//
+// Feeds payloads of connection (100, fd) to a session manager, with
+// made up timestamps
+//
+class http_session_test : public testing::Test
+{
+protected:
+	http_session_test():
+		m_sessions(&m_recorder, 16)
+	{
+		m_scapevt.ts = 0;
+		m_evt.m_pevt = &m_scapevt;
+	}
+
+	//
+	// original_len is what the syscall returned, if more than what
+	// the snaplen let through
+	//
+	void read(uint64_t ts, const std::string& data, uint32_t original_len = 0, int64_t fd = 5)
+	{
+		m_scapevt.ts = ts;
+		m_buf = data;
+		m_sessions.on_read(&m_evt, 100, fd, (char*)m_buf.data(),
+			original_len ? original_len : data.size(), data.size());
+	}
+
+	void write(uint64_t ts, const std::string& data, uint32_t original_len = 0, int64_t fd = 5)
+	{
+		m_scapevt.ts = ts;
+		m_buf = data;
+		m_sessions.on_write(&m_evt, 100, fd, (char*)m_buf.data(),
+			original_len ? original_len : data.size(), data.size());
+	}
+
+	vector<sinsp_http_request>& reqs()
+	{
+		return m_recorder.m_reqs;
+	}
+
+	void assert_request(uint32_t idx, const char* method, const char* url, uint16_t status,
+		uint64_t latency, uint64_t req_bytes, uint64_t resp_bytes)
+	{
+		ASSERT_LT(idx, reqs().size());
+		const sinsp_http_request& req = reqs()[idx];
+		ASSERT_STREQ(method, req.method_str());
+		ASSERT_EQ(url, req.m_url);
+		ASSERT_EQ(status, req.m_status);
+		ASSERT_EQ(latency, req.latency_ns());
+		ASSERT_EQ(req_bytes, req.m_req_bytes);
+		ASSERT_EQ(resp_bytes, req.m_resp_bytes);
+	}
+
+	request_recorder m_recorder;
+	sinsp_http_session_manager m_sessions;
+	std::string m_buf;
+	scap_evt m_scapevt;
+	sinsp_evt m_evt;
+};
+
+const std::string get_index = "GET /index.html HTTP/1.1\r\nHost: example.com\r\n\r\n";
+const std::string ok_hello = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+
+}
+
+TEST_F(http_session_test, server)
+{
+	read(1000, get_index);
+	write(1500, ok_hello);
+	ASSERT_EQ(1u, reqs().size());
+	assert_request(0, "GET", "/index.html", 200, 500, get_index.size(), ok_hello.size());
+	ASSERT_TRUE(reqs()[0].m_is_server);
+	ASSERT_EQ(100, reqs()[0].m_pid);
+	ASSERT_EQ(5, reqs()[0].m_fd);
+	ASSERT_EQ(1500u, reqs()[0].m_end_ts);
+	ASSERT_EQ(&m_evt, m_recorder.m_evts[0]);
+
+	// a request and its chunked response, both split in several payloads
+	std::string post = "POST /api/v1/items?id=1 HTTP/1.1\r\nContent-Length: 11\r\n\r\n{\"a\": \"b\"}\n";
+	read(2000, post.substr(0, 10));
+	read(2100, post.substr(10, 40));
+	read(2200, post.substr(50));
+	std::string chunked = "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n4\r\nabcd\r\n3\r\nefg\r\n0\r\n\r\n";
+	write(2500, chunked.substr(0, 30));
+	write(2600, chunked.substr(30, 30));
+	ASSERT_EQ(1u, reqs().size());
+	write(2700, chunked.substr(60));
+	ASSERT_EQ(2u, reqs().size());
+	assert_request(1, "POST", "/api/v1/items?id=1", 201, 500, post.size(), chunked.size());
+	ASSERT_EQ(2700u, reqs()[1].m_end_ts);
+	ASSERT_EQ(1u, m_sessions.get_n_sessions());
+	ASSERT_EQ(0u, m_sessions.get_n_parse_errors());
+}
+
+TEST_F(http_session_test, client_pipelined)
+{
+	std::string put = "PUT /a HTTP/1.1\r\nContent-Length: 2\r\n\r\nhi";
+	write(1000, get_index + put + get_index);
+	std::string no_content = "HTTP/1.1 204 No Content\r\n\r\n";
+	std::string not_found = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+	read(1200, ok_hello + no_content);
+	read(1300, not_found);
+
+	ASSERT_EQ(3u, reqs().size());
+	assert_request(0, "GET", "/index.html", 200, 200, get_index.size(), ok_hello.size());
+	assert_request(1, "PUT", "/a", 204, 200, put.size(), no_content.size());
+	assert_request(2, "GET", "/index.html", 404, 300, get_index.size(), not_found.size());
+	ASSERT_FALSE(reqs()[0].m_is_server);
+}
+
+TEST_F(http_session_test, snaplen)
+{
+	// bodies cut by the snaplen are skipped without losing the sync
+	std::string headers = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 100000\r\n\r\n";
+	read(1000, get_index);
+	write(1100, headers + "<html>", headers.size() + 60000);
+	write(1200, "<p>", 40000);
+	read(2000, get_index);
+	write(2100, ok_hello);
+
+	ASSERT_EQ(2u, reqs().size());
+	assert_request(0, "GET", "/index.html", 200, 100, get_index.size(), headers.size() + 100000);
+	ASSERT_EQ(1200u, reqs()[0].m_end_ts);
+	assert_request(1, "GET", "/index.html", 200, 100, get_index.size(), ok_hello.size());
+
+	// the end of the headers got cut: we still know the method and the
+	// URL, and the next response gets us back in sync
+	std::string req = "GET /search?q=falco HTTP/1.1\r\nHost: example.com\r\nAccept: */*\r\n\r\n";
+	read(3000, req.substr(0, 40), req.size());
+	write(3100, ok_hello);
+	ASSERT_EQ(3u, reqs().size());
+	assert_request(2, "GET", "/search?q=falco", 200, 100, req.size(), ok_hello.size());
+
+	// a response whose headers got cut is still reported with its status
+	read(4000, get_index);
+	write(4100, ok_hello.substr(0, 20), ok_hello.size());
+	ASSERT_EQ(4u, reqs().size());
+	assert_request(3, "GET", "/index.html", 200, 100, get_index.size(), ok_hello.size());
+	read(5000, get_index);
+	write(5100, ok_hello);
+	ASSERT_EQ(5u, reqs().size());
+	assert_request(4, "GET", "/index.html", 200, 100, get_index.size(), ok_hello.size());
+
+	// but without its status it's given up on
+	read(6000, get_index);
+	write(6100, ok_hello.substr(0, 10), ok_hello.size());
+	read(7000, get_index);
+	write(7100, ok_hello);
+	ASSERT_EQ(6u, reqs().size());
+	ASSERT_EQ(7000u, reqs()[5].m_req_ts);
+	ASSERT_EQ(1u, m_sessions.get_n_dropped_requests());
+}
+
+TEST_F(http_session_test, special_responses)
+{
+	// the response to a HEAD has no body
+	std::string head = "HEAD / HTTP/1.1\r\n\r\n";
+	std::string head_resp = "HTTP/1.1 200 OK\r\nContent-Length: 1000\r\n\r\n";
+	read(1000, head);
+	write(1100, head_resp);
+
+	// the interim response is not reported
+	std::string post = "POST /upload HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 3\r\n\r\n";
+	std::string cont = "HTTP/1.1 100 Continue\r\n\r\n";
+	read(2000, post);
+	write(2100, cont);
+	read(2200, "abc");
+	write(2300, ok_hello);
+
+	ASSERT_EQ(2u, reqs().size());
+	assert_request(0, "HEAD", "/", 200, 100, head.size(), head_resp.size());
+	assert_request(1, "POST", "/upload", 200, 300, post.size() + 3, ok_hello.size());
+
+	// without length nor chunked encoding, the response ends with the
+	// connection
+	std::string eof_resp = "HTTP/1.0 200 OK\r\n\r\nsome data";
+	read(3000, get_index);
+	write(3100, eof_resp);
+	write(3200, " and more");
+	ASSERT_EQ(2u, reqs().size());
+	m_sessions.on_erase_fd(100, 5);
+	ASSERT_EQ(3u, reqs().size());
+	assert_request(2, "GET", "/index.html", 200, 100, get_index.size(), eof_resp.size() + 9);
+	ASSERT_EQ(NULL, m_recorder.m_evts[2]);
+	ASSERT_EQ(0u, m_sessions.get_n_sessions());
+}
+
+TEST_F(http_session_test, upgrade)
+{
+	std::string upgrade = "GET /chat HTTP/1.1\r\nConnection: Upgrade\r\nUpgrade: websocket\r\n\r\n";
+	std::string switching = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: websocket\r\n\r\n";
+	read(1000, upgrade);
+	write(1100, switching + "\x81\x05hello");
+	ASSERT_EQ(1u, reqs().size());
+	assert_request(0, "GET", "/chat", 101, 100, upgrade.size(), switching.size());
+
+	// websocket frames that look like HTTP are ignored
+	read(2000, get_index);
+	write(2100, ok_hello);
+	ASSERT_EQ(1u, reqs().size());
+	ASSERT_EQ(1u, m_sessions.get_n_sessions());
+}
+
+TEST_F(http_session_test, bounds)
+{
+	// non HTTP connections are not tracked
+	read(1000, std::string("\x16\x03\x01\x02\x00\x01\x00\x01\xfc\x03\x03", 11));
+	write(1000, "SSH-2.0-OpenSSH_8.2p1\r\n");
+	read(1000, "220 mail.example.com ESMTP\r\n");
+	ASSERT_EQ(0u, m_sessions.get_n_sessions());
+
+	// too many connections
+	for(int64_t fd = 10; fd < 30; fd++)
+	{
+		read(2000, get_index, 0, fd);
+	}
+	ASSERT_EQ(16u, m_sessions.get_n_sessions());
+	ASSERT_EQ(4u, m_sessions.get_n_dropped_sessions());
+
+	// too many pipelined requests and a very long URL, on a connection
+	// that is now used by a client
+	m_sessions.on_erase_fd(100, 10);
+	ASSERT_EQ(1u, m_sessions.get_n_dropped_requests());
+	std::string long_url = "/" + std::string(1000, 'x');
+	std::string reqs_str;
+	for(uint32_t j = 0; j < HTTP_SESSION_MAX_PENDING + 2; j++)
+	{
+		reqs_str += "GET " + long_url + " HTTP/1.1\r\n\r\n";
+	}
+	std::string resps;
+	for(uint32_t j = 0; j < HTTP_SESSION_MAX_PENDING + 2; j++)
+	{
+		resps += ok_hello;
+	}
+	write(3000, reqs_str, 0, 10);
+	read(3100, resps, 0, 10);
+	ASSERT_EQ((size_t)HTTP_SESSION_MAX_PENDING, reqs().size());
+	ASSERT_EQ((size_t)HTTP_SESSION_MAX_URL_LEN, reqs()[0].m_url.size());
+	ASSERT_EQ(3u, m_sessions.get_n_dropped_requests());
+
+	// idle connections are forgotten
+	read(3000 + HTTP_SESSION_TIMEOUT_NS + 1, get_index, 0, 10);
+	ASSERT_EQ(1u, m_sessions.get_n_sessions());
+}
+
+namespace {
+
+const char* urls[] = {"/", "/index.html", "/api/v1/users/42", "/static/app.js?v=3", "/healthz"};
+const char* verbs[] = {"GET", "POST", "PUT", "DELETE"};
+
+//
+// Keep-alive traffic of many connections with the payloads cut at
+// snaplen bytes, as the driver would capture it
+//
+double replay_synthetic(sinsp_http_session_manager* sessions, uint32_t n_exchanges, uint32_t snaplen)
+{
+	std::mt19937 rng(42);
+	std::string buf;
+	scap_evt scapevt;
+	sinsp_evt evt;
+	evt.m_pevt = &scapevt;
+	scapevt.ts = 0;
+
+	vector<std::string> reqs;
+	vector<std::string> resps;
+	vector<uint32_t> resp_lens;
+	for(uint32_t j = 0; j < 64; j++)
+	{
+		std::string verb = verbs[rng() % 4];
+		std::string body = (verb == "POST" || verb == "PUT") ? std::string(rng() % 2000, 'b') : "";
+		reqs.push_back(verb + " " + urls[rng() % 5] + " HTTP/1.1\r\nHost: svc.local\r\n"
+			"User-Agent: curl/7.68.0\r\nAccept: */*\r\nContent-Length: " + std::to_string(body.size()) +
+			"\r\n\r\n" + body);
+
+		uint32_t len = rng() % 50000;
+		resps.push_back("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+			std::to_string(len) + "\r\n\r\n" + std::string(std::min(len, snaplen), 'r'));
+		resp_lens.push_back(resps.back().size() - std::min(len, snaplen) + len);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t j = 0; j < n_exchanges; j++)
+	{
+		int64_t fd = 10 + rng() % 1000;
+		uint32_t k = rng() % reqs.size();
+
+		scapevt.ts += 10000;
+		const std::string& req = reqs[k];
+		sessions->on_read(&evt, 100, fd, (char*)req.data(), req.size(), std::min((uint32_t)req.size(), snaplen));
+
+		scapevt.ts += 10000;
+		const std::string& resp = resps[k];
+		sessions->on_write(&evt, 100, fd, (char*)resp.data(), resp_lens[k], std::min((uint32_t)resp.size(), snaplen));
+	}
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count() / (2.0 * n_exchanges);
+}
+
+class counting_listener : public sinsp_http_listener
+{
+public:
+	void on_http_request(sinsp_evt* evt, const sinsp_http_request& req)
+	{
+		m_n_reqs++;
+	}
+
+	uint64_t m_n_reqs = 0;
+};
+
+}
+
+//
+// Cost per payload of the reconstruction. With HTTP_SESSION_CAPTURE set
+// to a capture file, also the cost per event of replaying it with and
+// without the reconstruction
+//
+TEST(http_session, DISABLED_benchmark)
+{
+	for(uint32_t snaplen : {80, 2000, 65536})
+	{
+		counting_listener listener;
+		sinsp_http_session_manager sessions(&listener);
+		double ns = replay_synthetic(&sessions, 2000000, snaplen);
+		std::cout << "snaplen " << snaplen << ": " << ns << " ns per payload, " <<
+			listener.m_n_reqs << " requests, " << sessions.get_n_dropped_requests() << " dropped" << std::endl;
+	}
+
+	const char* capture = getenv("HTTP_SESSION_CAPTURE");
+	if(capture == NULL)
+	{
+		return;
+	}
+
+	for(bool enabled : {false, true})
+	{
+		counting_listener listener;
+		sinsp inspector;
+		inspector.open(capture);
+		if(enabled)
+		{
+			inspector.set_http_listener(&listener, HTTP_SESSION_DEFAULT_MAX_SESSIONS);
+		}
+
+		sinsp_evt* evt;
+		uint64_t n_evts = 0;
+		auto start = std::chrono::steady_clock::now();
+		while(inspector.next(&evt) != SCAP_EOF)
+		{
+			n_evts++;
+		}
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		inspector.close();
+
+		std::cout << capture << (enabled ? " with" : " without") << " reconstruction: " <<
+			elapsed / std::max(n_evts, (uint64_t)1) << " ns per event, " << listener.m_n_reqs << " requests" << std::endl;
+	}
+}
@@ -0,0 +1,59 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifdef __linux__
+
+#include <gtest.h>
+#include "json_query.h"
+
+TEST(json_query, parsed_input)
+{
+	const std::string json = R"({"type": "ADDED", "object": )"
+		R"({"n": 3, "big": 5000000000, "neg": -7, "f": 1.5, "s": "a\"b", "a": [true, null, {}]}})";
+	const std::string filter = ".object";
+	const std::string error_filter = R"(select(.type == "ERROR"))";
+
+	json_query jq;
+	jv input = json_query::parse(json);
+	ASSERT_TRUE(jv_is_valid(input));
+	for(int i = 0; i < 3; i++)
+	{
+		// the same as going through the result text
+		Json::Value root, expected;
+		ASSERT_TRUE(jq.process(input, filter));
+		ASSERT_TRUE(jq.result(root));
+		ASSERT_TRUE(jq.process(json, filter));
+		ASSERT_TRUE(Json::Reader().parse(jq.result(), expected));
+		ASSERT_EQ(expected, root);
+		ASSERT_EQ(3, root["n"].asInt());
+
+		ASSERT_FALSE(jq.process(input, error_filter));
+	}
+	jv_free(input);
+
+	ASSERT_FALSE(jq.process(json, "]"));
+	ASSERT_EQ("Filter parsing failed.", jq.get_error());
+
+	auto stats = jq.get_stats();
+	ASSERT_EQ(6u, stats[filter].m_runs);
+	ASSERT_EQ(0u, stats[filter].m_failures);
+	ASSERT_EQ(3u, stats[error_filter].m_runs);
+	ASSERT_EQ(3u, stats[error_filter].m_failures);
+	ASSERT_EQ(0u, stats["]"].m_runs);
+}
+
+#endif // __linux__
@@ -0,0 +1,102 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "json_stream_parser.h"
+
+using namespace libsinsp;
+
+TEST(json_stream_parser, extract_fields)
+{
+	json_stream_parser p(R"({
+		"skipped": {"a": [1, 2.5e3, {"b": "}]\"["}], "c": null, "d": true},
+		"name": "pod\u00e9\ud83d\ude00\n",
+		"count": -42,
+		"list": ["x", 3, "y"]
+	})");
+
+	std::string name;
+	int64_t count = 0;
+	std::vector<std::string> list;
+
+	ASSERT_TRUE(p.enter_object());
+	while(p.next_member())
+	{
+		if(p.key() == "name") { ASSERT_TRUE(p.read_string(name)); }
+		else if(p.key() == "count") { ASSERT_TRUE(p.read_int64(count)); }
+		else if(p.key() == "list")
+		{
+			ASSERT_TRUE(p.enter_array());
+			std::string s;
+			while(p.next_element())
+			{
+				if(p.read_string(s))
+				{
+					list.push_back(s);
+				}
+			}
+		}
+		else { ASSERT_TRUE(p.skip()); }
+	}
+
+	ASSERT_TRUE(p.at_end());
+	ASSERT_EQ("pod\xc3\xa9\xf0\x9f\x98\x80\n", name);
+	ASSERT_EQ(-42, count);
+	ASSERT_EQ(std::vector<std::string>({"x", "y"}), list);
+}
+
+TEST(json_stream_parser, type_mismatch)
+{
+	json_stream_parser p(R"({"a": null, "b": 1.5, "c": {"x": 1}, "d": "e"})");
+	std::string s;
+	int64_t i;
+
+	ASSERT_TRUE(p.enter_object());
+	ASSERT_TRUE(p.next_member());
+	ASSERT_FALSE(p.read_string(s));
+	ASSERT_TRUE(p.next_member());
+	ASSERT_FALSE(p.read_int64(i));
+	ASSERT_TRUE(p.next_member());
+	ASSERT_FALSE(p.enter_array());
+	ASSERT_TRUE(p.next_member());
+	ASSERT_FALSE(p.enter_object());
+	ASSERT_FALSE(p.next_member());
+	ASSERT_TRUE(p.ok());
+	ASSERT_TRUE(p.at_end());
+}
+
+TEST(json_stream_parser, syntax_errors)
+{
+	for(const char* json : {"{\"a\" 1}", "{\"a\": 1,}", "{\"a\": [1 2]}", "{\"a\": \"x", "{\"a\": {\"b\": 1}", "{} x"})
+	{
+		json_stream_parser p(json);
+		if(p.enter_object())
+		{
+			while(p.next_member())
+			{
+				if(p.enter_array())
+				{
+					while(p.next_element())
+					{
+						p.skip();
+					}
+				}
+			}
+		}
+		ASSERT_FALSE(p.at_end()) << json;
+	}
+}
@@ -0,0 +1,196 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef MINIMAL_BUILD
+
+#include <gtest.h>
+#include "k8s_pod_handler.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+const char* POD = R"({
+	"kind": "Pod",
+	"apiVersion": "v1",
+	"metadata": {
+		"name": "web-7d9f",
+		"namespace": "default",
+		"uid": "0b1f7e3a-6c1d-4f5e-9a1b-2f3c4d5e6f70",
+		"creationTimestamp": "2021-03-01T10:00:00Z",
+		"labels": {"tier": "front", "app": "web", "replicas": 3},
+		"ownerReferences": [{"kind": "ReplicaSet", "name": "web"}]
+	},
+	"spec": {
+		"nodeName": "node-1",
+		"containers": [
+			{"name": "nginx", "image": "nginx:1.19", "ports": [{"name": "http", "containerPort": 80, "protocol": "TCP"}, {"containerPort": 443}]},
+			{"name": "sidecar", "args": ["--a=\"]}\""]}
+		]
+	},
+	"status": {
+		"phase": "Running",
+		"initContainerStatuses": [{"name": "init", "containerID": "docker://ffff", "restartCount": 7}],
+		"hostIP": "10.0.0.1",
+		"podIP": "172.16.0.5",
+		"containerStatuses": [
+			{"name": "nginx", "containerID": "docker://aaaa", "restartCount": 2},
+			{"name": "sidecar", "restartCount": 1}
+		]
+	}
+})";
+
+// what the jq filters turn a pod into
+Json::Value normalize(const Json::Value& pod)
+{
+	Json::Value item;
+	item["namespace"] = pod["metadata"]["namespace"];
+	item["name"] = pod["metadata"]["name"];
+	item["uid"] = pod["metadata"]["uid"];
+	item["nodeName"] = pod["spec"]["nodeName"];
+	item["hostIP"] = pod["status"]["hostIP"];
+	item["podIP"] = pod["status"]["podIP"];
+	item["containers"] = pod["spec"]["containers"];
+	item["containerStatuses"] = pod["status"]["containerStatuses"];
+	item["initContainerStatuses"] = pod["status"]["initContainerStatuses"];
+	item["labels"] = pod["metadata"]["labels"];
+	return item;
+}
+
+k8s_pod_handler::pod_item extract_dom(const Json::Value& item)
+{
+	k8s_pod_handler::pod_item pod;
+	pod.m_name = item["name"].asString();
+	pod.m_uid = item["uid"].asString();
+	pod.m_namespace = item["namespace"].asString();
+	pod.m_labels = k8s_component::extract_object(item, "labels");
+	pod.m_container_ids = k8s_pod_handler::extract_pod_container_ids(item);
+	pod.m_containers = k8s_pod_handler::extract_pod_containers(item);
+	k8s_pod_handler::extract_pod_data(item, pod);
+	pod.m_restart_count = k8s_pod_handler::extract_pod_restart_count(item);
+	return pod;
+}
+
+void assert_same(const k8s_pod_handler::pod_item& a, const k8s_pod_handler::pod_item& b)
+{
+	ASSERT_EQ(a.m_name, b.m_name);
+	ASSERT_EQ(a.m_uid, b.m_uid);
+	ASSERT_EQ(a.m_namespace, b.m_namespace);
+	ASSERT_EQ(a.m_labels, b.m_labels);
+	ASSERT_EQ(a.m_container_ids, b.m_container_ids);
+	ASSERT_TRUE(a.m_containers == b.m_containers);
+	ASSERT_EQ(a.m_node_name, b.m_node_name);
+	ASSERT_EQ(a.m_host_ip, b.m_host_ip);
+	ASSERT_EQ(a.m_pod_ip, b.m_pod_ip);
+	ASSERT_EQ(a.m_restart_count, b.m_restart_count);
+}
+
+}
+
+TEST(k8s_pod_handler, decode_event)
+{
+	std::string json = std::string("{\"type\": \"MODIFIED\", \"object\": ") + POD + "}";
+	k8s_pod_handler::pod_msg msg;
+	ASSERT_TRUE(k8s_pod_handler::decode_pod_json(json, msg));
+	ASSERT_EQ("MODIFIED", msg.m_type);
+	ASSERT_EQ(1u, msg.m_items.size());
+
+	Json::Value pod;
+	ASSERT_TRUE(Json::Reader().parse(POD, pod));
+	assert_same(extract_dom(normalize(pod)), msg.m_items[0]);
+
+	const auto& item = msg.m_items[0];
+	ASSERT_EQ(k8s_pair_list({{"app", "web"}, {"tier", "front"}}), item.m_labels);
+	ASSERT_EQ(k8s_pod_t::container_id_list({"docker://aaaa", "docker://ffff"}), item.m_container_ids);
+	ASSERT_EQ(2u, item.m_containers.size());
+	ASSERT_EQ(80u, item.m_containers[0].get_port("http")->get_port());
+	ASSERT_EQ("TCP", item.m_containers[0].get_port("http")->get_protocol());
+	ASSERT_EQ(3u, item.m_restart_count);
+	ASSERT_EQ("172.16.0.5", item.m_pod_ip);
+}
+
+TEST(k8s_pod_handler, decode_state)
+{
+	std::string json = std::string("{\"kind\": \"PodList\", \"apiVersion\": \"v1\", "
+								   "\"metadata\": {\"resourceVersion\": \"42\"}, \"items\": [") +
+					   POD + ", " + POD + "]}";
+	k8s_pod_handler::pod_msg msg;
+	ASSERT_TRUE(k8s_pod_handler::decode_pod_json(json, msg));
+	ASSERT_EQ("ADDED", msg.m_type);
+	ASSERT_EQ(2u, msg.m_items.size());
+	assert_same(msg.m_items[0], msg.m_items[1]);
+
+	ASSERT_TRUE(k8s_pod_handler::decode_pod_json("{\"kind\": \"PodList\", \"items\": []}", msg));
+	ASSERT_TRUE(msg.m_items.empty());
+}
+
+TEST(k8s_pod_handler, decode_leaves_errors_to_jq)
+{
+	k8s_pod_handler::pod_msg msg;
+	ASSERT_FALSE(k8s_pod_handler::decode_pod_json(
+		"{\"type\": \"ERROR\", \"object\": {\"kind\": \"Status\", \"code\": 410}}", msg));
+	ASSERT_FALSE(k8s_pod_handler::decode_pod_json(
+		"{\"kind\": \"Status\", \"status\": \"Failure\", \"code\": 403}", msg));
+	ASSERT_FALSE(k8s_pod_handler::decode_pod_json("{\"type\": \"ADDED\", \"object\": {", msg));
+}
+
+//
+// Throughput of the streaming decoding against the JSON DOM path
+// (parse plus the extract_* functions; the jq filter, which comes on
+// top of that, is not included) over a generated watch stream of 20000
+// pod updates
+//
+TEST(k8s_pod_handler, DISABLED_decode_benchmark)
+{
+	std::vector<std::string> stream;
+	size_t bytes = 0;
+	for(int i = 0; i < 20000; i++)
+	{
+		std::string pod = POD;
+		pod.replace(pod.find("web-7d9f"), 8, "web-" + std::to_string(100000 + i).substr(1, 4));
+		stream.push_back(std::string("{\"type\": \"MODIFIED\", \"object\": ") + pod + "}");
+		bytes += stream.back().size();
+	}
+
+	size_t items = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(const auto& json : stream)
+	{
+		Json::Value root;
+		Json::Reader().parse(json, root);
+		items += extract_dom(normalize(root["object"])).m_containers.size();
+	}
+	auto dom = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for(const auto& json : stream)
+	{
+		k8s_pod_handler::pod_msg msg;
+		k8s_pod_handler::decode_pod_json(json, msg);
+		items -= msg.m_items[0].m_containers.size();
+	}
+	auto streaming = std::chrono::steady_clock::now() - start;
+
+	ASSERT_EQ(0u, items);
+	auto mb_per_s = [bytes](std::chrono::steady_clock::duration d) {
+		return bytes / std::chrono::duration<double>(d).count() / (1024 * 1024);
+	};
+	std::cout << "DOM: " << mb_per_s(dom) << " MB/s, streaming: " << mb_per_s(streaming) << " MB/s" << std::endl;
+}
+
+#endif // MINIMAL_BUILD
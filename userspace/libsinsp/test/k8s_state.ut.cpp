@@ -0,0 +1,221 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#if !defined(MINIMAL_BUILD) && !defined(HAS_ANALYZER)
+
+#include <gtest.h>
+#include "k8s_state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace {
+
+std::string uid(int i)
+{
+	return "uid-" + std::to_string(i);
+}
+
+k8s_pod_t& add_pod(k8s_state_t& state, int i, k8s_pair_list labels)
+{
+	k8s_pod_t& pod = state.get_component<k8s_pods, k8s_pod_t>(state.get_pods(),
+		"pod-" + std::to_string(i), uid(i), "ns-" + std::to_string(i % 3));
+	pod.set_labels(std::move(labels));
+	pod.set_container_ids({"docker://" + std::to_string(100000000000LL + i)});
+	return pod;
+}
+
+}
+
+TEST(k8s_state, uid_index)
+{
+	k8s_state_t state;
+	for(int i = 0; i < 1000; i++)
+	{
+		add_pod(state, i, {});
+	}
+
+	// erase from the middle, the end, and one that does not exist
+	ASSERT_TRUE(state.delete_component(state.get_pods(), uid(500)));
+	ASSERT_TRUE(state.delete_component(state.get_pods(), uid(999)));
+	ASSERT_FALSE(state.delete_component(state.get_pods(), uid(999)));
+	add_pod(state, 1000, {});
+
+	for(int i = 0; i <= 1000; i++)
+	{
+		const k8s_pod_t* pod = state.get_component<k8s_pods, k8s_pod_t>(state.get_pods(), uid(i));
+		if(i == 500 || i == 999)
+		{
+			ASSERT_EQ(nullptr, pod);
+			ASSERT_FALSE(state.has(uid(i)));
+		}
+		else
+		{
+			ASSERT_NE(nullptr, pod);
+			ASSERT_EQ(uid(i), pod->get_uid());
+			ASSERT_TRUE(state.has(uid(i)));
+		}
+	}
+
+	// the vector changing behind the index back is picked up too
+	state.get_pods().erase(state.get_pods().begin());
+	ASSERT_EQ(nullptr, (state.get_component<k8s_pods, k8s_pod_t>(state.get_pods(), uid(0))));
+	ASSERT_EQ(uid(1), (state.get_component<k8s_pods, k8s_pod_t>(state.get_pods(), uid(1))->get_uid()));
+}
+
+TEST(k8s_state, incremental_caches)
+{
+	k8s_state_t state;
+	std::mt19937 rng(42);
+	auto random_labels = [&rng](size_t max) {
+		k8s_pair_list labels;
+		size_t n = rng() % (max + 1);
+		for(size_t i = 0; i < n; i++)
+		{
+			labels.emplace_back("k" + std::to_string(rng() % 4), "v" + std::to_string(rng() % 3));
+		}
+		return labels;
+	};
+
+	state.get_pods().reserve(3000);
+	for(int i = 0; i < 2000; i++)
+	{
+		add_pod(state, i, random_labels(4));
+	}
+	for(int i = 0; i < 200; i++)
+	{
+		k8s_service_t& service = state.get_component<k8s_services, k8s_service_t>(state.get_services(),
+			"svc-" + std::to_string(i), "svc-uid-" + std::to_string(i), "ns-" + std::to_string(i % 3));
+		service.set_selectors(random_labels(2));
+	}
+	state.update_cache(k8s_component::K8S_PODS);
+	state.update_cache(k8s_component::K8S_SERVICES);
+	ASSERT_EQ(2000u, state.get_container_pod_map().size());
+	state.get_pod_service_map();
+
+	// pods changing and being added, then services changing, each
+	// updating the caches in place
+	for(int i = 0; i < 500; i++)
+	{
+		int n = rng() % 2500;
+		if(n < 2000)
+		{
+			k8s_pod_t* pod = state.get_component<k8s_pods, k8s_pod_t>(state.get_pods(), uid(n));
+			pod->set_labels(random_labels(4));
+			pod->set_container_ids({"docker://" + std::to_string(200000000000LL + n)});
+		}
+		else
+		{
+			n = 2000 + i;
+			add_pod(state, n, random_labels(4));
+		}
+		state.update_cache(k8s_component::K8S_PODS, uid(n));
+	}
+	for(const auto& service : state.get_services())
+	{
+		ASSERT_EQ(service.get_selected_pods(state.get_pods()), state.get_selected_pods(service));
+	}
+	ASSERT_EQ(state.get_pods().size(), state.get_container_pod_map().size());
+	for(const auto& pod : state.get_pods())
+	{
+		ASSERT_EQ(&pod, state.get_pod(pod.get_container_ids()[0].substr(9, 12)));
+	}
+
+	// as before, pod changes don't update the pod to service map
+	state.update_cache(k8s_component::K8S_SERVICES);
+	for(int i = 0; i < 100; i++)
+	{
+		std::string svc_uid = "svc-uid-" + std::to_string(rng() % 200);
+		state.get_component<k8s_services, k8s_service_t>(state.get_services(), svc_uid)->set_selectors(random_labels(2));
+		state.update_cache(k8s_component::K8S_SERVICES, svc_uid);
+	}
+
+	size_t selected = 0;
+	for(const auto& service : state.get_services())
+	{
+		std::vector<const k8s_pod_t*> expected = service.get_selected_pods(state.get_pods());
+		for(const k8s_pod_t* pod : expected)
+		{
+			auto range = state.get_pod_service_map().equal_range(pod->get_uid());
+			ASSERT_EQ(1, std::count_if(range.first, range.second,
+				[&service](const k8s_state_t::pod_service_map::value_type& v) { return v.second == &service; }));
+		}
+		selected += expected.size();
+	}
+	ASSERT_GT(selected, 0u);
+	ASSERT_EQ(selected, state.get_pod_service_map().size());
+}
+
+//
+// Cost of a pod update (lookup, change, cache update and a lookup of
+// the container and service caches, as done when handling a watch
+// event and then a syscall event) on a large generated cluster, with a
+// service update every 10 pod updates
+//
+TEST(k8s_state, DISABLED_update_benchmark)
+{
+	// a multiple of the namespace count, so that the app label of
+	// a pod is always in the namespace of the service selecting it
+	const int num_services = 2100;
+	const int num_pods = 100000;
+	const int num_updates = 20000;
+
+	k8s_state_t state;
+	for(int i = 0; i < num_pods; i++)
+	{
+		add_pod(state, i, {{"app", "app-" + std::to_string(i % num_services)}, {"tier", "t" + std::to_string(i % 4)}});
+	}
+	for(int i = 0; i < num_services; i++)
+	{
+		k8s_service_t& service = state.get_component<k8s_services, k8s_service_t>(state.get_services(),
+			"svc-" + std::to_string(i), "svc-uid-" + std::to_string(i), "ns-" + std::to_string(i % 3));
+		service.set_selectors({{"app", "app-" + std::to_string(i)}});
+	}
+	state.update_cache(k8s_component::K8S_PODS);
+	state.update_cache(k8s_component::K8S_SERVICES);
+	state.get_pod_service_map();
+
+	std::mt19937 rng(42);
+	size_t found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < num_updates; i++)
+	{
+		int n = rng() % num_pods;
+		k8s_pod_t* pod = state.get_component<k8s_pods, k8s_pod_t>(state.get_pods(), uid(n));
+		pod->set_restart_count(i);
+		state.update_cache(k8s_component::K8S_PODS, uid(n));
+		if(i % 10 == 0)
+		{
+			std::string svc_uid = "svc-uid-" + std::to_string(rng() % num_services);
+			k8s_service_t* service = state.get_component<k8s_services, k8s_service_t>(state.get_services(), svc_uid);
+			service->set_cluster_ip(std::to_string(i));
+			state.update_cache(k8s_component::K8S_SERVICES, svc_uid);
+		}
+		found += state.get_pod(std::to_string(100000000000LL + n).substr(0, 12)) != nullptr;
+		found += state.get_pod_service_map().count(uid(n));
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	ASSERT_EQ(2u * num_updates, found);
+	std::cout << "pod update: " <<
+		std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / num_updates <<
+		" ns" << std::endl;
+}
+
+#endif // !MINIMAL_BUILD && !HAS_ANALYZER
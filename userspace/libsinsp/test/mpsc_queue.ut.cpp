@@ -0,0 +1,165 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <mpsc_queue.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace libsinsp;
+
+TEST(mpsc_queue_test, fifo)
+{
+	mpsc_queue<std::string> q(3);
+	ASSERT_EQ(4u, q.capacity());
+	ASSERT_TRUE(q.empty());
+
+	std::string val;
+	ASSERT_FALSE(q.pop(val));
+
+	// wrap around the ring a few times
+	for(int lap = 0; lap < 3; lap++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			ASSERT_TRUE(q.push(std::to_string(lap * 10 + j)));
+		}
+		ASSERT_EQ(4u, q.size());
+
+		for(int j = 0; j < 4; j++)
+		{
+			ASSERT_TRUE(q.pop(val));
+			ASSERT_EQ(std::to_string(lap * 10 + j), val);
+		}
+		ASSERT_TRUE(q.empty());
+	}
+	ASSERT_EQ(0u, q.dropped());
+}
+
+TEST(mpsc_queue_test, overflow_policies)
+{
+	mpsc_queue<int> newest(4, mpsc_queue<int>::DROP_NEWEST);
+	mpsc_queue<int> oldest(4, mpsc_queue<int>::DROP_OLDEST);
+	for(int j = 0; j < 10; j++)
+	{
+		ASSERT_EQ(j < 4, newest.push(std::move(j)));
+		ASSERT_TRUE(oldest.push(std::move(j)));
+	}
+	ASSERT_EQ(6u, newest.dropped());
+	ASSERT_EQ(6u, oldest.dropped());
+
+	std::vector<int> vals;
+	ASSERT_EQ(4u, newest.pop_batch(vals, 10));
+	ASSERT_EQ(std::vector<int>({0, 1, 2, 3}), vals);
+
+	vals.clear();
+	ASSERT_EQ(3u, oldest.pop_batch(vals, 3));
+	ASSERT_EQ(1u, oldest.pop_batch(vals, 3));
+	ASSERT_EQ(std::vector<int>({6, 7, 8, 9}), vals);
+}
+
+TEST(mpsc_queue_test, destroys_queued_elements)
+{
+	auto val = std::make_shared<int>(42);
+	{
+		mpsc_queue<std::shared_ptr<int>> q(8);
+		q.push(val);
+		q.push(val);
+		ASSERT_EQ(3, val.use_count());
+	}
+	ASSERT_EQ(1, val.use_count());
+}
+
+TEST(mpsc_queue_test, concurrent_producers)
+{
+	const uint64_t NUM_PRODUCERS = 4;
+	const uint64_t ITEMS_PER_PRODUCER = 100000;
+
+	for(auto policy : {mpsc_queue<uint64_t>::DROP_NEWEST, mpsc_queue<uint64_t>::DROP_OLDEST})
+	{
+		mpsc_queue<uint64_t> q(256, policy);
+		std::atomic<uint64_t> rejected(0);
+
+		std::vector<std::thread> producers;
+		for(uint64_t i = 0; i < NUM_PRODUCERS; i++)
+		{
+			producers.emplace_back([&q, &rejected, i]() {
+				for(uint64_t j = 0; j < ITEMS_PER_PRODUCER; j++)
+				{
+					uint64_t val = i * ITEMS_PER_PRODUCER + j;
+					if(!q.push(std::move(val)))
+					{
+						rejected++;
+					}
+				}
+			});
+		}
+
+		// the values of each producer must come out in order, and
+		// every value must either come out or be counted as dropped
+		std::vector<uint64_t> last(NUM_PRODUCERS, 0);
+		std::vector<bool> seen(NUM_PRODUCERS, false);
+		uint64_t received = 0;
+		std::vector<uint64_t> batch;
+		// no ASSERT_* here: returning early would leave the producers
+		// running, and their std::thread unjoined
+		auto drain = [&]() {
+			batch.clear();
+			q.pop_batch(batch, 64);
+			for(uint64_t val : batch)
+			{
+				received++;
+				uint64_t producer = val / ITEMS_PER_PRODUCER;
+				if(producer >= NUM_PRODUCERS)
+				{
+					ADD_FAILURE() << "unexpected value " << val;
+					continue;
+				}
+				if(seen[producer])
+				{
+					EXPECT_GT(val, last[producer]);
+				}
+				seen[producer] = true;
+				last[producer] = val;
+			}
+		};
+
+		while(received + q.dropped() < NUM_PRODUCERS * ITEMS_PER_PRODUCER)
+		{
+			drain();
+		}
+		for(auto& t : producers)
+		{
+			t.join();
+		}
+
+		ASSERT_TRUE(q.empty());
+		ASSERT_EQ(NUM_PRODUCERS * ITEMS_PER_PRODUCER, received + q.dropped());
+		if(policy == mpsc_queue<uint64_t>::DROP_NEWEST)
+		{
+			ASSERT_EQ(rejected, q.dropped());
+		}
+		else
+		{
+			ASSERT_EQ(0u, rejected);
+		}
+	}
+}
@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <rcu_ptr.h>
+
+#include <atomic>
+#include <map>
+#include <thread>
+#include <vector>
+
+using namespace libsinsp;
+
+TEST(rcu_ptr_test, snapshot_is_immutable)
+{
+	rcu_ptr<std::map<int, int>> m;
+
+	m.update([](std::map<int, int>& v) { v[1] = 1; });
+	auto snapshot = m.read();
+
+	m.update([](std::map<int, int>& v) { v[2] = 2; });
+
+	ASSERT_EQ(snapshot->size(), 1u);
+	ASSERT_EQ(m.read()->size(), 2u);
+}
+
+TEST(rcu_ptr_test, independent_instances)
+{
+	rcu_ptr<std::map<int, int>> a;
+	rcu_ptr<std::map<int, int>> b;
+
+	a.update([](std::map<int, int>& v) { v[1] = 1; });
+
+	// the per-thread snapshot cache must not mix up the two instances
+	ASSERT_EQ(a.read()->size(), 1u);
+	ASSERT_EQ(b.read()->size(), 0u);
+	ASSERT_EQ(a.read()->size(), 1u);
+}
+
+TEST(rcu_ptr_test, concurrent_readers_and_writers)
+{
+	const int NUM_WRITERS = 2;
+	const int UPDATES_PER_WRITER = 500;
+	rcu_ptr<std::map<int, int>> m;
+	std::atomic<bool> done(false);
+
+	std::vector<std::thread> readers;
+	for(int i = 0; i < 2; i++)
+	{
+		readers.emplace_back([&]() {
+			size_t last_size = 0;
+			while(!done)
+			{
+				// entries are only ever added, so a newer snapshot
+				// can never be smaller than an older one
+				auto snapshot = m.read();
+				ASSERT_GE(snapshot->size(), last_size);
+				last_size = snapshot->size();
+			}
+		});
+	}
+
+	std::vector<std::thread> writers;
+	for(int i = 0; i < NUM_WRITERS; i++)
+	{
+		writers.emplace_back([&m, i]() {
+			for(int j = 0; j < UPDATES_PER_WRITER; j++)
+			{
+				m.update([&](std::map<int, int>& v) { v[i * UPDATES_PER_WRITER + j] = j; });
+			}
+		});
+	}
+
+	for(auto& t : writers)
+	{
+		t.join();
+	}
+	done = true;
+	for(auto& t : readers)
+	{
+		t.join();
+	}
+
+	ASSERT_EQ(m.read()->size(), (size_t)(NUM_WRITERS * UPDATES_PER_WRITER));
+}
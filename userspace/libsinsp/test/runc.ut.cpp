@@ -0,0 +1,91 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <runc.h>
+
+using namespace libsinsp::runc;
+
+namespace {
+
+const cgroup_layout TEST_LAYOUT[] = {
+	{"/", ""},
+	{"/crio-", ""},
+	{"/cri-containerd-", ".scope"},
+	{"/crio-", ".scope"},
+	{":cri-containerd:", ""},
+	{nullptr, nullptr}
+};
+
+const std::string ID = "a8e2e1ee1e9fa8a22e2a2c6f5db2ab0e3b0d6de4f93d7a0e36af6c3c7d0ab1e2";
+
+}
+
+TEST(runc_test, cgroup_matcher_layouts)
+{
+	cgroup_matcher matcher(TEST_LAYOUT);
+	const std::string cgroups[] = {
+		"/kubepods/besteffort/pod1234/" + ID,
+		"/kubepods/crio-" + ID,
+		"/kubepods.slice/cri-containerd-" + ID + ".scope",
+		"/kubepods.slice/crio-" + ID + ".scope",
+		"/system.slice/containerd.service/kubepods:cri-containerd:" + ID,
+	};
+
+	for(const auto& cgroup : cgroups)
+	{
+		std::string container_id;
+		ASSERT_TRUE(matcher.match(cgroup, container_id)) << cgroup;
+		ASSERT_EQ(container_id, ID.substr(0, 12));
+	}
+}
+
+TEST(runc_test, cgroup_matcher_no_match)
+{
+	cgroup_matcher matcher(TEST_LAYOUT);
+	const std::string cgroups[] = {
+		"/",
+		"/user.slice",
+		"/system.slice/docker-" + ID + ".scope",
+		"/kubepods/" + ID.substr(1),
+		"/kubepods/" + ID.substr(1) + "x",
+		"/kubepods/crio-" + ID + ".service",
+	};
+
+	for(const auto& cgroup : cgroups)
+	{
+		std::string container_id = "unchanged";
+		ASSERT_FALSE(matcher.match(cgroup, container_id)) << cgroup;
+		ASSERT_EQ(container_id, "unchanged");
+
+		// a cached miss stays a miss
+		ASSERT_FALSE(matcher.match(cgroup, container_id)) << cgroup;
+	}
+}
+
+TEST(runc_test, cgroup_matcher_cache_bounded)
+{
+	cgroup_matcher matcher(TEST_LAYOUT, 4);
+
+	for(int i = 0; i < 10; i++)
+	{
+		std::string container_id;
+		std::string cgroup = "/kubepods/pod" + std::to_string(i) + "/" + ID;
+		ASSERT_TRUE(matcher.match(cgroup, container_id));
+		ASSERT_LE(matcher.cache_size(), 4u);
+	}
+}
@@ -0,0 +1,132 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include "sketch.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace libsinsp;
+
+TEST(sketch, hyperloglog)
+{
+	hyperloglog a;
+	hyperloglog b;
+	a.init();
+	b.init();
+	ASSERT_EQ(0u, a.estimate());
+
+	for(uint64_t n : {10, 100, 1000, 10000, 100000})
+	{
+		hyperloglog hll;
+		hll.init();
+		// every value twice
+		for(uint64_t j = 0; j < 2 * n; j++)
+		{
+			uint64_t val = j % n;
+			hll.add((uint8_t*)&val, sizeof(val));
+		}
+		ASSERT_NEAR(n, hll.estimate(), n * 0.1) << n;
+	}
+
+	for(uint32_t j = 0; j < 20000; j++)
+	{
+		std::string val = "10.0.0." + std::to_string(j);
+		((j < 15000) ? a : b).add((uint8_t*)val.c_str(), val.size() + 1);
+		if(j >= 5000)
+		{
+			b.add((uint8_t*)val.c_str(), val.size() + 1);
+		}
+	}
+	a.merge(b);
+	ASSERT_NEAR(20000, a.estimate(), 2000);
+}
+
+TEST(sketch, tdigest)
+{
+	std::mt19937 rng(42);
+	std::exponential_distribution<double> latency(1.0 / 1000);
+	std::vector<double> vals;
+	tdigest a;
+	tdigest b;
+	a.init();
+	b.init();
+	ASSERT_EQ(0, a.quantile(0.5));
+
+	for(uint32_t j = 0; j < 100000; j++)
+	{
+		double val = latency(rng);
+		vals.push_back(val);
+		((j % 3 == 0) ? a : b).add(val);
+	}
+	a.merge(b);
+	std::sort(vals.begin(), vals.end());
+
+	// the rank error gets smaller near the tails
+	for(double q : {0.001, 0.01, 0.1, 0.5, 0.9, 0.99, 0.999})
+	{
+		double rank = (double)(std::lower_bound(vals.begin(), vals.end(), a.quantile(q)) - vals.begin()) / vals.size();
+		ASSERT_NEAR(q, rank, 0.001 + 0.02 * q * (1 - q)) << q;
+	}
+	ASSERT_NEAR(vals[99000], a.quantile(0.99), vals[99000] * 0.02);
+	ASSERT_EQ(vals.front(), a.quantile(0));
+	ASSERT_EQ(vals.back(), a.quantile(1));
+
+	tdigest one;
+	one.init();
+	one.add(42);
+	ASSERT_EQ(42, one.quantile(0.5));
+	ASSERT_EQ(42, one.quantile(0.99));
+}
+
+TEST(sketch, count_min_top)
+{
+	std::mt19937 rng(42);
+	count_min_top a;
+	count_min_top b;
+	a.init();
+	b.init();
+	uint32_t len;
+	ASSERT_EQ(nullptr, a.top(&len));
+
+	// a heavy hitter hidden in a lot of noise, seen mostly by b
+	for(uint32_t j = 0; j < 50000; j++)
+	{
+		std::string val = (j % 20 == 0) ? "heavy" : "noise-" + std::to_string(rng() % 5000);
+		((j % 4 == 0) ? a : b).add((uint8_t*)val.c_str(), val.size() + 1);
+	}
+	a.merge(b);
+
+	uint32_t count;
+	const uint8_t* top = a.top(&len, &count);
+	ASSERT_NE(nullptr, top);
+	ASSERT_STREQ("heavy", (const char*)top);
+	ASSERT_EQ(6u, len);
+	ASSERT_GE(count, 2500u);
+
+	// long values come back truncated but terminated
+	count_min_top c;
+	c.init();
+	std::string val(200, 'x');
+	c.add((uint8_t*)val.c_str(), val.size() + 1);
+	top = c.top(&len);
+	ASSERT_EQ((uint32_t)count_min_top::VALUE_SIZE, len);
+	ASSERT_EQ((size_t)count_min_top::VALUE_SIZE - 1, strlen((const char*)top));
+}
@@ -0,0 +1,221 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#if defined(HAS_CAPTURE) && !defined(_WIN32) && !defined(MINIMAL_BUILD)
+
+#include <gtest.h>
+#include "socket_collector.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * Stands in for socket_data_handler, but does a single read of at most
+ * `max_read` bytes per on_data() call, so a single edge may need
+ * several calls.
+ */
+class fake_handler
+{
+public:
+	static const int CONNECTION_CLOSED = ~0;
+
+	fake_handler(int fd, size_t max_read):
+		m_fd(fd),
+		m_max_read(max_read),
+		m_id("fake" + std::to_string(fd))
+	{
+	}
+
+	int get_socket(long)
+	{
+		return m_fd;
+	}
+
+	const std::string& get_id() const
+	{
+		return m_id;
+	}
+
+	bool is_enabled() const
+	{
+		return m_enabled;
+	}
+
+	void enable(bool e = true)
+	{
+		m_enabled = e;
+	}
+
+	int on_data(char* buf, size_t len)
+	{
+		ssize_t n = recv(m_fd, buf, std::min(len, m_max_read), MSG_DONTWAIT);
+		if(n == 0)
+		{
+			return CONNECTION_CLOSED;
+		}
+		if(n < 0)
+		{
+			m_drained = true;
+			return errno == EAGAIN ? 0 : errno;
+		}
+		m_data.append(buf, n);
+		m_drained = false;
+		return 0;
+	}
+
+	bool is_drained() const
+	{
+		return m_drained;
+	}
+
+	int get_socket_error()
+	{
+		return 0;
+	}
+
+	std::string m_data;
+
+private:
+	int m_fd;
+	size_t m_max_read;
+	std::string m_id;
+	bool m_enabled = true;
+	bool m_drained = true;
+};
+
+struct connection
+{
+	connection()
+	{
+		socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, m_fds);
+	}
+
+	~connection()
+	{
+		close(m_fds[0]);
+		if(m_fds[1] >= 0)
+		{
+			close(m_fds[1]);
+		}
+	}
+
+	void send(const std::string& data)
+	{
+		ASSERT_EQ((ssize_t)data.size(), write(m_fds[1], data.c_str(), data.size()));
+	}
+
+	void close_peer()
+	{
+		close(m_fds[1]);
+		m_fds[1] = -1;
+	}
+
+	int m_fds[2];
+};
+
+class socket_collector_test : public testing::TestWithParam<bool>
+{
+};
+
+}
+
+TEST_P(socket_collector_test, partial_reads)
+{
+	socket_collector<fake_handler> collector(false, 0, GetParam());
+	ASSERT_EQ(GetParam(), collector.uses_epoll());
+	connection conn;
+	auto handler = std::make_shared<fake_handler>(conn.m_fds[0], 10);
+	collector.add(handler);
+
+	conn.send("0123456789abcdefghijKLMNO");
+
+	// the data arrives at once, but takes three reads to consume
+	for(int i = 0; i < 3; i++)
+	{
+		collector.get_data();
+	}
+
+	ASSERT_EQ("0123456789abcdefghijKLMNO", handler->m_data);
+	ASSERT_EQ(1, collector.subscription_count());
+}
+
+TEST_P(socket_collector_test, disabled_handler)
+{
+	socket_collector<fake_handler> collector(false, 0, GetParam());
+	connection conn;
+	auto handler = std::make_shared<fake_handler>(conn.m_fds[0], 1024);
+	collector.add(handler);
+	handler->enable(false);
+
+	conn.send("hello");
+	collector.get_data();
+	ASSERT_EQ("", handler->m_data);
+
+	// no new data comes in, yet the handler still gets what arrived
+	handler->enable();
+	collector.get_data();
+	ASSERT_EQ("hello", handler->m_data);
+}
+
+TEST_P(socket_collector_test, connection_closed)
+{
+	socket_collector<fake_handler> collector(false, 0, GetParam());
+	connection conn1, conn2;
+	auto handler1 = std::make_shared<fake_handler>(conn1.m_fds[0], 1024);
+	auto handler2 = std::make_shared<fake_handler>(conn2.m_fds[0], 1024);
+	collector.add(handler1);
+	collector.add(handler2);
+
+	conn1.send("bye");
+	conn1.close_peer();
+	conn2.send("hi");
+	collector.get_data();
+	collector.get_data();
+
+	ASSERT_EQ("bye", handler1->m_data);
+	ASSERT_EQ("hi", handler2->m_data);
+	ASSERT_FALSE(collector.has(handler1));
+	ASSERT_TRUE(collector.has(handler2));
+}
+
+INSTANTIATE_TEST_CASE_P(socket_collector, socket_collector_test, testing::Values(true, false));
+
+TEST(socket_collector_epoll_test, above_fd_setsize)
+{
+	connection conn;
+	int fd = fcntl(conn.m_fds[0], F_DUPFD, FD_SETSIZE + 10);
+	if(fd < 0)
+	{
+		return; // not allowed to open that many descriptors
+	}
+
+	socket_collector<fake_handler> collector(false, 0, true);
+	auto handler = std::make_shared<fake_handler>(fd, 1024);
+	collector.add(handler);
+
+	conn.send("far away");
+	collector.get_data();
+
+	ASSERT_EQ("far away", handler->m_data);
+	close(fd);
+}
+
+#endif // HAS_CAPTURE && !_WIN32 && !MINIMAL_BUILD
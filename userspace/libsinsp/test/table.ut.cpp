@@ -0,0 +1,394 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// to build the events by hand
+#define VISIBILITY_PRIVATE
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filter.h"
+#include "filterchecks.h"
+#include "table.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+
+extern sinsp_evttables g_infotables;
+
+namespace {
+
+const char* comms[] = {"bash", "sshd", "nginx", "postgres", "java", "python3", "node"};
+
+//
+// Events of random fake threads, built like the ones of
+// sinsp_table::process_proctable()
+//
+class table_events
+{
+public:
+	table_events(sinsp* inspector, uint32_t n_threads):
+		m_threads(n_threads),
+		m_rng(42)
+	{
+		for(uint32_t j = 0; j < n_threads; j++)
+		{
+			m_threads[j].m_tid = 1000 + j;
+			m_threads[j].m_pid = 1000 + j - (j % 4);
+			m_threads[j].m_comm = comms[m_rng() % (sizeof(comms) / sizeof(comms[0]))];
+			m_threads[j].m_exe = m_threads[j].m_comm;
+		}
+
+		m_scapevt.ts = 10 * ONE_SECOND_IN_NS;
+		m_scapevt.type = PPME_SYSDIGEVENT_X;
+		m_scapevt.len = 0;
+		m_scapevt.nparams = 0;
+
+		m_evt.m_inspector = inspector;
+		m_evt.m_info = &(g_infotables.m_event_info[PPME_SYSDIGEVENT_X]);
+		m_evt.m_pevt = &m_scapevt;
+		m_evt.m_cpuid = 0;
+		m_evt.m_evtnum = 0;
+		m_evt.m_fdinfo = NULL;
+	}
+
+	//
+	// An event of a random thread, with random memory counters and
+	// mostly the process name as exe
+	//
+	sinsp_evt* next()
+	{
+		sinsp_threadinfo* tinfo = &m_threads[m_rng() % m_threads.size()];
+		tinfo->m_vmsize_kb = m_rng() % 100000;
+		tinfo->m_vmrss_kb = m_rng() % 10000;
+		tinfo->m_vmswap_kb = m_rng() % 1000;
+		tinfo->m_exe = tinfo->m_comm;
+		if(m_rng() % 2 == 0)
+		{
+			tinfo->m_exe += "-" + std::to_string(m_rng() % 100) + std::string(m_rng() % 40, 'x');
+		}
+
+		m_evt.m_tinfo = tinfo;
+		m_scapevt.tid = tinfo->m_tid;
+		return &m_evt;
+	}
+
+	//
+	// An event one second later, to flush the tables with
+	//
+	sinsp_evt* tick()
+	{
+		m_scapevt.ts += ONE_SECOND_IN_NS;
+		return &m_evt;
+	}
+
+	sinsp_evt* now()
+	{
+		return &m_evt;
+	}
+
+	vector<sinsp_threadinfo> m_threads;
+	std::mt19937 m_rng;
+
+private:
+	scap_evt m_scapevt;
+	sinsp_evt m_evt;
+};
+
+void assert_same_field(const sinsp_table_field& a, const sinsp_table_field& b)
+{
+	ASSERT_EQ(a.m_len, b.m_len);
+	ASSERT_EQ(a.m_cnt, b.m_cnt);
+	ASSERT_EQ(0, memcmp(a.m_val, b.m_val, a.m_len));
+}
+
+//
+// Feed the same random events to a serial table and a sharded one, and
+// check that every sample comes out identical, row order included
+//
+void check_sharded_table(vector<sinsp_view_column_info>& columns)
+{
+	sinsp inspector;
+	sinsp_table serial(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS, sinsp_table::OT_CURSES, 0, 0);
+	sinsp_table sharded(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS, sinsp_table::OT_CURSES, 0, 0);
+	serial.configure(&columns, "", false, 0);
+	sharded.configure(&columns, "", false, 0);
+	sharded.set_aggregation_shards(4);
+	ASSERT_EQ(4u, sharded.get_aggregation_shards());
+	serial.set_sorting_col(1);
+	sharded.set_sorting_col(1);
+
+	table_events events(&inspector, 500);
+	serial.flush(events.now());
+	sharded.flush(events.now());
+
+	for(uint32_t sample = 0; sample < 5; sample++)
+	{
+		uint32_t n_evts = 20000 + events.m_rng() % 20000;
+		for(uint32_t j = 0; j < n_evts; j++)
+		{
+			sinsp_evt* evt = events.next();
+			serial.process_event(evt);
+			sharded.process_event(evt);
+		}
+
+		serial.flush(events.tick());
+		sharded.flush(events.now());
+
+		vector<sinsp_sample_row>* expected = serial.get_sample(ONE_SECOND_IN_NS);
+		vector<sinsp_sample_row>* actual = sharded.get_sample(ONE_SECOND_IN_NS);
+		ASSERT_FALSE(expected->empty());
+		ASSERT_EQ(expected->size(), actual->size());
+		for(uint32_t j = 0; j < expected->size(); j++)
+		{
+			assert_same_field(expected->at(j).m_key, actual->at(j).m_key);
+			ASSERT_EQ(expected->at(j).m_values.size(), actual->at(j).m_values.size());
+			for(uint32_t k = 0; k < expected->at(j).m_values.size(); k++)
+			{
+				assert_same_field(expected->at(j).m_values[k], actual->at(j).m_values[k]);
+			}
+		}
+	}
+}
+
+
+bool same_field(const sinsp_table_field& a, const sinsp_table_field& b)
+{
+	return a.m_len == b.m_len && a.m_cnt == b.m_cnt && memcmp(a.m_val, b.m_val, a.m_len) == 0;
+}
+
+std::string key_of(const sinsp_sample_row& row)
+{
+	return std::string((const char*)row.m_key.m_val, row.m_key.m_len);
+}
+
+//
+// Check that a table emitting only its top rows gives the same sample as
+// a full table that is sorted and truncated. Rows tied with the last one
+// can come out in any order, so they are only checked by value.
+//
+void check_top_rows(uint32_t sorting_col, bool ascending)
+{
+	vector<sinsp_view_column_info> columns = {
+		{"thread.tid", "TID", "", 8, TEF_IS_KEY, A_NONE, A_NONE, {}, ""},
+		{"proc.pid", "PID", "", 8, 0, A_MAX, A_NONE, {}, ""},
+		{"thread.vmsize", "VIRT", "", 8, 0, A_SUM, A_NONE, {}, ""},
+	};
+	const uint32_t max_rows = 25;
+
+	sinsp inspector;
+	sinsp_table full(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS, sinsp_table::OT_CURSES, 0, 0);
+	sinsp_table top(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS, sinsp_table::OT_CURSES, 0, 0);
+	full.configure(&columns, "", false, 0);
+	top.configure(&columns, "", false, 0);
+	top.set_max_rows(max_rows);
+	for(sinsp_table* t : {&full, &top})
+	{
+		t->set_sorting_col(sorting_col);
+		if(ascending)
+		{
+			// selecting the same column again flips the order
+			t->set_sorting_col(sorting_col);
+		}
+		ASSERT_EQ(ascending, t->is_sorting_ascending());
+	}
+
+	table_events events(&inspector, 500);
+	full.flush(events.now());
+	top.flush(events.now());
+
+	for(uint32_t j = 0; j < 20000; j++)
+	{
+		sinsp_evt* evt = events.next();
+		full.process_event(evt);
+		top.process_event(evt);
+	}
+
+	full.flush(events.tick());
+	top.flush(events.now());
+
+	vector<sinsp_sample_row>* expected = full.get_sample(ONE_SECOND_IN_NS);
+	vector<sinsp_sample_row>* actual = top.get_sample(ONE_SECOND_IN_NS);
+	ASSERT_GT(expected->size(), max_rows);
+	ASSERT_EQ(max_rows, actual->size());
+
+	std::map<std::string, const sinsp_sample_row*> full_rows;
+	for(const auto& row : *expected)
+	{
+		full_rows[key_of(row)] = &row;
+	}
+
+	uint32_t col = sorting_col - 1;
+	const sinsp_table_field& last = expected->at(max_rows - 1).m_values[col];
+	std::set<std::string> expected_keys;
+	std::set<std::string> actual_keys;
+	for(uint32_t j = 0; j < max_rows; j++)
+	{
+		const sinsp_sample_row& row = actual->at(j);
+		assert_same_field(expected->at(j).m_values[col], row.m_values[col]);
+
+		auto it = full_rows.find(key_of(row));
+		ASSERT_TRUE(it != full_rows.end());
+		ASSERT_EQ(it->second->m_values.size(), row.m_values.size());
+		for(uint32_t k = 0; k < row.m_values.size(); k++)
+		{
+			assert_same_field(it->second->m_values[k], row.m_values[k]);
+		}
+
+		if(!same_field(expected->at(j).m_values[col], last))
+		{
+			expected_keys.insert(key_of(expected->at(j)));
+		}
+		if(!same_field(row.m_values[col], last))
+		{
+			actual_keys.insert(key_of(row));
+		}
+	}
+	ASSERT_EQ(expected_keys, actual_keys);
+}
+}
+
+TEST(table, sharded_aggregation)
+{
+	vector<sinsp_view_column_info> columns = {
+		{"proc.name", "NAME", "", 16, TEF_IS_KEY, A_NONE, A_NONE, {}, ""},
+		{"thread.vmsize", "VIRT", "", 8, 0, A_SUM, A_NONE, {}, ""},
+		{"thread.vmrss", "RES", "", 8, 0, A_MAX, A_NONE, {}, ""},
+		{"proc.pid", "PID", "", 8, 0, A_MIN, A_NONE, {}, ""},
+		{"thread.vmsize", "VIRTAVG", "", 8, 0, A_AVG, A_NONE, {}, ""},
+		{"proc.exe", "EXE", "", 20, 0, A_MAX, A_NONE, {}, ""},
+		{"thread.vmrss", "RES50", "", 8, 0, A_P50, A_NONE, {}, ""},
+	};
+
+	check_sharded_table(columns);
+}
+
+TEST(table, sharded_aggregation_groupby)
+{
+	vector<sinsp_view_column_info> columns = {
+		{"thread.tid", "TID", "", 8, TEF_IS_KEY, A_NONE, A_NONE, {}, ""},
+		{"proc.name", "NAME", "", 16, TEF_IS_GROUPBY_KEY, A_NONE, A_NONE, {}, ""},
+		{"thread.vmsize", "VIRT", "", 8, 0, A_SUM, A_SUM, {}, ""},
+		{"thread.vmrss", "RES", "", 8, 0, A_MAX, A_AVG, {}, ""},
+		{"proc.exe", "EXE", "", 20, 0, A_MAX, A_MAX, {}, ""},
+		{"proc.pid", "PIDS", "", 8, 0, A_DISTINCT, A_DISTINCT, {}, ""},
+	};
+
+	check_sharded_table(columns);
+}
+
+TEST(table, sharded_aggregation_config)
+{
+	sinsp inspector;
+	sinsp_table list(&inspector, sinsp_table::TT_LIST, ONE_SECOND_IN_NS, sinsp_table::OT_CURSES, 0, 0);
+	ASSERT_THROW(list.set_aggregation_shards(2), sinsp_exception);
+	list.set_aggregation_shards(1);
+	ASSERT_EQ(0u, list.get_aggregation_shards());
+}
+
+TEST(table, top_rows)
+{
+	// every pid is shared by four threads, so there are ties
+	check_top_rows(1, false);
+	check_top_rows(1, true);
+	check_top_rows(2, false);
+	check_top_rows(2, true);
+}
+
+TEST(table, sketch_aggregations)
+{
+	// per process name: distinct pids, 99th percentile of the virtual
+	// memory and most frequent exe
+	vector<sinsp_view_column_info> columns = {
+		{"proc.name", "NAME", "", 16, TEF_IS_KEY, A_NONE, A_NONE, {}, ""},
+		{"proc.pid", "PIDS", "", 8, 0, A_DISTINCT, A_NONE, {}, ""},
+		{"thread.vmsize", "VIRT", "", 8, 0, A_P99, A_NONE, {}, ""},
+		{"proc.exe", "EXE", "", 20, 0, A_TOP, A_NONE, {}, ""},
+	};
+
+	// the same, grouping by name the sketches of every thread
+	vector<sinsp_view_column_info> groupby_columns = {
+		{"thread.tid", "TID", "", 8, TEF_IS_KEY, A_NONE, A_NONE, {}, ""},
+		{"proc.name", "NAME", "", 16, TEF_IS_GROUPBY_KEY, A_NONE, A_NONE, {}, ""},
+		{"proc.pid", "PIDS", "", 8, 0, A_DISTINCT, A_DISTINCT, {}, ""},
+		{"thread.vmsize", "VIRT", "", 8, 0, A_P99, A_P99, {}, ""},
+		{"proc.exe", "EXE", "", 20, 0, A_TOP, A_TOP, {}, ""},
+	};
+
+	sinsp inspector;
+	sinsp_table table(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS, sinsp_table::OT_CURSES, 0, 0);
+	sinsp_table groupby_table(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS, sinsp_table::OT_CURSES, 0, 0);
+	table.configure(&columns, "", false, 0);
+	groupby_table.configure(&groupby_columns, "", false, 0);
+	table.set_sorting_col(1);
+	groupby_table.set_sorting_col(1);
+	ASSERT_EQ(PT_UINT64, table.get_legend()->at(1).m_type);
+	ASSERT_EQ(PT_UINT64, groupby_table.get_legend()->at(1).m_type);
+
+	table_events events(&inspector, 2000);
+	table.flush(events.now());
+	groupby_table.flush(events.now());
+
+	std::map<std::string, std::set<int64_t>> pids;
+	std::map<std::string, vector<uint64_t>> vmsizes;
+	for(uint32_t j = 0; j < 200000; j++)
+	{
+		sinsp_evt* evt = events.next();
+		pids[evt->m_tinfo->m_comm].insert(evt->m_tinfo->m_pid);
+		// thread.vmsize is 0 for the threads that aren't the main one
+		vmsizes[evt->m_tinfo->m_comm].push_back(evt->m_tinfo->is_main_thread()? evt->m_tinfo->m_vmsize_kb : 0);
+		table.process_event(evt);
+		groupby_table.process_event(evt);
+	}
+
+	table.flush(events.tick());
+	groupby_table.flush(events.now());
+
+	for(sinsp_table* t : {&table, &groupby_table})
+	{
+		SCOPED_TRACE(t == &table? "table" : "groupby_table");
+		vector<sinsp_sample_row>* sample = t->get_sample(ONE_SECOND_IN_NS);
+		ASSERT_EQ(pids.size(), sample->size());
+
+		for(const auto& row : *sample)
+		{
+			std::string name = (const char*)row.m_key.m_val;
+			vector<uint64_t>& vals = vmsizes[name];
+			std::sort(vals.begin(), vals.end());
+			double p99 = vals[vals.size() * 99 / 100];
+
+			ASSERT_EQ(sizeof(uint64_t), row.m_values[0].m_len);
+			ASSERT_NEAR(pids[name].size(), *(uint64_t*)row.m_values[0].m_val, pids[name].size() * 0.1);
+			ASSERT_NEAR(p99, *(uint64_t*)row.m_values[1].m_val, p99 * 0.03);
+			ASSERT_EQ(name, (const char*)row.m_values[2].m_val);
+		}
+	}
+}
+
+TEST(table, sketch_aggregations_config)
+{
+	vector<sinsp_view_column_info> columns = {
+		{"proc.pid", "PID", "", 8, TEF_IS_KEY, A_NONE, A_NONE, {}, ""},
+		{"proc.name", "NAME", "", 16, 0, A_P50, A_NONE, {}, ""},
+	};
+
+	sinsp inspector;
+	sinsp_table table(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS, sinsp_table::OT_CURSES, 0, 0);
+	ASSERT_THROW(table.configure(&columns, "", false, 0), sinsp_exception);
+}
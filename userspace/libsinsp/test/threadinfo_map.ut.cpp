@@ -0,0 +1,257 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// to drive the thread manager by hand
+#define VISIBILITY_PRIVATE
+
+#include "sinsp.h"
+#include <gtest.h>
+#include <unistd.h>
+
+static sinsp_threadinfo* make_thread(int64_t tid)
+{
+	sinsp_threadinfo* tinfo = new sinsp_threadinfo();
+	tinfo->m_tid = tid;
+	tinfo->m_pid = tid;
+	return tinfo;
+}
+
+TEST(threadinfo_map_test, expiry_order_follows_insertion)
+{
+	threadinfo_map_t map;
+	ASSERT_EQ(nullptr, map.expiry_head());
+
+	map.put(make_thread(1));
+	map.put(make_thread(2));
+	map.put(make_thread(3));
+
+	ASSERT_EQ(1, map.expiry_head()->m_tid);
+
+	map.erase(1);
+	ASSERT_EQ(2, map.expiry_head()->m_tid);
+	ASSERT_EQ(2, map.size());
+}
+
+TEST(threadinfo_map_test, requeue_moves_to_tail)
+{
+	threadinfo_map_t map;
+	map.put(make_thread(1));
+	map.put(make_thread(2));
+
+	map.expiry_requeue(map.get(1), 100);
+	ASSERT_EQ(2, map.expiry_head()->m_tid);
+
+	map.erase(2);
+	ASSERT_EQ(1, map.expiry_head()->m_tid);
+
+	map.erase(1);
+	ASSERT_EQ(nullptr, map.expiry_head());
+	ASSERT_EQ(0, map.size());
+}
+
+TEST(threadinfo_map_test, put_replaces_existing_entry)
+{
+	threadinfo_map_t map;
+	map.put(make_thread(1));
+	map.put(make_thread(2));
+
+	// a tid collision replaces the old thread and requeues the new one
+	map.put(make_thread(1));
+	ASSERT_EQ(2, map.size());
+	ASSERT_EQ(2, map.expiry_head()->m_tid);
+
+	map.erase(2);
+	ASSERT_EQ(1, map.expiry_head()->m_tid);
+
+	map.clear();
+	ASSERT_EQ(nullptr, map.expiry_head());
+}
+
+//
+// The threads below don't exist in /proc, so the thread manager sees
+// them as dead once they have been idle for longer than the timeout
+//
+class remove_inactive_threads_test : public testing::Test
+{
+protected:
+	static const int64_t s_tid = 0x7ffffff0;
+	static const uint64_t s_start_ts = 1000 * ONE_SECOND_IN_NS;
+
+	void SetUp()
+	{
+		m_inspector.open_nodriver();
+		m_inspector.m_thread_manager->clear();
+		m_inspector.set_thread_timeout_s(10);
+		m_inspector.set_thread_purge_interval_s(20);
+		set_ts(0);
+	}
+
+	void TearDown()
+	{
+		m_inspector.close();
+	}
+
+	void set_ts(uint64_t seconds)
+	{
+		m_inspector.m_lastevent_ts = s_start_ts + seconds * ONE_SECOND_IN_NS;
+	}
+
+	sinsp_threadinfo* add_thread(int64_t tid, int64_t pid)
+	{
+		sinsp_threadinfo* tinfo = new sinsp_threadinfo(&m_inspector);
+		tinfo->m_tid = tid;
+		tinfo->m_pid = pid;
+		tinfo->m_comm = "expiry_test";
+		if(tid != pid)
+		{
+			tinfo->m_flags |= PPM_CL_CLONE_THREAD;
+		}
+		EXPECT_TRUE(m_inspector.add_thread(tinfo));
+		return tinfo;
+	}
+
+	bool has_thread(int64_t tid)
+	{
+		return m_inspector.get_thread_ref(tid, false, true) != nullptr;
+	}
+
+	sinsp m_inspector;
+};
+
+TEST(remove_inactive_threads, proc_threads_are_not_expired_at_start)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+
+	sinsp_threadinfo* tinfo = &*inspector.get_thread_ref(getpid(), false, true);
+	ASSERT_NE(nullptr, tinfo);
+	ASSERT_NE(0, tinfo->m_lastaccess_ts);
+
+	uint32_t nthreads = inspector.m_thread_manager->get_thread_count();
+	inspector.m_lastevent_ts = sinsp_utils::get_current_time_ns();
+	inspector.remove_inactive_threads();
+	ASSERT_EQ(nthreads, inspector.m_thread_manager->get_thread_count());
+	ASSERT_TRUE(inspector.get_thread_ref(getpid(), false, true) != nullptr);
+
+	inspector.close();
+}
+
+TEST_F(remove_inactive_threads_test, expire_dead_threads)
+{
+	add_thread(s_tid, s_tid);
+	add_thread(s_tid + 1, s_tid + 1);
+
+	set_ts(5);
+	m_inspector.get_thread_ref(s_tid + 1, false, false);
+
+	set_ts(11);
+	m_inspector.remove_inactive_threads();
+	ASSERT_FALSE(has_thread(s_tid));
+	ASSERT_TRUE(has_thread(s_tid + 1));
+
+	// requeued at 11s after the lookup at 5s
+	set_ts(16);
+	m_inspector.remove_inactive_threads();
+	ASSERT_TRUE(has_thread(s_tid + 1));
+
+	set_ts(22);
+	m_inspector.remove_inactive_threads();
+	ASSERT_FALSE(has_thread(s_tid + 1));
+}
+
+TEST_F(remove_inactive_threads_test, returns_true_on_table_scan)
+{
+	// with a short interval the first scan is at the next event
+	ASSERT_FALSE(m_inspector.remove_inactive_threads());
+	set_ts(1);
+	ASSERT_TRUE(m_inspector.remove_inactive_threads());
+	set_ts(10);
+	ASSERT_FALSE(m_inspector.remove_inactive_threads());
+	set_ts(21);
+	ASSERT_FALSE(m_inspector.remove_inactive_threads());
+	set_ts(22);
+	ASSERT_TRUE(m_inspector.remove_inactive_threads());
+}
+
+TEST_F(remove_inactive_threads_test, first_scan_after_30s)
+{
+	m_inspector.set_thread_purge_interval_s(1200);
+	ASSERT_FALSE(m_inspector.remove_inactive_threads());
+	set_ts(29);
+	ASSERT_FALSE(m_inspector.remove_inactive_threads());
+	set_ts(31);
+	ASSERT_TRUE(m_inspector.remove_inactive_threads());
+}
+
+TEST_F(remove_inactive_threads_test, closed_process_removed_at_scan)
+{
+	m_inspector.set_thread_timeout_s(1800);
+
+	sinsp_threadinfo* main_thread = add_thread(s_tid, s_tid);
+	add_thread(s_tid + 1, s_tid);
+	ASSERT_EQ(1, main_thread->m_nchilds);
+
+	m_inspector.remove_inactive_threads();
+	set_ts(1);
+	ASSERT_TRUE(m_inspector.remove_inactive_threads());
+
+	// the process exits while one of its threads is still around
+	set_ts(2);
+	main_thread->m_flags |= PPM_CL_CLOSED;
+	m_inspector.remove_thread(s_tid, false);
+	ASSERT_TRUE(has_thread(s_tid));
+
+	// then the last thread exits too
+	set_ts(3);
+	m_inspector.remove_thread(s_tid + 1, false);
+	ASSERT_FALSE(has_thread(s_tid + 1));
+	ASSERT_EQ(0, main_thread->m_nchilds);
+
+	set_ts(10);
+	ASSERT_FALSE(m_inspector.remove_inactive_threads());
+	ASSERT_TRUE(has_thread(s_tid));
+
+	// removed at the next table scan, not after the thread timeout
+	set_ts(22);
+	ASSERT_TRUE(m_inspector.remove_inactive_threads());
+	ASSERT_FALSE(has_thread(s_tid));
+}
+
+TEST_F(remove_inactive_threads_test, fds_erased_over_several_events)
+{
+	sinsp_threadinfo* tinfo = add_thread(s_tid, s_tid);
+
+	sinsp_fdinfo_t fdinfo;
+	fdinfo.m_type = SCAP_FD_FILE_V2;
+	for(int64_t fd = 0; fd < 1000; fd++)
+	{
+		ASSERT_NE(nullptr, tinfo->add_fd(fd, &fdinfo));
+	}
+
+	set_ts(11);
+	m_inspector.remove_inactive_threads();
+	ASSERT_TRUE(has_thread(s_tid));
+	ASSERT_EQ(1000 - 256, tinfo->m_fdtable.size());
+
+	m_inspector.remove_inactive_threads();
+	m_inspector.remove_inactive_threads();
+	ASSERT_TRUE(has_thread(s_tid));
+	ASSERT_EQ(1000 - 3 * 256, tinfo->m_fdtable.size());
+
+	m_inspector.remove_inactive_threads();
+	ASSERT_FALSE(has_thread(s_tid));
+}
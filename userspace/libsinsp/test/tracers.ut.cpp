@@ -0,0 +1,213 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// to look at the parser state
+#define VISIBILITY_PRIVATE
+
+#include <gtest.h>
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "tracers.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace {
+
+class tracers_test : public testing::Test
+{
+protected:
+	tracers_test():
+		m_parser(NULL)
+	{
+		m_tinfo.m_tid = 33;
+		m_tinfo.m_pid = 22;
+		m_tinfo.m_ptid = 11;
+		m_parser.m_tinfo = &m_tinfo;
+	}
+
+	sinsp_tracerparser::parse_result parse(std::string str)
+	{
+		return m_parser.process_event_data((char*)str.c_str(), str.size(), 0);
+	}
+
+	std::vector<std::string> strings(const vector<char*>& strs, const vector<uint32_t>& lens)
+	{
+		std::vector<std::string> res;
+		EXPECT_EQ(strs.size(), lens.size());
+		for(uint32_t j = 0; j < strs.size(); j++)
+		{
+			EXPECT_EQ(strlen(strs[j]), lens[j]);
+			res.push_back(strs[j]);
+		}
+		return res;
+	}
+
+	std::vector<std::string> tags()
+	{
+		return strings(m_parser.m_tags, m_parser.m_taglens);
+	}
+
+	std::vector<std::string> argnames()
+	{
+		return strings(m_parser.m_argnames, m_parser.m_argnamelens);
+	}
+
+	std::vector<std::string> argvals()
+	{
+		return strings(m_parser.m_argvals, m_parser.m_argvallens);
+	}
+
+	sinsp_threadinfo m_tinfo;
+	sinsp_tracerparser m_parser;
+};
+
+typedef std::vector<std::string> strvec;
+
+}
+
+TEST_F(tracers_test, simple)
+{
+	ASSERT_EQ(sinsp_tracerparser::RES_OK, parse(">:t:mysql.query.init:user=root,db=test:"));
+	ASSERT_EQ('>', m_parser.m_type_str[0]);
+	ASSERT_EQ(33, m_parser.m_id);
+	ASSERT_EQ(strvec({"mysql", "query", "init"}), tags());
+	ASSERT_EQ(strvec({"user", "db"}), argnames());
+	ASSERT_EQ(strvec({"root", "test"}), argvals());
+	ASSERT_EQ(14u, m_parser.m_tot_taglens);
+	ASSERT_EQ(6u, m_parser.m_tot_argnamelens);
+	ASSERT_EQ(8u, m_parser.m_tot_argvallens);
+
+	ASSERT_EQ(sinsp_tracerparser::RES_OK, parse("<:pp:a::"));
+	ASSERT_EQ('<', m_parser.m_type_str[0]);
+	ASSERT_EQ(11, m_parser.m_id);
+	ASSERT_EQ(strvec({"a"}), tags());
+	ASSERT_TRUE(argnames().empty());
+
+	ASSERT_EQ(sinsp_tracerparser::RES_OK, parse(">:-12::k=v:"));
+	ASSERT_EQ(-12, m_parser.m_id);
+	ASSERT_TRUE(tags().empty());
+	ASSERT_EQ(strvec({"k"}), argnames());
+
+	ASSERT_EQ(sinsp_tracerparser::RES_FAILED, parse(">:t:a>b::"));
+	ASSERT_EQ(sinsp_tracerparser::RES_FAILED, parse(">:t:a:k<=v:"));
+}
+
+TEST_F(tracers_test, simple_escapes)
+{
+	// escaped delimiters are part of the tokens, and the lengths are
+	// the ones of the unescaped strings
+	ASSERT_EQ(sinsp_tracerparser::RES_OK, parse(">:t:www\\.example\\.com.a\\:b:u\\=rl=/q\\,x\\=1,n=\\\\:"));
+	ASSERT_EQ(strvec({"www.example.com", "a:b"}), tags());
+	ASSERT_EQ(strvec({"u=rl", "n"}), argnames());
+	ASSERT_EQ(strvec({"/q,x=1", "\\"}), argvals());
+	ASSERT_EQ(18u, m_parser.m_tot_taglens);
+	ASSERT_EQ(5u, m_parser.m_tot_argnamelens);
+	ASSERT_EQ(7u, m_parser.m_tot_argvallens);
+
+	ASSERT_EQ(sinsp_tracerparser::RES_OK, parse(">:t:a\\>b::"));
+	ASSERT_EQ(strvec({"a>b"}), tags());
+}
+
+TEST_F(tracers_test, json)
+{
+	ASSERT_EQ(sinsp_tracerparser::RES_OK, parse("[\">\", 12345, [\"mysql\", \"query\"], [{\"user\":\"root\"}, {\"db\":\"a\\\"b\"}]]"));
+	ASSERT_EQ('>', m_parser.m_type_str[0]);
+	ASSERT_EQ(12345, m_parser.m_id);
+	ASSERT_EQ(strvec({"mysql", "query"}), tags());
+	ASSERT_EQ(strvec({"user", "db"}), argnames());
+	ASSERT_EQ(strvec({"root", "a\\\"b"}), argvals());
+
+	ASSERT_EQ(sinsp_tracerparser::RES_OK, parse("[\"<\", \"p\", [], []]"));
+	ASSERT_EQ(22, m_parser.m_id);
+	ASSERT_TRUE(tags().empty());
+	ASSERT_TRUE(argnames().empty());
+}
+
+TEST_F(tracers_test, fragments)
+{
+	ASSERT_EQ(sinsp_tracerparser::RES_TRUNCATED, parse(">:t:mysql.qu"));
+	ASSERT_EQ(sinsp_tracerparser::RES_TRUNCATED, parse("ery:user=r"));
+	ASSERT_EQ(sinsp_tracerparser::RES_OK, parse("oot:"));
+	ASSERT_EQ(strvec({"mysql", "query"}), tags());
+	ASSERT_EQ(strvec({"root"}), argvals());
+
+	ASSERT_EQ(sinsp_tracerparser::RES_TRUNCATED, parse("[\">\", 1, [\"a\\\"b"));
+	ASSERT_EQ(sinsp_tracerparser::RES_OK, parse("\"], []]"));
+	ASSERT_EQ(strvec({"a\\\"b"}), tags());
+}
+
+TEST(tracers, partial_tracer_storage)
+{
+	sinsp_partial_tracer pae;
+	ASSERT_EQ(nullptr, pae.m_tags_storage);
+	ASSERT_EQ(0u, pae.m_tags_storage_size);
+
+	pae.reserve(&pae.m_tags_storage, &pae.m_tags_storage_size, 10);
+	ASSERT_NE(nullptr, pae.m_tags_storage);
+	ASSERT_EQ((uint32_t)UESTORAGE_INITIAL_BUFSIZE, pae.m_tags_storage_size);
+
+	pae.reserve(&pae.m_tags_storage, &pae.m_tags_storage_size, UESTORAGE_INITIAL_BUFSIZE + 1);
+	ASSERT_EQ(2u * UESTORAGE_INITIAL_BUFSIZE, pae.m_tags_storage_size);
+
+	pae.reserve(&pae.m_tags_storage, &pae.m_tags_storage_size, 10000);
+	ASSERT_EQ(10000u, pae.m_tags_storage_size);
+	memset(pae.m_tags_storage, 0, 10000);
+}
+
+//
+// Parsing cost of spans like the ones emitted by instrumented apps,
+// simple and JSON, with a few escapes, all through the same parser
+//
+TEST_F(tracers_test, DISABLED_parse_benchmark)
+{
+	std::mt19937 rng(42);
+	std::vector<std::string> spans;
+	for(uint32_t j = 0; j < 1000; j++)
+	{
+		std::string id = std::to_string(rng() % 100000);
+		std::string req = "req" + std::to_string(rng() % 1000);
+		if(j % 4 == 0)
+		{
+			spans.push_back("[\">\", " + id + ", [\"api\", \"" + req + "\", \"db\"], "
+				"[{\"query\":\"select * from t where id = " + id + "\"}, {\"host\":\"db-1\"}]]");
+			spans.push_back("[\"<\", " + id + ", [\"api\", \"" + req + "\", \"db\"], []]");
+		}
+		else
+		{
+			spans.push_back(">:t:api." + req + ".http:url=/v1/users/" + id + "?a\\=1,method=GET,host=www\\.example\\.com:");
+			spans.push_back("<:t:api." + req + ".http:status=200:");
+		}
+	}
+
+	const uint32_t n_rounds = 500;
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t j = 0; j < n_rounds; j++)
+	{
+		for(const auto& span : spans)
+		{
+			ASSERT_EQ(sinsp_tracerparser::RES_OK,
+				m_parser.process_event_data((char*)span.c_str(), span.size(), j));
+		}
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "span parse: " <<
+		std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / (n_rounds * spans.size()) <<
+		" ns" << std::endl;
+}
@@ -89,6 +89,9 @@ void sinsp_threadinfo::init()
 	m_category = CAT_NONE;
 	m_blprogram = NULL;
 	m_loginuid = 0;
+	m_expiry_prev = NULL;
+	m_expiry_next = NULL;
+	m_expiry_ts = 0;
 }
 
 sinsp_threadinfo::~sinsp_threadinfo()
@@ -103,7 +106,17 @@ sinsp_threadinfo::~sinsp_threadinfo()
 	m_private_state.clear();
 	if(m_lastevent_data)
 	{
-		free(m_lastevent_data);
+		//
+		// The parser is gone if the whole inspector is going away
+		//
+		if(m_inspector != NULL && m_inspector->m_parser != NULL)
+		{
+			m_inspector->m_parser->release_event_buffer(m_lastevent_data);
+		}
+		else
+		{
+			sinsp_parser::destroy_event_buffer(m_lastevent_data);
+		}
 	}
 
 	if(m_tracer_parser)
@@ -501,14 +514,21 @@ std::string sinsp_threadinfo::get_exepath() const
 
 void sinsp_threadinfo::set_args(const char* args, size_t len)
 {
-	m_args.clear();
+	//
+	// Build the new vector from scratch rather than going through
+	// m_args: its storage may still be shared with the parent
+	// and we don't want to copy it just to overwrite it
+	//
+	vector<string> new_args;
 
 	size_t offset = 0;
 	while(offset < len)
 	{
-		m_args.push_back(args + offset);
-		offset += m_args.back().length() + 1;
+		new_args.push_back(args + offset);
+		offset += new_args.back().length() + 1;
 	}
+
+	m_args = std::move(new_args);
 }
 
 void sinsp_threadinfo::set_env(const char* env, size_t len)
@@ -526,7 +546,7 @@ void sinsp_threadinfo::set_env(const char* env, size_t len)
 		}
 	}
 
-	m_env.clear();
+	vector<string> new_env;
 	size_t offset = 0;
 	while(offset < len)
 	{
@@ -540,14 +560,16 @@ void sinsp_threadinfo::set_env(const char* env, size_t len)
 			if(!memcmp(left, zero, sz))
 			{
 				free(zero);
-				return;
+				break;
 			}
 			free(zero);
 		}
-		m_env.push_back(left);
+		new_env.push_back(left);
 
-		offset += m_env.back().length() + 1;
+		offset += new_env.back().length() + 1;
 	}
+
+	m_env = std::move(new_env);
 }
 
 bool sinsp_threadinfo::set_env_from_proc() {
@@ -560,16 +582,17 @@ bool sinsp_threadinfo::set_env_from_proc() {
 		return false;
 	}
 
-	m_env.clear();
+	vector<string> new_env;
 	while (environment) {
 		string env;
 		getline(environment, env, '\0');
 		if (!env.empty())
 		{
-			m_env.emplace_back(env);
+			new_env.emplace_back(env);
 		}
 	}
 
+	m_env = std::move(new_env);
 	return true;
 }
 
@@ -618,50 +641,108 @@ string sinsp_threadinfo::get_env(const string& name)
 	return "";
 }
 
-void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
+//
+// Normalize the subsystem names reported by the driver to the
+// ones used in /proc/<pid>/cgroup
+//
+static void normalize_cgroup_subsys(string& subsys)
 {
-	m_cgroups.clear();
+	size_t pos = subsys.find("_cgroup");
+	if(pos != string::npos)
+	{
+		subsys.erase(pos, sizeof("_cgroup") - 1);
+	}
 
+	if(subsys == "perf")
+	{
+		subsys = "perf_event";
+	}
+	else if(subsys == "mem")
+	{
+		subsys = "memory";
+	}
+	else if(subsys == "io")
+	{
+		// blkio has been renamed just `io`
+		// in kernel space:
+		// https://github.com/torvalds/linux/commit/c165b3e3c7bb68c2ed55a5ac2623f030d01d9567
+		subsys = "blkio";
+	}
+}
+
+bool sinsp_threadinfo::cgroups_match(const char* cgroups, size_t len) const
+{
+	string subsys;
 	size_t offset = 0;
+	size_t j = 0;
+
 	while(offset < len)
 	{
 		const char* str = cgroups + offset;
 		const char* sep = strrchr(str, '=');
-		if(sep == NULL)
+		if(sep == NULL || j >= m_cgroups.size())
 		{
-			ASSERT(false);
-			return;
+			return false;
 		}
 
-		string subsys(str, sep - str);
-		string cgroup(sep + 1);
-
-		size_t subsys_length = subsys.length();
-		size_t pos = subsys.find("_cgroup");
-		if(pos != string::npos)
+		const auto& cg = m_cgroups[j++];
+		size_t cgroup_len = strlen(sep + 1);
+		if(cg.second.length() != cgroup_len ||
+		   memcmp(cg.second.c_str(), sep + 1, cgroup_len) != 0)
 		{
-			subsys.erase(pos, sizeof("_cgroup") - 1);
+			return false;
 		}
 
-		if(subsys == "perf")
-		{
-			subsys = "perf_event";
-		}
-		else if(subsys == "mem")
+		subsys.assign(str, sep - str);
+		size_t subsys_length = subsys.length();
+		normalize_cgroup_subsys(subsys);
+		if(subsys != cg.first)
 		{
-			subsys = "memory";
+			return false;
 		}
-		else if(subsys == "io")
+
+		offset += subsys_length + 1 + cgroup_len + 1;
+	}
+
+	return j == m_cgroups.size();
+}
+
+void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
+{
+	//
+	// The cgroups of a new thread or process are almost always
+	// the same as the parent's ones, which we are already sharing.
+	// Only build a new vector if something actually changed.
+	//
+	if(!m_cgroups.empty() && cgroups_match(cgroups, len))
+	{
+		return;
+	}
+
+	vector<pair<string, string>> new_cgroups;
+
+	size_t offset = 0;
+	while(offset < len)
+	{
+		const char* str = cgroups + offset;
+		const char* sep = strrchr(str, '=');
+		if(sep == NULL)
 		{
-			// blkio has been renamed just `io`
-			// in kernel space:
-			// https://github.com/torvalds/linux/commit/c165b3e3c7bb68c2ed55a5ac2623f030d01d9567
-			subsys = "blkio";
+			ASSERT(false);
+			break;
 		}
 
-		m_cgroups.push_back(std::make_pair(subsys, cgroup));
+		string subsys(str, sep - str);
+		string cgroup(sep + 1);
+
+		size_t subsys_length = subsys.length();
+		normalize_cgroup_subsys(subsys);
+
+		new_cgroups.push_back(std::make_pair(subsys, cgroup));
 		offset += subsys_length + 1 + cgroup.length() + 1;
 	}
+
+	m_cgroups = std::move(new_cgroups);
 }
 
 sinsp_threadinfo* sinsp_threadinfo::get_parent_thread()
@@ -1223,6 +1304,9 @@ void sinsp_thread_manager::clear()
 	m_last_tid = 0;
 	m_last_tinfo.reset();
 	m_last_flush_time_ns = 0;
+	m_child_dependencies_dirty = false;
+	m_expiring_tid = -1;
+	m_closed_tids.clear();
 	m_n_drops = 0;
 
 #ifdef GATHER_INTERNAL_STATS
@@ -1287,6 +1371,18 @@ bool sinsp_thread_manager::add_thread(sinsp_threadinfo *threadinfo, bool from_sc
 
 	threadinfo->compute_program_hash();
 	threadinfo->allocate_private_state();
+
+	//
+	// A new thread counts as accessed now, so that it isn't
+	// considered for expiration before the timeout. Threads imported
+	// from /proc are added before the first event, use the wall clock
+	// for them.
+	//
+	if(threadinfo->m_lastaccess_ts == 0)
+	{
+		threadinfo->m_lastaccess_ts = m_inspector->m_lastevent_ts != 0 ?
+			m_inspector->m_lastevent_ts : sinsp_utils::get_current_time_ns();
+	}
 	m_threadtable.put(threadinfo);
 
 	return true;
@@ -1375,6 +1471,16 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 		m_removed_threads->increment();
 #endif
 
+		//
+		// Give back the stored enter event, if any, so it can be recycled
+		//
+		if(tinfo->m_lastevent_data)
+		{
+			m_inspector->m_parser->free_event_buffer(tinfo->m_lastevent_data);
+			tinfo->m_lastevent_data = NULL;
+			tinfo->set_lastevent_data_validity(false);
+		}
+
 		m_threadtable.erase(tid);
 
 		//
@@ -1388,6 +1494,14 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 			recreate_child_dependencies();
 		}
 	}
+	else if(tinfo->m_flags & PPM_CL_CLOSED)
+	{
+		//
+		// The process exited but its threads are still around,
+		// try again at the next table scan
+		//
+		m_closed_tids.push_back(tid);
+	}
 }
 
 void sinsp_thread_manager::fix_sockets_coming_from_proc()
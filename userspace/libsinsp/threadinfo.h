@@ -33,6 +33,7 @@ struct iovec {
 #include <functional>
 #include <memory>
 #include <set>
+#include "cow_vector.h"
 #include "fdinfo.h"
 #include "internal_metrics.h"
 
@@ -252,9 +253,9 @@ public:
 	std::string m_comm; ///< Command name (e.g. "top")
 	std::string m_exe; ///< argv[0] (e.g. "sshd: user@pts/4")
 	std::string m_exepath; ///< full executable path
-	std::vector<std::string> m_args; ///< Command line arguments (e.g. "-d1")
-	std::vector<std::string> m_env; ///< Environment variables
-	std::vector<std::pair<std::string, std::string>> m_cgroups; ///< subsystem-cgroup pairs
+	libsinsp::cow_vector<std::string> m_args; ///< Command line arguments (e.g. "-d1"). Shared with the parent until execve.
+	libsinsp::cow_vector<std::string> m_env; ///< Environment variables. Shared with the parent until execve.
+	libsinsp::cow_vector<std::pair<std::string, std::string>> m_cgroups; ///< subsystem-cgroup pairs. Shared with the parent until they change.
 	std::string m_container_id; ///< heuristic-based container id
 	uint32_t m_flags; ///< The thread flags. See the PPM_CL_* declarations in ppm_events_public.h.
 	int64_t m_fdlimit;  ///< The maximum number of FDs this thread can open
@@ -392,6 +393,7 @@ VISIBILITY_PRIVATE
 	void set_env(const char* env, size_t len);
 	bool set_env_from_proc();
 	void set_cgroups(const char* cgroups, size_t len);
+	bool cgroups_match(const char* cgroups, size_t len) const;
 	bool is_lastevent_data_valid();
 	inline void set_lastevent_data_validity(bool isvalid)
 	{
@@ -441,6 +443,13 @@ VISIBILITY_PRIVATE
 	bool m_parent_loop_detected;
 	blprogram* m_blprogram;
 
+	//
+	// Hooks for the expiry list of the thread table, see threadinfo_map_t
+	//
+	sinsp_threadinfo* m_expiry_prev;
+	sinsp_threadinfo* m_expiry_next;
+	uint64_t m_expiry_ts; // When the thread was (re)queued in the expiry list
+
 	friend class sinsp;
 	friend class sinsp_parser;
 	friend class sinsp_analyzer;
@@ -451,10 +460,19 @@ VISIBILITY_PRIVATE
 	friend class sinsp_tracerparser;
 	friend class lua_cbacks;
 	friend class sinsp_baseliner;
+	friend class threadinfo_map_t;
 };
 
 /*@}*/
 
+//
+// The thread table. Besides the tid->thread map, threads are linked
+// in an intrusive list ordered by the time they were queued, so the
+// thread manager can find expiry candidates from the head of the list
+// without walking the whole table. Lookups don't touch the list: a thread
+// that was accessed after being queued is simply requeued when it
+// reaches the head.
+//
 class threadinfo_map_t
 {
 public:
@@ -464,7 +482,13 @@ public:
 
 	inline void put(sinsp_threadinfo* tinfo)
 	{
-		m_threads[tinfo->m_tid] = ptr_t(tinfo);
+		auto& slot = m_threads[tinfo->m_tid];
+		if(slot)
+		{
+			expiry_unlink(slot.get());
+		}
+		slot = ptr_t(tinfo);
+		expiry_link(tinfo, tinfo->m_lastaccess_ts);
 	}
 
 	inline sinsp_threadinfo* get(uint64_t tid)
@@ -489,14 +513,41 @@ public:
 
 	inline void erase(uint64_t tid)
 	{
-		m_threads.erase(tid);
+		auto it = m_threads.find(tid);
+		if (it == m_threads.end())
+		{
+			return;
+		}
+		expiry_unlink(it->second.get());
+		m_threads.erase(it);
 	}
 
 	inline void clear()
 	{
+		m_expiry_head = nullptr;
+		m_expiry_tail = nullptr;
 		m_threads.clear();
 	}
 
+	//
+	// Return the thread that has been sitting in the expiry list
+	// for the longest time, or nullptr if the table is empty
+	//
+	inline sinsp_threadinfo* expiry_head() const
+	{
+		return m_expiry_head;
+	}
+
+	//
+	// Move a thread to the tail of the expiry list, marking it
+	// as queued at time ts
+	//
+	inline void expiry_requeue(sinsp_threadinfo* tinfo, uint64_t ts)
+	{
+		expiry_unlink(tinfo);
+		expiry_link(tinfo, ts);
+	}
+
 	bool const_loop(const_visitor_t callback) const
 	{
 		for (const auto& it : m_threads)
@@ -527,7 +578,49 @@ public:
 	}
 
 protected:
+	inline void expiry_link(sinsp_threadinfo* tinfo, uint64_t ts)
+	{
+		tinfo->m_expiry_ts = ts;
+		tinfo->m_expiry_prev = m_expiry_tail;
+		tinfo->m_expiry_next = nullptr;
+		if(m_expiry_tail)
+		{
+			m_expiry_tail->m_expiry_next = tinfo;
+		}
+		else
+		{
+			m_expiry_head = tinfo;
+		}
+		m_expiry_tail = tinfo;
+	}
+
+	inline void expiry_unlink(sinsp_threadinfo* tinfo)
+	{
+		if(tinfo->m_expiry_prev)
+		{
+			tinfo->m_expiry_prev->m_expiry_next = tinfo->m_expiry_next;
+		}
+		else
+		{
+			m_expiry_head = tinfo->m_expiry_next;
+		}
+
+		if(tinfo->m_expiry_next)
+		{
+			tinfo->m_expiry_next->m_expiry_prev = tinfo->m_expiry_prev;
+		}
+		else
+		{
+			m_expiry_tail = tinfo->m_expiry_prev;
+		}
+
+		tinfo->m_expiry_prev = nullptr;
+		tinfo->m_expiry_next = nullptr;
+	}
+
 	std::unordered_map<int64_t, ptr_t> m_threads;
+	sinsp_threadinfo* m_expiry_head = nullptr;
+	sinsp_threadinfo* m_expiry_tail = nullptr;
 };
 
 
@@ -637,12 +730,25 @@ private:
 	inline void clear_thread_pointers(sinsp_threadinfo& threadinfo);
 	void free_dump_fdinfos(std::vector<scap_fdinfo*>* fdinfos_to_free);
 	void thread_to_scap(sinsp_threadinfo& tinfo, scap_threadinfo* sctinfo);
+	inline bool expire_fds(sinsp_threadinfo* tinfo, uint32_t* budget);
 
 	sinsp* m_inspector;
 	threadinfo_map_t m_threadtable;
 	int64_t m_last_tid;
 	std::weak_ptr<sinsp_threadinfo> m_last_tinfo;
 	uint64_t m_last_flush_time_ns;
+	// Set when an inactive thread couldn't be removed because of
+	// its child count, so the dependencies must be rebuilt
+	bool m_child_dependencies_dirty;
+	// Upper bound to the expiry checks done for a single event
+	const uint32_t m_max_expiry_checks_per_event = 8;
+	// Upper bound to the fds of expired processes erased for a single event
+	const uint32_t m_max_expired_fds_per_event = 256;
+	// The expired thread whose fds are being erased, -1 if none
+	int64_t m_expiring_tid;
+	// Closed threads that couldn't be removed because of their
+	// child count, retried at the next table scan
+	std::vector<int64_t> m_closed_tids;
 	uint32_t m_n_drops;
 	const uint32_t m_thread_table_absolute_max_size = 131072;
 	uint32_t m_max_thread_table_size;
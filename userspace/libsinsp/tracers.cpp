@@ -20,6 +20,48 @@ limitations under the License.
 #include "sinsp_int.h"
 #include "tracers.h"
 
+namespace {
+
+//
+// The characters that end a token of the simple tracer format (or make
+// it invalid), as a bitmask per character, so that the tokenizer can skip
+// the plain characters with a single lookup each
+//
+enum tracer_char_class
+{
+	TC_TAG_END = 1,
+	TC_ARGNAME_END = 2,
+	TC_ARGVAL_END = 4,
+};
+
+class tracer_char_classes
+{
+public:
+	tracer_char_classes()
+	{
+		memset(m_classes, 0, sizeof(m_classes));
+		set("\\.:><=\n", TC_TAG_END);
+		set("\\=><\n", TC_ARGNAME_END);
+		set("\\,:=", TC_ARGVAL_END);
+		m_classes[0] = TC_TAG_END | TC_ARGNAME_END | TC_ARGVAL_END;
+	}
+
+	uint8_t m_classes[256];
+
+private:
+	void set(const char* chars, uint8_t cls)
+	{
+		for(; *chars != 0; chars++)
+		{
+			m_classes[(uint8_t)*chars] |= cls;
+		}
+	}
+};
+
+const tracer_char_classes g_tracer_chars;
+
+}
+
 sinsp_tracerparser::sinsp_tracerparser(sinsp *inspector)
 {
 	m_inspector = inspector;
@@ -537,13 +579,50 @@ inline void sinsp_tracerparser::parse_json(char* evtstr)
 	return;
 }
 
-inline void sinsp_tracerparser::delete_char(char* p)
+//
+// Advance p to the first unescaped character of end_class, or to the
+// string terminator, removing the escaping backslashes in place. The
+// unescaped token ends at token_end, which is before p if there were
+// escapes.
+//
+inline char* sinsp_tracerparser::scan_token(char* p, uint8_t end_class, char** token_end)
 {
-	while(*p != 0)
+	char* dst = p;
+
+	while(true)
 	{
-		*p = *(p + 1);
+		char* start = p;
+
+		while((g_tracer_chars.m_classes[(uint8_t)*p] & end_class) == 0)
+		{
+			p++;
+		}
+
+		if(dst != start)
+		{
+			memmove(dst, start, p - start);
+		}
+		dst += p - start;
+
+		if(*p != '\\')
+		{
+			break;
+		}
+
+		//
+		// The escaped character is taken as is
+		//
 		p++;
+		if(*p == 0)
+		{
+			break;
+		}
+
+		*dst++ = *p++;
 	}
+
+	*token_end = dst;
+	return p;
 }
 
 inline void sinsp_tracerparser::parse_simple(char* evtstr)
@@ -630,50 +709,27 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 
 	if(*p != ':')
 	{
-		bool dont_interpret_next_char = false;
-
 		while(true)
 		{
 			char* start = p;
+			char* end;
 
 			m_tags.push_back(p);
 
-			while(*p != 0)
-			{
-				if(dont_interpret_next_char)
-				{
-					dont_interpret_next_char = false;
-					++p;
-					continue;
-				}
-
-				if(*p == '\\')
-				{
-					ASSERT(dont_interpret_next_char == false);
-					dont_interpret_next_char = true;
-					delete_char(p);
-					continue;
-				}
-
-				if(*p == '.' || *p == ':')
-				{
-					break;
-				}
-
-				if(*p == '>' || *p == '<' || *p == '=' || *p == '\n')
-				{
-					m_res = sinsp_tracerparser::RES_FAILED;
-					return;
-				}
+			p = scan_token(p, TC_TAG_END, &end);
 
-				++p;
+			if(*p != '.' && *p != ':' && *p != 0)
+			{
+				m_res = sinsp_tracerparser::RES_FAILED;
+				return;
 			}
 
-			m_taglens.push_back((uint32_t)(p - start));
-			m_tot_taglens += (uint32_t)(p - start);
+			m_taglens.push_back((uint32_t)(end - start));
+			m_tot_taglens += (uint32_t)(end - start);
 
 			if(*p == ':')
 			{
+				*end = 0;
 				*p = 0;
 				break;
 			}
@@ -684,6 +740,7 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 			}
 			else
 			{
+				*end = 0;
 				*p = 0;
 				++p;
 			}
@@ -703,54 +760,32 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 
 	if(*p != ':')
 	{
-		bool dont_interpret_next_char = false;
-
 		while(true)
 		{
 			char* start = p;
+			char* end;
 
 			//
 			// Arg name
 			//
 			m_argnames.push_back(p);
 
-			while(*p != 0)
-			{
-				if(dont_interpret_next_char)
-				{
-					dont_interpret_next_char = false;
-					++p;
-					continue;
-				}
+			p = scan_token(p, TC_ARGNAME_END, &end);
 
-				if(*p == '\\')
-				{
-					ASSERT(dont_interpret_next_char == false);
-					dont_interpret_next_char = true;
-					delete_char(p);
-					continue;
-				}
-
-				if(*p == '=')
-				{
-					break;
-				}
-
-				if(*p == '>' || *p == '<' || *p == '\n')
-				{
-					m_res = sinsp_tracerparser::RES_FAILED;
-					return;
-				}
-
-				++p;
+			if(*p != '=' && *p != 0)
+			{
+				m_res = sinsp_tracerparser::RES_FAILED;
+				return;
 			}
 
-			m_argnamelens.push_back((uint32_t)(p - start));
-			m_tot_argnamelens += (uint32_t)(p - start);
+			m_argnamelens.push_back((uint32_t)(end - start));
+			m_tot_argnamelens += (uint32_t)(end - start);
 
 			if(*p == 0)
 			{
-				if(*(p - 1) == ':')
+				*end = 0;
+
+				if(*(end - 1) == ':')
 				{
 					//
 					// This means there was an argument without value, 
@@ -766,6 +801,7 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 			}
 			else
 			{
+				*end = 0;
 				*p = 0;
 				++p;
 			}
@@ -776,49 +812,27 @@ inline void sinsp_tracerparser::parse_simple(char* evtstr)
 			start = p;
 			m_argvals.push_back(p);
 
-			dont_interpret_next_char = false;
-
-			while(*p != 0)
-			{
-				if(dont_interpret_next_char)
-				{
-					dont_interpret_next_char = false;
-					++p;
-					continue;
-				}
-
-				if(*p == '\\')
-				{
-					ASSERT(dont_interpret_next_char == false);
-					dont_interpret_next_char = true;
-					delete_char(p);
-					continue;
-				}
+			p = scan_token(p, TC_ARGVAL_END, &end);
 
-				if(*p == ',' || *p == ':' || *p == '=')
-				{
-					break;
-				}
-
-				++p;
-			}
-
-			m_argvallens.push_back((uint32_t)(p - start));
-			m_tot_argvallens += (uint32_t)(p - start);
+			m_argvallens.push_back((uint32_t)(end - start));
+			m_tot_argvallens += (uint32_t)(end - start);
 
 			if(*p == ':')
 			{
+				*end = 0;
 				*p = 0;
 				m_res = sinsp_tracerparser::RES_OK;
 				break;
 			}
 			else if(*p == 0)
 			{
+				*end = 0;
 				m_res = sinsp_tracerparser::RES_TRUNCATED;
 				break;
 			}
 			else
 			{
+				*end = 0;
 				*p = 0;
 				++p;
 			}
@@ -1071,15 +1085,16 @@ inline sinsp_tracerparser::parse_result sinsp_tracerparser::parsestr(char* p, ch
 	//
 	// Navigate to the end of the string
 	//
-	while(!(*p == '\"' && *(p - 1) != '\\'))
+	p = strchr(p, '"');
+	while(p != NULL && *(p - 1) == '\\')
 	{
-		if(*p == 0)
-		{
-			*delta = (uint32_t)(p - initial + 1);
-			return sinsp_tracerparser::RES_TRUNCATED;
-		}
+		p = strchr(p + 1, '"');
+	}
 
-		p++;
+	if(p == NULL)
+	{
+		*delta = (uint32_t)(strlen(initial) + 1);
+		return sinsp_tracerparser::RES_TRUNCATED;
 	}
 
 	*p = 0;
@@ -1227,11 +1242,7 @@ inline void sinsp_tracerparser::init_partial_tracer(sinsp_partial_tracer* pae)
 	pae->m_ntags = (uint32_t)m_tags.size();
 	uint32_t encoded_tags_len = m_tot_taglens + pae->m_ntags + 1;
 
-	if(pae->m_tags_storage_size < encoded_tags_len)
-	{
-		pae->m_tags_storage = (char*)realloc(pae->m_tags_storage, encoded_tags_len);
-		pae->m_tags_storage_size = encoded_tags_len;
-	}
+	pae->reserve(&pae->m_tags_storage, &pae->m_tags_storage_size, encoded_tags_len);
 
 	char* p = pae->m_tags_storage;
 	for(it = m_tags.begin(), sit = m_taglens.begin(); 
@@ -1254,11 +1265,7 @@ inline void sinsp_tracerparser::init_partial_tracer(sinsp_partial_tracer* pae)
 	pae->m_nargs = (uint32_t)m_argnames.size();
 	uint32_t encoded_argnames_len = m_tot_argnamelens + pae->m_nargs + 1;
 
-	if(pae->m_argnames_storage_size < encoded_argnames_len)
-	{
-		pae->m_argnames_storage = (char*)realloc(pae->m_argnames_storage, encoded_argnames_len);
-		pae->m_argnames_storage_size = encoded_argnames_len;
-	}
+	pae->reserve(&pae->m_argnames_storage, &pae->m_argnames_storage_size, encoded_argnames_len);
 
 	p = pae->m_argnames_storage;
 	for(it = m_argnames.begin(), sit = m_argnamelens.begin(); 
@@ -1280,11 +1287,7 @@ inline void sinsp_tracerparser::init_partial_tracer(sinsp_partial_tracer* pae)
 	pae->m_argvallens.clear();
 	uint32_t encoded_argvals_len = m_tot_argvallens + pae->m_nargs + 1;
 
-	if(pae->m_argvals_storage_size < encoded_argvals_len)
-	{
-		pae->m_argvals_storage = (char*)realloc(pae->m_argvals_storage, encoded_argvals_len);
-		pae->m_argvals_storage_size = encoded_argvals_len;
-	}
+	pae->reserve(&pae->m_argvals_storage, &pae->m_argvals_storage_size, encoded_argvals_len);
 
 	p = pae->m_argvals_storage;
 	for(it = m_argvals.begin(), sit = m_argvallens.begin(); 
@@ -1299,40 +1302,3 @@ inline void sinsp_tracerparser::init_partial_tracer(sinsp_partial_tracer* pae)
 	*p++ = 0;
 	pae->m_argvals_len = (uint32_t)(p - pae->m_argvals_storage);
 }
-
-void sinsp_tracerparser::test()
-{
-	char doc1[] = "[\">\",     12345, [\"mysql\", \"query\", \"init\"], [{\"argname1\":\"argval1\"}, {\"argname2\":\"argval2\"}, {\"argname3\":\"argval3\"}]]";
-
-	m_tinfo = new sinsp_threadinfo(nullptr);
-	m_tinfo->m_ptid = 11;
-	m_tinfo->m_pid = 22;
-	m_tinfo->m_tid = 33;
-
-	printf("1\n");
-
-	float cpu_time = ((float)clock ()) / CLOCKS_PER_SEC;
-
-	for(uint64_t j = 0; j < 30000000; j++)
-	{
-		process_event_data(doc1, sizeof(doc1) - 1, 10);
-
-		if(m_res != sinsp_tracerparser::RES_OK)
-		{
-			printf("ERROR\n");
-		}
-
-		process_event_data(doc1, sizeof(doc1) - 1, 20);
-
-		if(m_res != sinsp_tracerparser::RES_OK)
-		{
-			printf("ERROR\n");
-		}
-	}
-
-	cpu_time = ((float)clock()/ CLOCKS_PER_SEC) - cpu_time;
-	printf ("time: %5.2f\n", cpu_time);
-
-	delete m_tinfo;
-	m_tinfo = nullptr;
-}
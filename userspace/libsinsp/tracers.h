@@ -23,14 +23,18 @@ limitations under the License.
 class sinsp_partial_tracer
 {
 public:
+	//
+	// The storage is allocated by the first reserve(), since most of the
+	// tracers embedded in a sinsp_tracerparser are never filled
+	//
 	sinsp_partial_tracer()
 	{
-		m_tags_storage = (char*)malloc(UESTORAGE_INITIAL_BUFSIZE);
-		m_argnames_storage = (char*)malloc(UESTORAGE_INITIAL_BUFSIZE);
-		m_argvals_storage = (char*)malloc(UESTORAGE_INITIAL_BUFSIZE);
-		m_tags_storage_size = UESTORAGE_INITIAL_BUFSIZE;
-		m_argnames_storage_size = UESTORAGE_INITIAL_BUFSIZE;
-		m_argvals_storage_size = UESTORAGE_INITIAL_BUFSIZE;
+		m_tags_storage = NULL;
+		m_argnames_storage = NULL;
+		m_argvals_storage = NULL;
+		m_tags_storage_size = 0;
+		m_argnames_storage_size = 0;
+		m_argvals_storage_size = 0;
 	}
 
 	~sinsp_partial_tracer()
@@ -51,6 +55,33 @@ public:
 		}
 	}
 
+	inline void reserve(char** storage, uint32_t* storage_size, uint32_t len)
+	{
+		if(*storage_size >= len)
+		{
+			return;
+		}
+
+		uint32_t newsize = *storage_size * 2;
+		if(newsize < UESTORAGE_INITIAL_BUFSIZE)
+		{
+			newsize = UESTORAGE_INITIAL_BUFSIZE;
+		}
+		if(newsize < len)
+		{
+			newsize = len;
+		}
+
+		char* newstorage = (char*)realloc(*storage, newsize);
+		if(newstorage == NULL)
+		{
+			throw sinsp_exception("memory allocation error in sinsp_partial_tracer::reserve.");
+		}
+
+		*storage = newstorage;
+		*storage_size = newsize;
+	}
+
 	inline bool compare(sinsp_partial_tracer* other)
 	{
 		if(m_id != other->m_id)
@@ -143,7 +174,6 @@ public:
 	inline void parse_json(char* evtstr);
 	inline void parse_simple(char* evtstr);
 	sinsp_partial_tracer* find_parent_enter_pae();
-	void test();
 
 	char* m_type_str;
 	int64_t m_id;
@@ -172,8 +202,8 @@ VISIBILITY_PRIVATE
 	inline parse_result parsestr_not_enforce(char* p, char** res, uint32_t* delta);
 	inline parse_result parsenumber(char* p, int64_t* res, uint32_t* delta);
 	inline parse_result parsenumber_colend(char* p, int64_t* res, uint32_t* delta);
+	inline char* scan_token(char* p, uint8_t end_class, char** token_end);
 	inline void init_partial_tracer(sinsp_partial_tracer* pae);
-	inline void delete_char(char* p);
 
 	string m_fullfragment_storage_str;
 	sinsp *m_inspector;
@@ -18,6 +18,7 @@ limitations under the License.
 #pragma once
 
 #include "sinsp_int.h"
+#include "mpsc_queue.h"
 
 #include <memory>
 #include <mutex>
@@ -340,41 +341,65 @@ inline size_t sinsp_user_event::max_events_per_cycle()
 //
 // User-configured events queue
 //
+// Filled by the collector threads (k8s, docker, ...) and drained by the
+// event loop. It's bounded and lock-free, so a burst of events from a
+// collector never blocks the event loop: past the capacity, events are
+// dropped according to the overflow policy and counted in dropped()
+//
 class user_event_queue
 {
 public:
 	typedef std::shared_ptr<user_event_queue> ptr_t;
-	typedef std::deque<sinsp_user_event> type_t;
+	typedef libsinsp::mpsc_queue<sinsp_user_event> type_t;
+
+	static const size_t DEFAULT_CAPACITY = 4096;
 
-	void add(sinsp_user_event&& evt);
+	user_event_queue(size_t capacity = DEFAULT_CAPACITY,
+		type_t::overflow_policy policy = type_t::DROP_OLDEST);
+
+	//
+	// Return false if the event was dropped because the queue was full
+	//
+	bool add(sinsp_user_event&& evt);
 	bool get(sinsp_user_event& evt);
-	type_t::size_type count() const;
+
+	//
+	// Move up to max events to the end of evts, returning how many
+	//
+	size_t get_batch(std::vector<sinsp_user_event>& evts, size_t max);
+	size_t count() const;
+	uint64_t dropped() const;
 
 private:
 	type_t m_queue;
-	mutable std::mutex m_mutex;
 };
 
-inline void user_event_queue::add(sinsp_user_event&& evt)
+inline user_event_queue::user_event_queue(size_t capacity, type_t::overflow_policy policy):
+	m_queue(capacity, policy)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	m_queue.emplace_back(std::move(evt));
+}
+
+inline bool user_event_queue::add(sinsp_user_event&& evt)
+{
+	return m_queue.push(std::move(evt));
 }
 
 inline bool user_event_queue::get(sinsp_user_event& evt)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	if(!m_queue.size())
-	{
-		return false;
-	}
-	evt = std::move(m_queue.front());
-	m_queue.pop_front();
-	return true;
+	return m_queue.pop(evt);
+}
+
+inline size_t user_event_queue::get_batch(std::vector<sinsp_user_event>& evts, size_t max)
+{
+	return m_queue.pop_batch(evts, max);
 }
 
-inline user_event_queue::type_t::size_type user_event_queue::count() const
+inline size_t user_event_queue::count() const
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
 	return m_queue.size();
 }
+
+inline uint64_t user_event_queue::dropped() const
+{
+	return m_queue.dropped();
+}
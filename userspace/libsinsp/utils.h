@@ -291,6 +291,8 @@ public:
 	simple_lifo_queue(uint32_t size)
 	{
 		uint32_t j;
+		m_full_list.reserve(size);
+		m_avail_list.reserve(size);
 		for(j = 0; j < size; j++)
 		{
 			OBJ* newentry = new OBJ;
@@ -300,17 +302,18 @@ public:
 	}
 	~simple_lifo_queue()
 	{
-		while(!m_avail_list.empty())
+		for(OBJ* entry : m_full_list)
 		{
-			OBJ* head = m_avail_list.front();
-			delete head;
-			m_avail_list.pop_front();
+			delete entry;
 		}
 	}
+	//
+	// The available entries are a stack on a vector, so that pushing and
+	// popping never allocate
+	//
 	void push(OBJ* newentry)
-
 	{
-		m_avail_list.push_front(newentry);
+		m_avail_list.push_back(newentry);
 	}
 
 	OBJ* pop()
@@ -319,8 +322,8 @@ public:
 		{
 			return NULL;
 		}
-		OBJ* head = m_avail_list.front();
-		m_avail_list.pop_front();
+		OBJ* head = m_avail_list.back();
+		m_avail_list.pop_back();
 		return head;
 	}
 
@@ -330,8 +333,8 @@ public:
 	}
 
 private:
-	std::list<OBJ*> m_avail_list;
-	std::list<OBJ*> m_full_list;
+	std::vector<OBJ*> m_avail_list;
+	std::vector<OBJ*> m_full_list;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -32,6 +32,13 @@ typedef enum sinsp_field_aggregation
 	A_TIME_AVG,
 	A_MIN,
 	A_MAX,		
+	//
+	// Approximate aggregations, with bounded memory per row (see sketch.h)
+	//
+	A_DISTINCT,	// HyperLogLog count of the distinct values
+	A_P50,		// t-digest median
+	A_P99,		// t-digest 99th percentile
+	A_TOP,		// most frequent value, from a Count-Min sketch
 }sinsp_field_aggregation;
 
 //